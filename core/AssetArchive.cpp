@@ -0,0 +1,607 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "AssetArchive.h"
+#include "Memory.h"
+#include "StringId.h"
+
+#include "external/zstd/zstd.h"
+
+#include <cstring>
+
+namespace aga
+{
+    static StringView StripCurrentDirectory(StringView path)
+    {
+        while (path.Length() >= 2 && path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+        {
+            path = path.Substring(2);
+        }
+
+        return path;
+    }
+
+    static char NormalizeSeparator(char c)
+    {
+        return c == '\\' ? '/' : c;
+    }
+
+    uint64_t HashAssetPath(StringView path)
+    {
+        path = StripCurrentDirectory(path);
+
+        uint64_t hash = STRING_ID_FNV_OFFSET;
+
+        for (uint32_t i = 0; i < path.Length(); ++i)
+        {
+            hash = (hash ^ (uint8_t)NormalizeSeparator(path[i])) * STRING_ID_FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    String NormalizeAssetPath(StringView path)
+    {
+        path = StripCurrentDirectory(path);
+
+        String normalized(path.GetData(), path.Length());
+
+        for (uint32_t i = 0; i < normalized.Length(); ++i)
+        {
+            normalized[i] = NormalizeSeparator(normalized[i]);
+        }
+
+        return normalized;
+    }
+
+    AssetArchive::AssetArchive()
+        : m_File(nullptr),
+          m_SlotMask(0),
+          m_Slots(nullptr),
+          m_Entries(nullptr),
+          m_Chunks(nullptr),
+          m_Names(nullptr),
+          m_EntryCount(0),
+          m_DecompressContext(nullptr)
+    {
+    }
+
+    AssetArchive::~AssetArchive()
+    {
+        Close();
+    }
+
+    bool AssetArchive::Open(const char *path)
+    {
+        MemoryTagScope scope(MemoryTag::Core);
+
+        Close();
+
+        m_File = std::fopen(path, "rb");
+
+        if (!m_File)
+        {
+            return false;
+        }
+
+        //  Every offset and size in the header and the TOC is checked against the file size before it is used
+        const long end = std::fseek(m_File, 0, SEEK_END) == 0 ? std::ftell(m_File) : -1;
+        const uint64_t fileSize = end > 0 ? (uint64_t)end : 0;
+
+        AssetArchiveHeader header;
+
+        bool valid = std::fseek(m_File, 0, SEEK_SET) == 0 && std::fread(&header, sizeof(header), 1, m_File) == 1 &&
+                     memcmp(header.Magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC)) == 0 &&
+                     header.Version == ASSET_ARCHIVE_VERSION && header.ChunkSize == ASSET_ARCHIVE_CHUNK_SIZE;
+
+        //  The slot count is a power of two and leaves room for an empty slot, the slots themselves are checked below
+        valid = valid && header.SlotCount > header.EntryCount && (header.SlotCount & (header.SlotCount - 1)) == 0;
+
+        const uint64_t tocSize = (uint64_t)header.SlotCount * sizeof(uint32_t) +
+                                 (uint64_t)header.EntryCount * sizeof(AssetArchiveEntry) +
+                                 (uint64_t)header.ChunkCount * sizeof(AssetArchiveChunk) + header.NamesSize;
+
+        valid = valid && header.TocSize == tocSize && header.TocOffset >= sizeof(header) &&
+                header.TocOffset <= fileSize && tocSize <= fileSize - header.TocOffset;
+
+        if (valid)
+        {
+            m_Toc.resize((size_t)tocSize);
+
+            valid = std::fseek(m_File, (long)header.TocOffset, SEEK_SET) == 0 &&
+                    std::fread(m_Toc.data(), 1, m_Toc.size(), m_File) == m_Toc.size();
+        }
+
+        if (!valid)
+        {
+            Close();
+
+            return false;
+        }
+
+        const uint8_t *toc = m_Toc.data();
+
+        m_Slots = reinterpret_cast<const uint32_t *>(toc);
+        toc += header.SlotCount * sizeof(uint32_t);
+        m_Entries = reinterpret_cast<const AssetArchiveEntry *>(toc);
+        toc += header.EntryCount * sizeof(AssetArchiveEntry);
+        m_Chunks = reinterpret_cast<const AssetArchiveChunk *>(toc);
+        toc += header.ChunkCount * sizeof(AssetArchiveChunk);
+        m_Names = reinterpret_cast<const char *>(toc);
+
+        m_SlotMask = header.SlotCount - 1;
+        m_EntryCount = header.EntryCount;
+        m_Path = path;
+
+        //  Find indexes m_Entries with every slot and stops probing only at an empty one
+        bool hasEmptySlot = false;
+
+        for (uint32_t i = 0; i < header.SlotCount; ++i)
+        {
+            if (m_Slots[i] > header.EntryCount)
+            {
+                Close();
+
+                return false;
+            }
+
+            hasEmptySlot = hasEmptySlot || m_Slots[i] == 0;
+        }
+
+        if (!hasEmptySlot)
+        {
+            Close();
+
+            return false;
+        }
+
+        //  Chunk data lies between the header and the TOC
+        for (uint32_t i = 0; i < header.ChunkCount; ++i)
+        {
+            const AssetArchiveChunk &chunk = m_Chunks[i];
+
+            if (chunk.Offset < sizeof(header) || chunk.Offset > header.TocOffset ||
+                chunk.CompressedSize > header.TocOffset - chunk.Offset)
+            {
+                Close();
+
+                return false;
+            }
+        }
+
+        //  Entries pointing outside the TOC would make every later lookup unsafe, check them once here
+        for (uint32_t i = 0; i < m_EntryCount; ++i)
+        {
+            const AssetArchiveEntry &entry = m_Entries[i];
+
+            if ((uint64_t)entry.FirstChunk + entry.ChunkCount > header.ChunkCount ||
+                (uint64_t)entry.NameOffset + entry.NameLength > header.NamesSize ||
+                (entry.Size + ASSET_ARCHIVE_CHUNK_SIZE - 1) / ASSET_ARCHIVE_CHUNK_SIZE != entry.ChunkCount)
+            {
+                Close();
+
+                return false;
+            }
+
+            //  Read fetches an entry's chunks with one read sized by the first and the last, so they have to follow
+            //  each other
+            for (uint32_t chunk = entry.FirstChunk + 1; chunk < entry.FirstChunk + entry.ChunkCount; ++chunk)
+            {
+                if (m_Chunks[chunk].Offset != m_Chunks[chunk - 1].Offset + m_Chunks[chunk - 1].CompressedSize)
+                {
+                    Close();
+
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void AssetArchive::Close()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        if (m_File)
+        {
+            std::fclose(m_File);
+            m_File = nullptr;
+        }
+
+        if (m_DecompressContext)
+        {
+            ZSTD_freeDCtx(static_cast<ZSTD_DCtx *>(m_DecompressContext));
+            m_DecompressContext = nullptr;
+        }
+
+        m_Toc.clear();
+        m_Compressed.clear();
+        m_Slots = nullptr;
+        m_Entries = nullptr;
+        m_Chunks = nullptr;
+        m_Names = nullptr;
+        m_SlotMask = 0;
+        m_EntryCount = 0;
+        m_Path = "";
+    }
+
+    bool AssetArchive::IsOpen() const
+    {
+        return m_File != nullptr;
+    }
+
+    const String &AssetArchive::GetPath() const
+    {
+        return m_Path;
+    }
+
+    uint32_t AssetArchive::Find(StringView path) const
+    {
+        if (!m_File)
+        {
+            return ASSET_ARCHIVE_INVALID_ENTRY;
+        }
+
+        path = StripCurrentDirectory(path);
+
+        const uint64_t hash = HashAssetPath(path);
+
+        for (uint32_t slot = (uint32_t)hash & m_SlotMask;; slot = (slot + 1) & m_SlotMask)
+        {
+            const uint32_t index = m_Slots[slot];
+
+            if (index == 0)
+            {
+                return ASSET_ARCHIVE_INVALID_ENTRY;
+            }
+
+            const AssetArchiveEntry &entry = m_Entries[index - 1];
+
+            if (entry.PathHash != hash || entry.NameLength != path.Length())
+            {
+                continue;
+            }
+
+            //  Names are compared too, a hash collision must not hand out the wrong asset
+            const char *name = m_Names + entry.NameOffset;
+            uint32_t i = 0;
+
+            while (i < path.Length() && name[i] == NormalizeSeparator(path[i]))
+            {
+                ++i;
+            }
+
+            if (i == path.Length())
+            {
+                return index - 1;
+            }
+        }
+    }
+
+    uint32_t AssetArchive::GetEntryCount() const
+    {
+        return m_EntryCount;
+    }
+
+    StringView AssetArchive::GetEntryName(uint32_t entry) const
+    {
+        return entry < m_EntryCount ? StringView(m_Names + m_Entries[entry].NameOffset, m_Entries[entry].NameLength)
+                                    : StringView();
+    }
+
+    uint64_t AssetArchive::GetEntrySize(uint32_t entry) const
+    {
+        return entry < m_EntryCount ? m_Entries[entry].Size : 0;
+    }
+
+    bool AssetArchive::Read(uint32_t entry, std::vector<uint8_t> &data) const
+    {
+        if (entry >= m_EntryCount)
+        {
+            return false;
+        }
+
+        data.resize((size_t)m_Entries[entry].Size);
+
+        if (!Read(entry, data.data()))
+        {
+            data.clear();
+
+            return false;
+        }
+
+        return true;
+    }
+
+    bool AssetArchive::Read(uint32_t entry, uint8_t *data) const
+    {
+        if (entry >= m_EntryCount)
+        {
+            return false;
+        }
+
+        const AssetArchiveEntry &info = m_Entries[entry];
+        const size_t size = (size_t)info.Size;
+
+        if (info.ChunkCount == 0)
+        {
+            return true;
+        }
+
+        const AssetArchiveChunk *chunks = m_Chunks + info.FirstChunk;
+        const AssetArchiveChunk &last = chunks[info.ChunkCount - 1];
+        const uint64_t first = chunks[0].Offset;
+        const size_t span = (size_t)(last.Offset + last.CompressedSize - first);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        //  Chunks of an entry are contiguous, an entry stored without compression is read straight into place
+        const bool stored = span == size;
+        uint8_t *input = data;
+
+        if (!stored)
+        {
+            m_Compressed.resize(span);
+            input = m_Compressed.data();
+        }
+
+        if (std::fseek(m_File, (long)first, SEEK_SET) != 0 || std::fread(input, 1, span, m_File) != span)
+        {
+            return false;
+        }
+
+        if (stored)
+        {
+            return true;
+        }
+
+        if (!m_DecompressContext)
+        {
+            m_DecompressContext = ZSTD_createDCtx();
+
+            if (!m_DecompressContext)
+            {
+                return false;
+            }
+        }
+
+        for (uint32_t i = 0; i < info.ChunkCount; ++i)
+        {
+            const AssetArchiveChunk &chunk = chunks[i];
+            const size_t offset = (size_t)i * ASSET_ARCHIVE_CHUNK_SIZE;
+            const size_t chunkSize =
+                size - offset < ASSET_ARCHIVE_CHUNK_SIZE ? size - offset : ASSET_ARCHIVE_CHUNK_SIZE;
+
+            if (chunk.Offset < first || chunk.Offset - first + chunk.CompressedSize > span)
+            {
+                return false;
+            }
+
+            const uint8_t *source = input + (chunk.Offset - first);
+
+            if (chunk.Flags == AssetChunkStored)
+            {
+                if (chunk.CompressedSize != chunkSize)
+                {
+                    return false;
+                }
+
+                memcpy(data + offset, source, chunkSize);
+
+                continue;
+            }
+
+            const size_t result = ZSTD_decompressDCtx(static_cast<ZSTD_DCtx *>(m_DecompressContext), data + offset,
+                                                      chunkSize, source, chunk.CompressedSize);
+
+            if (ZSTD_isError(result) || result != chunkSize)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    AssetArchiveWriter::AssetArchiveWriter()
+        : m_File(nullptr), m_Level(0), m_Failed(false), m_Offset(0), m_CompressContext(nullptr)
+    {
+    }
+
+    AssetArchiveWriter::~AssetArchiveWriter()
+    {
+        if (m_File)
+        {
+            std::fclose(m_File);
+        }
+
+        ZSTD_freeCCtx(static_cast<ZSTD_CCtx *>(m_CompressContext));
+    }
+
+    bool AssetArchiveWriter::Open(const char *path, int level)
+    {
+        if (m_File)
+        {
+            std::fclose(m_File);
+        }
+
+        m_File = std::fopen(path, "wb");
+        m_Level = level;
+        m_Failed = false;
+        m_Offset = 0;
+        m_Entries.clear();
+        m_Chunks.clear();
+        m_Names.clear();
+
+        if (!m_File)
+        {
+            return false;
+        }
+
+        if (!m_CompressContext)
+        {
+            m_CompressContext = ZSTD_createCCtx();
+
+            if (!m_CompressContext)
+            {
+                std::fclose(m_File);
+                m_File = nullptr;
+
+                return false;
+            }
+        }
+
+        //  Filled in by Close once the TOC position is known
+        AssetArchiveHeader header;
+        memset(&header, 0, sizeof(header));
+
+        return _Write(&header, sizeof(header));
+    }
+
+    bool AssetArchiveWriter::Add(StringView path, const uint8_t *data, size_t size)
+    {
+        if (!m_File || m_Failed)
+        {
+            return false;
+        }
+
+        const String name = NormalizeAssetPath(path);
+        const uint64_t hash = HashString(name.GetData(), name.Length());
+
+        for (const AssetArchiveEntry &entry : m_Entries)
+        {
+            if (entry.PathHash == hash)
+            {
+                return false;
+            }
+        }
+
+        AssetArchiveEntry entry;
+        entry.PathHash = hash;
+        entry.Size = size;
+        entry.FirstChunk = (uint32_t)m_Chunks.size();
+        entry.ChunkCount = (uint32_t)((size + ASSET_ARCHIVE_CHUNK_SIZE - 1) / ASSET_ARCHIVE_CHUNK_SIZE);
+        entry.NameOffset = (uint32_t)m_Names.size();
+        entry.NameLength = name.Length();
+
+        m_Compressed.resize(ZSTD_compressBound(ASSET_ARCHIVE_CHUNK_SIZE));
+
+        for (size_t offset = 0; offset < size; offset += ASSET_ARCHIVE_CHUNK_SIZE)
+        {
+            const size_t chunkSize =
+                size - offset < ASSET_ARCHIVE_CHUNK_SIZE ? size - offset : ASSET_ARCHIVE_CHUNK_SIZE;
+
+            const size_t compressed = ZSTD_compressCCtx(static_cast<ZSTD_CCtx *>(m_CompressContext),
+                                                        m_Compressed.data(), m_Compressed.size(), data + offset,
+                                                        chunkSize, m_Level);
+
+            AssetArchiveChunk chunk;
+            chunk.Offset = m_Offset;
+
+            //  Incompressible chunks, e.g. PNG data, are cheaper to read as they are
+            if (!ZSTD_isError(compressed) && compressed < chunkSize)
+            {
+                chunk.CompressedSize = (uint32_t)compressed;
+                chunk.Flags = AssetChunkZstd;
+
+                _Write(m_Compressed.data(), compressed);
+            }
+            else
+            {
+                chunk.CompressedSize = (uint32_t)chunkSize;
+                chunk.Flags = AssetChunkStored;
+
+                _Write(data + offset, chunkSize);
+            }
+
+            m_Chunks.push_back(chunk);
+        }
+
+        m_Entries.push_back(entry);
+        m_Names.insert(m_Names.end(), name.GetData(), name.GetData() + name.Length());
+        m_Names.push_back('\0');
+
+        return !m_Failed;
+    }
+
+    bool AssetArchiveWriter::Close()
+    {
+        if (!m_File)
+        {
+            return false;
+        }
+
+        //  At most half full, keeps probe sequences short
+        uint32_t slotCount = 2;
+
+        while (slotCount < m_Entries.size() * 2)
+        {
+            slotCount *= 2;
+        }
+
+        std::vector<uint32_t> slots(slotCount, 0);
+
+        for (uint32_t i = 0; i < (uint32_t)m_Entries.size(); ++i)
+        {
+            uint32_t slot = (uint32_t)m_Entries[i].PathHash & (slotCount - 1);
+
+            while (slots[slot] != 0)
+            {
+                slot = (slot + 1) & (slotCount - 1);
+            }
+
+            slots[slot] = i + 1;
+        }
+
+        AssetArchiveHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.Magic, ASSET_ARCHIVE_MAGIC, sizeof(ASSET_ARCHIVE_MAGIC));
+        header.Version = ASSET_ARCHIVE_VERSION;
+        header.ChunkSize = ASSET_ARCHIVE_CHUNK_SIZE;
+        header.EntryCount = (uint32_t)m_Entries.size();
+        header.SlotCount = slotCount;
+        header.ChunkCount = (uint32_t)m_Chunks.size();
+        header.NamesSize = (uint32_t)m_Names.size();
+        header.TocOffset = m_Offset;
+
+        _Write(slots.data(), slots.size() * sizeof(uint32_t));
+        _Write(m_Entries.data(), m_Entries.size() * sizeof(AssetArchiveEntry));
+        _Write(m_Chunks.data(), m_Chunks.size() * sizeof(AssetArchiveChunk));
+        _Write(m_Names.data(), m_Names.size());
+
+        header.TocSize = m_Offset - header.TocOffset;
+
+        if (std::fseek(m_File, 0, SEEK_SET) != 0)
+        {
+            m_Failed = true;
+        }
+
+        _Write(&header, sizeof(header));
+
+        if (std::fclose(m_File) != 0)
+        {
+            m_Failed = true;
+        }
+
+        m_File = nullptr;
+
+        return !m_Failed;
+    }
+
+    uint64_t AssetArchiveWriter::GetDataSize() const
+    {
+        return m_Offset;
+    }
+
+    bool AssetArchiveWriter::_Write(const void *data, size_t size)
+    {
+        if (!m_Failed && size > 0 && std::fwrite(data, 1, size, m_File) != size)
+        {
+            m_Failed = true;
+        }
+
+        m_Offset += size;
+
+        return !m_Failed;
+    }
+}  // namespace aga
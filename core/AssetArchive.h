@@ -0,0 +1,160 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "String.h"
+#include "StringView.h"
+#include "Typedefs.h"
+
+#include <cstdio>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Archive files hold many assets in one file, read with a single open and mostly sequential reads. Layout,
+    //  in host byte order:
+    //
+    //      Header      AssetArchiveHeader
+    //      Data        compressed chunks of every entry, back to back in entry order
+    //      TOC         slots (4 * SlotCount), entries (AssetArchiveEntry), chunks (AssetArchiveChunk), names
+    //
+    //  Entries are split into ASSET_ARCHIVE_CHUNK_SIZE pieces of uncompressed data, each compressed with zstd on
+    //  its own. Chunks that do not shrink are stored as they are. The slots are an open addressing hash table
+    //  over the path hashes, holding entry index + 1 or 0 when empty.
+    const char ASSET_ARCHIVE_MAGIC[8] = {'A', 'G', 'A', 'P', 'A', 'K', '0', '1'};
+    const uint32_t ASSET_ARCHIVE_VERSION = 1;
+    const uint32_t ASSET_ARCHIVE_CHUNK_SIZE = 64 * 1024;
+
+    struct AssetArchiveHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t ChunkSize;
+        uint32_t EntryCount;
+        uint32_t SlotCount;
+        uint32_t ChunkCount;
+        uint32_t NamesSize;
+        uint64_t TocOffset;
+        uint64_t TocSize;
+    };
+
+    struct AssetArchiveEntry
+    {
+        //  HashString of the normalized path
+        uint64_t PathHash;
+        uint64_t Size;
+        uint32_t FirstChunk;
+        uint32_t ChunkCount;
+        uint32_t NameOffset;
+        uint32_t NameLength;
+    };
+
+    enum AssetArchiveChunkFlags
+    {
+        AssetChunkStored = 0,
+        AssetChunkZstd = 1
+    };
+
+    struct AssetArchiveChunk
+    {
+        uint64_t Offset;
+        uint32_t CompressedSize;
+        uint32_t Flags;
+    };
+
+    //  Entry index returned when a path is not in the archive
+    const uint32_t ASSET_ARCHIVE_INVALID_ENTRY = 0xFFFFFFFF;
+
+    //  Turns 'path' into the form entries are stored and looked up by: forward slashes, no leading "./"
+    String NormalizeAssetPath(StringView path);
+
+    //  Same as HashString(NormalizeAssetPath(path)), without building the string
+    uint64_t HashAssetPath(StringView path);
+
+    //  Read access to an archive file. The TOC is loaded by Open, entry data is read on demand. Reads are
+    //  serialized, so an archive can be shared between threads.
+    class AssetArchive
+    {
+    public:
+        AssetArchive();
+        ~AssetArchive();
+
+        AssetArchive(const AssetArchive &) = delete;
+        void operator=(const AssetArchive &) = delete;
+
+        bool Open(const char *path);
+        void Close();
+
+        bool IsOpen() const;
+        const String &GetPath() const;
+
+        //  Index of the entry stored under the normalized 'path', or ASSET_ARCHIVE_INVALID_ENTRY
+        uint32_t Find(StringView path) const;
+
+        uint32_t GetEntryCount() const;
+        StringView GetEntryName(uint32_t entry) const;
+        uint64_t GetEntrySize(uint32_t entry) const;
+
+        //  Replaces 'data' with the uncompressed contents of the entry
+        bool Read(uint32_t entry, std::vector<uint8_t> &data) const;
+
+        //  Decodes the entry into 'data', which has room for GetEntrySize bytes
+        bool Read(uint32_t entry, uint8_t *data) const;
+
+    private:
+        FILE *m_File;
+        String m_Path;
+
+        uint32_t m_SlotMask;
+        std::vector<uint8_t> m_Toc;
+        const uint32_t *m_Slots;
+        const AssetArchiveEntry *m_Entries;
+        const AssetArchiveChunk *m_Chunks;
+        const char *m_Names;
+        uint32_t m_EntryCount;
+
+        mutable std::mutex m_Mutex;
+        mutable std::vector<uint8_t> m_Compressed;
+        mutable void *m_DecompressContext;
+    };
+
+    //  Builds an archive file, used by the AssetPacker tool
+    class AssetArchiveWriter
+    {
+    public:
+        AssetArchiveWriter();
+        ~AssetArchiveWriter();
+
+        AssetArchiveWriter(const AssetArchiveWriter &) = delete;
+        void operator=(const AssetArchiveWriter &) = delete;
+
+        //  'level' is the zstd compression level, it only changes packing time and size, not read speed much
+        bool Open(const char *path, int level);
+
+        //  Fails when the file is not open, or when another entry has the same normalized path
+        bool Add(StringView path, const uint8_t *data, size_t size);
+
+        //  Writes the TOC and the header, the archive is complete only after this returned true
+        bool Close();
+
+        //  Compressed size of the data written so far
+        uint64_t GetDataSize() const;
+
+    private:
+        bool _Write(const void *data, size_t size);
+
+    private:
+        FILE *m_File;
+        int m_Level;
+        bool m_Failed;
+        uint64_t m_Offset;
+
+        std::vector<AssetArchiveEntry> m_Entries;
+        std::vector<AssetArchiveChunk> m_Chunks;
+        std::vector<char> m_Names;
+        std::vector<uint8_t> m_Compressed;
+        void *m_CompressContext;
+    };
+}  // namespace aga
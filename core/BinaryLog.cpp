@@ -0,0 +1,379 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "BinaryLog.h"
+
+#include <cstring>
+#include <fstream>
+
+namespace aga
+{
+    template <typename T>
+    static inline void Put(char *&output, const T &value)
+    {
+        memcpy(output, &value, sizeof(T));
+        output += sizeof(T);
+    }
+
+    template <typename T>
+    static inline bool Get(const char *&input, const char *end, T &value)
+    {
+        if ((size_t)(end - input) < sizeof(T))
+        {
+            return false;
+        }
+
+        memcpy(&value, input, sizeof(T));
+        input += sizeof(T);
+
+        return true;
+    }
+
+    //  Format id, format pointer, format length, function length
+    const uint32_t PACKED_HEADER_SIZE = sizeof(uint64_t) * 2 + sizeof(uint32_t) + sizeof(uint16_t);
+
+    uint32_t PackLogMessage(char *buffer, uint32_t size, const LogFormatString &format, StringView function,
+                            const FormatArgument *arguments, uint32_t count)
+    {
+        const uint16_t functionLength = (uint16_t)(function.Length() < 256 ? function.Length() : 256);
+
+        if (PACKED_HEADER_SIZE + functionLength + 1 > size)
+        {
+            return 0;
+        }
+
+        char *output = buffer;
+
+        Put(output, format.Id);
+        Put(output, (uint64_t)(uintptr_t)format.Text);
+        Put(output, format.Length);
+        Put(output, functionLength);
+
+        memcpy(output, function.GetData(), functionLength);
+        output += functionLength;
+
+        char *countOutput = output++;
+        uint8_t written = 0;
+
+        for (uint32_t i = 0; i < count && i < LOG_MAX_FORMAT_ARGUMENTS; ++i, ++written)
+        {
+            const uint32_t length = arguments[i].Serialize(output, size - (uint32_t)(output - buffer));
+
+            if (length == 0)
+            {
+                break;
+            }
+
+            output += length;
+        }
+
+        *countOutput = (char)written;
+
+        return (uint32_t)(output - buffer);
+    }
+
+    //  Reads the parts of a packed message, 'arguments' holds LOG_MAX_FORMAT_ARGUMENTS entries
+    static bool UnpackLogMessage(StringView packed, uint64_t &id, StringView &format, StringView &function,
+                                 FormatArgument *arguments, uint32_t &count, StringView &serialized)
+    {
+        const char *input = packed.GetData();
+        const char *end = input + packed.Length();
+
+        uint64_t text;
+        uint32_t formatLength;
+        uint16_t functionLength;
+        uint8_t argumentCount;
+
+        if (!Get(input, end, id) || !Get(input, end, text) || !Get(input, end, formatLength) ||
+            !Get(input, end, functionLength) || (size_t)(end - input) < functionLength)
+        {
+            return false;
+        }
+
+        format = StringView((const char *)(uintptr_t)text, formatLength);
+        function = StringView(input, functionLength);
+        input += functionLength;
+
+        if (!Get(input, end, argumentCount))
+        {
+            return false;
+        }
+
+        serialized = StringView(input, (uint32_t)(end - input));
+        count = 0;
+
+        while (count < argumentCount && count < LOG_MAX_FORMAT_ARGUMENTS)
+        {
+            const uint32_t length = FormatArgument::Deserialize(input, (uint32_t)(end - input), arguments[count]);
+
+            if (length == 0)
+            {
+                return false;
+            }
+
+            input += length;
+            ++count;
+        }
+
+        return true;
+    }
+
+    uint32_t FormatLogMessage(StringView packed, char *buffer, uint32_t size, StringView &function)
+    {
+        uint64_t id;
+        StringView format;
+        StringView serialized;
+        FormatArgument arguments[LOG_MAX_FORMAT_ARGUMENTS];
+        uint32_t count;
+
+        if (!UnpackLogMessage(packed, id, format, function, arguments, count, serialized))
+        {
+            return FormatArguments(buffer, size, "<malformed log message>\n", nullptr, 0);
+        }
+
+        return FormatArguments(buffer, size, format, arguments, count);
+    }
+
+    BinaryLogWriter::BinaryLogWriter() : m_File(nullptr)
+    {
+    }
+
+    BinaryLogWriter::~BinaryLogWriter()
+    {
+        Close();
+    }
+
+    bool BinaryLogWriter::Open(const char *path)
+    {
+        Close();
+
+        m_File = std::fopen(path, "wb");
+
+        if (!m_File)
+        {
+            return false;
+        }
+
+        std::fwrite(BINARY_LOG_MAGIC, 1, sizeof(BINARY_LOG_MAGIC), m_File);
+
+        return true;
+    }
+
+    void BinaryLogWriter::Close()
+    {
+        if (m_File)
+        {
+            std::fclose(m_File);
+            m_File = nullptr;
+        }
+
+        m_Defined.clear();
+    }
+
+    bool BinaryLogWriter::IsOpen() const
+    {
+        return m_File != nullptr;
+    }
+
+    void BinaryLogWriter::_Define(uint64_t id, StringView text)
+    {
+        if (!m_Defined.insert(id).second)
+        {
+            return;
+        }
+
+        char header[1 + sizeof(uint64_t) + sizeof(uint32_t)];
+        char *output = header;
+
+        Put(output, (uint8_t)BinaryLogDefinition);
+        Put(output, id);
+        Put(output, text.Length());
+
+        std::fwrite(header, 1, sizeof(header), m_File);
+        std::fwrite(text.GetData(), 1, text.Length(), m_File);
+    }
+
+    void BinaryLogWriter::WriteText(uint8_t level, int64_t time, StringView text)
+    {
+        char header[2 + sizeof(int64_t) + sizeof(uint32_t)];
+        char *output = header;
+
+        Put(output, (uint8_t)BinaryLogText);
+        Put(output, level);
+        Put(output, time);
+        Put(output, text.Length());
+
+        std::fwrite(header, 1, sizeof(header), m_File);
+        std::fwrite(text.GetData(), 1, text.Length(), m_File);
+    }
+
+    void BinaryLogWriter::WriteMessage(uint8_t level, int64_t time, StringView packed)
+    {
+        uint64_t formatId;
+        StringView format;
+        StringView function;
+        StringView serialized;
+        FormatArgument arguments[LOG_MAX_FORMAT_ARGUMENTS];
+        uint32_t count;
+
+        if (!UnpackLogMessage(packed, formatId, format, function, arguments, count, serialized))
+        {
+            return;
+        }
+
+        const uint64_t functionId = HashString(function.GetData(), function.Length());
+
+        _Define(formatId, format);
+        _Define(functionId, function);
+
+        char header[3 + sizeof(int64_t) + sizeof(uint64_t) * 2 + sizeof(uint32_t)];
+        char *output = header;
+
+        Put(output, (uint8_t)BinaryLogMessage);
+        Put(output, level);
+        Put(output, time);
+        Put(output, formatId);
+        Put(output, functionId);
+        Put(output, (uint8_t)count);
+        Put(output, serialized.Length());
+
+        std::fwrite(header, 1, sizeof(header), m_File);
+        std::fwrite(serialized.GetData(), 1, serialized.Length(), m_File);
+    }
+
+    void BinaryLogWriter::Flush()
+    {
+        if (m_File)
+        {
+            std::fflush(m_File);
+        }
+    }
+
+    BinaryLogReader::BinaryLogReader() : m_Offset(0)
+    {
+    }
+
+    bool BinaryLogReader::Open(const char *path)
+    {
+        std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        m_Data.resize((size_t)file.tellg());
+        file.seekg(0);
+        file.read(m_Data.data(), m_Data.size());
+
+        m_Definitions.clear();
+        m_Offset = sizeof(BINARY_LOG_MAGIC);
+
+        return m_Data.size() >= sizeof(BINARY_LOG_MAGIC) &&
+               memcmp(m_Data.data(), BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) == 0;
+    }
+
+    bool BinaryLogReader::Read(Entry &entry)
+    {
+        const char *input = m_Data.data() + m_Offset;
+        const char *end = m_Data.data() + m_Data.size();
+
+        while (input < end)
+        {
+            uint8_t kind;
+            Get(input, end, kind);
+
+            if (kind == BinaryLogDefinition)
+            {
+                uint64_t id;
+                uint32_t length;
+
+                if (!Get(input, end, id) || !Get(input, end, length) || (size_t)(end - input) < length)
+                {
+                    return false;
+                }
+
+                m_Definitions[id] = String(input, length);
+                input += length;
+
+                continue;
+            }
+
+            if (!Get(input, end, entry.Level) || !Get(input, end, entry.Time))
+            {
+                return false;
+            }
+
+            if (kind == BinaryLogText)
+            {
+                uint32_t length;
+
+                if (!Get(input, end, length) || (size_t)(end - input) < length)
+                {
+                    return false;
+                }
+
+                entry.Function = StringView();
+                entry.Message = StringView(input, length);
+                m_Offset = input + length - m_Data.data();
+
+                return true;
+            }
+
+            if (kind != BinaryLogMessage)
+            {
+                return false;
+            }
+
+            uint64_t formatId;
+            uint64_t functionId;
+            uint8_t count;
+            uint32_t size;
+
+            if (!Get(input, end, formatId) || !Get(input, end, functionId) || !Get(input, end, count) ||
+                !Get(input, end, size) || (size_t)(end - input) < size)
+            {
+                return false;
+            }
+
+            FormatArgument arguments[LOG_MAX_FORMAT_ARGUMENTS];
+            uint32_t parsed = 0;
+
+            for (const char *argument = input; parsed < count && parsed < LOG_MAX_FORMAT_ARGUMENTS; ++parsed)
+            {
+                const uint32_t length =
+                    FormatArgument::Deserialize(argument, (uint32_t)(input + size - argument), arguments[parsed]);
+
+                if (length == 0)
+                {
+                    return false;
+                }
+
+                argument += length;
+            }
+
+            const auto format = m_Definitions.find(formatId);
+            const auto function = m_Definitions.find(functionId);
+            const StringView formatText = format != m_Definitions.end() ? StringView(format->second)
+                                                                        : StringView("<unknown format>\n");
+
+            m_Text.resize(256);
+            uint32_t length = FormatArguments(m_Text.data(), (uint32_t)m_Text.size(), formatText, arguments, parsed);
+
+            if (length >= m_Text.size())
+            {
+                m_Text.resize(length + 1);
+                FormatArguments(m_Text.data(), (uint32_t)m_Text.size(), formatText, arguments, parsed);
+            }
+
+            entry.Function = function != m_Definitions.end() ? StringView(function->second) : StringView();
+            entry.Message = StringView(m_Text.data(), length);
+            m_Offset = input + size - m_Data.data();
+
+            return true;
+        }
+
+        m_Offset = m_Data.size();
+
+        return false;
+    }
+}  // namespace aga
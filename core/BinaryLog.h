@@ -0,0 +1,122 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Format.h"
+#include "String.h"
+#include "StringId.h"
+#include "StringView.h"
+#include "Typedefs.h"
+
+#include <cstdio>
+#include <stdint.h>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+//  Format string of a LOG_*_FMT call with its id hashed by the compiler. Only accepts literals, the binary log
+//  refers to the text from the writer thread long after the call returned.
+#define LOG_FORMAT_STRING(format)                                                                                      \
+    aga::LogFormatString                                                                                               \
+    {                                                                                                                  \
+        format, aga::LogFormatLength(format),                                                                          \
+            std::integral_constant<uint64_t, aga::HashString(format, aga::LogFormatLength(format))>::value             \
+    }
+
+namespace aga
+{
+    //  Arguments past this count are left out of binary log messages
+    const uint32_t LOG_MAX_FORMAT_ARGUMENTS = 16;
+
+    //  Only binds to character arrays, so passing a pointer fails to compile instead of measuring the pointer
+    template <size_t Size>
+    constexpr uint32_t LogFormatLength(const char (&)[Size])
+    {
+        return Size - 1;
+    }
+
+    struct LogFormatString
+    {
+        const char *Text;
+        uint32_t Length;
+        uint64_t Id;
+    };
+
+    //  Binary log files start with this magic and continue with records in host byte order:
+    //
+    //      Definition  kind, id (8), length (4), text           emitted before the first use of a format or function
+    //      Message     kind, level, time (8), format id (8), function id (8), argument count, size (4), arguments
+    //      Text        kind, level, time (8), length (4), text  plain Log calls
+    //
+    //  Times are nanoseconds since the epoch, arguments are encoded by FormatArgument::Serialize.
+    const char BINARY_LOG_MAGIC[8] = {'A', 'G', 'A', 'L', 'O', 'G', '0', '1'};
+
+    enum BinaryLogRecord
+    {
+        BinaryLogDefinition = 1,
+        BinaryLogMessage = 2,
+        BinaryLogText = 3
+    };
+
+    //  Packs a LOG_*_FMT call for the writer thread: the format id and pointer, the function name and the
+    //  serialized arguments. Arguments that do not fit into 'size' are left out. Returns the packed length.
+    uint32_t PackLogMessage(char *buffer, uint32_t size, const LogFormatString &format, StringView function,
+                            const FormatArgument *arguments, uint32_t count);
+
+    //  Formats a message packed by PackLogMessage as text, returns the same as FormatArguments
+    uint32_t FormatLogMessage(StringView packed, char *buffer, uint32_t size, StringView &function);
+
+    //  Writes binary log files, not thread-safe. Only used by the Logger writer thread.
+    class BinaryLogWriter
+    {
+    public:
+        BinaryLogWriter();
+        ~BinaryLogWriter();
+
+        bool Open(const char *path);
+        void Close();
+
+        bool IsOpen() const;
+
+        void WriteText(uint8_t level, int64_t time, StringView text);
+        void WriteMessage(uint8_t level, int64_t time, StringView packed);
+
+        void Flush();
+
+    private:
+        void _Define(uint64_t id, StringView text);
+
+    private:
+        FILE *m_File;
+        std::unordered_set<uint64_t> m_Defined;
+    };
+
+    //  Reads a whole binary log file back and formats its messages, used by the LogDecoder tool
+    class BinaryLogReader
+    {
+    public:
+        struct Entry
+        {
+            uint8_t Level;
+            int64_t Time;
+            StringView Function;
+            //  Valid until the next call to Read
+            StringView Message;
+        };
+
+    public:
+        BinaryLogReader();
+
+        bool Open(const char *path);
+
+        //  Returns false at the end of the file or on a malformed record
+        bool Read(Entry &entry);
+
+    private:
+        std::vector<char> m_Data;
+        size_t m_Offset;
+        std::unordered_map<uint64_t, String> m_Definitions;
+        std::vector<char> m_Text;
+    };
+}  // namespace aga
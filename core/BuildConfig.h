@@ -2,4 +2,51 @@
 
 #pragma once
 
-#define BUILD_ENABLE_VULKAN_DEBUG 0
\ No newline at end of file
+#define BUILD_ENABLE_VULKAN_DEBUG 0
+
+// SIMD kernels in core/math. The instruction set is chosen by the compiler flags (see BUILD_ENABLE_AVX2 in
+// CMakeLists.txt), setting this to 0 forces the scalar fallback.
+#define BUILD_ENABLE_SIMD 1
+
+// Every frame of the FrameAllocator gets its own slice of a reserved address range and the previous slice is
+// protected, so pointers kept past their frame fault immediately. Costs address space, keep it off in shipping builds.
+#define BUILD_ENABLE_FRAME_ALLOCATOR_DEBUG 0
+
+// Per-tag byte and allocation counters in the global operator new/delete, see MemoryTracker. Cheap enough for
+// profiling builds.
+#define BUILD_ENABLE_MEMORY_TRACKING 1
+
+// Keeps every live block in a list with its call site so MemoryTracker::ReportLeaks can list leaks at shutdown.
+// Adds a lock to every allocation, requires BUILD_ENABLE_MEMORY_TRACKING.
+#define BUILD_ENABLE_LEAK_TRACKING 0
+
+// Reverse lookup table from StringId back to its text, including hash collision checks. Debug builds only.
+#if defined(NDEBUG)
+#define BUILD_ENABLE_STRING_ID_TABLE 0
+#else
+#define BUILD_ENABLE_STRING_ID_TABLE 1
+#endif
+
+// Asynchronous file reads go through io_uring where the kernel allows it, 0 always uses the worker thread fallback.
+#define BUILD_ENABLE_IO_URING 1
+
+// Assets are read from data.pak built by the agaAssetArchive target, 0 reads the loose files under data/ instead.
+#define BUILD_ENABLE_ASSET_ARCHIVE 1
+
+// Edited GLSL sources are recompiled with glslc and only the pipelines using them are rebuilt. Debug builds only.
+#if defined(NDEBUG)
+#define BUILD_ENABLE_SHADER_HOT_RELOAD 0
+#else
+#define BUILD_ENABLE_SHADER_HOT_RELOAD 1
+#endif
+
+// Directory holding the GLSL sources watched by the shader hot-reload, set from CMake to the source tree.
+#if !defined(BUILD_SHADER_SOURCE_DIRECTORY)
+#define BUILD_SHADER_SOURCE_DIRECTORY "../data/shaders"
+#endif
+
+// Log calls below this level are compiled out together with their arguments: 0 Debug, 1 Info, 2 Warning, 3 Error.
+// Set from CMake through the BUILD_LOG_MIN_LEVEL cache variable.
+#if !defined(BUILD_LOG_MIN_LEVEL)
+#define BUILD_LOG_MIN_LEVEL 0
+#endif
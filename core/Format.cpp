@@ -0,0 +1,266 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "Format.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace aga
+{
+    static inline uint32_t WriteText(char *output, uint32_t available, const char *text, uint32_t length)
+    {
+        memcpy(output, text, length < available ? length : available);
+
+        return length;
+    }
+
+    static uint32_t WriteUnsigned(char *output, uint32_t available, uint64_t value, bool negative, uint32_t base)
+    {
+        char digits[24];
+        char *p = digits + sizeof(digits);
+
+        do
+        {
+            *--p = "0123456789abcdef"[value % base];
+            value /= base;
+        } while (value);
+
+        if (negative)
+        {
+            *--p = '-';
+        }
+
+        return WriteText(output, available, p, (uint32_t)(digits + sizeof(digits) - p));
+    }
+
+    static inline uint32_t _Clamp(uint32_t length, uint32_t capacity)
+    {
+        return length < capacity ? length : capacity;
+    }
+
+    static inline uint32_t _Remaining(uint32_t length, uint32_t capacity)
+    {
+        return length < capacity ? capacity - length : 0;
+    }
+
+    uint32_t FormatArgument::Write(char *output, uint32_t available) const
+    {
+        switch (m_Type)
+        {
+            case Signed:
+            {
+                const bool negative = m_Signed < 0;
+                const uint64_t magnitude = negative ? 0 - (uint64_t)m_Signed : (uint64_t)m_Signed;
+
+                return WriteUnsigned(output, available, magnitude, negative, 10);
+            }
+
+            case Unsigned:
+                return WriteUnsigned(output, available, m_Unsigned, false, 10);
+
+            case Real:
+            {
+                char digits[32];
+                const int length = snprintf(digits, sizeof(digits), "%g", m_Real);
+
+                return WriteText(output, available, digits, length > 0 ? (uint32_t)length : 0);
+            }
+
+            case Character:
+            {
+                const char c = (char)m_Signed;
+
+                return WriteText(output, available, &c, 1);
+            }
+
+            case Boolean:
+                return m_Signed ? WriteText(output, available, "true", 4) : WriteText(output, available, "false", 5);
+
+            case Text:
+                return WriteText(output, available, m_Text, m_Length);
+
+            case Pointer:
+            {
+                const uint32_t length = WriteText(output, available, "0x", 2);
+                const uint32_t skip = length < available ? length : available;
+
+                return length + WriteUnsigned(output + skip, available - skip, (uintptr_t)m_Pointer, false, 16);
+            }
+
+            default:
+                return 0;
+        }
+    }
+
+    uint32_t FormatArgument::Serialize(char *output, uint32_t available) const
+    {
+        uint32_t size = 0;
+
+        switch (m_Type)
+        {
+            case Signed:
+            case Unsigned:
+            case Real:
+            case Pointer:
+                size = sizeof(uint64_t);
+                break;
+
+            case Character:
+            case Boolean:
+                size = 1;
+                break;
+
+            case Text:
+                size = sizeof(uint32_t) + m_Length;
+                break;
+
+            default:
+                break;
+        }
+
+        if (1 + size > available)
+        {
+            return 0;
+        }
+
+        output[0] = (char)m_Type;
+
+        switch (m_Type)
+        {
+            case Character:
+            case Boolean:
+                output[1] = (char)m_Signed;
+                break;
+
+            case Text:
+                memcpy(output + 1, &m_Length, sizeof(uint32_t));
+                memcpy(output + 1 + sizeof(uint32_t), m_Text, m_Length);
+                break;
+
+            case Pointer:
+            {
+                const uint64_t address = (uintptr_t)m_Pointer;
+                memcpy(output + 1, &address, sizeof(uint64_t));
+                break;
+            }
+
+            default:
+                memcpy(output + 1, &m_Unsigned, size);
+                break;
+        }
+
+        return 1 + size;
+    }
+
+    uint32_t FormatArgument::Deserialize(const char *input, uint32_t available, FormatArgument &argument)
+    {
+        if (available < 1)
+        {
+            return 0;
+        }
+
+        argument = FormatArgument();
+        argument.m_Type = (Type)input[0];
+
+        switch (argument.m_Type)
+        {
+            case Signed:
+            case Unsigned:
+            case Real:
+                if (available < 1 + sizeof(uint64_t))
+                {
+                    return 0;
+                }
+
+                memcpy(&argument.m_Unsigned, input + 1, sizeof(uint64_t));
+
+                return 1 + sizeof(uint64_t);
+
+            case Pointer:
+            {
+                if (available < 1 + sizeof(uint64_t))
+                {
+                    return 0;
+                }
+
+                uint64_t address;
+                memcpy(&address, input + 1, sizeof(uint64_t));
+                argument.m_Pointer = (const void *)(uintptr_t)address;
+
+                return 1 + sizeof(uint64_t);
+            }
+
+            case Character:
+            case Boolean:
+                if (available < 2)
+                {
+                    return 0;
+                }
+
+                argument.m_Signed = input[1];
+
+                return 2;
+
+            case Text:
+                if (available < 1 + sizeof(uint32_t))
+                {
+                    return 0;
+                }
+
+                memcpy(&argument.m_Length, input + 1, sizeof(uint32_t));
+
+                if (argument.m_Length > available - 1 - sizeof(uint32_t))
+                {
+                    return 0;
+                }
+
+                argument.m_Text = input + 1 + sizeof(uint32_t);
+
+                return 1 + sizeof(uint32_t) + argument.m_Length;
+
+            default:
+                return 0;
+        }
+    }
+
+    uint32_t FormatArguments(char *buffer, uint32_t size, StringView format, const FormatArgument *arguments,
+                             uint32_t count)
+    {
+        //  One byte is always kept for the terminating zero
+        const uint32_t capacity = size > 0 ? size - 1 : 0;
+        uint32_t length = 0;
+        uint32_t argument = 0;
+
+        for (uint32_t i = 0; i < format.Length(); ++i)
+        {
+            const char c = format[i];
+            const bool hasNext = i + 1 < format.Length();
+
+            if (c == '{' && hasNext && format[i + 1] == '}')
+            {
+                if (argument < count)
+                {
+                    length += arguments[argument++].Write(buffer + _Clamp(length, capacity), _Remaining(length, capacity));
+                }
+
+                ++i;
+
+                continue;
+            }
+
+            if ((c == '{' || c == '}') && hasNext && format[i + 1] == c)
+            {
+                ++i;
+            }
+
+            length += WriteText(buffer + _Clamp(length, capacity), _Remaining(length, capacity), &c, 1);
+        }
+
+        if (size > 0)
+        {
+            buffer[_Clamp(length, capacity)] = '\0';
+        }
+
+        return length;
+    }
+}  // namespace aga
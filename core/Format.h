@@ -0,0 +1,185 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "String.h"
+#include "StringView.h"
+#include "Typedefs.h"
+
+#include <stdint.h>
+
+namespace aga
+{
+    //  One formatted value, built implicitly from the arguments of Format. Only stores a reference for text, so it
+    //  must not outlive the call.
+    class FormatArgument
+    {
+    public:
+        enum Type
+        {
+            None,
+            Signed,
+            Unsigned,
+            Real,
+            Character,
+            Boolean,
+            Text,
+            Pointer
+        };
+
+        FormatArgument() : m_Type(None), m_Signed(0), m_Length(0)
+        {
+        }
+
+        FormatArgument(int value) : m_Type(Signed), m_Signed(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(long value) : m_Type(Signed), m_Signed(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(long long value) : m_Type(Signed), m_Signed(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(unsigned int value) : m_Type(Unsigned), m_Unsigned(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(unsigned long value) : m_Type(Unsigned), m_Unsigned(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(unsigned long long value) : m_Type(Unsigned), m_Unsigned(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(double value) : m_Type(Real), m_Real(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(char value) : m_Type(Character), m_Signed(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(bool value) : m_Type(Boolean), m_Signed(value), m_Length(0)
+        {
+        }
+
+        FormatArgument(const char *value) : FormatArgument(StringView(value))
+        {
+        }
+
+        FormatArgument(const String &value) : FormatArgument(StringView(value))
+        {
+        }
+
+        FormatArgument(StringView value) : m_Type(Text), m_Text(value.GetData()), m_Length(value.Length())
+        {
+        }
+
+        FormatArgument(const void *value) : m_Type(Pointer), m_Pointer(value), m_Length(0)
+        {
+        }
+
+        Type GetType() const
+        {
+            return m_Type;
+        }
+
+        //  Writes at most 'available' characters of the value to 'output', returns the full length it needs
+        uint32_t Write(char *output, uint32_t available) const;
+
+        //  Raw encoding used by the binary log, a type byte followed by the value. Text is copied inline. Returns the
+        //  number of bytes written, or 0 when 'available' is too small.
+        uint32_t Serialize(char *output, uint32_t available) const;
+
+        //  Reads one value written by Serialize, text keeps pointing into 'input'. Returns the number of bytes
+        //  consumed, or 0 when the input is malformed.
+        static uint32_t Deserialize(const char *input, uint32_t available, FormatArgument &argument);
+
+    private:
+        Type m_Type;
+
+        union
+        {
+            int64_t m_Signed;
+            uint64_t m_Unsigned;
+            double m_Real;
+            const char *m_Text;
+            const void *m_Pointer;
+        };
+
+        uint32_t m_Length;
+    };
+
+    //  Replaces every "{}" in 'format' with the next argument ("{{" and "}}" produce literal braces). Writes at
+    //  most 'size' bytes including the terminating zero and returns the length the full result would have, so a
+    //  return value >= size means the output was truncated. Never allocates.
+    uint32_t FormatArguments(char *buffer, uint32_t size, StringView format, const FormatArgument *arguments,
+                             uint32_t count);
+
+    template <typename... Args>
+    uint32_t Format(char *buffer, uint32_t size, StringView format, const Args &... args)
+    {
+        //  The extra element keeps the array valid when there are no arguments
+        const FormatArgument arguments[] = {FormatArgument(args)..., FormatArgument()};
+
+        return FormatArguments(buffer, size, format, arguments, sizeof...(Args));
+    }
+
+    //  Formats into storage inside the object, meant to live on the stack. Longer results are truncated.
+    template <uint32_t Size>
+    class FormatBuffer
+    {
+    public:
+        template <typename... Args>
+        explicit FormatBuffer(StringView format, const Args &... args)
+        {
+            const uint32_t length = Format(m_Data, Size, format, args...);
+            m_Length = length < Size ? length : Size - 1;
+        }
+
+        const char *GetData() const
+        {
+            return m_Data;
+        }
+
+        uint32_t Length() const
+        {
+            return m_Length;
+        }
+
+        StringView GetView() const
+        {
+            return StringView(m_Data, m_Length);
+        }
+
+    private:
+        char m_Data[Size];
+        uint32_t m_Length;
+    };
+
+    template <typename... Args>
+    String FormatString(StringView format, const Args &... args)
+    {
+        const FormatArgument arguments[] = {FormatArgument(args)..., FormatArgument()};
+
+        char buffer[256];
+        const uint32_t length = FormatArguments(buffer, sizeof(buffer), format, arguments, sizeof...(Args));
+
+        if (length < sizeof(buffer))
+        {
+            return String(buffer, length);
+        }
+
+        char *large = new char[length + 1];
+        FormatArguments(large, length + 1, format, arguments, sizeof...(Args));
+
+        String result(large, length);
+        delete[] large;
+
+        return result;
+    }
+}  // namespace aga
@@ -0,0 +1,248 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "FrameAllocator.h"
+#include "BuildConfig.h"
+#include "Logger.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#if BUILD_ENABLE_FRAME_ALLOCATOR_DEBUG && defined(__linux)
+#include <sys/mman.h>
+#include <unistd.h>
+#define FRAME_ALLOCATOR_PROTECT_SLICES 1
+#else
+#define FRAME_ALLOCATOR_PROTECT_SLICES 0
+#endif
+
+namespace aga
+{
+    //  Number of frames that pass before a debug slice gets reused
+    const uint32_t FRAME_ALLOCATOR_DEBUG_SLICES = 1024;
+
+    const uint8_t FRAME_ALLOCATOR_POISON = 0xCD;
+
+    static inline uintptr_t AlignUp(uintptr_t value, size_t alignment)
+    {
+        return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+
+    FrameAllocator::FrameAllocator() :
+        m_Memory(nullptr),
+        m_Base(nullptr),
+        m_Capacity(0),
+        m_Offset(0),
+        m_Overflow(nullptr),
+        m_OverflowBytes(0),
+        m_OverflowCount(0),
+        m_PeakUsed(0),
+        m_FrameIndex(0),
+        m_ReservedSize(0),
+        m_DebugSlice(0)
+    {
+    }
+
+    FrameAllocator::~FrameAllocator()
+    {
+        Destroy();
+    }
+
+    bool FrameAllocator::Initialize(size_t capacity)
+    {
+        MemoryTagScope scope(MemoryTag::Core);
+
+        Destroy();
+
+#if FRAME_ALLOCATOR_PROTECT_SLICES
+        const size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+        capacity = AlignUp(capacity, pageSize);
+
+        //  Only address space is reserved here, pages get committed slice by slice in _MapDebugSlice
+        m_ReservedSize = capacity * FRAME_ALLOCATOR_DEBUG_SLICES;
+        void *memory = mmap(nullptr, m_ReservedSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+        if (memory == MAP_FAILED)
+        {
+            LOG_ERROR_F("Can not reserve frame allocator address space\n");
+
+            m_ReservedSize = 0;
+
+            return false;
+        }
+
+        m_Memory = static_cast<uint8_t *>(memory);
+        m_Capacity = capacity;
+        m_Base = _MapDebugSlice(0);
+#else
+        capacity = AlignUp(capacity, 64);
+
+        m_Memory = static_cast<uint8_t *>(std::aligned_alloc(64, capacity));
+
+        if (!m_Memory)
+        {
+            LOG_ERROR_F("Can not allocate frame allocator memory\n");
+
+            return false;
+        }
+
+        m_Capacity = capacity;
+        m_Base = m_Memory;
+#endif
+
+        m_Offset.store(0, std::memory_order_relaxed);
+
+        return true;
+    }
+
+    void FrameAllocator::Destroy()
+    {
+        _FreeOverflow();
+
+        if (!m_Memory)
+        {
+            return;
+        }
+
+#if FRAME_ALLOCATOR_PROTECT_SLICES
+        munmap(m_Memory, m_ReservedSize);
+        m_ReservedSize = 0;
+#else
+        std::free(m_Memory);
+#endif
+
+        m_Memory = nullptr;
+        m_Base = nullptr;
+        m_Capacity = 0;
+        m_Offset.store(0, std::memory_order_relaxed);
+    }
+
+    void *FrameAllocator::Allocate(size_t size, size_t alignment)
+    {
+        size_t offset = m_Offset.load(std::memory_order_relaxed);
+        size_t alignedOffset;
+        size_t end;
+
+        do
+        {
+            alignedOffset = AlignUp((uintptr_t)m_Base + offset, alignment) - (uintptr_t)m_Base;
+            end = alignedOffset + size;
+
+            if (end > m_Capacity)
+            {
+                return _AllocateOverflow(size, alignment);
+            }
+        } while (!m_Offset.compare_exchange_weak(offset, end, std::memory_order_relaxed));
+
+        return m_Base + alignedOffset;
+    }
+
+    void FrameAllocator::Reset()
+    {
+        const size_t used = std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity);
+        m_PeakUsed = std::max(m_PeakUsed, used);
+
+        if (m_OverflowCount.load(std::memory_order_relaxed) > 0)
+        {
+            LOG_WARNING_F("Frame allocator overflowed by " +
+                          String((uint32_t)m_OverflowBytes.load(std::memory_order_relaxed)) + " bytes in " +
+                          String(m_OverflowCount.load(std::memory_order_relaxed)) + " allocations\n");
+        }
+
+        _FreeOverflow();
+
+#if FRAME_ALLOCATOR_PROTECT_SLICES
+        if (m_Memory)
+        {
+            //  Retire the slice of the previous frame: drop its pages and make any access to it fault
+            mprotect(m_Base, m_Capacity, PROT_NONE);
+            madvise(m_Base, m_Capacity, MADV_DONTNEED);
+
+            m_DebugSlice = (m_DebugSlice + 1) % FRAME_ALLOCATOR_DEBUG_SLICES;
+            m_Base = _MapDebugSlice(m_DebugSlice);
+        }
+#elif BUILD_ENABLE_FRAME_ALLOCATOR_DEBUG
+        if (m_Base)
+        {
+            std::memset(m_Base, FRAME_ALLOCATOR_POISON, used);
+        }
+#endif
+
+        m_Offset.store(0, std::memory_order_relaxed);
+        ++m_FrameIndex;
+    }
+
+    bool FrameAllocator::IsFromCurrentFrame(const void *memory) const
+    {
+        const uint8_t *address = static_cast<const uint8_t *>(memory);
+
+        return address >= m_Base && address < m_Base + m_Offset.load(std::memory_order_relaxed);
+    }
+
+    FrameAllocator::Statistics FrameAllocator::GetStatistics() const
+    {
+        Statistics statistics;
+        statistics.Capacity = m_Capacity;
+        statistics.UsedBytes = std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity);
+        statistics.PeakUsedBytes = std::max(m_PeakUsed, statistics.UsedBytes);
+        statistics.OverflowBytes = m_OverflowBytes.load(std::memory_order_relaxed);
+        statistics.OverflowCount = m_OverflowCount.load(std::memory_order_relaxed);
+        statistics.FrameIndex = m_FrameIndex;
+
+        return statistics;
+    }
+
+    void *FrameAllocator::_AllocateOverflow(size_t size, size_t alignment)
+    {
+        alignment = std::max(alignment, alignof(OverflowBlock));
+
+        const size_t headerSize = AlignUp(sizeof(OverflowBlock), alignment);
+        uint8_t *memory = static_cast<uint8_t *>(std::malloc(headerSize + size));
+
+        if (!memory)
+        {
+            return nullptr;
+        }
+
+        //  Header sits at the start of the block so _FreeOverflow can walk the list without extra storage
+        OverflowBlock *block = reinterpret_cast<OverflowBlock *>(memory);
+        block->Next = m_Overflow.load(std::memory_order_relaxed);
+
+        while (!m_Overflow.compare_exchange_weak(block->Next, block, std::memory_order_release,
+                                                 std::memory_order_relaxed))
+            ;
+
+        m_OverflowBytes.fetch_add(size, std::memory_order_relaxed);
+        m_OverflowCount.fetch_add(1, std::memory_order_relaxed);
+
+        return reinterpret_cast<uint8_t *>(AlignUp((uintptr_t)memory + sizeof(OverflowBlock), alignment));
+    }
+
+    void FrameAllocator::_FreeOverflow()
+    {
+        OverflowBlock *block = m_Overflow.exchange(nullptr, std::memory_order_acquire);
+
+        while (block)
+        {
+            OverflowBlock *next = block->Next;
+            std::free(block);
+            block = next;
+        }
+
+        m_OverflowBytes.store(0, std::memory_order_relaxed);
+        m_OverflowCount.store(0, std::memory_order_relaxed);
+    }
+
+    uint8_t *FrameAllocator::_MapDebugSlice(uint32_t slice)
+    {
+        uint8_t *base = m_Memory + (size_t)slice * m_Capacity;
+
+#if FRAME_ALLOCATOR_PROTECT_SLICES
+        mprotect(base, m_Capacity, PROT_READ | PROT_WRITE);
+        std::memset(base, FRAME_ALLOCATOR_POISON, m_Capacity);
+#endif
+
+        return base;
+    }
+}  // namespace aga
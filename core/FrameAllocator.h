@@ -0,0 +1,126 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Bump allocator for data that lives no longer than one frame. Allocate is lock-free and may be called from
+    //  any thread, Reset must only be called at the frame boundary when no allocation is in flight. Memory is never
+    //  freed individually. When the arena runs out, allocations fall back to the heap until the next Reset.
+    //
+    //  With BUILD_ENABLE_FRAME_ALLOCATOR_DEBUG every frame gets a fresh slice of a large reserved address range
+    //  and the previous slice is made inaccessible, so touching a pointer that escaped its frame faults on the spot.
+    class FrameAllocator
+    {
+    public:
+        struct Statistics
+        {
+            size_t Capacity;
+            size_t UsedBytes;
+            size_t PeakUsedBytes;
+            size_t OverflowBytes;
+            uint32_t OverflowCount;
+            uint64_t FrameIndex;
+        };
+
+    public:
+        static FrameAllocator &getInstance()
+        {
+            static FrameAllocator instance;
+            return instance;
+        }
+
+    private:
+        FrameAllocator();
+
+    public:
+        FrameAllocator(FrameAllocator const &) = delete;
+        void operator=(FrameAllocator const &) = delete;
+
+        ~FrameAllocator();
+
+        bool Initialize(size_t capacity);
+        void Destroy();
+
+        void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+        //  Releases everything allocated since the previous Reset
+        void Reset();
+
+        bool IsFromCurrentFrame(const void *memory) const;
+
+        Statistics GetStatistics() const;
+
+    private:
+        struct OverflowBlock
+        {
+            OverflowBlock *Next;
+        };
+
+        void *_AllocateOverflow(size_t size, size_t alignment);
+        void _FreeOverflow();
+
+        uint8_t *_MapDebugSlice(uint32_t slice);
+
+    private:
+        uint8_t *m_Memory;
+        uint8_t *m_Base;
+        size_t m_Capacity;
+        std::atomic<size_t> m_Offset;
+        std::atomic<OverflowBlock *> m_Overflow;
+        std::atomic<size_t> m_OverflowBytes;
+        std::atomic<uint32_t> m_OverflowCount;
+        size_t m_PeakUsed;
+        uint64_t m_FrameIndex;
+
+        size_t m_ReservedSize;
+        uint32_t m_DebugSlice;
+    };
+
+    //  STL allocator adapter, e.g. std::vector<int, FrameStlAllocator<int>> or FrameVector<int>.
+    //  Containers using it must not outlive the frame they were filled in.
+    template <typename T>
+    class FrameStlAllocator
+    {
+    public:
+        using value_type = T;
+
+        FrameStlAllocator() = default;
+
+        template <typename U>
+        FrameStlAllocator(const FrameStlAllocator<U> &)
+        {
+        }
+
+        T *allocate(size_t count)
+        {
+            return static_cast<T *>(FrameAllocator::getInstance().Allocate(count * sizeof(T), alignof(T)));
+        }
+
+        void deallocate(T *, size_t)
+        {
+        }
+    };
+
+    template <typename T, typename U>
+    bool operator==(const FrameStlAllocator<T> &, const FrameStlAllocator<U> &)
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const FrameStlAllocator<T> &, const FrameStlAllocator<U> &)
+    {
+        return false;
+    }
+
+    template <typename T>
+    using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+}  // namespace aga
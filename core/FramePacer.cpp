@@ -0,0 +1,184 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "FramePacer.h"
+
+#include <cstring>
+#include <thread>
+
+namespace aga
+{
+    //  Starting guess for the oversleep, calibrated by every sleep afterwards
+    const std::chrono::microseconds FRAME_PACER_INITIAL_OVERSHOOT(1000);
+
+    //  Sleeps shorter than this are not worth the wake-up latency, the rest is spun
+    const std::chrono::microseconds FRAME_PACER_MIN_SLEEP(100);
+
+    //  Share of the oversleep estimate kept per sleep, lets it decay over a few hundred frames
+    const int64_t FRAME_PACER_OVERSHOOT_DECAY = 255;
+
+    FrameTimeHistogram::FrameTimeHistogram()
+    {
+        Reset();
+    }
+
+    void FrameTimeHistogram::Add(double milliseconds)
+    {
+        milliseconds = milliseconds > 0.0 ? milliseconds : 0.0;
+
+        uint32_t bucket = (uint32_t)(milliseconds / FRAME_HISTOGRAM_BUCKET_WIDTH);
+        bucket = bucket < FRAME_HISTOGRAM_BUCKET_COUNT ? bucket : FRAME_HISTOGRAM_BUCKET_COUNT - 1;
+
+        ++m_Buckets[bucket];
+        ++m_Count;
+        m_Sum += milliseconds;
+        m_Min = m_Count == 1 || milliseconds < m_Min ? milliseconds : m_Min;
+        m_Max = milliseconds > m_Max ? milliseconds : m_Max;
+    }
+
+    void FrameTimeHistogram::Reset()
+    {
+        memset(m_Buckets, 0, sizeof(m_Buckets));
+        m_Count = 0;
+        m_Sum = 0.0;
+        m_Min = 0.0;
+        m_Max = 0.0;
+    }
+
+    uint32_t FrameTimeHistogram::GetCount() const
+    {
+        return m_Count;
+    }
+
+    uint32_t FrameTimeHistogram::GetBucket(uint32_t index) const
+    {
+        return index < FRAME_HISTOGRAM_BUCKET_COUNT ? m_Buckets[index] : 0;
+    }
+
+    double FrameTimeHistogram::GetMin() const
+    {
+        return m_Min;
+    }
+
+    double FrameTimeHistogram::GetMax() const
+    {
+        return m_Max;
+    }
+
+    double FrameTimeHistogram::GetMean() const
+    {
+        return m_Count > 0 ? m_Sum / m_Count : 0.0;
+    }
+
+    double FrameTimeHistogram::GetPercentile(double fraction) const
+    {
+        const double target = fraction * m_Count;
+        uint32_t total = 0;
+
+        for (uint32_t i = 0; i < FRAME_HISTOGRAM_BUCKET_COUNT - 1; ++i)
+        {
+            total += m_Buckets[i];
+
+            if (total > 0 && total >= target)
+            {
+                return (i + 1) * FRAME_HISTOGRAM_BUCKET_WIDTH;
+            }
+        }
+
+        return m_Max;
+    }
+
+    FramePacer::FramePacer()
+        : m_Mode(PacingVSync),
+          m_Period(0),
+          m_HasLastFrame(false),
+          m_SleepOvershoot(FRAME_PACER_INITIAL_OVERSHOOT)
+    {
+    }
+
+    void FramePacer::SetMode(Mode mode, double framesPerSecond)
+    {
+        m_Mode = mode;
+        m_Period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0));
+
+        Reset();
+    }
+
+    FramePacer::Mode FramePacer::GetMode() const
+    {
+        return m_Mode;
+    }
+
+    void FramePacer::WaitForNextFrame()
+    {
+        const bool paced = m_Mode == PacingFixedRate && m_Period.count() > 0 && m_HasLastFrame;
+
+        if (paced)
+        {
+            _SleepUntil(m_Deadline);
+        }
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        if (m_HasLastFrame)
+        {
+            m_FrameTimes.Add(std::chrono::duration<double, std::milli>(now - m_LastFrame).count());
+        }
+
+        if (paced)
+        {
+            m_DeadlineErrors.Add(std::chrono::duration<double, std::milli>(now - m_Deadline).count());
+
+            //  A frame that ran over by more than a whole period starts a new schedule instead of rushing the next
+            //  ones to catch up
+            m_Deadline = now - m_Deadline > m_Period ? now + m_Period : m_Deadline + m_Period;
+        }
+        else
+        {
+            m_Deadline = now + m_Period;
+        }
+
+        m_LastFrame = now;
+        m_HasLastFrame = true;
+    }
+
+    void FramePacer::Reset()
+    {
+        m_HasLastFrame = false;
+    }
+
+    const FrameTimeHistogram &FramePacer::GetFrameTimes() const
+    {
+        return m_FrameTimes;
+    }
+
+    const FrameTimeHistogram &FramePacer::GetDeadlineErrors() const
+    {
+        return m_DeadlineErrors;
+    }
+
+    void FramePacer::_SleepUntil(std::chrono::steady_clock::time_point deadline)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        const std::chrono::steady_clock::duration sleep = deadline - now - m_SleepOvershoot;
+
+        if (sleep > FRAME_PACER_MIN_SLEEP)
+        {
+            std::this_thread::sleep_for(sleep);
+
+            const std::chrono::steady_clock::time_point woken = std::chrono::steady_clock::now();
+            const std::chrono::steady_clock::duration overshoot = woken - now - sleep;
+
+            m_SleepOvershoot = overshoot > m_SleepOvershoot
+                                   ? overshoot
+                                   : m_SleepOvershoot * FRAME_PACER_OVERSHOOT_DECAY / 256 + overshoot / 256;
+            now = woken;
+        }
+
+        while (now < deadline)
+        {
+            std::this_thread::yield();
+            now = std::chrono::steady_clock::now();
+        }
+    }
+}  // namespace aga
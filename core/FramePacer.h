@@ -0,0 +1,90 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <chrono>
+#include <stdint.h>
+
+namespace aga
+{
+    //  Samples are counted in buckets of FRAME_HISTOGRAM_BUCKET_WIDTH milliseconds, the last bucket collects
+    //  everything above the range
+    const uint32_t FRAME_HISTOGRAM_BUCKET_COUNT = 512;
+    const double FRAME_HISTOGRAM_BUCKET_WIDTH = 0.1;
+
+    class FrameTimeHistogram
+    {
+    public:
+        FrameTimeHistogram();
+
+        void Add(double milliseconds);
+        void Reset();
+
+        uint32_t GetCount() const;
+        uint32_t GetBucket(uint32_t index) const;
+
+        double GetMin() const;
+        double GetMax() const;
+        double GetMean() const;
+
+        //  Upper edge of the bucket holding the given fraction of samples, e.g. 0.99 for the 99th percentile
+        double GetPercentile(double fraction) const;
+
+    private:
+        uint32_t m_Buckets[FRAME_HISTOGRAM_BUCKET_COUNT];
+        uint32_t m_Count;
+        double m_Sum;
+        double m_Min;
+        double m_Max;
+    };
+
+    //  Decides when the next frame starts. A fixed rate sleeps through most of the wait and spins the rest, the
+    //  sleep is shortened by the worst oversleep seen recently so deadlines are met to a fraction of a millisecond.
+    //  VSync leaves the waiting to the presentation engine.
+    class FramePacer
+    {
+    public:
+        enum Mode
+        {
+            PacingUncapped,
+            PacingVSync,
+            PacingFixedRate
+        };
+
+    public:
+        FramePacer();
+
+        void SetMode(Mode mode, double framesPerSecond = 60.0);
+        Mode GetMode() const;
+
+        //  Blocks until the next frame is due and records the time since the previous one
+        void WaitForNextFrame();
+
+        //  Forgets the previous frame, for when the loop was stalled on purpose and should not catch up
+        void Reset();
+
+        //  Time between consecutive frames
+        const FrameTimeHistogram &GetFrameTimes() const;
+
+        //  How late each frame started past its deadline, fixed rate only
+        const FrameTimeHistogram &GetDeadlineErrors() const;
+
+    private:
+        void _SleepUntil(std::chrono::steady_clock::time_point deadline);
+
+    private:
+        Mode m_Mode;
+        std::chrono::steady_clock::duration m_Period;
+        std::chrono::steady_clock::time_point m_Deadline;
+        std::chrono::steady_clock::time_point m_LastFrame;
+        bool m_HasLastFrame;
+
+        //  Recent worst oversleep, decays slowly so a single spike does not cost CPU forever
+        std::chrono::steady_clock::duration m_SleepOvershoot;
+
+        FrameTimeHistogram m_FrameTimes;
+        FrameTimeHistogram m_DeadlineErrors;
+    };
+}  // namespace aga
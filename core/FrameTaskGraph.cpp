@@ -0,0 +1,387 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "FrameTaskGraph.h"
+#include "FrameAllocator.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace aga
+{
+    //  Weight of the latest measurement in the smoothed task cost
+    const double FRAME_TASK_COST_SMOOTHING = 0.1;
+
+    FrameTaskGraph::FrameTaskGraph() : m_Remaining(0), m_Built(false)
+    {
+    }
+
+    uint32_t FrameTaskGraph::AddTask(const char *name, TaskFunction function, std::initializer_list<StringId> reads,
+                                     std::initializer_list<StringId> writes, uint32_t frameLatency, uint32_t flags)
+    {
+        Task task;
+        task.Name = name;
+        task.Function = std::move(function);
+        task.Reads = reads;
+        task.Writes = writes;
+        task.FrameLatency = frameLatency;
+        task.Flags = flags;
+        task.Cost = 0.0;
+        task.Rank = 0.0;
+        task.Duration = 0;
+        task.Active = false;
+        task.FeedsWorkers = false;
+
+        m_Tasks.push_back(std::move(task));
+        m_Built = false;
+
+        return (uint32_t)m_Tasks.size() - 1;
+    }
+
+    void FrameTaskGraph::AddBufferedResource(StringId resource)
+    {
+        m_BufferedResources.insert(resource);
+        m_Built = false;
+    }
+
+    void FrameTaskGraph::_AddEdge(uint32_t from, uint32_t to)
+    {
+        std::vector<uint32_t> &successors = m_Tasks[from].Successors;
+
+        if (from != to && std::find(successors.begin(), successors.end(), to) == successors.end())
+        {
+            successors.push_back(to);
+            m_Tasks[to].Predecessors.push_back(from);
+        }
+    }
+
+    bool FrameTaskGraph::Build()
+    {
+        m_Order.clear();
+
+        for (Task &task : m_Tasks)
+        {
+            if (task.FrameLatency > 1)
+            {
+                return false;
+            }
+
+            task.Predecessors.clear();
+            task.Successors.clear();
+        }
+
+        for (uint32_t latency = 2; latency-- > 0;)
+        {
+            for (uint32_t i = 0; i < m_Tasks.size(); ++i)
+            {
+                if (m_Tasks[i].FrameLatency == latency)
+                {
+                    m_Order.push_back(i);
+                }
+            }
+        }
+
+        std::unordered_map<StringId, uint32_t> lastWriter;
+        std::unordered_map<StringId, std::vector<uint32_t>> readers;
+
+        //  Tasks of different frames touch different copies of a buffered resource
+        auto conflicts = [this](StringId resource, uint32_t a, uint32_t b) {
+            return m_Tasks[a].FrameLatency == m_Tasks[b].FrameLatency ||
+                   m_BufferedResources.find(resource) == m_BufferedResources.end();
+        };
+
+        for (uint32_t task : m_Order)
+        {
+            for (StringId resource : m_Tasks[task].Reads)
+            {
+                auto writer = lastWriter.find(resource);
+
+                if (writer != lastWriter.end() && conflicts(resource, writer->second, task))
+                {
+                    _AddEdge(writer->second, task);
+                }
+
+                readers[resource].push_back(task);
+            }
+
+            for (StringId resource : m_Tasks[task].Writes)
+            {
+                auto writer = lastWriter.find(resource);
+
+                if (writer != lastWriter.end() && conflicts(resource, writer->second, task))
+                {
+                    _AddEdge(writer->second, task);
+                }
+
+                for (uint32_t reader : readers[resource])
+                {
+                    if (conflicts(resource, reader, task))
+                    {
+                        _AddEdge(reader, task);
+                    }
+                }
+
+                lastWriter[resource] = task;
+                readers[resource].clear();
+            }
+        }
+
+        for (Task &task : m_Tasks)
+        {
+            task.FeedsWorkers = std::any_of(task.Successors.begin(), task.Successors.end(),
+                                            [this](uint32_t successor) {
+                                                return (m_Tasks[successor].Flags & TaskMainThread) == 0;
+                                            });
+        }
+
+        m_Pending = std::vector<std::atomic<uint32_t>>(m_Tasks.size());
+        m_Built = true;
+
+        _UpdateCosts();
+
+        return true;
+    }
+
+    void FrameTaskGraph::Execute(uint64_t frame)
+    {
+        _Run(frame, true, frame > 0);
+    }
+
+    void FrameTaskGraph::Finish(uint64_t frame)
+    {
+        _Run(frame + 1, false, true);
+    }
+
+    void FrameTaskGraph::_Run(uint64_t frame, bool runCurrent, bool runLatent)
+    {
+        if (!m_Built && !Build())
+        {
+            return;
+        }
+
+        uint32_t activeCount = 0;
+
+        for (Task &task : m_Tasks)
+        {
+            task.Active = task.FrameLatency == 0 ? runCurrent : runLatent;
+            activeCount += task.Active ? 1 : 0;
+        }
+
+        if (activeCount == 0)
+        {
+            return;
+        }
+
+        for (uint32_t i = 0; i < m_Tasks.size(); ++i)
+        {
+            uint32_t pending = 0;
+
+            for (uint32_t predecessor : m_Tasks[i].Predecessors)
+            {
+                pending += m_Tasks[predecessor].Active ? 1 : 0;
+            }
+
+            m_Pending[i].store(pending, std::memory_order_relaxed);
+        }
+
+        m_Remaining.store(activeCount, std::memory_order_release);
+
+        //  Least critical first, so the most critical root ends up on top of the queue
+        FrameVector<uint32_t> roots;
+
+        for (uint32_t i = 0; i < m_Tasks.size(); ++i)
+        {
+            if (m_Tasks[i].Active && m_Pending[i].load(std::memory_order_relaxed) == 0)
+            {
+                roots.push_back(i);
+            }
+        }
+
+        std::sort(roots.begin(), roots.end(),
+                  [this](uint32_t a, uint32_t b) { return m_Tasks[a].Rank < m_Tasks[b].Rank; });
+
+        for (uint32_t task : roots)
+        {
+            _Schedule(task, frame);
+        }
+
+        JobSystem &jobSystem = JobSystem::getInstance();
+
+        while (m_Remaining.load(std::memory_order_acquire) > 0)
+        {
+            std::pair<uint32_t, uint64_t> mainThreadTask(0, 0);
+            bool hasMainThreadTask = false;
+
+            {
+                std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+
+                if (!m_MainThreadReady.empty())
+                {
+                    auto next = std::max_element(m_MainThreadReady.begin(), m_MainThreadReady.end(),
+                                                 [this](const std::pair<uint32_t, uint64_t> &a,
+                                                        const std::pair<uint32_t, uint64_t> &b) {
+                                                     return _IsMoreUrgent(b.first, a.first);
+                                                 });
+
+                    mainThreadTask = *next;
+                    m_MainThreadReady.erase(next);
+                    hasMainThreadTask = true;
+                }
+            }
+
+            if (hasMainThreadTask)
+            {
+                _ExecuteTask(mainThreadTask.first, mainThreadTask.second);
+            }
+            else if (!jobSystem.Help())
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        _UpdateCosts();
+    }
+
+    bool FrameTaskGraph::_IsMoreUrgent(uint32_t a, uint32_t b) const
+    {
+        //  The main thread runs its tasks one by one, whichever unblocks work for the other threads goes first so it
+        //  overlaps with the rest of the main thread chain
+        if (m_Tasks[a].FeedsWorkers != m_Tasks[b].FeedsWorkers)
+        {
+            return m_Tasks[a].FeedsWorkers;
+        }
+
+        return m_Tasks[a].Rank > m_Tasks[b].Rank;
+    }
+
+    void FrameTaskGraph::_Schedule(uint32_t task, uint64_t frame)
+    {
+        if (m_Tasks[task].Flags & TaskMainThread)
+        {
+            std::lock_guard<std::mutex> lock(m_MainThreadMutex);
+            m_MainThreadReady.emplace_back(task, frame);
+
+            return;
+        }
+
+        const TaskJobData data = {this, task, frame};
+        JobSystem &jobSystem = JobSystem::getInstance();
+
+        jobSystem.Run(jobSystem.CreateJob(&FrameTaskGraph::_TaskJob, &data, sizeof(data)));
+    }
+
+    void FrameTaskGraph::_TaskJob(Job *, void *data)
+    {
+        const TaskJobData *job = static_cast<const TaskJobData *>(data);
+
+        job->Graph->_ExecuteTask(job->Task, job->Frame);
+    }
+
+    void FrameTaskGraph::_ExecuteTask(uint32_t index, uint64_t frame)
+    {
+        Task &task = m_Tasks[index];
+
+        const auto start = std::chrono::steady_clock::now();
+
+        task.Function(frame - task.FrameLatency);
+
+        task.Duration =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+        for (uint32_t successor : task.Successors)
+        {
+            if (m_Tasks[successor].Active && m_Pending[successor].fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                _Schedule(successor, frame);
+            }
+        }
+
+        m_Remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void FrameTaskGraph::_UpdateCosts()
+    {
+        for (Task &task : m_Tasks)
+        {
+            if (task.Active)
+            {
+                //  The first measurement replaces the initial guess outright
+                task.Cost = task.Cost > 0.0
+                                ? task.Cost + ((double)task.Duration - task.Cost) * FRAME_TASK_COST_SMOOTHING
+                                : (double)task.Duration;
+            }
+        }
+
+        //  Every edge points forward in m_Order, so walking it backwards sees successors first
+        for (auto it = m_Order.rbegin(); it != m_Order.rend(); ++it)
+        {
+            Task &task = m_Tasks[*it];
+            double longest = 0.0;
+
+            for (uint32_t successor : task.Successors)
+            {
+                longest = std::max(longest, m_Tasks[successor].Rank);
+            }
+
+            task.Rank = task.Cost + longest;
+        }
+
+        for (Task &task : m_Tasks)
+        {
+            std::sort(task.Successors.begin(), task.Successors.end(),
+                      [this](uint32_t a, uint32_t b) { return m_Tasks[a].Rank < m_Tasks[b].Rank; });
+        }
+
+        m_CriticalPath.clear();
+
+        if (m_Order.empty())
+        {
+            return;
+        }
+
+        uint32_t current = m_Order[0];
+
+        for (uint32_t task : m_Order)
+        {
+            if (m_Tasks[task].Predecessors.empty() && m_Tasks[task].Rank > m_Tasks[current].Rank)
+            {
+                current = task;
+            }
+        }
+
+        while (true)
+        {
+            m_CriticalPath.push_back(current);
+
+            const std::vector<uint32_t> &successors = m_Tasks[current].Successors;
+
+            if (successors.empty())
+            {
+                break;
+            }
+
+            current = successors.back();
+        }
+    }
+
+    const std::vector<uint32_t> &FrameTaskGraph::GetCriticalPath() const
+    {
+        return m_CriticalPath;
+    }
+
+    uint32_t FrameTaskGraph::GetTaskCount() const
+    {
+        return (uint32_t)m_Tasks.size();
+    }
+
+    const char *FrameTaskGraph::GetTaskName(uint32_t task) const
+    {
+        return m_Tasks[task].Name;
+    }
+
+    double FrameTaskGraph::GetTaskCost(uint32_t task) const
+    {
+        return m_Tasks[task].Cost;
+    }
+}  // namespace aga
@@ -0,0 +1,129 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "StringId.h"
+#include "Typedefs.h"
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace aga
+{
+    struct Job;
+
+    //  Declarative per-frame task graph executed on the JobSystem. Tasks name the resources they read and write,
+    //  Build derives the dependencies from that: a task runs after the last earlier writer of everything it
+    //  touches, and a writer also waits for the readers before it. Tasks without a path between them run in
+    //  parallel.
+    //
+    //  A task with frame latency 1 runs one frame behind, so Execute(N) overlaps it with the tasks of frame N.
+    //  Latent tasks count as running before the current ones. A resource used by tasks of both frames is
+    //  serialized between them unless it is declared with AddBufferedResource.
+    //
+    //  Task costs are measured every frame. Ready tasks are scheduled along the longest remaining path first, and
+    //  GetCriticalPath reports the chain that bounds the frame time.
+    class FrameTaskGraph
+    {
+    public:
+        typedef std::function<void(uint64_t frame)> TaskFunction;
+
+        enum TaskFlags
+        {
+            TaskDefault = 0,
+            //  Runs on the thread calling Execute, e.g. for OS event pumps
+            TaskMainThread = 1
+        };
+
+    public:
+        FrameTaskGraph();
+
+        FrameTaskGraph(const FrameTaskGraph &) = delete;
+        void operator=(const FrameTaskGraph &) = delete;
+
+        uint32_t AddTask(const char *name, TaskFunction function, std::initializer_list<StringId> reads,
+                         std::initializer_list<StringId> writes, uint32_t frameLatency = 0,
+                         uint32_t flags = TaskDefault);
+
+        //  The resource has one copy per frame in flight, tasks of different frames never wait for each other on it
+        void AddBufferedResource(StringId resource);
+
+        //  Fails when a task has a frame latency above 1
+        bool Build();
+
+        //  Runs the tasks of 'frame' and the latent tasks of the frame before it, returns when all are done
+        void Execute(uint64_t frame);
+
+        //  Runs the latent tasks still owed to 'frame', call it once after the last Execute
+        void Finish(uint64_t frame);
+
+        //  Tasks along the most expensive dependency chain, as measured by the last run
+        const std::vector<uint32_t> &GetCriticalPath() const;
+
+        uint32_t GetTaskCount() const;
+        const char *GetTaskName(uint32_t task) const;
+
+        //  Smoothed duration of the task in nanoseconds
+        double GetTaskCost(uint32_t task) const;
+
+    private:
+        struct Task
+        {
+            const char *Name;
+            TaskFunction Function;
+            std::vector<StringId> Reads;
+            std::vector<StringId> Writes;
+            uint32_t FrameLatency;
+            uint32_t Flags;
+
+            std::vector<uint32_t> Predecessors;
+            //  Sorted by ascending Rank, so the most critical successor is pushed last and popped first
+            std::vector<uint32_t> Successors;
+
+            double Cost;
+            //  Cost of the most expensive path starting at this task
+            double Rank;
+            int64_t Duration;
+            bool Active;
+            //  Main thread task with a successor that runs on a worker
+            bool FeedsWorkers;
+        };
+
+        struct TaskJobData
+        {
+            FrameTaskGraph *Graph;
+            uint32_t Task;
+            uint64_t Frame;
+        };
+
+        void _AddEdge(uint32_t from, uint32_t to);
+        void _Run(uint64_t frame, bool runCurrent, bool runLatent);
+        void _Schedule(uint32_t task, uint64_t frame);
+        void _ExecuteTask(uint32_t task, uint64_t frame);
+        bool _IsMoreUrgent(uint32_t a, uint32_t b) const;
+        void _UpdateCosts();
+
+        static void _TaskJob(Job *job, void *data);
+
+    private:
+        std::vector<Task> m_Tasks;
+        //  Latent tasks first, then the current ones, each in declaration order. Every edge points forward.
+        std::vector<uint32_t> m_Order;
+        std::vector<uint32_t> m_CriticalPath;
+        std::unordered_set<StringId> m_BufferedResources;
+
+        std::vector<std::atomic<uint32_t>> m_Pending;
+        std::atomic<uint32_t> m_Remaining;
+
+        std::mutex m_MainThreadMutex;
+        std::vector<std::pair<uint32_t, uint64_t>> m_MainThreadReady;
+
+        bool m_Built;
+    };
+}  // namespace aga
@@ -0,0 +1,434 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "JobSystem.h"
+#include "Memory.h"
+
+#include <cstring>
+
+namespace aga
+{
+    const uint32_t JOB_INVALID_WORKER = 0xFFFFFFFF;
+
+    //  ParallelFor aims for this many batches per worker so stealing can even out uneven batches
+    const uint32_t JOB_BATCHES_PER_WORKER = 4;
+
+    static thread_local uint32_t t_WorkerIndex = JOB_INVALID_WORKER;
+
+    JobQueue::JobQueue() : m_Top(0), m_Bottom(0)
+    {
+        for (uint32_t i = 0; i < JOB_QUEUE_CAPACITY; ++i)
+        {
+            m_Jobs[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    bool JobQueue::Push(Job *job)
+    {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed);
+        const int64_t top = m_Top.load(std::memory_order_acquire);
+
+        if (bottom - top >= (int64_t)JOB_QUEUE_CAPACITY)
+        {
+            return false;
+        }
+
+        m_Jobs[bottom % JOB_QUEUE_CAPACITY].store(job, std::memory_order_relaxed);
+        m_Bottom.store(bottom + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    Job *JobQueue::Pop()
+    {
+        const int64_t bottom = m_Bottom.load(std::memory_order_relaxed) - 1;
+        m_Bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        int64_t top = m_Top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+
+            return nullptr;
+        }
+
+        Job *job = m_Jobs[bottom % JOB_QUEUE_CAPACITY].load(std::memory_order_relaxed);
+
+        if (top == bottom)
+        {
+            //  Last job, race the thieves for it
+            if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            {
+                job = nullptr;
+            }
+
+            m_Bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job *JobQueue::Steal()
+    {
+        int64_t top = m_Top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t bottom = m_Bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+        {
+            return nullptr;
+        }
+
+        Job *job = m_Jobs[top % JOB_QUEUE_CAPACITY].load(std::memory_order_relaxed);
+
+        if (!m_Top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        {
+            return nullptr;
+        }
+
+        return job;
+    }
+
+    JobSystem::JobSystem()
+        : m_Running(false), m_ExternalJobs(new Job[JOB_POOL_SIZE]), m_NextExternalJob(0), m_SleepingWorkers(0),
+          m_WakeCount(0)
+    {
+    }
+
+    JobSystem::~JobSystem()
+    {
+        Destroy();
+
+        delete[] m_ExternalJobs;
+        m_ExternalJobs = nullptr;
+    }
+
+    bool JobSystem::Initialize(uint32_t workerCount)
+    {
+        MemoryTagScope scope(MemoryTag::Core);
+
+        if (!m_Workers.empty())
+        {
+            return true;
+        }
+
+        if (workerCount == 0)
+        {
+            workerCount = std::thread::hardware_concurrency();
+            workerCount = workerCount > 0 ? workerCount : 1;
+        }
+
+        for (uint32_t i = 0; i < workerCount; ++i)
+        {
+            Worker *worker = new Worker();
+            worker->Jobs = new Job[JOB_POOL_SIZE];
+            worker->NextJob = 0;
+            worker->Random = 0x9E3779B9u * (i + 1);
+
+            m_Workers.push_back(worker);
+        }
+
+        m_Running.store(true, std::memory_order_release);
+        t_WorkerIndex = 0;
+
+        for (uint32_t i = 1; i < workerCount; ++i)
+        {
+            m_Workers[i]->Thread = std::thread(&JobSystem::_WorkerMain, this, i);
+        }
+
+        return true;
+    }
+
+    void JobSystem::Destroy()
+    {
+        if (m_Workers.empty())
+        {
+            return;
+        }
+
+        m_Running.store(false, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(m_WakeMutex);
+            m_Wake.notify_all();
+        }
+
+        //  Workers steal from each other until they stop, so none is freed before all are joined
+        for (Worker *worker : m_Workers)
+        {
+            if (worker->Thread.joinable())
+            {
+                worker->Thread.join();
+            }
+        }
+
+        for (Worker *worker : m_Workers)
+        {
+            delete[] worker->Jobs;
+            delete worker;
+        }
+
+        m_Workers.clear();
+        m_WakeCount = 0;
+
+        t_WorkerIndex = JOB_INVALID_WORKER;
+    }
+
+    uint32_t JobSystem::GetWorkerCount() const
+    {
+        return (uint32_t)m_Workers.size();
+    }
+
+    bool JobSystem::_IsWorkerThread() const
+    {
+        return t_WorkerIndex < m_Workers.size();
+    }
+
+    Job *JobSystem::_AllocateJob(Job *parent, JobFunction function)
+    {
+        Job *job;
+
+        if (_IsWorkerThread())
+        {
+            Worker &worker = *m_Workers[t_WorkerIndex];
+            job = &worker.Jobs[worker.NextJob++ % JOB_POOL_SIZE];
+        }
+        else
+        {
+            job = &m_ExternalJobs[m_NextExternalJob.fetch_add(1, std::memory_order_relaxed) % JOB_POOL_SIZE];
+        }
+
+        job->Function = function;
+        job->Parent = parent;
+        job->UnfinishedJobs.store(1, std::memory_order_relaxed);
+        job->ContinuationCount.store(0, std::memory_order_relaxed);
+
+        if (parent)
+        {
+            parent->UnfinishedJobs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        return job;
+    }
+
+    Job *JobSystem::CreateJob(JobFunction function, const void *data, uint32_t size)
+    {
+        return CreateChildJob(nullptr, function, data, size);
+    }
+
+    Job *JobSystem::CreateChildJob(Job *parent, JobFunction function, const void *data, uint32_t size)
+    {
+        if (size > JOB_DATA_SIZE)
+        {
+            return nullptr;
+        }
+
+        Job *job = _AllocateJob(parent, function);
+
+        if (data)
+        {
+            memcpy(job->Data, data, size);
+        }
+
+        return job;
+    }
+
+    bool JobSystem::AddContinuation(Job *job, Job *continuation)
+    {
+        const int32_t index = job->ContinuationCount.fetch_add(1, std::memory_order_relaxed);
+
+        if (index >= (int32_t)JOB_MAX_CONTINUATIONS)
+        {
+            job->ContinuationCount.fetch_sub(1, std::memory_order_relaxed);
+
+            return false;
+        }
+
+        job->Continuations[index] = continuation;
+
+        return true;
+    }
+
+    void JobSystem::Run(Job *job)
+    {
+        if (!_IsWorkerThread() || !m_Workers[t_WorkerIndex]->Queue.Push(job))
+        {
+            _Execute(job);
+
+            return;
+        }
+
+        //  Pairs with the fence in _WorkerMain, either the sleeper is counted here or it finds the job
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (m_SleepingWorkers.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_WakeMutex);
+
+            //  One worker per pushed job, never more wakes than sleepers
+            if (m_WakeCount < m_SleepingWorkers.load(std::memory_order_relaxed))
+            {
+                ++m_WakeCount;
+                m_Wake.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::Wait(const Job *job)
+    {
+        while (!IsFinished(job))
+        {
+            if (!Help())
+            {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    bool JobSystem::Help()
+    {
+        Job *job = _IsWorkerThread() ? _GetJob(*m_Workers[t_WorkerIndex]) : nullptr;
+
+        if (!job)
+        {
+            return false;
+        }
+
+        _Execute(job);
+
+        return true;
+    }
+
+    bool JobSystem::IsFinished(const Job *job) const
+    {
+        return job->UnfinishedJobs.load(std::memory_order_acquire) == 0;
+    }
+
+    uint32_t JobSystem::_GetBatchSize(uint32_t count, uint32_t minBatchSize) const
+    {
+        const uint32_t batches = (uint32_t)m_Workers.size() * JOB_BATCHES_PER_WORKER;
+
+        if (m_Workers.size() <= 1)
+        {
+            return count;
+        }
+
+        const uint32_t batchSize = (count + batches - 1) / batches;
+
+        return batchSize > minBatchSize ? batchSize : (minBatchSize > 0 ? minBatchSize : 1);
+    }
+
+    Job *JobSystem::_GetJob(Worker &worker)
+    {
+        Job *job = worker.Queue.Pop();
+
+        if (job)
+        {
+            return job;
+        }
+
+        const uint32_t count = (uint32_t)m_Workers.size();
+
+        //  xorshift, only decides where to start looking for a victim
+        worker.Random ^= worker.Random << 13;
+        worker.Random ^= worker.Random >> 17;
+        worker.Random ^= worker.Random << 5;
+
+        for (uint32_t i = 0, start = worker.Random % count; i < count; ++i)
+        {
+            Worker *victim = m_Workers[(start + i) % count];
+
+            if (victim != &worker)
+            {
+                job = victim->Queue.Steal();
+
+                if (job)
+                {
+                    return job;
+                }
+            }
+        }
+
+        return nullptr;
+    }
+
+    void JobSystem::_Execute(Job *job)
+    {
+        if (job->Function)
+        {
+            job->Function(job, job->Data);
+        }
+
+        _Finish(job);
+    }
+
+    void JobSystem::_Finish(Job *job)
+    {
+        //  Read everything up front, once the count drops to zero a waiter may return and the slot may be reused
+        Job *parent = job->Parent;
+        const int32_t continuationCount = job->ContinuationCount.load(std::memory_order_acquire);
+        Job *continuations[JOB_MAX_CONTINUATIONS];
+
+        for (int32_t i = 0; i < continuationCount; ++i)
+        {
+            continuations[i] = job->Continuations[i];
+        }
+
+        if (job->UnfinishedJobs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+        {
+            return;
+        }
+
+        for (int32_t i = 0; i < continuationCount; ++i)
+        {
+            Run(continuations[i]);
+        }
+
+        if (parent)
+        {
+            _Finish(parent);
+        }
+    }
+
+    void JobSystem::_WorkerMain(uint32_t index)
+    {
+        t_WorkerIndex = index;
+
+        Worker &worker = *m_Workers[index];
+
+        while (m_Running.load(std::memory_order_acquire))
+        {
+            Job *job = _GetJob(worker);
+
+            if (!job)
+            {
+                std::unique_lock<std::mutex> lock(m_WakeMutex);
+
+                //  Counted as sleeping before the last look for work, so a job pushed meanwhile is either found
+                //  here or its Run sees the sleeper and wakes it
+                m_SleepingWorkers.fetch_add(1, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+
+                job = _GetJob(worker);
+
+                if (!job)
+                {
+                    m_Wake.wait(lock,
+                                [this]() { return m_WakeCount > 0 || !m_Running.load(std::memory_order_acquire); });
+
+                    m_WakeCount -= m_WakeCount > 0 ? 1 : 0;
+                }
+
+                m_SleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+            }
+
+            if (job)
+            {
+                _Execute(job);
+            }
+        }
+
+        t_WorkerIndex = JOB_INVALID_WORKER;
+    }
+}  // namespace aga
@@ -0,0 +1,210 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <stdint.h>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace aga
+{
+    //  Jobs are taken from a ring per thread, a job has to be finished before its thread creates this many more
+    const uint32_t JOB_POOL_SIZE = 4096;
+    const uint32_t JOB_QUEUE_CAPACITY = 4096;
+    const uint32_t JOB_MAX_CONTINUATIONS = 4;
+    const uint32_t JOB_DATA_SIZE = 64;
+
+    struct Job;
+
+    typedef void (*JobFunction)(Job *job, void *data);
+
+    struct alignas(64) Job
+    {
+        JobFunction Function;
+        Job *Parent;
+        //  The job itself plus its unfinished children
+        std::atomic<int32_t> UnfinishedJobs;
+        std::atomic<int32_t> ContinuationCount;
+        Job *Continuations[JOB_MAX_CONTINUATIONS];
+        alignas(16) char Data[JOB_DATA_SIZE];
+    };
+
+    //  Chase-Lev work-stealing deque. The owning thread pushes and pops at the bottom, any other thread steals from
+    //  the top. Fixed capacity, Push fails when full.
+    class JobQueue
+    {
+    public:
+        JobQueue();
+
+        bool Push(Job *job);
+        Job *Pop();
+        Job *Steal();
+
+    private:
+        alignas(64) std::atomic<int64_t> m_Top;
+        alignas(64) std::atomic<int64_t> m_Bottom;
+        std::atomic<Job *> m_Jobs[JOB_QUEUE_CAPACITY];
+    };
+
+    //  Work-stealing scheduler with one worker per core. The thread calling Initialize becomes worker 0 and
+    //  executes jobs while it waits for them.
+    //
+    //  Dependencies are expressed without blocking: children created with CreateChildJob keep their parent
+    //  unfinished until they are done, and continuations added with AddContinuation are scheduled once the job
+    //  and all its children finished. Only worker threads run jobs in parallel, on any other thread Run executes
+    //  the job on the spot.
+    class JobSystem
+    {
+    public:
+        static JobSystem &getInstance()
+        {
+            static JobSystem instance;
+            return instance;
+        }
+
+    private:
+        JobSystem();
+
+    public:
+        ~JobSystem();
+
+        JobSystem(JobSystem const &) = delete;
+        void operator=(JobSystem const &) = delete;
+
+        //  0 starts one worker per hardware thread
+        bool Initialize(uint32_t workerCount = 0);
+        void Destroy();
+
+        uint32_t GetWorkerCount() const;
+
+        Job *CreateJob(JobFunction function, const void *data = nullptr, uint32_t size = 0);
+        Job *CreateChildJob(Job *parent, JobFunction function, const void *data = nullptr, uint32_t size = 0);
+
+        //  Stores 'function' inside the job, it has to fit into JOB_DATA_SIZE bytes
+        template <typename Function>
+        Job *CreateJob(Function &&function)
+        {
+            return _CreateJobFromFunction(nullptr, std::forward<Function>(function));
+        }
+
+        template <typename Function>
+        Job *CreateChildJob(Job *parent, Function &&function)
+        {
+            return _CreateJobFromFunction(parent, std::forward<Function>(function));
+        }
+
+        //  Schedules 'continuation' once 'job' is finished. Has to be called before 'job' is run.
+        bool AddContinuation(Job *job, Job *continuation);
+
+        void Run(Job *job);
+
+        //  Executes other jobs until 'job' is finished
+        void Wait(const Job *job);
+
+        bool IsFinished(const Job *job) const;
+
+        //  Executes one queued or stolen job, for wait loops that also have other work to look after. Returns false
+        //  when there was nothing to run or the caller is not a worker.
+        bool Help();
+
+        //  Calls function(first, count) for batches of at least 'minBatchSize' elements covering [0, count) and
+        //  returns when all of them are done
+        template <typename Function>
+        void ParallelFor(uint32_t count, uint32_t minBatchSize, const Function &function)
+        {
+            struct Range
+            {
+                const Function *Body;
+                uint32_t First;
+                uint32_t Count;
+            };
+
+            const uint32_t batchSize = _GetBatchSize(count, minBatchSize);
+
+            if (batchSize >= count || !_IsWorkerThread())
+            {
+                function(0, count);
+
+                return;
+            }
+
+            Job *root = _AllocateJob(nullptr, nullptr);
+
+            for (uint32_t first = 0; first < count; first += batchSize)
+            {
+                const Range range = {&function, first, count - first < batchSize ? count - first : batchSize};
+
+                Run(CreateChildJob(root,
+                                   [](Job *, void *data) {
+                                       const Range *range = static_cast<const Range *>(data);
+                                       (*range->Body)(range->First, range->Count);
+                                   },
+                                   &range, sizeof(range)));
+            }
+
+            Run(root);
+            Wait(root);
+        }
+
+    private:
+        struct alignas(64) Worker
+        {
+            JobQueue Queue;
+            Job *Jobs;
+            uint32_t NextJob;
+            uint32_t Random;
+            std::thread Thread;
+        };
+
+        template <typename Function>
+        Job *_CreateJobFromFunction(Job *parent, Function &&function)
+        {
+            typedef typename std::decay<Function>::type Stored;
+
+            static_assert(sizeof(Stored) <= JOB_DATA_SIZE, "Job function does not fit into Job::Data");
+            static_assert(alignof(Stored) <= 16, "Job function is over-aligned for Job::Data");
+
+            Job *job = _AllocateJob(parent, [](Job *job, void *data) {
+                Stored *stored = static_cast<Stored *>(data);
+                (*stored)();
+                stored->~Stored();
+            });
+
+            new (job->Data) Stored(std::forward<Function>(function));
+
+            return job;
+        }
+
+        Job *_AllocateJob(Job *parent, JobFunction function);
+        uint32_t _GetBatchSize(uint32_t count, uint32_t minBatchSize) const;
+        bool _IsWorkerThread() const;
+
+        Job *_GetJob(Worker &worker);
+        void _Execute(Job *job);
+        void _Finish(Job *job);
+        void _WorkerMain(uint32_t index);
+
+    private:
+        std::vector<Worker *> m_Workers;
+        std::atomic<bool> m_Running;
+
+        //  Jobs created on threads that are not workers
+        Job *m_ExternalJobs;
+        std::atomic<uint32_t> m_NextExternalJob;
+
+        //  Idle workers block on m_Wake, Run wakes one of them per job. m_WakeCount holds the wakes not taken
+        //  yet and is guarded by m_WakeMutex, so is every change of m_SleepingWorkers.
+        std::atomic<uint32_t> m_SleepingWorkers;
+        std::mutex m_WakeMutex;
+        std::condition_variable m_Wake;
+        uint32_t m_WakeCount;
+    };
+}  // namespace aga
@@ -2,46 +2,521 @@
 
 #include "Logger.h"
 #include "Common.h"
+#include "Memory.h"
 
+#include <cerrno>
 #include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <unistd.h>
 
 namespace aga
 {
-    void Logger::Log(LogLevel level, const String &message)
+    //  How long the writer thread sleeps when the ring is empty
+    const std::chrono::milliseconds LOG_FLUSH_INTERVAL(10);
+
+    const int LOG_CRASH_SIGNALS[] = {SIGSEGV, SIGABRT, SIGFPE, SIGILL};
+
+    //  Plain write(2), the only way out of a signal handler
+    static void WriteRaw(const char *data, size_t length)
+    {
+        while (length > 0)
+        {
+            const ssize_t written = write(STDOUT_FILENO, data, length);
+
+            if (written < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (written <= 0)
+            {
+                return;
+            }
+
+            data += written;
+            length -= (size_t)written;
+        }
+    }
+
+    static int64_t GetTimeNanoseconds()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    Logger::Logger()
+        : m_Level(Info), m_OverflowPolicy(Drop), m_Tail(0), m_Head(0), m_Dropped(0), m_Draining(false),
+          m_Running(true), m_BinarySinkOpen(false), m_Slots(nullptr), m_ReportedDropped(0),
+          m_CachedSecond(-1)
+    {
+        //  Allocated here rather than in the initializer list, so the ring is charged to Core
+        MemoryTagScope scope(MemoryTag::Core);
+        m_Slots = new Slot[LOG_SLOT_COUNT];
+
+        for (uint32_t i = 0; i < LOG_SLOT_COUNT; ++i)
+        {
+            m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+        }
+
+        m_Thread = std::thread(&Logger::_ThreadMain, this);
+
+        for (int signal : LOG_CRASH_SIGNALS)
+        {
+            std::signal(signal, &Logger::_CrashHandler);
+        }
+    }
+
+    Logger::~Logger()
+    {
+        Shutdown();
+
+        delete[] m_Slots;
+        m_Slots = nullptr;
+    }
+
+    void Logger::Log(LogLevel level, StringView message)
+    {
+        if (!IsEnabled(level))
+        {
+            return;
+        }
+
+        _Write(level, RecordText, StringView(), message);
+    }
+
+    void Logger::Log(LogLevel level, StringView function, StringView message)
+    {
+        if (!IsEnabled(level))
+        {
+            return;
+        }
+
+        _Write(level, RecordText, function, message);
+    }
+
+    void Logger::_Write(LogLevel level, RecordKind kind, StringView function, StringView message)
+    {
+        const int64_t time = GetTimeNanoseconds();
+
+        if (!m_Running.load(std::memory_order_acquire))
+        {
+            //  _WriteOut shares the cached timestamp and the sink with the drain
+            _LockDrain();
+            _WriteOut(level, kind, time, function, message);
+            m_Draining.store(false, std::memory_order_release);
+
+            return;
+        }
+
+        const uint32_t separatorLength = function.IsEmpty() ? 0 : 2;
+        const uint32_t payload = sizeof(Slot::Data);
+        const uint32_t maxLength = LOG_MAX_RECORD_SLOTS * payload - sizeof(RecordHeader);
+
+        uint32_t length = function.Length() + separatorLength + message.Length();
+        length = length < maxLength ? length : maxLength;
+
+        const uint32_t slotCount = (sizeof(RecordHeader) + length + payload - 1) / payload;
+        uint64_t position;
+
+        while (!_Claim(slotCount, position))
+        {
+            m_Wake.notify_one();
+
+            if (m_OverflowPolicy.load(std::memory_order_relaxed) == Drop)
+            {
+                m_Dropped.fetch_add(1, std::memory_order_relaxed);
+
+                return;
+            }
+
+            std::this_thread::yield();
+        }
+
+        RecordHeader header;
+        header.Time = time;
+        header.Length = length;
+        header.SlotCount = (uint16_t)slotCount;
+        header.Level = (uint8_t)level;
+        header.Kind = (uint8_t)kind;
+
+        //  Text runs through the payloads of consecutive slots, the first one starts with the header
+        uint32_t slot = 0;
+        uint32_t offset = sizeof(RecordHeader);
+        memcpy(m_Slots[position % LOG_SLOT_COUNT].Data, &header, sizeof(RecordHeader));
+
+        const StringView parts[] = {function, StringView(": ", separatorLength), message};
+        uint32_t remaining = length;
+
+        for (const StringView &part : parts)
+        {
+            const char *data = part.GetData();
+            uint32_t partLength = part.Length() < remaining ? part.Length() : remaining;
+            remaining -= partLength;
+
+            while (partLength > 0)
+            {
+                if (offset == payload)
+                {
+                    ++slot;
+                    offset = 0;
+                }
+
+                const uint32_t count = partLength < payload - offset ? partLength : payload - offset;
+                memcpy(m_Slots[(position + slot) % LOG_SLOT_COUNT].Data + offset, data, count);
+
+                data += count;
+                offset += count;
+                partLength -= count;
+            }
+        }
+
+        //  The first slot goes last, the writer starts reading a record only once its first slot is published
+        for (uint32_t i = slotCount; i-- > 0;)
+        {
+            m_Slots[(position + i) % LOG_SLOT_COUNT].Sequence.store(position + i + 1, std::memory_order_release);
+        }
+
+        //  Shutdown may have drained the ring between the check above and the publish
+        if (!m_Running.load(std::memory_order_acquire))
+        {
+            _Drain();
+        }
+    }
+
+    bool Logger::_Claim(uint32_t slotCount, uint64_t &position)
+    {
+        position = m_Tail.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            //  The writer frees slots in order, so if the last one is free all of them are
+            const uint64_t last = position + slotCount - 1;
+            const uint64_t sequence = m_Slots[last % LOG_SLOT_COUNT].Sequence.load(std::memory_order_acquire);
+            const int64_t difference = (int64_t)(sequence - last);
+
+            if (difference == 0)
+            {
+                if (m_Tail.compare_exchange_weak(position, position + slotCount, std::memory_order_relaxed))
+                {
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = m_Tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void Logger::_WriteOut(LogLevel level, RecordKind kind, int64_t time, StringView function, StringView message)
     {
-        if (level < m_Level)
+        if (kind == RecordPacked)
         {
+            if (m_BinarySink.IsOpen())
+            {
+                m_BinarySink.WriteMessage((uint8_t)level, time, message);
+
+                return;
+            }
+
+            //  The sink was closed while the record waited in the ring
+            char text[LOG_FORMAT_BUFFER_SIZE];
+            StringView packedFunction;
+            const uint32_t length = FormatLogMessage(message, text, sizeof(text), packedFunction);
+
+            _WriteLine(level, time, packedFunction,
+                       StringView(text, length < sizeof(text) ? length : sizeof(text) - 1));
+
             return;
         }
 
-        std::time_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+        if (!m_BinarySink.IsOpen())
+        {
+            _WriteLine(level, time, function, message);
 
-        char time_buffer[100] = {0};
-        std::strftime(time_buffer, sizeof(time_buffer), "%T", std::localtime(&now));
+            return;
+        }
 
-        char severity[10];
+        if (function.IsEmpty())
+        {
+            m_BinarySink.WriteText((uint8_t)level, time, message);
 
+            return;
+        }
+
+        FormatBuffer<LOG_MAX_RECORD_SLOTS * LOG_SLOT_SIZE> text("{}: {}", function, message);
+        m_BinarySink.WriteText((uint8_t)level, time, text.GetView());
+    }
+
+    void Logger::_WriteLine(LogLevel level, int64_t time, StringView function, StringView message)
+    {
+        const int64_t second = time / 1000000000;
+
+        if (second != m_CachedSecond)
+        {
+            const std::time_t now = (std::time_t)second;
+            std::strftime(m_CachedTime, sizeof(m_CachedTime), "%T", std::localtime(&now));
+            m_CachedSecond = second;
+        }
+
+        //  One fwrite per line keeps lines from different threads whole
+        char line[LOG_MAX_RECORD_SLOTS * LOG_SLOT_SIZE + 64];
+        uint32_t length = function.IsEmpty() ? Format(line, sizeof(line), "{} {}: {}", m_CachedTime,
+                                                      GetLevelName(level), message)
+                                             : Format(line, sizeof(line), "{} {}: {}: {}", m_CachedTime,
+                                                      GetLevelName(level), function, message);
+
+        std::fwrite(line, 1, length < sizeof(line) ? length : sizeof(line) - 1, stdout);
+    }
+
+    bool Logger::_Drain()
+    {
+        if (m_Draining.exchange(true, std::memory_order_acquire))
+        {
+            return false;
+        }
+
+        const uint32_t payload = sizeof(Slot::Data);
+        char text[LOG_MAX_RECORD_SLOTS * payload];
+        uint64_t position = m_Head.load(std::memory_order_relaxed);
+
+        while (true)
+        {
+            Slot &first = m_Slots[position % LOG_SLOT_COUNT];
+
+            if (first.Sequence.load(std::memory_order_acquire) != position + 1)
+            {
+                break;
+            }
+
+            RecordHeader header;
+            memcpy(&header, first.Data, sizeof(RecordHeader));
+
+            uint32_t copied = 0;
+
+            for (uint32_t i = 0; i < header.SlotCount; ++i)
+            {
+                Slot &slot = m_Slots[(position + i) % LOG_SLOT_COUNT];
+                const uint32_t offset = i == 0 ? sizeof(RecordHeader) : 0;
+                const uint32_t count =
+                    header.Length - copied < payload - offset ? header.Length - copied : payload - offset;
+
+                memcpy(text + copied, slot.Data + offset, count);
+                copied += count;
+
+                slot.Sequence.store(position + i + LOG_SLOT_COUNT, std::memory_order_release);
+            }
+
+            position += header.SlotCount;
+            m_Head.store(position, std::memory_order_release);
+
+            _WriteOut((LogLevel)header.Level, (RecordKind)header.Kind, header.Time, StringView(),
+                      StringView(text, header.Length));
+        }
+
+        const uint64_t dropped = m_Dropped.load(std::memory_order_relaxed);
+
+        if (dropped != m_ReportedDropped)
+        {
+            FormatBuffer<64> message("{} log messages dropped\n", dropped - m_ReportedDropped);
+            _WriteOut(Warning, RecordText, GetTimeNanoseconds(), "Logger", message.GetView());
+
+            m_ReportedDropped = dropped;
+        }
+
+        std::fflush(stdout);
+        m_BinarySink.Flush();
+
+        m_Draining.store(false, std::memory_order_release);
+
+        return true;
+    }
+
+    void Logger::_LockDrain()
+    {
+        while (m_Draining.exchange(true, std::memory_order_acquire))
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    void Logger::_ThreadMain()
+    {
+        MemoryTagScope scope(MemoryTag::Core);
+
+        while (m_Running.load(std::memory_order_acquire))
+        {
+            _Drain();
+
+            std::unique_lock<std::mutex> lock(m_WakeMutex);
+            m_Wake.wait_for(lock, LOG_FLUSH_INTERVAL);
+        }
+    }
+
+    void Logger::_CrashHandler(int signal)
+    {
+        Logger &logger = getInstance();
+
+        //  Nothing _Drain does is async-signal-safe (stdio, localtime, the sink), so the published records are
+        //  copied straight from the ring with write(2) and left in place. Packed records would need decoding first.
+        const uint32_t payload = sizeof(Slot::Data);
+        uint64_t position = logger.m_Head.load(std::memory_order_acquire);
+
+        while (true)
+        {
+            const Slot &first = logger.m_Slots[position % LOG_SLOT_COUNT];
+
+            if (first.Sequence.load(std::memory_order_acquire) != position + 1)
+            {
+                break;
+            }
+
+            RecordHeader header;
+            memcpy(&header, first.Data, sizeof(RecordHeader));
+
+            if (header.SlotCount == 0 || header.SlotCount > LOG_MAX_RECORD_SLOTS)
+            {
+                break;
+            }
+
+            const char *level = GetLevelName((LogLevel)header.Level);
+            WriteRaw(level, strlen(level));
+            WriteRaw(": ", 2);
+
+            if (header.Kind == RecordPacked)
+            {
+                const char PACKED[] = "(binary record not written)\n";
+                WriteRaw(PACKED, sizeof(PACKED) - 1);
+            }
+            else
+            {
+                uint32_t copied = 0;
+                char last = '\n';
+
+                for (uint32_t i = 0; i < header.SlotCount && copied < header.Length; ++i)
+                {
+                    const Slot &slot = logger.m_Slots[(position + i) % LOG_SLOT_COUNT];
+                    const uint32_t offset = i == 0 ? sizeof(RecordHeader) : 0;
+                    const uint32_t count =
+                        header.Length - copied < payload - offset ? header.Length - copied : payload - offset;
+
+                    WriteRaw(slot.Data + offset, count);
+                    copied += count;
+                    last = count > 0 ? slot.Data[offset + count - 1] : last;
+                }
+
+                if (last != '\n')
+                {
+                    WriteRaw("\n", 1);
+                }
+            }
+
+            position += header.SlotCount;
+        }
+
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    void Logger::EnableLogLevel(LogLevel level)
+    {
+        m_Level.store(level, std::memory_order_relaxed);
+    }
+
+    void Logger::SetOverflowPolicy(OverflowPolicy policy)
+    {
+        m_OverflowPolicy.store(policy, std::memory_order_relaxed);
+    }
+
+    void Logger::Flush()
+    {
+        const uint64_t target = m_Tail.load(std::memory_order_acquire);
+
+        while (m_Head.load(std::memory_order_acquire) < target)
+        {
+            if (m_Running.load(std::memory_order_acquire))
+            {
+                m_Wake.notify_one();
+            }
+            else
+            {
+                _Drain();
+            }
+
+            std::this_thread::yield();
+        }
+    }
+
+    void Logger::Shutdown()
+    {
+        if (m_Running.exchange(false, std::memory_order_acq_rel))
+        {
+            m_Wake.notify_one();
+            m_Thread.join();
+        }
+
+        while (!_Drain())
+        {
+            std::this_thread::yield();
+        }
+    }
+
+    bool Logger::OpenBinarySink(const char *path)
+    {
+        MemoryTagScope scope(MemoryTag::Core);
+
+        //  Earlier records still go to stdout
+        Flush();
+        _LockDrain();
+
+        const bool opened = m_BinarySink.Open(path);
+        m_BinarySinkOpen.store(opened, std::memory_order_relaxed);
+
+        m_Draining.store(false, std::memory_order_release);
+
+        return opened;
+    }
+
+    void Logger::CloseBinarySink()
+    {
+        m_BinarySinkOpen.store(false, std::memory_order_relaxed);
+
+        //  Everything logged so far still belongs into the file
+        Flush();
+        _LockDrain();
+
+        m_BinarySink.Close();
+
+        m_Draining.store(false, std::memory_order_release);
+    }
+
+    const char *Logger::GetLevelName(LogLevel level)
+    {
         switch (level)
         {
             case LogLevel::Debug:
-                StrCopy(severity, "DEBUG");
-                break;
+                return "DEBUG";
             case LogLevel::Info:
-                StrCopy(severity, "INFO");
-                break;
+                return "INFO";
             case LogLevel::Warning:
-                StrCopy(severity, "WARNING");
-                break;
+                return "WARNING";
             case LogLevel::Error:
-                StrCopy(severity, "ERROR");
-                break;
+                return "ERROR";
         }
 
-        std::cout << time_buffer << " " << severity << ": " << message;
+        return "";
     }
 
-    void Logger::EnableLogLevel(LogLevel level)
+    uint64_t Logger::GetDroppedCount() const
     {
-        m_Level = level;
+        return m_Dropped.load(std::memory_order_relaxed);
     }
-}  // namespace aga
\ No newline at end of file
+}  // namespace aga
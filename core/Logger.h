@@ -2,26 +2,94 @@
 
 #pragma once
 
+#include "BinaryLog.h"
+#include "BuildConfig.h"
+#include "Format.h"
 #include "String.h"
+#include "StringView.h"
 
-#define LOG_DEBUG(message) aga::Logger::getInstance().Log(aga::Logger::LogLevel::Debug, message);
-#define LOG_DEBUG_F(message)                                                                                           \
-    aga::Logger::getInstance().Log(aga::Logger::LogLevel::Debug, aga::String(__FUNCTION__) + ": " + message);
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
 
-#define LOG_INFO(message) aga::Logger::getInstance().Log(aga::Logger::LogLevel::Info, message);
-#define LOG_INFO_F(message)                                                                                            \
-    aga::Logger::getInstance().Log(aga::Logger::LogLevel::Info, aga::String(__FUNCTION__) + ": " + message);
+//  The message expression is only evaluated when its level is enabled, so filtered calls build no temporaries.
+//  Levels below BUILD_LOG_MIN_LEVEL are discarded at compile time.
+#define LOG_MESSAGE(level, message)                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr ((level) >= BUILD_LOG_MIN_LEVEL)                                                                  \
+        {                                                                                                              \
+            if (aga::Logger::getInstance().IsEnabled(level))                                                           \
+            {                                                                                                          \
+                aga::Logger::getInstance().Log(level, message);                                                        \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
 
-#define LOG_WARNING(message) aga::Logger::getInstance().Log(aga::Logger::LogLevel::Warning, message);
-#define LOG_WARNING_F(message)                                                                                         \
-    aga::Logger::getInstance().Log(aga::Logger::LogLevel::Warning, aga::String(__FUNCTION__) + ": " + message);
+//  The function name is passed on next to the message instead of being concatenated in front of it
+#define LOG_MESSAGE_F(level, message)                                                                                  \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr ((level) >= BUILD_LOG_MIN_LEVEL)                                                                  \
+        {                                                                                                              \
+            if (aga::Logger::getInstance().IsEnabled(level))                                                           \
+            {                                                                                                          \
+                aga::Logger::getInstance().Log(level, __FUNCTION__, message);                                          \
+            }                                                                                                          \
+        }                                                                                                              \
+    } while (0)
 
-#define LOG_ERROR(message) aga::Logger::getInstance().Log(aga::Logger::LogLevel::Error, message);
-#define LOG_ERROR_F(message)                                                                                           \
-    aga::Logger::getInstance().Log(aga::Logger::LogLevel::Error, aga::String(__FUNCTION__) + ": " + message);
+//  'format' has to be a string literal, see LOG_FORMAT_STRING
+#define LOG_FORMAT(level, function, format, ...)                                                                       \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if constexpr ((level) >= BUILD_LOG_MIN_LEVEL)                                                                  \
+        {                                                                                                              \
+            aga::Logger::getInstance().LogFormat(level, function, LOG_FORMAT_STRING(format), ##__VA_ARGS__);           \
+        }                                                                                                              \
+    } while (0)
+
+#define LOG_DEBUG(message) LOG_MESSAGE(aga::Logger::LogLevel::Debug, message);
+#define LOG_DEBUG_F(message) LOG_MESSAGE_F(aga::Logger::LogLevel::Debug, message);
+
+#define LOG_INFO(message) LOG_MESSAGE(aga::Logger::LogLevel::Info, message);
+#define LOG_INFO_F(message) LOG_MESSAGE_F(aga::Logger::LogLevel::Info, message);
+
+#define LOG_WARNING(message) LOG_MESSAGE(aga::Logger::LogLevel::Warning, message);
+#define LOG_WARNING_F(message) LOG_MESSAGE_F(aga::Logger::LogLevel::Warning, message);
+
+#define LOG_ERROR(message) LOG_MESSAGE(aga::Logger::LogLevel::Error, message);
+#define LOG_ERROR_F(message) LOG_MESSAGE_F(aga::Logger::LogLevel::Error, message);
+
+//  Format based variants, see Format.h. Arguments are formatted into a stack buffer after the level check, or
+//  copied raw when a binary sink is open.
+#define LOG_DEBUG_FMT(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Debug, "", format, ##__VA_ARGS__);
+#define LOG_DEBUG_FMT_F(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Debug, __FUNCTION__, format, ##__VA_ARGS__);
+
+#define LOG_INFO_FMT(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Info, "", format, ##__VA_ARGS__);
+#define LOG_INFO_FMT_F(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Info, __FUNCTION__, format, ##__VA_ARGS__);
+
+#define LOG_WARNING_FMT(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Warning, "", format, ##__VA_ARGS__);
+#define LOG_WARNING_FMT_F(format, ...)                                                                                 \
+    LOG_FORMAT(aga::Logger::LogLevel::Warning, __FUNCTION__, format, ##__VA_ARGS__);
+
+#define LOG_ERROR_FMT(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Error, "", format, ##__VA_ARGS__);
+#define LOG_ERROR_FMT_F(format, ...) LOG_FORMAT(aga::Logger::LogLevel::Error, __FUNCTION__, format, ##__VA_ARGS__);
 
 namespace aga
 {
+    //  Ring of fixed-size slots shared by all producers, a record takes as many consecutive slots as its text needs
+    const uint32_t LOG_SLOT_SIZE = 128;
+    const uint32_t LOG_SLOT_COUNT = 8192;
+    //  Longer records are truncated
+    const uint32_t LOG_MAX_RECORD_SLOTS = 64;
+
+    //  Producers only copy the message into a lock-free MPSC ring, a background thread adds the timestamp and
+    //  severity and writes it out. Memory is bounded by the ring, what happens when it is full is chosen by the
+    //  OverflowPolicy. Pending records are written on Flush, on shutdown and when the process crashes, the latter
+    //  as bare text without timestamps.
     class Logger
     {
     public:
@@ -33,6 +101,14 @@ namespace aga
             Error
         };
 
+        enum OverflowPolicy
+        {
+            //  Lose the message and count it, reported with the next written record
+            Drop,
+            //  Wait for the writer thread to make room
+            Block
+        };
+
     public:
         static Logger &getInstance()
         {
@@ -41,17 +117,129 @@ namespace aga
         }
 
     private:
-        LogLevel m_Level;
-
-        Logger() : m_Level(Info)
-        {
-        }
+        Logger();
 
     public:
+        ~Logger();
+
         Logger(Logger const &) = delete;
         void operator=(Logger const &) = delete;
 
-        void Log(LogLevel level, const String &message);
+        void Log(LogLevel level, StringView message);
+        void Log(LogLevel level, StringView function, StringView message);
         void EnableLogLevel(LogLevel level);
+
+        bool IsEnabled(LogLevel level) const
+        {
+            return level >= m_Level.load(std::memory_order_relaxed);
+        }
+
+        //  Longer messages are truncated
+        template <typename... Args>
+        void LogFormat(LogLevel level, StringView function, const LogFormatString &format, const Args &... args)
+        {
+            if (!IsEnabled(level))
+            {
+                return;
+            }
+
+            const FormatArgument arguments[] = {FormatArgument(args)..., FormatArgument()};
+            char buffer[LOG_FORMAT_BUFFER_SIZE];
+
+            if (m_BinarySinkOpen.load(std::memory_order_relaxed))
+            {
+                const uint32_t length = PackLogMessage(buffer, sizeof(buffer), format, function, arguments,
+                                                       sizeof...(Args));
+
+                _Write(level, RecordPacked, StringView(), StringView(buffer, length));
+
+                return;
+            }
+
+            const uint32_t length = FormatArguments(buffer, sizeof(buffer), StringView(format.Text, format.Length),
+                                                    arguments, sizeof...(Args));
+
+            _Write(level, RecordText, function,
+                   StringView(buffer, length < sizeof(buffer) ? length : sizeof(buffer) - 1));
+        }
+
+        //  From now on records go to a binary log file instead of stdout, formatted calls are stored as format id
+        //  and raw arguments. Read it back with the LogDecoder tool.
+        bool OpenBinarySink(const char *path);
+        void CloseBinarySink();
+
+        void SetOverflowPolicy(OverflowPolicy policy);
+
+        //  Blocks until every record logged before the call has been written
+        void Flush();
+
+        //  Stops the writer thread and writes what is left, later messages are written on the calling thread
+        void Shutdown();
+
+        uint64_t GetDroppedCount() const;
+
+        static const char *GetLevelName(LogLevel level);
+
+    private:
+        static const uint32_t LOG_FORMAT_BUFFER_SIZE = 1024;
+
+        enum RecordKind
+        {
+            RecordText,
+            //  Output of PackLogMessage
+            RecordPacked
+        };
+
+        struct RecordHeader
+        {
+            int64_t Time;
+            uint32_t Length;
+            uint16_t SlotCount;
+            uint8_t Level;
+            uint8_t Kind;
+        };
+
+        struct Slot
+        {
+            //  Equal to the slot position when free, position + 1 once a producer published it
+            std::atomic<uint64_t> Sequence;
+            char Data[LOG_SLOT_SIZE - sizeof(std::atomic<uint64_t>)];
+        };
+
+        void _Write(LogLevel level, RecordKind kind, StringView function, StringView message);
+        bool _Claim(uint32_t slotCount, uint64_t &position);
+        //  Sends a record to the binary sink when it is open, otherwise to stdout through _WriteLine
+        void _WriteOut(LogLevel level, RecordKind kind, int64_t time, StringView function, StringView message);
+        void _WriteLine(LogLevel level, int64_t time, StringView function, StringView message);
+
+        //  Writes published records until the ring is empty, returns false if another thread is already draining
+        bool _Drain();
+        void _LockDrain();
+        void _ThreadMain();
+
+        static void _CrashHandler(int signal);
+
+    private:
+        std::atomic<LogLevel> m_Level;
+        std::atomic<OverflowPolicy> m_OverflowPolicy;
+
+        alignas(64) std::atomic<uint64_t> m_Tail;
+        alignas(64) std::atomic<uint64_t> m_Head;
+        std::atomic<uint64_t> m_Dropped;
+        std::atomic<bool> m_Draining;
+        std::atomic<bool> m_Running;
+        std::atomic<bool> m_BinarySinkOpen;
+
+        std::thread m_Thread;
+        std::mutex m_WakeMutex;
+        std::condition_variable m_Wake;
+
+        Slot *m_Slots;
+
+        //  Only touched by the thread holding m_Draining
+        BinaryLogWriter m_BinarySink;
+        uint64_t m_ReportedDropped;
+        int64_t m_CachedSecond;
+        char m_CachedTime[16];
     };
 }  // namespace aga
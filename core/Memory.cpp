@@ -0,0 +1,465 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "Memory.h"
+#include "BuildConfig.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#if BUILD_ENABLE_LEAK_TRACKING && defined(__linux)
+#include <execinfo.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define MEMORY_CALL_SITE() _ReturnAddress()
+#else
+#define MEMORY_CALL_SITE() __builtin_return_address(0)
+#endif
+
+namespace aga
+{
+    const uint32_t MEMORY_TAG_COUNT = (uint32_t)MemoryTag::Count;
+
+    //  Threads past this many share one slot, updated with atomic adds instead of plain stores
+    const uint32_t MEMORY_MAX_THREAD_SLOTS = 64;
+
+    //  Written only by the owning thread, so updates are plain load/store pairs without a locked instruction.
+    //  The atomics are there so EndFrame can read them from another thread without tearing.
+    struct alignas(64) ThreadMemoryCounters
+    {
+        std::atomic<int64_t> Bytes[MEMORY_TAG_COUNT];
+        std::atomic<uint64_t> Allocations[MEMORY_TAG_COUNT];
+        std::atomic<uint64_t> Frees[MEMORY_TAG_COUNT];
+    };
+
+    struct alignas(16) AllocationHeader
+    {
+#if BUILD_ENABLE_LEAK_TRACKING
+        AllocationHeader *Previous;
+        AllocationHeader *Next;
+        void *CallSite;
+        uint64_t Sequence;
+#endif
+        uint64_t Size;
+        MemoryTag Tag;
+    };
+
+    //  Everything below is constant-initialized, operator new may run before any dynamic initializer
+    static ThreadMemoryCounters g_ThreadCounters[MEMORY_MAX_THREAD_SLOTS + 1];
+    static std::atomic<uint32_t> g_ThreadSlotCount(0);
+
+    static thread_local ThreadMemoryCounters *t_Counters = nullptr;
+    static thread_local MemoryTag t_CurrentTag = MemoryTag::General;
+
+#if BUILD_ENABLE_LEAK_TRACKING
+    static std::atomic_flag g_LiveBlocksLock = ATOMIC_FLAG_INIT;
+    static AllocationHeader *g_LiveBlocks = nullptr;
+    static std::atomic<uint64_t> g_AllocationSequence(0);
+    static uint64_t g_LeakCheckpoint = 0;
+
+    static inline void LockLiveBlocks()
+    {
+        while (g_LiveBlocksLock.test_and_set(std::memory_order_acquire))
+            ;
+    }
+
+    static inline void UnlockLiveBlocks()
+    {
+        g_LiveBlocksLock.clear(std::memory_order_release);
+    }
+#endif
+
+    static inline ThreadMemoryCounters *GetThreadCounters()
+    {
+        if (!t_Counters)
+        {
+            const uint32_t slot = g_ThreadSlotCount.fetch_add(1, std::memory_order_relaxed);
+            t_Counters = &g_ThreadCounters[std::min(slot, MEMORY_MAX_THREAD_SLOTS)];
+        }
+
+        return t_Counters;
+    }
+
+    template <typename T>
+    static inline void AddToCounter(ThreadMemoryCounters *counters, std::atomic<T> &counter, T value)
+    {
+        if (counters == &g_ThreadCounters[MEMORY_MAX_THREAD_SLOTS])
+        {
+            counter.fetch_add(value, std::memory_order_relaxed);
+        }
+        else
+        {
+            counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
+    }
+
+    static void *TrackedAllocate(size_t size, void *callSite, bool throwOnFailure)
+    {
+#if BUILD_ENABLE_MEMORY_TRACKING
+        AllocationHeader *header = static_cast<AllocationHeader *>(std::malloc(sizeof(AllocationHeader) + size));
+
+        if (!header)
+        {
+            if (throwOnFailure)
+            {
+                throw std::bad_alloc();
+            }
+
+            return nullptr;
+        }
+
+        header->Size = size;
+        header->Tag = t_CurrentTag;
+
+        const uint32_t tag = (uint32_t)header->Tag;
+        ThreadMemoryCounters *counters = GetThreadCounters();
+
+        AddToCounter<int64_t>(counters, counters->Bytes[tag], (int64_t)size);
+        AddToCounter<uint64_t>(counters, counters->Allocations[tag], 1);
+
+#if BUILD_ENABLE_LEAK_TRACKING
+        header->CallSite = callSite;
+        header->Sequence = g_AllocationSequence.fetch_add(1, std::memory_order_relaxed);
+        header->Previous = nullptr;
+
+        LockLiveBlocks();
+
+        header->Next = g_LiveBlocks;
+
+        if (g_LiveBlocks)
+        {
+            g_LiveBlocks->Previous = header;
+        }
+
+        g_LiveBlocks = header;
+
+        UnlockLiveBlocks();
+#else
+        (void)callSite;
+#endif
+
+        return header + 1;
+#else
+        (void)callSite;
+
+        void *memory = std::malloc(size);
+
+        if (!memory && throwOnFailure)
+        {
+            throw std::bad_alloc();
+        }
+
+        return memory;
+#endif
+    }
+
+    static void TrackedFree(void *memory)
+    {
+#if BUILD_ENABLE_MEMORY_TRACKING
+        if (!memory)
+        {
+            return;
+        }
+
+        AllocationHeader *header = static_cast<AllocationHeader *>(memory) - 1;
+
+        const uint32_t tag = (uint32_t)header->Tag;
+        ThreadMemoryCounters *counters = GetThreadCounters();
+
+        AddToCounter<int64_t>(counters, counters->Bytes[tag], -(int64_t)header->Size);
+        AddToCounter<uint64_t>(counters, counters->Frees[tag], 1);
+
+#if BUILD_ENABLE_LEAK_TRACKING
+        LockLiveBlocks();
+
+        if (header->Previous)
+        {
+            header->Previous->Next = header->Next;
+        }
+        else
+        {
+            g_LiveBlocks = header->Next;
+        }
+
+        if (header->Next)
+        {
+            header->Next->Previous = header->Previous;
+        }
+
+        UnlockLiveBlocks();
+#endif
+
+        std::free(header);
+#else
+        std::free(memory);
+#endif
+    }
+
+    MemoryTracker::MemoryTracker() : m_Tags(), m_PeakBytes(0), m_FrameIndex(0)
+    {
+    }
+
+    void MemoryTracker::EndFrame()
+    {
+        const uint32_t slotCount = std::min(g_ThreadSlotCount.load(std::memory_order_relaxed), MEMORY_MAX_THREAD_SLOTS);
+        int64_t totalBytes = 0;
+
+        for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            int64_t bytes = 0;
+            uint64_t allocations = 0;
+            uint64_t frees = 0;
+
+            //  Thread slots first, the shared overflow slot is added below
+            for (uint32_t slot = 0; slot < slotCount; ++slot)
+            {
+                bytes += g_ThreadCounters[slot].Bytes[tag].load(std::memory_order_relaxed);
+                allocations += g_ThreadCounters[slot].Allocations[tag].load(std::memory_order_relaxed);
+                frees += g_ThreadCounters[slot].Frees[tag].load(std::memory_order_relaxed);
+            }
+
+            const ThreadMemoryCounters &shared = g_ThreadCounters[MEMORY_MAX_THREAD_SLOTS];
+            bytes += shared.Bytes[tag].load(std::memory_order_relaxed);
+            allocations += shared.Allocations[tag].load(std::memory_order_relaxed);
+            frees += shared.Frees[tag].load(std::memory_order_relaxed);
+
+            TagStatistics &statistics = m_Tags[tag];
+            statistics.FrameAllocations = allocations - statistics.TotalAllocations;
+            statistics.TotalAllocations = allocations;
+            statistics.LiveAllocations = allocations - frees;
+            statistics.CurrentBytes = bytes;
+            statistics.PeakBytes = std::max(statistics.PeakBytes, bytes);
+
+            totalBytes += bytes;
+        }
+
+        m_PeakBytes = std::max(m_PeakBytes, totalBytes);
+        ++m_FrameIndex;
+    }
+
+    MemoryTracker::TagStatistics MemoryTracker::GetTagStatistics(MemoryTag tag) const
+    {
+        return m_Tags[(uint32_t)tag];
+    }
+
+    int64_t MemoryTracker::GetCurrentBytes() const
+    {
+        int64_t bytes = 0;
+
+        for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            bytes += m_Tags[tag].CurrentBytes;
+        }
+
+        return bytes;
+    }
+
+    int64_t MemoryTracker::GetPeakBytes() const
+    {
+        return m_PeakBytes;
+    }
+
+    uint64_t MemoryTracker::GetFrameAllocations() const
+    {
+        uint64_t allocations = 0;
+
+        for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            allocations += m_Tags[tag].FrameAllocations;
+        }
+
+        return allocations;
+    }
+
+    uint32_t MemoryTracker::GetPoolCount() const
+    {
+        return PoolAllocator::getInstance().GetPoolCount();
+    }
+
+    PoolAllocator::Statistics MemoryTracker::GetPoolStatistics(uint32_t pool) const
+    {
+        return PoolAllocator::getInstance().GetStatistics(pool);
+    }
+
+    void MemoryTracker::PrintStatistics()
+    {
+        EndFrame();
+
+        LOG_INFO("Memory: " + String((uint32_t)(GetCurrentBytes() / 1024)) + " KiB in use, peak " +
+                 String((uint32_t)(m_PeakBytes / 1024)) + " KiB\n");
+
+        for (uint32_t tag = 0; tag < MEMORY_TAG_COUNT; ++tag)
+        {
+            const TagStatistics &statistics = m_Tags[tag];
+
+            if (statistics.TotalAllocations == 0)
+            {
+                continue;
+            }
+
+            LOG_INFO(String("  ") + GetTagName((MemoryTag)tag) + ": " +
+                     String((uint32_t)(statistics.CurrentBytes / 1024)) + " KiB in " +
+                     String((uint32_t)statistics.LiveAllocations) + " blocks, peak " +
+                     String((uint32_t)(statistics.PeakBytes / 1024)) + " KiB, " +
+                     String((uint32_t)statistics.TotalAllocations) + " allocations in total\n");
+        }
+
+        for (uint32_t i = 0; i < GetPoolCount(); ++i)
+        {
+            PoolAllocator::Statistics statistics = GetPoolStatistics(i);
+
+            if (statistics.SlabCount == 0)
+            {
+                continue;
+            }
+
+            LOG_INFO("  Pool " + String(statistics.BlockSize) + "B: " + String((uint32_t)statistics.UsedBlocks) +
+                     " / " + String((uint32_t)statistics.CapacityBlocks) + " blocks used, peak " +
+                     String((uint32_t)statistics.PeakUsedBlocks) + "\n");
+        }
+    }
+
+    void MemoryTracker::SetLeakCheckpoint()
+    {
+#if BUILD_ENABLE_LEAK_TRACKING
+        g_LeakCheckpoint = g_AllocationSequence.load(std::memory_order_relaxed);
+#endif
+    }
+
+    void MemoryTracker::ReportLeaks()
+    {
+#if BUILD_ENABLE_LEAK_TRACKING
+        uint32_t leakCount = 0;
+        uint64_t leakBytes = 0;
+
+        //  Printing goes straight to stderr, anything that allocates would deadlock on the list lock
+        LockLiveBlocks();
+
+        for (AllocationHeader *header = g_LiveBlocks; header; header = header->Next)
+        {
+            if (header->Sequence < g_LeakCheckpoint)
+            {
+                continue;
+            }
+
+            ++leakCount;
+            leakBytes += header->Size;
+
+            std::fprintf(stderr, "Leak: %llu bytes [%s] at %p, allocated from %p\n",
+                         (unsigned long long)header->Size, GetTagName(header->Tag), (void *)(header + 1),
+                         header->CallSite);
+#if defined(__linux)
+            std::fflush(stderr);
+            backtrace_symbols_fd(&header->CallSite, 1, 2);
+#endif
+        }
+
+        UnlockLiveBlocks();
+
+        if (leakCount > 0)
+        {
+            LOG_WARNING_F(String(leakCount) + " blocks leaked, " + String((uint32_t)leakBytes) + " bytes in total\n");
+        }
+        else
+        {
+            LOG_INFO_F("No memory leaks detected\n");
+        }
+#endif
+    }
+
+    const char *MemoryTracker::GetTagName(MemoryTag tag)
+    {
+        switch (tag)
+        {
+            case MemoryTag::General:
+                return "General";
+            case MemoryTag::Core:
+                return "Core";
+            case MemoryTag::Render:
+                return "Render";
+            case MemoryTag::Platform:
+                return "Platform";
+            case MemoryTag::Strings:
+                return "Strings";
+            default:
+                return "Unknown";
+        }
+    }
+
+    void MemoryTracker::TrackSystemAllocation(size_t size)
+    {
+#if BUILD_ENABLE_MEMORY_TRACKING
+        const uint32_t tag = (uint32_t)t_CurrentTag;
+        ThreadMemoryCounters *counters = GetThreadCounters();
+
+        AddToCounter<int64_t>(counters, counters->Bytes[tag], (int64_t)size);
+        AddToCounter<uint64_t>(counters, counters->Allocations[tag], 1);
+#else
+        (void)size;
+#endif
+    }
+
+    MemoryTagScope::MemoryTagScope(MemoryTag tag) : m_Previous(t_CurrentTag)
+    {
+        t_CurrentTag = tag;
+    }
+
+    MemoryTagScope::~MemoryTagScope()
+    {
+        t_CurrentTag = m_Previous;
+    }
+}  // namespace aga
+
+void *operator new(size_t size)
+{
+    return aga::TrackedAllocate(size, MEMORY_CALL_SITE(), true);
+}
+
+void *operator new[](size_t size)
+{
+    return aga::TrackedAllocate(size, MEMORY_CALL_SITE(), true);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    return aga::TrackedAllocate(size, MEMORY_CALL_SITE(), false);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    return aga::TrackedAllocate(size, MEMORY_CALL_SITE(), false);
+}
+
+void operator delete(void *memory) noexcept
+{
+    aga::TrackedFree(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    aga::TrackedFree(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept
+{
+    aga::TrackedFree(memory);
+}
+
+void operator delete[](void *memory, size_t) noexcept
+{
+    aga::TrackedFree(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept
+{
+    aga::TrackedFree(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept
+{
+    aga::TrackedFree(memory);
+}
@@ -4,14 +4,40 @@
 
 #include "Logger.h"
 #include "Common.h"
+#include "PoolAllocator.h"
 #include "Typedefs.h"
 
 #include <memory>
+#include <stdint.h>
 
 namespace aga
 {
-    struct MemoryTracker
+    //  Subsystem an allocation is charged to, set for the current thread with MemoryTagScope
+    enum class MemoryTag : uint8_t
     {
+        General,
+        Core,
+        Render,
+        Platform,
+        Strings,
+        Count
+    };
+
+    //  Global operator new/delete (Memory.cpp) count bytes and allocations per tag in per-thread counters, which
+    //  EndFrame folds into the totals once per frame. With BUILD_ENABLE_LEAK_TRACKING every live block is also
+    //  linked into a list together with its call site, so ReportLeaks can list what was never freed.
+    class MemoryTracker
+    {
+    public:
+        struct TagStatistics
+        {
+            int64_t CurrentBytes;
+            int64_t PeakBytes;
+            uint64_t LiveAllocations;
+            uint64_t TotalAllocations;
+            uint64_t FrameAllocations;
+        };
+
     public:
         static MemoryTracker &getInstance()
         {
@@ -20,53 +46,53 @@ namespace aga
         }
 
     private:
-        MemoryTracker()
-        {
-        }
+        MemoryTracker();
 
     public:
         MemoryTracker(MemoryTracker const &) = delete;
         void operator=(MemoryTracker const &) = delete;
 
-        void IncreaseAllocationsCount(uint32_t by)
-        {
-            m_AllocationsCount += by;
-        }
+        //  Aggregates the per-thread counters, peaks and per-frame rates are sampled here
+        void EndFrame();
 
-        void PrintStatistics()
-        {
-            LOG_INFO("Allocations count: " + String(m_AllocationsCount) + "\n");
-        }
+        TagStatistics GetTagStatistics(MemoryTag tag) const;
+        int64_t GetCurrentBytes() const;
+        int64_t GetPeakBytes() const;
 
-    private:
-        uint32_t m_AllocationsCount;
-    };  // namespace aga
-}  // namespace aga
+        //  Allocations of all tags during the frame EndFrame closed last
+        uint64_t GetFrameAllocations() const;
 
-void *operator new(size_t size)
-{
-    //   aga::MemoryTracker::getInstance().IncreaseAllocationsCount(1);
+        uint32_t GetPoolCount() const;
+        PoolAllocator::Statistics GetPoolStatistics(uint32_t pool) const;
 
-    return std::malloc(size);
-}
+        void PrintStatistics();
 
-void *operator new[](size_t size)
-{
-    //  aga::MemoryTracker::getInstance().IncreaseAllocationsCount(1);
+        //  Only blocks allocated after the checkpoint are reported, which hides long-lived startup allocations
+        void SetLeakCheckpoint();
+        void ReportLeaks();
 
-    return std::malloc(size);
-}
+        static const char *GetTagName(MemoryTag tag);
 
-void operator delete(void *memory)
-{
-    //   aga::MemoryTracker::getInstance().IncreaseAllocationsCount(-1);
+        //  Charges memory taken straight from the system to the current tag, e.g. PoolAllocator slabs. Such memory
+        //  is never handed back, so it stays live until the process exits.
+        static void TrackSystemAllocation(size_t size);
 
-    std::free(memory);
-}
+    private:
+        TagStatistics m_Tags[(uint32_t)MemoryTag::Count];
+        int64_t m_PeakBytes;
+        uint64_t m_FrameIndex;
+    };
 
-void operator delete[](void *memory)
-{
-    //   aga::MemoryTracker::getInstance().IncreaseAllocationsCount(-1);
+    class MemoryTagScope
+    {
+    public:
+        explicit MemoryTagScope(MemoryTag tag);
+        ~MemoryTagScope();
+
+        MemoryTagScope(MemoryTagScope const &) = delete;
+        void operator=(MemoryTagScope const &) = delete;
 
-    std::free(memory);
-}
\ No newline at end of file
+    private:
+        MemoryTag m_Previous;
+    };
+}  // namespace aga
@@ -0,0 +1,326 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "PoolAllocator.h"
+#include "Memory.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+namespace aga
+{
+    const uint32_t POOL_BLOCK_SIZES[POOL_SIZE_CLASS_COUNT] = {16, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256};
+
+    //  Maps (size + 15) / 16 to the size class serving it
+    const uint8_t POOL_SIZE_CLASS_LOOKUP[POOL_MAX_BLOCK_SIZE / 16 + 1] = {0, 0, 1, 2, 3, 4, 5, 6, 7,
+                                                                          8, 8, 9, 9, 10, 10, 11, 11};
+
+    const uint32_t POOL_SLAB_SIZE = 64 * 1024;
+
+    //  Bytes moved between a thread cache and the shared pool at once
+    const uint32_t POOL_BATCH_BYTES = 4096;
+
+    const uint64_t POOL_POINTER_MASK = (1ull << 48) - 1;
+
+    //  Set once the cache of this thread is gone, e.g. while static objects are destroyed after main returns
+    static thread_local bool t_ThreadCacheDestroyed = false;
+
+    static inline void *UnpackBatch(uint64_t value)
+    {
+        return reinterpret_cast<void *>(value & POOL_POINTER_MASK);
+    }
+
+    static inline uint64_t PackBatch(void *batch, uint64_t previous)
+    {
+        //  Bumping the tag on every change makes a stale compare-exchange fail even if the same block is back on top
+        return ((previous & ~POOL_POINTER_MASK) + (1ull << 48)) | reinterpret_cast<uint64_t>(batch);
+    }
+
+    PoolAllocator::PoolAllocator()
+    {
+        for (uint32_t i = 0; i < POOL_SIZE_CLASS_COUNT; ++i)
+        {
+            Pool &pool = m_Pools[i];
+
+            pool.BlockSize = POOL_BLOCK_SIZES[i];
+            pool.BatchSize = std::max(8u, POOL_BATCH_BYTES / pool.BlockSize);
+            pool.Batches.store(0, std::memory_order_relaxed);
+            pool.SlabCount.store(0, std::memory_order_relaxed);
+            pool.UsedBlocks.store(0, std::memory_order_relaxed);
+            pool.PeakUsedBlocks.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    void *PoolAllocator::Allocate(size_t size)
+    {
+        //  Through operator new, so the tracker charges it to the current tag like any other heap block
+        if (size > POOL_MAX_BLOCK_SIZE)
+        {
+            return ::operator new(size, std::nothrow);
+        }
+
+        const uint32_t sizeClass = POOL_SIZE_CLASS_LOOKUP[(size + 15) >> 4];
+
+        if (t_ThreadCacheDestroyed)
+        {
+            //  Free can later hand this block to the pool, it is just as large as a pool block and is charged like a
+            //  slab for that reason
+            void *memory = std::malloc(m_Pools[sizeClass].BlockSize);
+
+            if (memory)
+            {
+                MemoryTracker::TrackSystemAllocation(m_Pools[sizeClass].BlockSize);
+            }
+
+            return memory;
+        }
+
+        ThreadFreeList &list = _GetThreadCache().Lists[sizeClass];
+
+        if (!list.Head)
+        {
+            _Refill(sizeClass, list);
+
+            if (!list.Head)
+            {
+                return nullptr;
+            }
+        }
+
+        Block *block = list.Head;
+        list.Head = block->Next;
+        --list.Count;
+        ++list.UsedDelta;
+
+        return block;
+    }
+
+    void PoolAllocator::Free(void *memory, size_t size)
+    {
+        if (!memory)
+        {
+            return;
+        }
+
+        if (size > POOL_MAX_BLOCK_SIZE)
+        {
+            ::operator delete(memory);
+
+            return;
+        }
+
+        const uint32_t sizeClass = POOL_SIZE_CLASS_LOOKUP[(size + 15) >> 4];
+        Block *block = static_cast<Block *>(memory);
+
+        if (t_ThreadCacheDestroyed)
+        {
+            block->Next = nullptr;
+            _PushBatch(m_Pools[sizeClass], block);
+
+            return;
+        }
+
+        ThreadFreeList &list = _GetThreadCache().Lists[sizeClass];
+
+        block->Next = list.Head;
+        list.Head = block;
+        ++list.Count;
+        --list.UsedDelta;
+
+        //  Keep one batch around so a thread alternating Allocate and Free does not bounce batches
+        const uint32_t batchSize = m_Pools[sizeClass].BatchSize;
+
+        if (list.Count >= batchSize * 2)
+        {
+            _Release(sizeClass, list, batchSize);
+        }
+    }
+
+    uint32_t PoolAllocator::GetPoolCount() const
+    {
+        return POOL_SIZE_CLASS_COUNT;
+    }
+
+    PoolAllocator::Statistics PoolAllocator::GetStatistics(uint32_t pool) const
+    {
+        const Pool &source = m_Pools[pool];
+
+        Statistics statistics;
+        statistics.BlockSize = source.BlockSize;
+        statistics.SlabCount = source.SlabCount.load(std::memory_order_relaxed);
+        statistics.CapacityBlocks =
+            (size_t)statistics.SlabCount * (POOL_SLAB_SIZE / source.BlockSize / source.BatchSize) * source.BatchSize;
+        statistics.UsedBlocks = (size_t)std::max<int64_t>(0, source.UsedBlocks.load(std::memory_order_relaxed));
+        statistics.PeakUsedBlocks = (size_t)source.PeakUsedBlocks.load(std::memory_order_relaxed);
+
+        return statistics;
+    }
+
+    PoolAllocator::ThreadCache::~ThreadCache()
+    {
+        //  Hand everything back on thread exit, blocks freed by this thread may be in use elsewhere later
+        PoolAllocator &allocator = PoolAllocator::getInstance();
+
+        for (uint32_t i = 0; i < POOL_SIZE_CLASS_COUNT; ++i)
+        {
+            ThreadFreeList &list = Lists[i];
+            const uint32_t batchSize = allocator.m_Pools[i].BatchSize;
+
+            while (list.Count >= batchSize)
+            {
+                allocator._Release(i, list, batchSize);
+            }
+
+            //  Whatever is left goes back as a short batch, _Refill counts the blocks it receives
+            if (list.Count > 0)
+            {
+                allocator._Release(i, list, list.Count);
+            }
+
+            allocator._FlushUsedDelta(allocator.m_Pools[i], list);
+        }
+
+        t_ThreadCacheDestroyed = true;
+    }
+
+    PoolAllocator::ThreadCache &PoolAllocator::_GetThreadCache()
+    {
+        static thread_local ThreadCache cache = {};
+
+        return cache;
+    }
+
+    void PoolAllocator::_Refill(uint32_t sizeClass, ThreadFreeList &list)
+    {
+        Pool &pool = m_Pools[sizeClass];
+        Block *batch = _PopBatch(pool);
+
+        if (!batch)
+        {
+            batch = _AllocateSlab(pool);
+
+            if (!batch)
+            {
+                return;
+            }
+        }
+
+        list.Head = batch;
+        list.Count = 0;
+
+        for (Block *block = batch; block; block = block->Next)
+        {
+            ++list.Count;
+        }
+
+        _FlushUsedDelta(pool, list);
+    }
+
+    void PoolAllocator::_Release(uint32_t sizeClass, ThreadFreeList &list, uint32_t count)
+    {
+        Pool &pool = m_Pools[sizeClass];
+
+        Block *batch = list.Head;
+        Block *last = batch;
+
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            last = last->Next;
+        }
+
+        list.Head = last->Next;
+        list.Count -= count;
+        last->Next = nullptr;
+
+        _PushBatch(pool, batch);
+        _FlushUsedDelta(pool, list);
+    }
+
+    void PoolAllocator::_FlushUsedDelta(Pool &pool, ThreadFreeList &list)
+    {
+        if (list.UsedDelta == 0)
+        {
+            return;
+        }
+
+        const int64_t used = pool.UsedBlocks.fetch_add(list.UsedDelta, std::memory_order_relaxed) + list.UsedDelta;
+        list.UsedDelta = 0;
+
+        int64_t peak = pool.PeakUsedBlocks.load(std::memory_order_relaxed);
+
+        while (used > peak && !pool.PeakUsedBlocks.compare_exchange_weak(peak, used, std::memory_order_relaxed))
+            ;
+    }
+
+    PoolAllocator::Block *PoolAllocator::_PopBatch(Pool &pool)
+    {
+        uint64_t top = pool.Batches.load(std::memory_order_acquire);
+
+        while (Block *batch = static_cast<Block *>(UnpackBatch(top)))
+        {
+            //  'batch' may already be owned by another thread here, the read stays safe because slabs are never
+            //  freed and the tag makes the exchange fail in that case
+            if (pool.Batches.compare_exchange_weak(top, PackBatch(batch->NextBatch, top), std::memory_order_acquire,
+                                                   std::memory_order_acquire))
+            {
+                return batch;
+            }
+        }
+
+        return nullptr;
+    }
+
+    void PoolAllocator::_PushBatch(Pool &pool, Block *batch)
+    {
+        uint64_t top = pool.Batches.load(std::memory_order_relaxed);
+
+        do
+        {
+            batch->NextBatch = static_cast<Block *>(UnpackBatch(top));
+        } while (!pool.Batches.compare_exchange_weak(top, PackBatch(batch, top), std::memory_order_release,
+                                                     std::memory_order_relaxed));
+    }
+
+    PoolAllocator::Block *PoolAllocator::_AllocateSlab(Pool &pool)
+    {
+        uint8_t *slab = static_cast<uint8_t *>(std::aligned_alloc(64, POOL_SLAB_SIZE));
+
+        if (!slab)
+        {
+            return nullptr;
+        }
+
+        pool.SlabCount.fetch_add(1, std::memory_order_relaxed);
+        MemoryTracker::TrackSystemAllocation(POOL_SLAB_SIZE);
+
+        //  Only whole batches are carved out, the tail of the slab that does not fit one stays unused
+        const uint32_t batchBytes = pool.BlockSize * pool.BatchSize;
+        const uint32_t batchCount = POOL_SLAB_SIZE / batchBytes;
+
+        Block *first = nullptr;
+
+        for (uint32_t i = 0; i < batchCount; ++i)
+        {
+            uint8_t *memory = slab + i * batchBytes;
+
+            for (uint32_t j = 0; j < pool.BatchSize; ++j)
+            {
+                Block *block = reinterpret_cast<Block *>(memory + j * pool.BlockSize);
+                block->Next = (j + 1 < pool.BatchSize) ? reinterpret_cast<Block *>(memory + (j + 1) * pool.BlockSize)
+                                                       : nullptr;
+            }
+
+            Block *batch = reinterpret_cast<Block *>(memory);
+
+            if (i == 0)
+            {
+                first = batch;
+            }
+            else
+            {
+                _PushBatch(pool, batch);
+            }
+        }
+
+        return first;
+    }
+}  // namespace aga
@@ -0,0 +1,172 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <stdint.h>
+
+namespace aga
+{
+    //  Block sizes of the pools, requests are rounded up to the nearest one. Anything bigger goes to operator new.
+    const uint32_t POOL_SIZE_CLASS_COUNT = 12;
+    const uint32_t POOL_MAX_BLOCK_SIZE = 256;
+
+    //  Size-class allocator for small objects. Every thread owns a private free list per size class, so the common
+    //  Allocate/Free path touches no shared state at all. Blocks move between threads and the shared pool in
+    //  batches through a lock-free stack, and pools grow by whole slabs which are never returned to the system.
+    //
+    //  Free needs the size that was passed to Allocate, use PoolAllocated or PoolStlAllocator to get that for free.
+    class PoolAllocator
+    {
+    public:
+        struct Statistics
+        {
+            uint32_t BlockSize;
+            uint32_t SlabCount;
+            size_t CapacityBlocks;
+            //  Updated whenever a thread exchanges a batch with the shared pool, so it may lag by a few batches
+            size_t UsedBlocks;
+            size_t PeakUsedBlocks;
+        };
+
+    public:
+        static PoolAllocator &getInstance()
+        {
+            static PoolAllocator instance;
+            return instance;
+        }
+
+    private:
+        PoolAllocator();
+
+    public:
+        PoolAllocator(PoolAllocator const &) = delete;
+        void operator=(PoolAllocator const &) = delete;
+
+        void *Allocate(size_t size);
+        void Free(void *memory, size_t size);
+
+        uint32_t GetPoolCount() const;
+        Statistics GetStatistics(uint32_t pool) const;
+
+    private:
+        struct Block
+        {
+            Block *Next;
+            //  Only valid on the first block of a batch sitting in the shared stack. Batches are BatchSize blocks
+            //  long except the ones handed back by exiting threads.
+            Block *NextBatch;
+        };
+
+        struct ThreadFreeList
+        {
+            Block *Head;
+            uint32_t Count;
+            int32_t UsedDelta;
+        };
+
+        struct ThreadCache
+        {
+            ThreadFreeList Lists[POOL_SIZE_CLASS_COUNT];
+
+            ~ThreadCache();
+        };
+
+        //  Each pool sits on its own cache line, threads hammering different size classes must not share one
+        struct alignas(64) Pool
+        {
+            uint32_t BlockSize;
+            uint32_t BatchSize;
+
+            //  Top of the batch stack, pointer in the low 48 bits and an ABA tag in the high 16
+            std::atomic<uint64_t> Batches;
+
+            std::atomic<uint32_t> SlabCount;
+            std::atomic<int64_t> UsedBlocks;
+            std::atomic<int64_t> PeakUsedBlocks;
+        };
+
+        static ThreadCache &_GetThreadCache();
+
+        void _Refill(uint32_t sizeClass, ThreadFreeList &list);
+        void _Release(uint32_t sizeClass, ThreadFreeList &list, uint32_t count);
+        void _FlushUsedDelta(Pool &pool, ThreadFreeList &list);
+
+        Block *_PopBatch(Pool &pool);
+        void _PushBatch(Pool &pool, Block *batch);
+        Block *_AllocateSlab(Pool &pool);
+
+    private:
+        Pool m_Pools[POOL_SIZE_CLASS_COUNT];
+    };
+
+    //  Base class routing new/delete of the derived class through the PoolAllocator. Deleting through a pointer to
+    //  a base class requires a virtual destructor, otherwise the wrong size reaches Free.
+    class PoolAllocated
+    {
+    public:
+        static void *operator new(size_t size)
+        {
+            void *memory = PoolAllocator::getInstance().Allocate(size);
+
+            if (!memory)
+            {
+                throw std::bad_alloc();
+            }
+
+            return memory;
+        }
+
+        static void operator delete(void *memory, size_t size)
+        {
+            PoolAllocator::getInstance().Free(memory, size);
+        }
+    };
+
+    template <typename T>
+    class PoolStlAllocator
+    {
+    public:
+        using value_type = T;
+
+        PoolStlAllocator() = default;
+
+        template <typename U>
+        PoolStlAllocator(const PoolStlAllocator<U> &)
+        {
+        }
+
+        T *allocate(size_t count)
+        {
+            void *memory = PoolAllocator::getInstance().Allocate(count * sizeof(T));
+
+            if (!memory)
+            {
+                throw std::bad_alloc();
+            }
+
+            return static_cast<T *>(memory);
+        }
+
+        void deallocate(T *memory, size_t count)
+        {
+            PoolAllocator::getInstance().Free(memory, count * sizeof(T));
+        }
+    };
+
+    template <typename T, typename U>
+    bool operator==(const PoolStlAllocator<T> &, const PoolStlAllocator<U> &)
+    {
+        return true;
+    }
+
+    template <typename T, typename U>
+    bool operator!=(const PoolStlAllocator<T> &, const PoolStlAllocator<U> &)
+    {
+        return false;
+    }
+}  // namespace aga
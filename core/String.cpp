@@ -2,8 +2,11 @@
 
 #include "String.h"
 #include "Macros.h"
+#include "Memory.h"
+#include "PoolAllocator.h"
 
 #include <limits.h>
+#include <utility>
 
 namespace aga
 {
@@ -52,114 +55,108 @@ namespace aga
         return (char *)memcpy(dest, p, src_size);
     }
 
-    String::String()
+    static char *AllocateBuffer(uint32_t capacity)
     {
-        m_Length = 0;
-        m_Data = new char[1];
-        m_Data[m_Length] = '\0';
+        //  Slabs the pool grows by while serving strings are charged to them as well
+        MemoryTagScope scope(MemoryTag::Strings);
+
+        void *memory = PoolAllocator::getInstance().Allocate(capacity + 1);
+
+        if (!memory)
+        {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<char *>(memory);
     }
 
-    String::String(char c)
+    static void FreeBuffer(char *buffer, uint32_t capacity)
+    {
+        PoolAllocator::getInstance().Free(buffer, capacity + 1);
+    }
+
+    String::String(char c) : String()
     {
         m_Length = 1;
-        m_Data = new char[2];
         m_Data[0] = c;
         m_Data[1] = '\0';
     }
 
-    String::String(uint32_t c)
+    String::String(uint32_t c) : String()
     {
-        char dest[100];
-        IToA(c, dest, 100, 10);
+        //  Digits are written backwards from the end of the inline buffer, any 32-bit number fits
+        char *end = m_Inline + STRING_INLINE_CAPACITY;
+        char *digit = end;
 
-        uint32_t i = 0;
-        while (dest[i] != '\0')
+        do
         {
-            i++;
-        }
-
-        m_Length = i;
-        m_Data = new char[m_Length + 1];
+            *--digit = (char)('0' + c % 10);
+            c /= 10;
+        } while (c);
 
-        for (uint32_t j = 0; j < m_Length; ++j)
-        {
-            m_Data[j] = dest[j];
-        }
+        m_Length = (uint32_t)(end - digit);
+        memmove(m_Inline, digit, m_Length);
+        m_Inline[m_Length] = '\0';
+    }
 
-        m_Data[m_Length] = '\0';
+    String::String(const char *c, uint32_t length) : String()
+    {
+        _Assign(c, length);
     }
 
-    String::String(const char *c)
+    String::String(StringView view) : String()
     {
-        if (c)
-        {
-            uint32_t n = 0;
+        _Assign(view.GetData(), view.Length());
+    }
 
-            while (c[n] != '\0')
-            {
-                n++;
-            }
+    String::String(const std::vector<char> &c) : String()
+    {
+        _Assign(c.data(), (uint32_t)c.size());
+    }
 
-            m_Length = n;
-            m_Data = new char[m_Length + 1];
+    String::String(const String &s) : String()
+    {
+        _Assign(s.m_Data, s.m_Length);
+    }
 
-            for (uint32_t j = 0; j < n; j++)
-            {
-                m_Data[j] = c[j];
-            }
-        }
-        else
+    void String::_Release()
+    {
+        if (m_Data != m_Inline)
         {
-            m_Length = 0;
-            m_Data = new char[1];
-        }
+            FreeBuffer(m_Data, m_Capacity);
 
-        m_Data[m_Length] = '\0';
+            m_Data = m_Inline;
+            m_Capacity = STRING_INLINE_CAPACITY;
+        }
     }
 
-    String::String(const std::vector<char> &c)
+    const char *String::_Grow(const char *data, uint32_t length)
     {
-        if (!c.empty())
-        {
-            m_Length = c.size();
-            m_Data = new char[m_Length + 1];
+        //  'data' may point into this string, which Reserve is about to free
+        const bool aliased = data >= m_Data && data <= m_Data + m_Length;
+        const size_t offset = data - m_Data;
 
-            for (uint32_t j = 0; j < m_Length; j++)
-            {
-                m_Data[j] = c[j];
-            }
-        }
-        else
-        {
-            m_Length = 0;
-            m_Data = new char[1];
-        }
+        //  Grow geometrically so repeated appends stay amortized O(1)
+        uint32_t capacity = m_Capacity * 2;
+        Reserve(capacity > m_Length + length ? capacity : m_Length + length);
 
-        m_Data[m_Length] = '\0';
+        return aliased ? m_Data + offset : data;
     }
 
-    String::String(const String &s)
+    void String::Reserve(uint32_t capacity)
     {
-        m_Length = s.Length();
-        m_Data = new char[m_Length + 1];
-
-        for (uint32_t j = 0; j < m_Length; j++)
+        if (capacity <= m_Capacity)
         {
-            m_Data[j] = s[j];
+            return;
         }
 
-        m_Data[m_Length] = '\0';
-    }
+        char *buffer = AllocateBuffer(capacity);
+        memcpy(buffer, m_Data, m_Length + 1);
 
-    String::~String()
-    {
-        SAFE_DELETE_ARRAY(m_Data);
-        m_Length = 0;
-    }
+        _Release();
 
-    uint32_t String::Length() const
-    {
-        return m_Length;
+        m_Data = buffer;
+        m_Capacity = capacity;
     }
 
     int String::IndexOf(char c) const
@@ -229,17 +226,7 @@ namespace aga
 
     std::ostream &operator<<(std::ostream &os, const String &s)
     {
-        if (s.Length() > 0)
-        {
-            for (uint32_t j = 0; j < s.Length(); j++)
-            {
-                os << s[j];
-            }
-        }
-        else
-        {
-            os << "";
-        }
+        os.write(s.m_Data, s.m_Length);
 
         return os;
     }
@@ -255,16 +242,6 @@ namespace aga
         return is;
     }
 
-    char String::operator[](uint32_t j) const
-    {
-        return m_Data[j];
-    }
-
-    char &String::operator[](uint32_t j)
-    {
-        return m_Data[j];
-    }
-
     String &String::operator=(const String &s)
     {
         if (this == &s)
@@ -272,117 +249,108 @@ namespace aga
             return *this;
         }
 
-        SAFE_DELETE_ARRAY(m_Data);
-
-        m_Length = s.Length();
-        m_Data = new char[m_Length + 1];
-
-        for (uint32_t j = 0; j < m_Length; j++)
-        {
-            m_Data[j] = s[j];
-        }
-
-        m_Data[m_Length] = '\0';
+        _Assign(s.m_Data, s.m_Length);
 
         return *this;
     }
 
-    const char *String::GetData() const
-    {
-        return m_Data;
-    }
-
-    String::operator const char *() const
+    String &String::operator=(String &&s) noexcept
     {
-        return m_Data;
-    }
+        if (this == &s)
+        {
+            return *this;
+        }
 
-    String &String::operator+=(const String &s)
-    {
-        uint32_t len = m_Length + s.Length() + 1;
-        char *str = new char[len];
+        _Release();
 
-        for (uint32_t j = 0; j < m_Length; j++)
+        if (s.m_Data == s.m_Inline)
         {
-            str[j] = m_Data[j];
+            memcpy(m_Inline, s.m_Inline, s.m_Length + 1);
         }
-
-        for (uint32_t i = 0; i < s.Length(); i++)
+        else
         {
-            str[m_Length + i] = s[i];
+            m_Data = s.m_Data;
+            m_Capacity = s.m_Capacity;
+
+            s.m_Data = s.m_Inline;
+            s.m_Capacity = STRING_INLINE_CAPACITY;
         }
 
-        SAFE_DELETE_ARRAY(m_Data);
+        m_Length = s.m_Length;
 
-        m_Length = len - 1;
-        m_Data = str;
-        m_Data[m_Length] = '\0';
+        s.m_Length = 0;
+        s.m_Inline[0] = '\0';
 
         return *this;
     }
 
-    String operator+(const String &lhs, const String &rhs)
+    String &String::operator+=(StringView s)
     {
-        return String(lhs) += rhs;
-    }
+        _Append(s.GetData(), s.Length());
 
-    String operator+(const String &lhs, char rhs)
-    {
-        return String(lhs) += String(rhs);
+        return *this;
     }
 
-    String operator+(const String &lhs, const char *rhs)
+    String operator+(const String &lhs, const String &rhs)
     {
-        return String(lhs) += String(rhs);
-    }
+        String result;
+        result.Reserve(lhs.m_Length + rhs.m_Length);
+        result._Append(lhs.m_Data, lhs.m_Length);
+        result._Append(rhs.m_Data, rhs.m_Length);
 
-    String operator+(char lhs, const String &rhs)
-    {
-        return String(lhs) += rhs;
+        return result;
     }
-    String operator+(const char *lhs, const String &rhs)
+
+    String operator+(const String &lhs, char rhs)
     {
-        return String(lhs) += rhs;
+        String result;
+        result.Reserve(lhs.m_Length + 1);
+        result._Append(lhs.m_Data, lhs.m_Length);
+        result._Append(&rhs, 1);
+
+        return result;
     }
 
-    bool operator==(const String &lhs, const String &rhs)
+    String operator+(const String &lhs, const char *rhs)
     {
-        if (lhs.Length() != rhs.Length())
-        {
-            return false;
-        }
+        const uint32_t length = rhs ? (uint32_t)strlen(rhs) : 0;
 
-        uint32_t cap = lhs.Length();
-        uint32_t n = 0;
-        while ((n < cap) && (lhs[n] == rhs[n]))
-        {
-            n++;
-        }
+        String result;
+        result.Reserve(lhs.m_Length + length);
+        result._Append(lhs.m_Data, lhs.m_Length);
+        result._Append(rhs, length);
 
-        return (n == cap);
+        return result;
     }
 
-    bool operator==(const String &lhs, char rhs)
+    String operator+(char lhs, const String &rhs)
     {
-        return (lhs == String(rhs));
-    }
+        String result;
+        result.Reserve(rhs.m_Length + 1);
+        result._Append(&lhs, 1);
+        result._Append(rhs.m_Data, rhs.m_Length);
 
-    bool operator==(const String &lhs, const char *rhs)
-    {
-        return (lhs == String(rhs));
+        return result;
     }
 
-    bool operator==(char lhs, const String &rhs)
+    String operator+(const char *lhs, const String &rhs)
     {
-        return (String(lhs) == rhs);
+        const uint32_t length = lhs ? (uint32_t)strlen(lhs) : 0;
+
+        String result;
+        result.Reserve(length + rhs.m_Length);
+        result._Append(lhs, length);
+        result._Append(rhs.m_Data, rhs.m_Length);
+
+        return result;
     }
 
-    bool operator==(const char *lhs, const String &rhs)
+    static bool _Equals(StringView lhs, StringView rhs)
     {
-        return (String(lhs) == rhs);
+        return lhs.Length() == rhs.Length() && memcmp(lhs.GetData(), rhs.GetData(), lhs.Length()) == 0;
     }
 
-    bool operator>(const String &lhs, const String &rhs)
+    static bool _Greater(StringView lhs, StringView rhs)
     {
         uint32_t cap = (lhs.Length() < rhs.Length()) ? lhs.Length() : rhs.Length();
         uint32_t n = 0;
@@ -411,123 +379,213 @@ namespace aga
         return lhs[n] > rhs[n];
     }
 
+    bool operator==(const String &lhs, const String &rhs)
+    {
+        return _Equals(lhs, rhs);
+    }
+
+    bool operator==(const String &lhs, char rhs)
+    {
+        return _Equals(lhs, StringView(&rhs, 1));
+    }
+
+    bool operator==(const String &lhs, const char *rhs)
+    {
+        return _Equals(lhs, StringView(rhs));
+    }
+
+    bool operator==(char lhs, const String &rhs)
+    {
+        return _Equals(StringView(&lhs, 1), rhs);
+    }
+
+    bool operator==(const char *lhs, const String &rhs)
+    {
+        return _Equals(StringView(lhs), rhs);
+    }
+
+    bool operator==(const String &lhs, StringView rhs)
+    {
+        return _Equals(lhs, rhs);
+    }
+
+    bool operator==(StringView lhs, const String &rhs)
+    {
+        return _Equals(lhs, rhs);
+    }
+
+    bool operator>(const String &lhs, const String &rhs)
+    {
+        return _Greater(lhs, rhs);
+    }
+
     bool operator>(const String &lhs, char rhs)
     {
-        return (lhs > String(rhs));
+        return _Greater(lhs, StringView(&rhs, 1));
     }
 
     bool operator>(const String &lhs, const char *rhs)
     {
-        return (lhs > String(rhs));
+        return _Greater(lhs, StringView(rhs));
     }
 
     bool operator>(char lhs, const String &rhs)
     {
-        return (String(lhs) > rhs);
+        return _Greater(StringView(&lhs, 1), rhs);
     }
 
     bool operator>(const char *lhs, const String &rhs)
     {
-        return (String(lhs) > rhs);
+        return _Greater(StringView(lhs), rhs);
+    }
+
+    bool operator>(const String &lhs, StringView rhs)
+    {
+        return _Greater(lhs, rhs);
+    }
+
+    bool operator>(StringView lhs, const String &rhs)
+    {
+        return _Greater(lhs, rhs);
     }
 
     bool operator!=(const String &lhs, const String &rhs)
     {
-        return !(lhs == rhs);
+        return !_Equals(lhs, rhs);
     }
 
     bool operator!=(const String &lhs, char rhs)
     {
-        return !(lhs == rhs);
+        return !_Equals(lhs, StringView(&rhs, 1));
     }
 
     bool operator!=(const String &lhs, const char *rhs)
     {
-        return !(lhs == rhs);
+        return !_Equals(lhs, StringView(rhs));
     }
 
     bool operator!=(char lhs, const String &rhs)
     {
-        return !(lhs == rhs);
+        return !_Equals(StringView(&lhs, 1), rhs);
     }
 
     bool operator!=(const char *lhs, const String &rhs)
     {
-        return !(lhs == rhs);
+        return !_Equals(StringView(lhs), rhs);
+    }
+
+    bool operator!=(const String &lhs, StringView rhs)
+    {
+        return !_Equals(lhs, rhs);
+    }
+
+    bool operator!=(StringView lhs, const String &rhs)
+    {
+        return !_Equals(lhs, rhs);
     }
 
     bool operator<(const String &lhs, const String &rhs)
     {
-        return !(lhs == rhs) && !(lhs > rhs);
+        return _Greater(rhs, lhs);
     }
 
     bool operator<(const String &lhs, char rhs)
     {
-        return !(lhs == rhs) && !(lhs > rhs);
+        return _Greater(StringView(&rhs, 1), lhs);
     }
 
     bool operator<(const String &lhs, const char *rhs)
     {
-        return !(lhs == rhs) && !(lhs > rhs);
+        return _Greater(StringView(rhs), lhs);
     }
 
     bool operator<(char lhs, const String &rhs)
     {
-        return !(lhs == rhs) && !(lhs > rhs);
+        return _Greater(rhs, StringView(&lhs, 1));
     }
 
     bool operator<(const char *lhs, const String &rhs)
     {
-        return !(lhs == rhs) && !(lhs > rhs);
+        return _Greater(rhs, StringView(lhs));
+    }
+
+    bool operator<(const String &lhs, StringView rhs)
+    {
+        return _Greater(rhs, lhs);
+    }
+
+    bool operator<(StringView lhs, const String &rhs)
+    {
+        return _Greater(rhs, lhs);
     }
 
     bool operator<=(const String &lhs, const String &rhs)
     {
-        return !(lhs > rhs);
+        return !_Greater(lhs, rhs);
     }
 
     bool operator<=(const String &lhs, char rhs)
     {
-        return !(lhs > rhs);
+        return !_Greater(lhs, StringView(&rhs, 1));
     }
 
     bool operator<=(const String &lhs, const char *rhs)
     {
-        return !(lhs > rhs);
+        return !_Greater(lhs, StringView(rhs));
     }
 
     bool operator<=(char lhs, const String &rhs)
     {
-        return !(lhs > rhs);
+        return !_Greater(StringView(&lhs, 1), rhs);
     }
 
     bool operator<=(const char *lhs, const String &rhs)
     {
-        return !(lhs > rhs);
+        return !_Greater(StringView(lhs), rhs);
+    }
+
+    bool operator<=(const String &lhs, StringView rhs)
+    {
+        return !_Greater(lhs, rhs);
+    }
+
+    bool operator<=(StringView lhs, const String &rhs)
+    {
+        return !_Greater(lhs, rhs);
     }
 
     bool operator>=(const String &lhs, const String &rhs)
     {
-        return (lhs == rhs) || (lhs > rhs);
+        return !_Greater(rhs, lhs);
     }
 
     bool operator>=(const String &lhs, char rhs)
     {
-        return (lhs == rhs) || (lhs > rhs);
+        return !_Greater(StringView(&rhs, 1), lhs);
     }
 
     bool operator>=(const String &lhs, const char *rhs)
     {
-        return (lhs == rhs) || (lhs > rhs);
+        return !_Greater(StringView(rhs), lhs);
     }
 
     bool operator>=(char lhs, const String &rhs)
     {
-        return (lhs == rhs) || (lhs > rhs);
+        return !_Greater(rhs, StringView(&lhs, 1));
     }
 
     bool operator>=(const char *lhs, const String &rhs)
     {
-        return (lhs == rhs) || (lhs > rhs);
+        return !_Greater(rhs, StringView(lhs));
+    }
+
+    bool operator>=(const String &lhs, StringView rhs)
+    {
+        return !_Greater(rhs, lhs);
+    }
+
+    bool operator>=(StringView lhs, const String &rhs)
+    {
+        return !_Greater(rhs, lhs);
     }
-}  // namespace aga
\ No newline at end of file
+}  // namespace aga
@@ -3,24 +3,84 @@
 #pragma once
 
 #include "Common.h"
+#include "StringView.h"
+
+#include <utility>
 
 namespace aga
 {
     void StrCopy(char *_dst, const char *_src);
     char *IToA(int number, char *dest, size_t dest_size, int base);
 
+    //  Strings up to this many characters are stored inside the object and never touch the heap
+    const uint32_t STRING_INLINE_CAPACITY = 15;
+
     class String
     {
     public:
-        String();
+        //  Construction, moves and destruction of short strings are inline, chained concatenations create and destroy
+        //  several temporaries and a call for each of them costs more than the copying itself
+        String() : m_Data(m_Inline), m_Length(0), m_Capacity(STRING_INLINE_CAPACITY)
+        {
+            m_Inline[0] = '\0';
+        }
+
         String(char c);
         String(uint32_t c);
-        String(const char *c);
+
+        String(const char *c) : String()
+        {
+            if (c)
+            {
+                _Assign(c, (uint32_t)strlen(c));
+            }
+        }
+
+        String(const char *c, uint32_t length);
+        explicit String(StringView view);
         String(const std::vector<char> &c);
         String(const String &s);
-        ~String();
 
-        uint32_t Length() const;
+        String(String &&s) noexcept : m_Data(m_Inline), m_Length(s.m_Length), m_Capacity(STRING_INLINE_CAPACITY)
+        {
+            if (s.m_Data == s.m_Inline)
+            {
+                //  The whole inline buffer, a fixed size copy is a couple of moves
+                memcpy(m_Inline, s.m_Inline, sizeof(m_Inline));
+            }
+            else
+            {
+                m_Data = s.m_Data;
+                m_Capacity = s.m_Capacity;
+
+                s.m_Data = s.m_Inline;
+                s.m_Capacity = STRING_INLINE_CAPACITY;
+            }
+
+            s.m_Length = 0;
+            s.m_Inline[0] = '\0';
+        }
+
+        ~String()
+        {
+            if (m_Data != m_Inline)
+            {
+                _Release();
+            }
+        }
+
+        uint32_t Length() const
+        {
+            return m_Length;
+        }
+
+        uint32_t Capacity() const
+        {
+            return m_Capacity;
+        }
+
+        //  Makes room for 'capacity' characters, never shrinks
+        void Reserve(uint32_t capacity);
 
         int IndexOf(char c) const;
 
@@ -31,16 +91,52 @@ namespace aga
         friend std::ostream &operator<<(std::ostream &so, const String &s);
         friend std::istream &operator>>(std::istream &so, String &s);
 
-        char operator[](uint32_t j) const;
-        char &operator[](uint32_t j);
+        char operator[](uint32_t j) const
+        {
+            return m_Data[j];
+        }
+
+        char &operator[](uint32_t j)
+        {
+            return m_Data[j];
+        }
 
         String &operator=(const String &s);
+        String &operator=(String &&s) noexcept;
+
+        String &operator+=(const String &s)
+        {
+            _Append(s.m_Data, s.m_Length);
+
+            return *this;
+        }
+
+        String &operator+=(const char *s)
+        {
+            if (s)
+            {
+                _Append(s, (uint32_t)strlen(s));
+            }
+
+            return *this;
+        }
 
-        String &operator+=(const String &s);
+        String &operator+=(StringView s);
 
-        const char *GetData() const;
+        const char *GetData() const
+        {
+            return m_Data;
+        }
 
-        operator const char *() const;
+        operator const char *() const
+        {
+            return m_Data;
+        }
+
+        operator StringView() const
+        {
+            return StringView(m_Data, m_Length);
+        }
 
         friend String operator+(const String &lhs, const String &rhs);
         friend String operator+(const String &lhs, char rhs);
@@ -48,44 +144,114 @@ namespace aga
         friend String operator+(char lhs, const String &rhs);
         friend String operator+(const char *lhs, const String &rhs);
 
+        //  Chained concatenations like a + "b" + c keep appending into the buffer of the first temporary
+        friend String operator+(String &&lhs, const String &rhs)
+        {
+            lhs._Append(rhs.m_Data, rhs.m_Length);
+
+            return std::move(lhs);
+        }
+
+        friend String operator+(String &&lhs, char rhs)
+        {
+            lhs._Append(&rhs, 1);
+
+            return std::move(lhs);
+        }
+
+        friend String operator+(String &&lhs, const char *rhs)
+        {
+            lhs += rhs;
+
+            return std::move(lhs);
+        }
+
         friend bool operator==(const String &lhs, const String &rhs);
         friend bool operator==(const String &lhs, char rhs);
         friend bool operator==(const String &lhs, const char *rhs);
         friend bool operator==(char lhs, const String &rhs);
         friend bool operator==(const char *lhs, const String &rhs);
+        friend bool operator==(const String &lhs, StringView rhs);
+        friend bool operator==(StringView lhs, const String &rhs);
 
         friend bool operator>(const String &lhs, const String &rhs);
         friend bool operator>(const String &lhs, char rhs);
         friend bool operator>(const String &lhs, const char *rhs);
         friend bool operator>(char lhs, const String &rhs);
         friend bool operator>(const char *lhs, const String &rhs);
+        friend bool operator>(const String &lhs, StringView rhs);
+        friend bool operator>(StringView lhs, const String &rhs);
 
         friend bool operator!=(const String &lhs, const String &rhs);
         friend bool operator!=(const String &lhs, char rhs);
         friend bool operator!=(const String &lhs, const char *rhs);
         friend bool operator!=(char lhs, const String &rhs);
         friend bool operator!=(const char *lhs, const String &rhs);
+        friend bool operator!=(const String &lhs, StringView rhs);
+        friend bool operator!=(StringView lhs, const String &rhs);
 
         friend bool operator<(const String &lhs, const String &rhs);
         friend bool operator<(const String &lhs, char rhs);
         friend bool operator<(const String &lhs, const char *rhs);
         friend bool operator<(char lhs, const String &rhs);
         friend bool operator<(const char *lhs, const String &rhs);
+        friend bool operator<(const String &lhs, StringView rhs);
+        friend bool operator<(StringView lhs, const String &rhs);
 
         friend bool operator<=(const String &lhs, const String &rhs);
         friend bool operator<=(const String &lhs, char rhs);
         friend bool operator<=(const String &lhs, const char *rhs);
         friend bool operator<=(char lhs, const String &rhs);
         friend bool operator<=(const char *lhs, const String &rhs);
+        friend bool operator<=(const String &lhs, StringView rhs);
+        friend bool operator<=(StringView lhs, const String &rhs);
 
         friend bool operator>=(const String &lhs, const String &rhs);
         friend bool operator>=(const String &lhs, char rhs);
         friend bool operator>=(const String &lhs, const char *rhs);
         friend bool operator>=(char lhs, const String &rhs);
         friend bool operator>=(const char *lhs, const String &rhs);
+        friend bool operator>=(const String &lhs, StringView rhs);
+        friend bool operator>=(StringView lhs, const String &rhs);
+
+    private:
+        void _Append(const char *data, uint32_t length)
+        {
+            if (m_Length + length > m_Capacity)
+            {
+                data = _Grow(data, length);
+            }
+
+            memmove(m_Data + m_Length, data, length);
+
+            m_Length += length;
+            m_Data[m_Length] = '\0';
+        }
+
+        void _Assign(const char *data, uint32_t length)
+        {
+            m_Length = 0;
+
+            if (length > m_Capacity)
+            {
+                Reserve(length);
+            }
+
+            memcpy(m_Data, data, length);
+
+            m_Length = length;
+            m_Data[m_Length] = '\0';
+        }
+
+        //  Makes room for 'length' more characters, returns 'data' moved along when it pointed into this string
+        const char *_Grow(const char *data, uint32_t length);
+        void _Release();
 
     private:
+        //  Points either to m_Inline or to a heap buffer of m_Capacity + 1 bytes
         char *m_Data;
         uint32_t m_Length;
+        uint32_t m_Capacity;
+        char m_Inline[STRING_INLINE_CAPACITY + 1];
     };
 }  // namespace aga
@@ -0,0 +1,110 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "StringId.h"
+#include "Logger.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace aga
+{
+#if BUILD_ENABLE_STRING_ID_TABLE
+    //  Power of two, the table is open addressed and never grows
+    const uint32_t STRING_ID_TABLE_SIZE = 64 * 1024;
+
+    struct StringIdEntry
+    {
+        std::atomic<uint64_t> Hash;
+        std::atomic<const char *> Text;
+    };
+
+    //  Zero-initialized, so it is usable before any dynamic initializer ran
+    static StringIdEntry g_StringIdTable[STRING_ID_TABLE_SIZE];
+
+    static void RegisterStringId(uint64_t hash, const char *text, size_t length)
+    {
+        for (uint32_t probe = 0; probe < STRING_ID_TABLE_SIZE; ++probe)
+        {
+            StringIdEntry &entry = g_StringIdTable[(hash + probe) & (STRING_ID_TABLE_SIZE - 1)];
+            uint64_t current = entry.Hash.load(std::memory_order_acquire);
+
+            if (current == 0)
+            {
+                //  Claim the slot, the winner publishes the text, everybody else sees the hash right away
+                if (entry.Hash.compare_exchange_strong(current, hash, std::memory_order_acq_rel))
+                {
+                    char *copy = static_cast<char *>(std::malloc(length + 1));
+                    memcpy(copy, text, length);
+                    copy[length] = '\0';
+
+                    entry.Text.store(copy, std::memory_order_release);
+
+                    return;
+                }
+            }
+
+            if (current == hash)
+            {
+                const char *registered = entry.Text.load(std::memory_order_acquire);
+
+                if (registered && (strncmp(registered, text, length) != 0 || registered[length] != '\0'))
+                {
+                    LOG_ERROR_F(String("StringId collision between '") + registered + "' and '" + String(text, length) +
+                                "'\n");
+                }
+
+                return;
+            }
+        }
+
+        static std::atomic<bool> reported(false);
+
+        if (!reported.exchange(true))
+        {
+            LOG_WARNING_F("StringId table is full, reverse lookup is incomplete\n");
+        }
+    }
+#endif
+
+    StringId::StringId(const char *text) : StringId(text ? text : "", text ? strlen(text) : 0)
+    {
+    }
+
+    StringId::StringId(const char *text, size_t length) : m_Hash(HashString(text, length))
+    {
+#if BUILD_ENABLE_STRING_ID_TABLE
+        RegisterStringId(m_Hash, text, length);
+#endif
+    }
+
+    StringId::StringId(const String &text) : StringId(text.GetData(), text.Length())
+    {
+    }
+
+    const char *StringId::GetString() const
+    {
+#if BUILD_ENABLE_STRING_ID_TABLE
+        for (uint32_t probe = 0; probe < STRING_ID_TABLE_SIZE; ++probe)
+        {
+            StringIdEntry &entry = g_StringIdTable[(m_Hash + probe) & (STRING_ID_TABLE_SIZE - 1)];
+            const uint64_t current = entry.Hash.load(std::memory_order_acquire);
+
+            if (current == 0)
+            {
+                break;
+            }
+
+            if (current == m_Hash)
+            {
+                //  The text may still be on its way from the registering thread
+                const char *text = entry.Text.load(std::memory_order_acquire);
+
+                return text ? text : "<pending>";
+            }
+        }
+#endif
+
+        return "<unknown>";
+    }
+}  // namespace aga
@@ -0,0 +1,102 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "BuildConfig.h"
+#include "String.h"
+#include "Typedefs.h"
+
+#include <functional>
+#include <stdint.h>
+
+namespace aga
+{
+    const uint64_t STRING_ID_FNV_OFFSET = 0xcbf29ce484222325ull;
+    const uint64_t STRING_ID_FNV_PRIME = 0x100000001b3ull;
+
+    //  64-bit FNV-1a, usable in constant expressions so literals are hashed by the compiler
+    constexpr uint64_t HashString(const char *text, size_t length)
+    {
+        uint64_t hash = STRING_ID_FNV_OFFSET;
+
+        for (size_t i = 0; i < length; ++i)
+        {
+            hash = (hash ^ (uint8_t)text[i]) * STRING_ID_FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    //  Hashed identifier for names and asset paths. Comparing and hashing is a single integer operation.
+    //
+    //  Ids built from runtime strings are registered in a global table when BUILD_ENABLE_STRING_ID_TABLE is set,
+    //  which gives GetString a way back to the text and reports hash collisions. Ids from the _sid literal are
+    //  hashed at compile time and only resolve once the same text was also registered at runtime.
+    class StringId
+    {
+    public:
+        constexpr StringId() : m_Hash(0)
+        {
+        }
+
+        constexpr explicit StringId(uint64_t hash) : m_Hash(hash)
+        {
+        }
+
+        //  nullptr gives the id of the empty string
+        explicit StringId(const char *text);
+        StringId(const char *text, size_t length);
+        explicit StringId(const String &text);
+
+        constexpr uint64_t GetHash() const
+        {
+            return m_Hash;
+        }
+
+        constexpr bool IsValid() const
+        {
+            return m_Hash != 0;
+        }
+
+        //  Registered text of this id, or a placeholder when it is unknown or the table is compiled out
+        const char *GetString() const;
+
+        constexpr bool operator==(const StringId &other) const
+        {
+            return m_Hash == other.m_Hash;
+        }
+
+        constexpr bool operator!=(const StringId &other) const
+        {
+            return m_Hash != other.m_Hash;
+        }
+
+        constexpr bool operator<(const StringId &other) const
+        {
+            return m_Hash < other.m_Hash;
+        }
+
+    private:
+        uint64_t m_Hash;
+    };
+
+    namespace literals
+    {
+        constexpr StringId operator"" _sid(const char *text, size_t length)
+        {
+            return StringId(HashString(text, length));
+        }
+    }  // namespace literals
+}  // namespace aga
+
+namespace std
+{
+    template <>
+    struct hash<aga::StringId>
+    {
+        size_t operator()(const aga::StringId &id) const
+        {
+            return (size_t)id.GetHash();
+        }
+    };
+}  // namespace std
@@ -0,0 +1,99 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <cstring>
+
+namespace aga
+{
+    //  Non-owning reference to a run of characters, not necessarily null-terminated. Cheap to pass by value;
+    //  the referenced memory has to outlive the view.
+    class StringView
+    {
+    public:
+        constexpr StringView() : m_Data(""), m_Length(0)
+        {
+        }
+
+        constexpr StringView(const char *data) : m_Data(data ? data : ""), m_Length(data ? _Length(data) : 0)
+        {
+        }
+
+        constexpr StringView(const char *data, uint32_t length) : m_Data(data), m_Length(length)
+        {
+        }
+
+        constexpr const char *GetData() const
+        {
+            return m_Data;
+        }
+
+        constexpr uint32_t Length() const
+        {
+            return m_Length;
+        }
+
+        constexpr bool IsEmpty() const
+        {
+            return m_Length == 0;
+        }
+
+        constexpr char operator[](uint32_t index) const
+        {
+            return m_Data[index];
+        }
+
+        constexpr StringView Substring(uint32_t first, uint32_t count = 0xFFFFFFFF) const
+        {
+            return first >= m_Length ? StringView(m_Data + m_Length, 0)
+                                     : StringView(m_Data + first, count < m_Length - first ? count : m_Length - first);
+        }
+
+        int IndexOf(char c) const
+        {
+            const void *found = memchr(m_Data, c, m_Length);
+
+            return found ? (int)(static_cast<const char *>(found) - m_Data) : -1;
+        }
+
+        bool StartsWith(StringView prefix) const
+        {
+            return prefix.m_Length <= m_Length && memcmp(m_Data, prefix.m_Data, prefix.m_Length) == 0;
+        }
+
+        bool EndsWith(StringView suffix) const
+        {
+            return suffix.m_Length <= m_Length &&
+                   memcmp(m_Data + m_Length - suffix.m_Length, suffix.m_Data, suffix.m_Length) == 0;
+        }
+
+    private:
+        static constexpr uint32_t _Length(const char *data)
+        {
+            uint32_t length = 0;
+
+            while (data[length] != '\0')
+            {
+                ++length;
+            }
+
+            return length;
+        }
+
+    private:
+        const char *m_Data;
+        uint32_t m_Length;
+    };
+
+    inline bool operator==(StringView lhs, StringView rhs)
+    {
+        return lhs.Length() == rhs.Length() && memcmp(lhs.GetData(), rhs.GetData(), lhs.Length()) == 0;
+    }
+
+    inline bool operator!=(StringView lhs, StringView rhs)
+    {
+        return !(lhs == rhs);
+    }
+}  // namespace aga
@@ -0,0 +1,328 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "TlsfAllocator.h"
+
+#include <cstring>
+
+namespace aga
+{
+    static inline uint32_t HighestBit(uint64_t value)
+    {
+        return 63 - static_cast<uint32_t>(__builtin_clzll(value));
+    }
+
+    TlsfAllocator::TlsfAllocator()
+        : m_FirstRange(TLSF_INVALID_RANGE), m_FirstLevelBitmap(0), m_Size(0), m_UsedSize(0), m_AllocationCount(0)
+    {
+        memset(m_SecondLevelBitmaps, 0, sizeof(m_SecondLevelBitmaps));
+        memset(m_FreeHeads, 0xFF, sizeof(m_FreeHeads));
+    }
+
+    void TlsfAllocator::Initialize(uint64_t size)
+    {
+        m_Ranges.clear();
+        m_UnusedRanges.clear();
+        m_FirstLevelBitmap = 0;
+        memset(m_SecondLevelBitmaps, 0, sizeof(m_SecondLevelBitmaps));
+        memset(m_FreeHeads, 0xFF, sizeof(m_FreeHeads));
+
+        m_Size = size;
+        m_UsedSize = 0;
+        m_AllocationCount = 0;
+
+        m_FirstRange = _NewRange();
+
+        Range &range = m_Ranges[m_FirstRange];
+        range.Offset = 0;
+        range.Size = size;
+
+        _InsertFree(m_FirstRange);
+    }
+
+    uint32_t TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t &offset, void *userData)
+    {
+        if (size == 0)
+        {
+            return TLSF_INVALID_RANGE;
+        }
+
+        //  Any range of the class found can hold the size plus the worst case padding
+        const uint64_t padded = alignment > 1 ? size + alignment - 1 : size;
+        uint32_t range = _FindFree(padded);
+
+        if (range == TLSF_INVALID_RANGE)
+        {
+            return TLSF_INVALID_RANGE;
+        }
+
+        _RemoveFree(range);
+
+        const uint64_t alignedOffset =
+            alignment > 1 ? (m_Ranges[range].Offset + alignment - 1) & ~(alignment - 1) : m_Ranges[range].Offset;
+        const uint64_t padding = alignedOffset - m_Ranges[range].Offset;
+
+        //  Neighbours of a free range are always used, so the pieces split off need no merging
+        if (padding > 0)
+        {
+            _Split(range, padding);
+            _InsertFree(range);
+
+            range = m_Ranges[range].NextPhysical;
+        }
+
+        if (m_Ranges[range].Size > size)
+        {
+            _Split(range, size);
+            _InsertFree(m_Ranges[range].NextPhysical);
+        }
+
+        Range &allocated = m_Ranges[range];
+        allocated.IsFree = false;
+        allocated.UserData = userData;
+
+        m_UsedSize += allocated.Size;
+        ++m_AllocationCount;
+
+        offset = allocated.Offset;
+
+        return range;
+    }
+
+    void TlsfAllocator::Free(uint32_t range)
+    {
+        if (range >= m_Ranges.size() || m_Ranges[range].IsFree)
+        {
+            return;
+        }
+
+        m_Ranges[range].IsFree = true;
+        m_Ranges[range].UserData = nullptr;
+        m_UsedSize -= m_Ranges[range].Size;
+        --m_AllocationCount;
+
+        const uint32_t next = m_Ranges[range].NextPhysical;
+
+        if (next != TLSF_INVALID_RANGE && m_Ranges[next].IsFree)
+        {
+            _RemoveFree(next);
+            _Merge(range, next);
+        }
+
+        const uint32_t previous = m_Ranges[range].PreviousPhysical;
+
+        if (previous != TLSF_INVALID_RANGE && m_Ranges[previous].IsFree)
+        {
+            _RemoveFree(previous);
+            _Merge(previous, range);
+
+            range = previous;
+        }
+
+        _InsertFree(range);
+    }
+
+    uint64_t TlsfAllocator::GetSize() const
+    {
+        return m_Size;
+    }
+
+    uint64_t TlsfAllocator::GetUsedSize() const
+    {
+        return m_UsedSize;
+    }
+
+    uint32_t TlsfAllocator::GetAllocationCount() const
+    {
+        return m_AllocationCount;
+    }
+
+    bool TlsfAllocator::IsEmpty() const
+    {
+        return m_AllocationCount == 0;
+    }
+
+    void TlsfAllocator::ForEachAllocation(
+        const std::function<void(uint32_t range, uint64_t offset, uint64_t size, void *userData)> &callback) const
+    {
+        for (uint32_t i = m_FirstRange; i != TLSF_INVALID_RANGE; i = m_Ranges[i].NextPhysical)
+        {
+            const Range &range = m_Ranges[i];
+
+            if (!range.IsFree)
+            {
+                callback(i, range.Offset, range.Size, range.UserData);
+            }
+        }
+    }
+
+    void TlsfAllocator::_Map(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel)
+    {
+        if (size < TLSF_SECOND_LEVEL_COUNT)
+        {
+            firstLevel = 0;
+            secondLevel = static_cast<uint32_t>(size);
+
+            return;
+        }
+
+        const uint32_t bit = HighestBit(size);
+
+        firstLevel = bit - TLSF_SECOND_LEVEL_LOG2 + 1;
+        secondLevel = static_cast<uint32_t>(size >> (bit - TLSF_SECOND_LEVEL_LOG2)) - TLSF_SECOND_LEVEL_COUNT;
+    }
+
+    uint32_t TlsfAllocator::_NewRange()
+    {
+        uint32_t index;
+
+        if (!m_UnusedRanges.empty())
+        {
+            index = m_UnusedRanges.back();
+            m_UnusedRanges.pop_back();
+        }
+        else
+        {
+            index = static_cast<uint32_t>(m_Ranges.size());
+            m_Ranges.emplace_back();
+        }
+
+        Range &range = m_Ranges[index];
+        range.Offset = 0;
+        range.Size = 0;
+        range.PreviousPhysical = TLSF_INVALID_RANGE;
+        range.NextPhysical = TLSF_INVALID_RANGE;
+        range.PreviousFree = TLSF_INVALID_RANGE;
+        range.NextFree = TLSF_INVALID_RANGE;
+        range.UserData = nullptr;
+        range.IsFree = true;
+
+        return index;
+    }
+
+    void TlsfAllocator::_InsertFree(uint32_t range)
+    {
+        uint32_t firstLevel, secondLevel;
+        _Map(m_Ranges[range].Size, firstLevel, secondLevel);
+
+        const uint32_t head = m_FreeHeads[firstLevel][secondLevel];
+
+        m_Ranges[range].IsFree = true;
+        m_Ranges[range].PreviousFree = TLSF_INVALID_RANGE;
+        m_Ranges[range].NextFree = head;
+
+        if (head != TLSF_INVALID_RANGE)
+        {
+            m_Ranges[head].PreviousFree = range;
+        }
+
+        m_FreeHeads[firstLevel][secondLevel] = range;
+        m_FirstLevelBitmap |= 1ull << firstLevel;
+        m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+    }
+
+    void TlsfAllocator::_RemoveFree(uint32_t range)
+    {
+        const uint32_t previous = m_Ranges[range].PreviousFree;
+        const uint32_t next = m_Ranges[range].NextFree;
+
+        if (next != TLSF_INVALID_RANGE)
+        {
+            m_Ranges[next].PreviousFree = previous;
+        }
+
+        if (previous != TLSF_INVALID_RANGE)
+        {
+            m_Ranges[previous].NextFree = next;
+
+            return;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        _Map(m_Ranges[range].Size, firstLevel, secondLevel);
+
+        m_FreeHeads[firstLevel][secondLevel] = next;
+
+        if (next == TLSF_INVALID_RANGE)
+        {
+            m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+
+            if (m_SecondLevelBitmaps[firstLevel] == 0)
+            {
+                m_FirstLevelBitmap &= ~(1ull << firstLevel);
+            }
+        }
+    }
+
+    uint32_t TlsfAllocator::_FindFree(uint64_t size)
+    {
+        //  Rounded up to the next subclass, every range listed there is then big enough and no list is searched
+        if (size >= TLSF_SECOND_LEVEL_COUNT)
+        {
+            size += (1ull << (HighestBit(size) - TLSF_SECOND_LEVEL_LOG2)) - 1;
+        }
+
+        uint32_t firstLevel, secondLevel;
+        _Map(size, firstLevel, secondLevel);
+
+        if (firstLevel >= TLSF_FIRST_LEVEL_COUNT)
+        {
+            return TLSF_INVALID_RANGE;
+        }
+
+        uint32_t secondLevelBitmap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+
+        if (secondLevelBitmap == 0)
+        {
+            const uint64_t firstLevelBitmap = m_FirstLevelBitmap & (~0ull << (firstLevel + 1));
+
+            if (firstLevelBitmap == 0)
+            {
+                return TLSF_INVALID_RANGE;
+            }
+
+            firstLevel = static_cast<uint32_t>(__builtin_ctzll(firstLevelBitmap));
+            secondLevelBitmap = m_SecondLevelBitmaps[firstLevel];
+        }
+
+        secondLevel = static_cast<uint32_t>(__builtin_ctz(secondLevelBitmap));
+
+        return m_FreeHeads[firstLevel][secondLevel];
+    }
+
+    void TlsfAllocator::_Split(uint32_t range, uint64_t size)
+    {
+        const uint32_t rest = _NewRange();
+
+        Range &first = m_Ranges[range];
+        Range &second = m_Ranges[rest];
+
+        second.Offset = first.Offset + size;
+        second.Size = first.Size - size;
+        second.PreviousPhysical = range;
+        second.NextPhysical = first.NextPhysical;
+
+        if (first.NextPhysical != TLSF_INVALID_RANGE)
+        {
+            m_Ranges[first.NextPhysical].PreviousPhysical = rest;
+        }
+
+        first.Size = size;
+        first.NextPhysical = rest;
+    }
+
+    void TlsfAllocator::_Merge(uint32_t range, uint32_t next)
+    {
+        Range &first = m_Ranges[range];
+        const Range &second = m_Ranges[next];
+
+        first.Size += second.Size;
+        first.NextPhysical = second.NextPhysical;
+
+        if (second.NextPhysical != TLSF_INVALID_RANGE)
+        {
+            m_Ranges[second.NextPhysical].PreviousPhysical = range;
+        }
+
+        m_UnusedRanges.push_back(next);
+    }
+}  // namespace aga
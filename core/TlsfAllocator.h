@@ -0,0 +1,83 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Typedefs.h"
+
+#include <functional>
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Each power of two size class is split into this many (log2) linear subclasses
+    const uint32_t TLSF_SECOND_LEVEL_LOG2 = 4;
+    const uint32_t TLSF_SECOND_LEVEL_COUNT = 1 << TLSF_SECOND_LEVEL_LOG2;
+    const uint32_t TLSF_FIRST_LEVEL_COUNT = 64 - TLSF_SECOND_LEVEL_LOG2 + 1;
+
+    //  Returned by Allocate when no free range is big enough
+    const uint32_t TLSF_INVALID_RANGE = 0xFFFFFFFF;
+
+    //  Two-level segregated fit allocator over a range of offsets, it never touches the memory it manages. Free
+    //  ranges are kept in lists by size class with a bitmap of non-empty lists, so Allocate and Free take constant
+    //  time, and a freed range is merged with its free neighbours right away. Not thread-safe.
+    class TlsfAllocator
+    {
+    public:
+        TlsfAllocator();
+
+        //  Starts over with a single free range of 'size' bytes
+        void Initialize(uint64_t size);
+
+        //  Returns the range, 'offset' is a multiple of 'alignment' (a power of two). 'userData' is kept with the
+        //  range for ForEachAllocation.
+        uint32_t Allocate(uint64_t size, uint64_t alignment, uint64_t &offset, void *userData = nullptr);
+        void Free(uint32_t range);
+
+        uint64_t GetSize() const;
+        uint64_t GetUsedSize() const;
+        uint32_t GetAllocationCount() const;
+        bool IsEmpty() const;
+
+        //  Visits the allocated ranges in offset order
+        void ForEachAllocation(const std::function<void(uint32_t range, uint64_t offset, uint64_t size,
+                                                        void *userData)> &callback) const;
+
+    private:
+        struct Range
+        {
+            uint64_t Offset;
+            uint64_t Size;
+            uint32_t PreviousPhysical;
+            uint32_t NextPhysical;
+            uint32_t PreviousFree;
+            uint32_t NextFree;
+            void *UserData;
+            bool IsFree;
+        };
+
+        static void _Map(uint64_t size, uint32_t &firstLevel, uint32_t &secondLevel);
+
+        uint32_t _NewRange();
+        void _InsertFree(uint32_t range);
+        void _RemoveFree(uint32_t range);
+        uint32_t _FindFree(uint64_t size);
+
+        //  Splits 'size' bytes off the front of 'range', the rest becomes a new free range
+        void _Split(uint32_t range, uint64_t size);
+        void _Merge(uint32_t range, uint32_t next);
+
+    private:
+        std::vector<Range> m_Ranges;
+        std::vector<uint32_t> m_UnusedRanges;
+        uint32_t m_FirstRange;
+
+        uint64_t m_FirstLevelBitmap;
+        uint32_t m_SecondLevelBitmaps[TLSF_FIRST_LEVEL_COUNT];
+        uint32_t m_FreeHeads[TLSF_FIRST_LEVEL_COUNT][TLSF_SECOND_LEVEL_COUNT];
+
+        uint64_t m_Size;
+        uint64_t m_UsedSize;
+        uint32_t m_AllocationCount;
+    };
+}  // namespace aga
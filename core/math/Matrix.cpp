@@ -1,10 +1,48 @@
 // Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
 
 #include "Matrix.h"
+#include "SIMD.h"
 #include "core/Macros.h"
 
 namespace aga
 {
+#if SIMD_ENABLE_SSE2
+    static_assert(sizeof(real_t) == sizeof(float), "SIMD Matrix kernels require single precision real_t");
+
+    //  2x2 sub-matrix helpers used by GetInverse, each __m128 holds a row-major 2x2 block
+    static inline __m128 Matrix2Multiply(__m128 a, __m128 b)
+    {
+        return _mm_add_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 3, 0))),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                                     _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+    }
+
+    //  adj(a) * b
+    static inline __m128 Matrix2AdjointMultiply(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3)), b),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 2, 1, 1)),
+                                     _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 3, 2))));
+    }
+
+    //  a * adj(b)
+    static inline __m128 Matrix2MultiplyAdjoint(__m128 a, __m128 b)
+    {
+        return _mm_sub_ps(_mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 3, 0, 3))),
+                          _mm_mul_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 0, 1)),
+                                     _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 2, 1, 2))));
+    }
+
+    static inline __m128 TransformRow(__m128 v, __m128 r0, __m128 r1, __m128 r2, __m128 r3)
+    {
+        __m128 result = _mm_mul_ps(SIMD_SPLAT(v, 0), r0);
+        result = SIMDMultiplyAdd(SIMD_SPLAT(v, 1), r1, result);
+        result = SIMDMultiplyAdd(SIMD_SPLAT(v, 2), r2, result);
+
+        return SIMDMultiplyAdd(SIMD_SPLAT(v, 3), r3, result);
+    }
+#endif
+
     Matrix::Matrix()
     {
         SetIdentity();
@@ -71,20 +109,69 @@ namespace aga
 
     Matrix &Matrix::operator*=(const Matrix &m)
     {
-        Matrix temp;
+        Multiply(*this, m, *this);
+
+        return *this;
+    }
+
+    void Matrix::Multiply(const Matrix &a, const Matrix &b, Matrix &out)
+    {
+#if SIMD_ENABLE_AVX2
+        //  Two rows of 'a' per 256-bit register, every row of 'b' is duplicated into both lanes
+        const __m256 b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(b.m_Data[0]));
+        const __m256 b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(b.m_Data[1]));
+        const __m256 b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(b.m_Data[2]));
+        const __m256 b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(b.m_Data[3]));
+
+        const __m256 a01 = _mm256_loadu_ps(a.m_Data[0]);
+        const __m256 a23 = _mm256_loadu_ps(a.m_Data[2]);
+
+        __m256 r01 = _mm256_mul_ps(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        __m256 r23 = _mm256_mul_ps(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        r01 = SIMDMultiplyAdd(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(1, 1, 1, 1)), b1, r01);
+        r23 = SIMDMultiplyAdd(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(1, 1, 1, 1)), b1, r23);
+        r01 = SIMDMultiplyAdd(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(2, 2, 2, 2)), b2, r01);
+        r23 = SIMDMultiplyAdd(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(2, 2, 2, 2)), b2, r23);
+        r01 = SIMDMultiplyAdd(_mm256_shuffle_ps(a01, a01, _MM_SHUFFLE(3, 3, 3, 3)), b3, r01);
+        r23 = SIMDMultiplyAdd(_mm256_shuffle_ps(a23, a23, _MM_SHUFFLE(3, 3, 3, 3)), b3, r23);
+
+        _mm256_storeu_ps(out.m_Data[0], r01);
+        _mm256_storeu_ps(out.m_Data[2], r23);
+#elif SIMD_ENABLE_SSE2
+        const __m128 b0 = _mm_load_ps(b.m_Data[0]);
+        const __m128 b1 = _mm_load_ps(b.m_Data[1]);
+        const __m128 b2 = _mm_load_ps(b.m_Data[2]);
+        const __m128 b3 = _mm_load_ps(b.m_Data[3]);
+
+        const __m128 r0 = TransformRow(_mm_load_ps(a.m_Data[0]), b0, b1, b2, b3);
+        const __m128 r1 = TransformRow(_mm_load_ps(a.m_Data[1]), b0, b1, b2, b3);
+        const __m128 r2 = TransformRow(_mm_load_ps(a.m_Data[2]), b0, b1, b2, b3);
+        const __m128 r3 = TransformRow(_mm_load_ps(a.m_Data[3]), b0, b1, b2, b3);
+
+        _mm_store_ps(out.m_Data[0], r0);
+        _mm_store_ps(out.m_Data[1], r1);
+        _mm_store_ps(out.m_Data[2], r2);
+        _mm_store_ps(out.m_Data[3], r3);
+#else
+        real_t result[4][4];
 
         for (int i = 0; i < 4; ++i)
         {
             for (int j = 0; j < 4; ++j)
             {
-                for (int k = 0; k < 4; ++k)
-                {
-                    temp.m_Data[i][j] += (m_Data[i][k] * m.m_Data[k][j]);
-                }
+                result[i][j] = a.m_Data[i][0] * b.m_Data[0][j] + a.m_Data[i][1] * b.m_Data[1][j] +
+                               a.m_Data[i][2] * b.m_Data[2][j] + a.m_Data[i][3] * b.m_Data[3][j];
             }
         }
 
-        return (*this = temp);
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                out.m_Data[i][j] = result[i][j];
+            }
+        }
+#endif
     }
 
     Matrix &Matrix::operator*=(real_t num)
@@ -113,10 +200,23 @@ namespace aga
         return *this;
     }
 
-    Matrix Matrix::Transpose()
+    Matrix Matrix::Transpose() const
     {
         Matrix ret;
 
+#if SIMD_ENABLE_SSE2
+        __m128 r0 = _mm_load_ps(m_Data[0]);
+        __m128 r1 = _mm_load_ps(m_Data[1]);
+        __m128 r2 = _mm_load_ps(m_Data[2]);
+        __m128 r3 = _mm_load_ps(m_Data[3]);
+
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        _mm_store_ps(ret.m_Data[0], r0);
+        _mm_store_ps(ret.m_Data[1], r1);
+        _mm_store_ps(ret.m_Data[2], r2);
+        _mm_store_ps(ret.m_Data[3], r3);
+#else
         for (int i = 0; i < 4; ++i)
         {
             for (int j = 0; j < 4; ++j)
@@ -124,10 +224,214 @@ namespace aga
                 ret.m_Data[j][i] = m_Data[i][j];
             }
         }
+#endif
 
         return ret;
     }
 
+    bool Matrix::GetInverse(Matrix &out) const
+    {
+#if SIMD_ENABLE_SSE2
+        //  Block-wise inversion: M = | A B |, each of A, B, C, D is a 2x2 matrix packed in one register
+        //                            | C D |
+        const __m128 row0 = _mm_load_ps(m_Data[0]);
+        const __m128 row1 = _mm_load_ps(m_Data[1]);
+        const __m128 row2 = _mm_load_ps(m_Data[2]);
+        const __m128 row3 = _mm_load_ps(m_Data[3]);
+
+        const __m128 A = _mm_movelh_ps(row0, row1);
+        const __m128 B = _mm_movehl_ps(row1, row0);
+        const __m128 C = _mm_movelh_ps(row2, row3);
+        const __m128 D = _mm_movehl_ps(row3, row2);
+
+        //  (|A|, |B|, |C|, |D|)
+        const __m128 detSub =
+            _mm_sub_ps(_mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(2, 0, 2, 0)),
+                                  _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(3, 1, 3, 1))),
+                       _mm_mul_ps(_mm_shuffle_ps(row0, row2, _MM_SHUFFLE(3, 1, 3, 1)),
+                                  _mm_shuffle_ps(row1, row3, _MM_SHUFFLE(2, 0, 2, 0))));
+
+        const __m128 detA = SIMD_SPLAT(detSub, 0);
+        const __m128 detB = SIMD_SPLAT(detSub, 1);
+        const __m128 detC = SIMD_SPLAT(detSub, 2);
+        const __m128 detD = SIMD_SPLAT(detSub, 3);
+
+        const __m128 adjDC = Matrix2AdjointMultiply(D, C);
+        const __m128 adjAB = Matrix2AdjointMultiply(A, B);
+
+        __m128 X = _mm_sub_ps(_mm_mul_ps(detD, A), Matrix2Multiply(B, adjDC));
+        __m128 W = _mm_sub_ps(_mm_mul_ps(detA, D), Matrix2Multiply(C, adjAB));
+        __m128 Y = _mm_sub_ps(_mm_mul_ps(detB, C), Matrix2MultiplyAdjoint(D, adjAB));
+        __m128 Z = _mm_sub_ps(_mm_mul_ps(detC, B), Matrix2MultiplyAdjoint(A, adjDC));
+
+        //  |M| = |A| * |D| + |B| * |C| - tr(adj(A)B * adj(D)C)
+        __m128 trace = _mm_mul_ps(adjAB, _mm_shuffle_ps(adjDC, adjDC, _MM_SHUFFLE(3, 1, 2, 0)));
+        trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(2, 3, 0, 1)));
+        trace = _mm_add_ps(trace, _mm_shuffle_ps(trace, trace, _MM_SHUFFLE(1, 0, 3, 2)));
+
+        const __m128 detM = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC)), trace);
+
+        if (_mm_cvtss_f32(detM) == 0.0f)
+        {
+            return false;
+        }
+
+        const __m128 reciprocalDet = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+
+        X = _mm_mul_ps(X, reciprocalDet);
+        Y = _mm_mul_ps(Y, reciprocalDet);
+        Z = _mm_mul_ps(Z, reciprocalDet);
+        W = _mm_mul_ps(W, reciprocalDet);
+
+        _mm_store_ps(out.m_Data[0], _mm_shuffle_ps(X, Y, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(out.m_Data[1], _mm_shuffle_ps(X, Y, _MM_SHUFFLE(0, 2, 0, 2)));
+        _mm_store_ps(out.m_Data[2], _mm_shuffle_ps(Z, W, _MM_SHUFFLE(1, 3, 1, 3)));
+        _mm_store_ps(out.m_Data[3], _mm_shuffle_ps(Z, W, _MM_SHUFFLE(0, 2, 0, 2)));
+
+        return true;
+#else
+        const real_t(&m)[4][4] = m_Data;
+
+        //  2x2 sub-determinants of the two upper and two lower rows
+        const real_t s0 = m[0][0] * m[1][1] - m[1][0] * m[0][1];
+        const real_t s1 = m[0][0] * m[1][2] - m[1][0] * m[0][2];
+        const real_t s2 = m[0][0] * m[1][3] - m[1][0] * m[0][3];
+        const real_t s3 = m[0][1] * m[1][2] - m[1][1] * m[0][2];
+        const real_t s4 = m[0][1] * m[1][3] - m[1][1] * m[0][3];
+        const real_t s5 = m[0][2] * m[1][3] - m[1][2] * m[0][3];
+
+        const real_t c5 = m[2][2] * m[3][3] - m[3][2] * m[2][3];
+        const real_t c4 = m[2][1] * m[3][3] - m[3][1] * m[2][3];
+        const real_t c3 = m[2][1] * m[3][2] - m[3][1] * m[2][2];
+        const real_t c2 = m[2][0] * m[3][3] - m[3][0] * m[2][3];
+        const real_t c1 = m[2][0] * m[3][2] - m[3][0] * m[2][2];
+        const real_t c0 = m[2][0] * m[3][1] - m[3][0] * m[2][1];
+
+        const real_t det = s0 * c5 - s1 * c4 + s2 * c3 + s3 * c2 - s4 * c1 + s5 * c0;
+
+        if (det == 0)
+        {
+            return false;
+        }
+
+        const real_t invDet = Reciprocal(det);
+        real_t result[4][4];
+
+        result[0][0] = (m[1][1] * c5 - m[1][2] * c4 + m[1][3] * c3) * invDet;
+        result[0][1] = (-m[0][1] * c5 + m[0][2] * c4 - m[0][3] * c3) * invDet;
+        result[0][2] = (m[3][1] * s5 - m[3][2] * s4 + m[3][3] * s3) * invDet;
+        result[0][3] = (-m[2][1] * s5 + m[2][2] * s4 - m[2][3] * s3) * invDet;
+
+        result[1][0] = (-m[1][0] * c5 + m[1][2] * c2 - m[1][3] * c1) * invDet;
+        result[1][1] = (m[0][0] * c5 - m[0][2] * c2 + m[0][3] * c1) * invDet;
+        result[1][2] = (-m[3][0] * s5 + m[3][2] * s2 - m[3][3] * s1) * invDet;
+        result[1][3] = (m[2][0] * s5 - m[2][2] * s2 + m[2][3] * s1) * invDet;
+
+        result[2][0] = (m[1][0] * c4 - m[1][1] * c2 + m[1][3] * c0) * invDet;
+        result[2][1] = (-m[0][0] * c4 + m[0][1] * c2 - m[0][3] * c0) * invDet;
+        result[2][2] = (m[3][0] * s4 - m[3][1] * s2 + m[3][3] * s0) * invDet;
+        result[2][3] = (-m[2][0] * s4 + m[2][1] * s2 - m[2][3] * s0) * invDet;
+
+        result[3][0] = (-m[1][0] * c3 + m[1][1] * c1 - m[1][2] * c0) * invDet;
+        result[3][1] = (m[0][0] * c3 - m[0][1] * c1 + m[0][2] * c0) * invDet;
+        result[3][2] = (-m[3][0] * s3 + m[3][1] * s1 - m[3][2] * s0) * invDet;
+        result[3][3] = (m[2][0] * s3 - m[2][1] * s1 + m[2][2] * s0) * invDet;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                out.m_Data[i][j] = result[i][j];
+            }
+        }
+
+        return true;
+#endif
+    }
+
+    bool Matrix::MakeInverse()
+    {
+        return GetInverse(*this);
+    }
+
+    Vector3 Matrix::TransformPoint(const Vector3 &point) const
+    {
+        Vector3 result;
+        TransformPoints(&point, &result, 1);
+
+        return result;
+    }
+
+    Vector3 Matrix::TransformVector(const Vector3 &vector) const
+    {
+        Vector3 result;
+        TransformVectors(&vector, &result, 1);
+
+        return result;
+    }
+
+    void Matrix::TransformPoints(const Vector3 *in, Vector3 *out, uint32_t count) const
+    {
+#if SIMD_ENABLE_SSE2
+        const __m128 r0 = _mm_load_ps(m_Data[0]);
+        const __m128 r1 = _mm_load_ps(m_Data[1]);
+        const __m128 r2 = _mm_load_ps(m_Data[2]);
+        const __m128 r3 = _mm_load_ps(m_Data[3]);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            __m128 result = SIMDMultiplyAdd(_mm_set1_ps(in[i].X), r0, r3);
+            result = SIMDMultiplyAdd(_mm_set1_ps(in[i].Y), r1, result);
+            result = SIMDMultiplyAdd(_mm_set1_ps(in[i].Z), r2, result);
+
+            //  Vector3 is 12 bytes wide, so store X/Y and Z separately to not clobber the next element
+            _mm_storel_pi(reinterpret_cast<__m64 *>(&out[i].X), result);
+            _mm_store_ss(&out[i].Z, _mm_movehl_ps(result, result));
+        }
+#else
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const real_t x = in[i].X;
+            const real_t y = in[i].Y;
+            const real_t z = in[i].Z;
+
+            out[i].X = x * m_Data[0][0] + y * m_Data[1][0] + z * m_Data[2][0] + m_Data[3][0];
+            out[i].Y = x * m_Data[0][1] + y * m_Data[1][1] + z * m_Data[2][1] + m_Data[3][1];
+            out[i].Z = x * m_Data[0][2] + y * m_Data[1][2] + z * m_Data[2][2] + m_Data[3][2];
+        }
+#endif
+    }
+
+    void Matrix::TransformVectors(const Vector3 *in, Vector3 *out, uint32_t count) const
+    {
+#if SIMD_ENABLE_SSE2
+        const __m128 r0 = _mm_load_ps(m_Data[0]);
+        const __m128 r1 = _mm_load_ps(m_Data[1]);
+        const __m128 r2 = _mm_load_ps(m_Data[2]);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            __m128 result = _mm_mul_ps(_mm_set1_ps(in[i].X), r0);
+            result = SIMDMultiplyAdd(_mm_set1_ps(in[i].Y), r1, result);
+            result = SIMDMultiplyAdd(_mm_set1_ps(in[i].Z), r2, result);
+
+            _mm_storel_pi(reinterpret_cast<__m64 *>(&out[i].X), result);
+            _mm_store_ss(&out[i].Z, _mm_movehl_ps(result, result));
+        }
+#else
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const real_t x = in[i].X;
+            const real_t y = in[i].Y;
+            const real_t z = in[i].Z;
+
+            out[i].X = x * m_Data[0][0] + y * m_Data[1][0] + z * m_Data[2][0];
+            out[i].Y = x * m_Data[0][1] + y * m_Data[1][1] + z * m_Data[2][1];
+            out[i].Z = x * m_Data[0][2] + y * m_Data[1][2] + z * m_Data[2][2];
+        }
+#endif
+    }
+
     Matrix &Matrix::SetIdentity()
     {
         for (int i = 0; i < 4; ++i)
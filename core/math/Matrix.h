@@ -25,13 +25,36 @@ namespace aga
             return m_Data[index];
         }
 
+        const real_t *operator[](int index) const
+        {
+            return m_Data[index];
+        }
+
+        const real_t *GetData() const
+        {
+            return &m_Data[0][0];
+        }
+
         Matrix &operator+=(const Matrix &);
         Matrix &operator-=(const Matrix &);
         Matrix &operator*=(const Matrix &);
         Matrix &operator*=(real_t);
         Matrix &operator/=(real_t);
 
-        Matrix Transpose();
+        Matrix Transpose() const;
+
+        //  Returns false (and leaves 'out' untouched) when the matrix is singular
+        bool GetInverse(Matrix &out) const;
+        bool MakeInverse();
+
+        Vector3 TransformPoint(const Vector3 &point) const;
+        Vector3 TransformVector(const Vector3 &vector) const;
+
+        //  Batch versions, 'in' and 'out' may point to the same array
+        void TransformPoints(const Vector3 *in, Vector3 *out, uint32_t count) const;
+        void TransformVectors(const Vector3 *in, Vector3 *out, uint32_t count) const;
+
+        static void Multiply(const Matrix &a, const Matrix &b, Matrix &out);
 
         Matrix &SetIdentity();
 
@@ -42,7 +65,8 @@ namespace aga
                                                real_t zFar);
 
     private:
-        real_t m_Data[4][4];
+        //  Row-major, vectors are treated as rows (v' = v * M), translation lives in the last row
+        alignas(16) real_t m_Data[4][4];
     };
 
     Matrix operator+(const Matrix &, const Matrix &);
@@ -0,0 +1,60 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "core/BuildConfig.h"
+
+#if BUILD_ENABLE_SIMD && defined(__AVX2__)
+#define SIMD_ENABLE_AVX2 1
+#else
+#define SIMD_ENABLE_AVX2 0
+#endif
+
+#if BUILD_ENABLE_SIMD && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SIMD_ENABLE_SSE2 1
+#else
+#define SIMD_ENABLE_SSE2 0
+#endif
+
+#if defined(__FMA__)
+#define SIMD_ENABLE_FMA SIMD_ENABLE_AVX2
+#else
+#define SIMD_ENABLE_FMA 0
+#endif
+
+#if SIMD_ENABLE_AVX2
+#include <immintrin.h>
+#elif SIMD_ENABLE_SSE2
+#include <emmintrin.h>
+#endif
+
+#if SIMD_ENABLE_SSE2
+//  Broadcasts lane 'i' of 'v' into all four lanes
+#define SIMD_SPLAT(v, i) _mm_shuffle_ps((v), (v), _MM_SHUFFLE((i), (i), (i), (i)))
+#endif
+
+namespace aga
+{
+#if SIMD_ENABLE_SSE2
+    //  a * b + c
+    inline __m128 SIMDMultiplyAdd(__m128 a, __m128 b, __m128 c)
+    {
+#if SIMD_ENABLE_FMA
+        return _mm_fmadd_ps(a, b, c);
+#else
+        return _mm_add_ps(_mm_mul_ps(a, b), c);
+#endif
+    }
+#endif
+
+#if SIMD_ENABLE_AVX2
+    inline __m256 SIMDMultiplyAdd(__m256 a, __m256 b, __m256 c)
+    {
+#if SIMD_ENABLE_FMA
+        return _mm256_fmadd_ps(a, b, c);
+#else
+        return _mm256_add_ps(_mm256_mul_ps(a, b), c);
+#endif
+    }
+#endif
+}  // namespace aga
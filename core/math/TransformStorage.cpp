@@ -0,0 +1,264 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "TransformStorage.h"
+#include "SIMD.h"
+#include "core/JobSystem.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace aga
+{
+    //  Streams are padded to a multiple of this many elements, which keeps every stream 32-byte aligned
+    const uint32_t TRANSFORM_STREAM_ALIGNMENT = 8;
+
+    //  Below this many entities per job the scheduling overhead outweighs the work
+    const uint32_t TRANSFORM_MIN_ENTITIES_PER_JOB = 2048;
+
+    const uint32_t MATRIX_ROW_SIZE = 4 * sizeof(real_t);
+
+#if SIMD_ENABLE_SSE2
+    static inline void StoreRow(uint8_t *destination, __m128 row, bool streaming)
+    {
+        if (streaming)
+        {
+            //  Bypasses the cache, which is what we want for write-combined mapped memory
+            _mm_stream_ps(reinterpret_cast<float *>(destination), row);
+        }
+        else
+        {
+            _mm_storeu_ps(reinterpret_cast<float *>(destination), row);
+        }
+    }
+#endif
+
+    TransformStorage::TransformStorage() : m_Memory(nullptr), m_Count(0), m_Capacity(0)
+    {
+        for (uint32_t i = 0; i < StreamCount; ++i)
+        {
+            m_Streams[i] = nullptr;
+        }
+    }
+
+    TransformStorage::~TransformStorage()
+    {
+        std::free(m_Memory);
+        m_Memory = nullptr;
+    }
+
+    uint32_t TransformStorage::Add(const Vector3 &position, const Vector3 &scale)
+    {
+        if (m_Count == m_Capacity)
+        {
+            Reserve(std::max(m_Capacity * 2, 64u));
+        }
+
+        uint32_t index = m_Count++;
+
+        SetPosition(index, position);
+        SetScale(index, scale);
+        SetRotation(index, 0.0f, 0.0f, 0.0f, 1.0f);
+
+        return index;
+    }
+
+    void TransformStorage::Reserve(uint32_t capacity)
+    {
+        capacity = (capacity + TRANSFORM_STREAM_ALIGNMENT - 1) & ~(TRANSFORM_STREAM_ALIGNMENT - 1);
+
+        if (capacity <= m_Capacity)
+        {
+            return;
+        }
+
+        real_t *memory =
+            static_cast<real_t *>(std::aligned_alloc(32, sizeof(real_t) * capacity * StreamCount));
+
+        for (uint32_t i = 0; i < StreamCount; ++i)
+        {
+            real_t *stream = memory + i * capacity;
+
+            if (m_Count > 0)
+            {
+                std::memcpy(stream, m_Streams[i], sizeof(real_t) * m_Count);
+            }
+
+            m_Streams[i] = stream;
+        }
+
+        std::free(m_Memory);
+
+        m_Memory = memory;
+        m_Capacity = capacity;
+    }
+
+    void TransformStorage::Clear()
+    {
+        m_Count = 0;
+    }
+
+    uint32_t TransformStorage::GetCount() const
+    {
+        return m_Count;
+    }
+
+    void TransformStorage::SetPosition(uint32_t index, const Vector3 &position)
+    {
+        m_Streams[PositionX][index] = position.X;
+        m_Streams[PositionY][index] = position.Y;
+        m_Streams[PositionZ][index] = position.Z;
+    }
+
+    Vector3 TransformStorage::GetPosition(uint32_t index) const
+    {
+        return Vector3(m_Streams[PositionX][index], m_Streams[PositionY][index], m_Streams[PositionZ][index]);
+    }
+
+    void TransformStorage::SetScale(uint32_t index, const Vector3 &scale)
+    {
+        m_Streams[ScaleX][index] = scale.X;
+        m_Streams[ScaleY][index] = scale.Y;
+        m_Streams[ScaleZ][index] = scale.Z;
+    }
+
+    Vector3 TransformStorage::GetScale(uint32_t index) const
+    {
+        return Vector3(m_Streams[ScaleX][index], m_Streams[ScaleY][index], m_Streams[ScaleZ][index]);
+    }
+
+    void TransformStorage::SetRotation(uint32_t index, real_t x, real_t y, real_t z, real_t w)
+    {
+        m_Streams[RotationX][index] = x;
+        m_Streams[RotationY][index] = y;
+        m_Streams[RotationZ][index] = z;
+        m_Streams[RotationW][index] = w;
+    }
+
+    void TransformStorage::SetRotationAxisRadians(uint32_t index, real_t angle, const Vector3 &axis)
+    {
+        const real_t s = ::sin(angle * 0.5f);
+
+        SetRotation(index, axis.X * s, axis.Y * s, axis.Z * s, ::cos(angle * 0.5f));
+    }
+
+    void TransformStorage::_ComposeScalar(uint8_t *destination, uint32_t stride, uint32_t index) const
+    {
+        const real_t x = m_Streams[RotationX][index];
+        const real_t y = m_Streams[RotationY][index];
+        const real_t z = m_Streams[RotationZ][index];
+        const real_t w = m_Streams[RotationW][index];
+
+        const real_t sx = m_Streams[ScaleX][index];
+        const real_t sy = m_Streams[ScaleY][index];
+        const real_t sz = m_Streams[ScaleZ][index];
+
+        const real_t matrix[4][4] = {
+            {(1.0f - 2.0f * (y * y + z * z)) * sx, 2.0f * (x * y + w * z) * sx, 2.0f * (x * z - w * y) * sx, 0.0f},
+            {2.0f * (x * y - w * z) * sy, (1.0f - 2.0f * (x * x + z * z)) * sy, 2.0f * (y * z + w * x) * sy, 0.0f},
+            {2.0f * (x * z + w * y) * sz, 2.0f * (y * z - w * x) * sz, (1.0f - 2.0f * (x * x + y * y)) * sz, 0.0f},
+            {m_Streams[PositionX][index], m_Streams[PositionY][index], m_Streams[PositionZ][index], 1.0f}};
+
+        std::memcpy(destination + (size_t)index * stride, matrix, sizeof(matrix));
+    }
+
+    void TransformStorage::ComposeWorldMatrices(void *destination, uint32_t stride, uint32_t first,
+                                                uint32_t count) const
+    {
+        uint8_t *output = static_cast<uint8_t *>(destination);
+        const uint32_t last = std::min(first + count, m_Count);
+        uint32_t index = first;
+
+#if SIMD_ENABLE_SSE2
+        const bool streaming = ((reinterpret_cast<uintptr_t>(output) | stride) & 15) == 0;
+
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 two = _mm_set1_ps(2.0f);
+        const __m128 zero = _mm_setzero_ps();
+
+        for (; index + 4 <= last; index += 4)
+        {
+            const __m128 x = _mm_loadu_ps(m_Streams[RotationX] + index);
+            const __m128 y = _mm_loadu_ps(m_Streams[RotationY] + index);
+            const __m128 z = _mm_loadu_ps(m_Streams[RotationZ] + index);
+            const __m128 w = _mm_loadu_ps(m_Streams[RotationW] + index);
+
+            const __m128 sx = _mm_loadu_ps(m_Streams[ScaleX] + index);
+            const __m128 sy = _mm_loadu_ps(m_Streams[ScaleY] + index);
+            const __m128 sz = _mm_loadu_ps(m_Streams[ScaleZ] + index);
+
+            const __m128 xx = _mm_mul_ps(x, x);
+            const __m128 yy = _mm_mul_ps(y, y);
+            const __m128 zz = _mm_mul_ps(z, z);
+            const __m128 xy = _mm_mul_ps(x, y);
+            const __m128 xz = _mm_mul_ps(x, z);
+            const __m128 yz = _mm_mul_ps(y, z);
+            const __m128 wx = _mm_mul_ps(w, x);
+            const __m128 wy = _mm_mul_ps(w, y);
+            const __m128 wz = _mm_mul_ps(w, z);
+
+            //  One register per matrix element, each lane belongs to a different entity
+            __m128 row0 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(yy, zz))), sx);
+            __m128 row1 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xy, wz)), sx);
+            __m128 row2 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xz, wy)), sx);
+            __m128 row3 = zero;
+            _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+            __m128 col0 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(xy, wz)), sy);
+            __m128 col1 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, zz))), sy);
+            __m128 col2 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(yz, wx)), sy);
+            __m128 col3 = zero;
+            _MM_TRANSPOSE4_PS(col0, col1, col2, col3);
+
+            __m128 axis0 = _mm_mul_ps(_mm_mul_ps(two, _mm_add_ps(xz, wy)), sz);
+            __m128 axis1 = _mm_mul_ps(_mm_mul_ps(two, _mm_sub_ps(yz, wx)), sz);
+            __m128 axis2 = _mm_mul_ps(_mm_sub_ps(one, _mm_mul_ps(two, _mm_add_ps(xx, yy))), sz);
+            __m128 axis3 = zero;
+            _MM_TRANSPOSE4_PS(axis0, axis1, axis2, axis3);
+
+            __m128 position0 = _mm_loadu_ps(m_Streams[PositionX] + index);
+            __m128 position1 = _mm_loadu_ps(m_Streams[PositionY] + index);
+            __m128 position2 = _mm_loadu_ps(m_Streams[PositionZ] + index);
+            __m128 position3 = one;
+            _MM_TRANSPOSE4_PS(position0, position1, position2, position3);
+
+            const __m128 rows[4][4] = {{row0, col0, axis0, position0},
+                                       {row1, col1, axis1, position1},
+                                       {row2, col2, axis2, position2},
+                                       {row3, col3, axis3, position3}};
+
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                uint8_t *matrix = output + (size_t)(index + i) * stride;
+
+                StoreRow(matrix, rows[i][0], streaming);
+                StoreRow(matrix + MATRIX_ROW_SIZE, rows[i][1], streaming);
+                StoreRow(matrix + MATRIX_ROW_SIZE * 2, rows[i][2], streaming);
+                StoreRow(matrix + MATRIX_ROW_SIZE * 3, rows[i][3], streaming);
+            }
+        }
+
+        if (streaming)
+        {
+            _mm_sfence();
+        }
+#endif
+
+        for (; index < last; ++index)
+        {
+            _ComposeScalar(output, stride, index);
+        }
+    }
+
+    void TransformStorage::ComposeWorldMatrices(void *destination, uint32_t stride) const
+    {
+        //  Batches go by groups of four entities so every job stays on the SIMD path
+        const uint32_t groupCount = (m_Count + 3) / 4;
+
+        JobSystem::getInstance().ParallelFor(
+            groupCount, TRANSFORM_MIN_ENTITIES_PER_JOB / 4,
+            [this, destination, stride](uint32_t first, uint32_t count) {
+                ComposeWorldMatrices(destination, stride, first * 4, count * 4);
+            });
+    }
+}  // namespace aga
@@ -0,0 +1,71 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "Vector3.h"
+#include "core/Typedefs.h"
+
+#include <stdint.h>
+
+namespace aga
+{
+    //  Structure-of-arrays storage for entity transforms. Every component lives in its own 32-byte aligned stream
+    //  so ComposeWorldMatrices can build the model matrices of several entities per SIMD instruction.
+    class TransformStorage
+    {
+    public:
+        TransformStorage();
+        ~TransformStorage();
+
+        TransformStorage(const TransformStorage &) = delete;
+        void operator=(const TransformStorage &) = delete;
+
+        uint32_t Add(const Vector3 &position = Vector3(), const Vector3 &scale = Vector3(1.0f, 1.0f, 1.0f));
+        void Reserve(uint32_t capacity);
+        void Clear();
+
+        uint32_t GetCount() const;
+
+        void SetPosition(uint32_t index, const Vector3 &position);
+        Vector3 GetPosition(uint32_t index) const;
+
+        void SetScale(uint32_t index, const Vector3 &scale);
+        Vector3 GetScale(uint32_t index) const;
+
+        //  Rotation is kept as a unit quaternion (x, y, z, w)
+        void SetRotation(uint32_t index, real_t x, real_t y, real_t z, real_t w);
+        void SetRotationAxisRadians(uint32_t index, real_t angle, const Vector3 &axis);
+
+        //  Writes 'count' row-major 4x4 world matrices (scale * rotation * translation, same layout as Matrix)
+        //  starting at entity 'first'. Matrices are 'stride' bytes apart in 'destination', which may be mapped
+        //  device memory. Disjoint ranges can be composed from different threads.
+        void ComposeWorldMatrices(void *destination, uint32_t stride, uint32_t first, uint32_t count) const;
+
+        //  Composes all entities, large batches are spread over the JobSystem workers
+        void ComposeWorldMatrices(void *destination, uint32_t stride) const;
+
+    private:
+        enum Stream
+        {
+            PositionX,
+            PositionY,
+            PositionZ,
+            RotationX,
+            RotationY,
+            RotationZ,
+            RotationW,
+            ScaleX,
+            ScaleY,
+            ScaleZ,
+            StreamCount
+        };
+
+        void _ComposeScalar(uint8_t *destination, uint32_t stride, uint32_t index) const;
+
+    private:
+        real_t *m_Streams[StreamCount];
+        real_t *m_Memory;
+        uint32_t m_Count;
+        uint32_t m_Capacity;
+    };
+}  // namespace aga
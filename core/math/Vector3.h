@@ -49,15 +49,6 @@ namespace aga
             return Vector3(-X, -Y, -Z);
         }
 
-        Vector3 &operator=(const Vector3 &other)
-        {
-            X = other.X;
-            Y = other.Y;
-            Z = other.Z;
-
-            return *this;
-        }
-
         Vector3 operator+(const Vector3 &other) const
         {
             return Vector3(X + other.X, Y + other.Y, Z + other.Z);
@@ -2,13 +2,19 @@
 
 #include "MainLoop.h"
 #include "core/Logger.h"
+#include "core/Memory.h"
 #include "core/Typedefs.h"
 
+#include <cstdlib>
+#include <cstring>
+
 int main(int argc, char *argv[])
 {
     aga::String title = "..:: agaEngine ::..";
     LOG_INFO(title + " [v " + ENGINE_VERSION_STRING + "]\n");
 
+    aga::MemoryTracker::getInstance().SetLeakCheckpoint();
+
     {
         aga::MainLoop mainLoop;
 
@@ -17,23 +23,56 @@ int main(int argc, char *argv[])
             exit(-1);
         }
 
-        if (!mainLoop.InitializeWindow())
+        //  --headless <frames> renders offscreen without a window, --capture <file.ppm> keeps the last frame,
+        //  --draws <count> sizes the scene to measure command recording
+        uint64_t headlessFrames = 0;
+        const char *capturePath = nullptr;
+        uint32_t drawCount = 1;
+
+        for (int i = 1; i + 1 < argc; i += 2)
+        {
+            if (strcmp(argv[i], "--headless") == 0)
+            {
+                headlessFrames = strtoull(argv[i + 1], nullptr, 10);
+            }
+            else if (strcmp(argv[i], "--capture") == 0)
+            {
+                capturePath = argv[i + 1];
+            }
+            else if (strcmp(argv[i], "--draws") == 0)
+            {
+                drawCount = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+            }
+        }
+
+        if (headlessFrames > 0 ? !mainLoop.InitializeHeadless(headlessFrames, capturePath)
+                               : !mainLoop.InitializeWindow())
         {
             exit(-1);
         }
-        
+
+        mainLoop.SetSceneDrawCount(drawCount);
+
         if (!mainLoop.Initialize(title))
         {
             exit(-1);
-        }        
+        }
 
         while (mainLoop.Iterate())
             ;
 
+        if (headlessFrames > 0)
+        {
+            mainLoop.FinishHeadless();
+        }
+
         mainLoop.DestroyWindow();
         mainLoop.DestroyRenderer();
     }
 
+    aga::MemoryTracker::getInstance().PrintStatistics();
+    aga::MemoryTracker::getInstance().ReportLeaks();
+
     LOG_DEBUG("Finishing agaEngine\n");
 
     return 0;
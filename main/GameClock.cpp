@@ -0,0 +1,118 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "GameClock.h"
+
+namespace aga
+{
+    const double GAME_CLOCK_DEFAULT_STEP = 1.0 / 120.0;
+    const uint32_t GAME_CLOCK_DEFAULT_MAX_STEPS = 8;
+
+    //  Longest real frame that is accounted for, covers debugger breaks and window drags
+    const double GAME_CLOCK_MAX_FRAME_DELTA = 0.25;
+
+    GameClock::GameClock()
+        : m_HasLastTime(false),
+          m_FixedStep(GAME_CLOCK_DEFAULT_STEP),
+          m_TimeScale(1.0),
+          m_Accumulator(0.0),
+          m_RealDelta(0.0),
+          m_MaxStepsPerFrame(GAME_CLOCK_DEFAULT_MAX_STEPS),
+          m_StepCount(0),
+          m_IsPaused(false)
+    {
+    }
+
+    void GameClock::SetFixedStep(double step)
+    {
+        if (step > 0.0)
+        {
+            m_FixedStep = step;
+            m_Accumulator = 0.0;
+        }
+    }
+
+    double GameClock::GetFixedStep() const
+    {
+        return m_FixedStep;
+    }
+
+    void GameClock::SetMaxStepsPerFrame(uint32_t steps)
+    {
+        m_MaxStepsPerFrame = steps > 0 ? steps : 1;
+    }
+
+    void GameClock::SetTimeScale(double scale)
+    {
+        m_TimeScale = scale > 0.0 ? scale : 0.0;
+    }
+
+    double GameClock::GetTimeScale() const
+    {
+        return m_TimeScale;
+    }
+
+    void GameClock::SetPaused(bool paused)
+    {
+        m_IsPaused = paused;
+    }
+
+    bool GameClock::IsPaused() const
+    {
+        return m_IsPaused;
+    }
+
+    uint32_t GameClock::Advance()
+    {
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        m_RealDelta = m_HasLastTime ? std::chrono::duration<double>(now - m_LastTime).count() : 0.0;
+        m_LastTime = now;
+        m_HasLastTime = true;
+
+        if (m_IsPaused)
+        {
+            return 0;
+        }
+
+        const double delta = m_RealDelta < GAME_CLOCK_MAX_FRAME_DELTA ? m_RealDelta : GAME_CLOCK_MAX_FRAME_DELTA;
+
+        m_Accumulator += delta * m_TimeScale;
+
+        uint32_t steps = (uint32_t)(m_Accumulator / m_FixedStep);
+
+        m_Accumulator -= m_FixedStep * steps;
+
+        //  The backlog is dropped, the fraction of a step is kept so the alpha stays continuous
+        steps = steps < m_MaxStepsPerFrame ? steps : m_MaxStepsPerFrame;
+        m_StepCount += steps;
+
+        return steps;
+    }
+
+    void GameClock::Reset()
+    {
+        m_HasLastTime = false;
+    }
+
+    float GameClock::GetInterpolationAlpha() const
+    {
+        const double alpha = m_Accumulator / m_FixedStep;
+
+        return (float)(alpha < 1.0 ? alpha : 1.0);
+    }
+
+    double GameClock::GetSimulationTime() const
+    {
+        return m_StepCount * m_FixedStep;
+    }
+
+    double GameClock::GetRealDelta() const
+    {
+        return m_RealDelta;
+    }
+
+    uint64_t GameClock::GetStepCount() const
+    {
+        return m_StepCount;
+    }
+}  // namespace aga
@@ -0,0 +1,65 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "core/Typedefs.h"
+
+#include <chrono>
+#include <stdint.h>
+
+namespace aga
+{
+    //  Game time advancing in fixed steps. Advance is called once per rendered frame and returns how many steps
+    //  the simulation owes, the time left over is exposed as the interpolation alpha between the last two steps.
+    //
+    //  Real time is scaled before it is accumulated, so pausing or slowing the game never changes the step size.
+    //  A frame that took too long is clamped and the steps it would need are dropped, a slow simulation then runs
+    //  slower than real time instead of falling further behind every frame.
+    class GameClock
+    {
+    public:
+        GameClock();
+
+        //  Seconds per simulation step
+        void SetFixedStep(double step);
+        double GetFixedStep() const;
+
+        //  Upper bound for steps run by a single Advance
+        void SetMaxStepsPerFrame(uint32_t steps);
+
+        void SetTimeScale(double scale);
+        double GetTimeScale() const;
+
+        void SetPaused(bool paused);
+        bool IsPaused() const;
+
+        //  Measures the real time since the previous call and returns the number of steps to run
+        uint32_t Advance();
+
+        //  Skips the real time passed since the last Advance, e.g. after the loop was blocked on window events
+        void Reset();
+
+        //  How far rendering is between the previous and the latest step, in [0, 1)
+        float GetInterpolationAlpha() const;
+
+        //  Game time at the latest step, in seconds
+        double GetSimulationTime() const;
+
+        //  Unscaled duration of the last frame, before clamping
+        double GetRealDelta() const;
+
+        uint64_t GetStepCount() const;
+
+    private:
+        std::chrono::steady_clock::time_point m_LastTime;
+        bool m_HasLastTime;
+
+        double m_FixedStep;
+        double m_TimeScale;
+        double m_Accumulator;
+        double m_RealDelta;
+        uint32_t m_MaxStepsPerFrame;
+        uint64_t m_StepCount;
+        bool m_IsPaused;
+    };
+}  // namespace aga
@@ -1,21 +1,56 @@
 // Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
 
 #include "MainLoop.h"
+#include "core/BuildConfig.h"
+#include "core/FrameAllocator.h"
+#include "core/JobSystem.h"
+#include "core/Logger.h"
 #include "core/Macros.h"
+#include "core/Memory.h"
+#include "platform/PlatformFileSystem.h"
 #include "platform/PlatformWindow.h"
 #include "render/VulkanRenderer.h"
 
-#include <chrono>
-#include <thread>
+#include <algorithm>
+#include <cstdio>
 
 namespace aga
 {
-    MainLoop::MainLoop() : m_Renderer(nullptr), m_PlatformWindowBase(nullptr)
+    //  Scratch memory available to a single frame, anything above it falls back to the heap
+    const size_t FRAME_ALLOCATOR_CAPACITY = 8 * 1024 * 1024;
+
+    //  Written next to the data directory by the agaAssetArchive target
+    const char *const ASSET_ARCHIVE_PATH = "data.pak";
+
+    //  The archive shadows the loose files it was packed from
+    const int32_t ASSET_DIRECTORY_PRIORITY = 0;
+    const int32_t ASSET_ARCHIVE_PRIORITY = 1;
+
+    //  Frames that may still allocate while caches and pools grow to their working size
+    const uint64_t FRAME_ALLOCATION_WARMUP = 16;
+
+    //  Size of the offscreen images when no window decides it
+    const uint32_t HEADLESS_DEFAULT_WIDTH = 1280;
+    const uint32_t HEADLESS_DEFAULT_HEIGHT = 800;
+
+    MainLoop::MainLoop()
+        : m_Renderer(nullptr),
+          m_PlatformWindowBase(nullptr),
+          m_SimulationSteps(0),
+          m_FrameIndex(0),
+          m_ShouldRun(true),
+          m_SteadyFrameAllocations(0),
+          m_HeadlessFrameCount(0),
+          m_CaptureWidth(0),
+          m_CaptureHeight(0)
     {
     }
 
     MainLoop::~MainLoop()
     {
+        PlatformFileSystem::getInstance()->Destroy();
+        JobSystem::getInstance().Destroy();
+        FrameAllocator::getInstance().Destroy();
     }
 
     bool MainLoop::InitializeRenderer()
@@ -39,34 +74,254 @@ namespace aga
         return true;
     }
 
+    bool MainLoop::InitializeHeadless(uint64_t frameCount, const char *capturePath)
+    {
+        m_HeadlessFrameCount = frameCount;
+        m_Renderer->SetHeadless(HEADLESS_DEFAULT_WIDTH, HEADLESS_DEFAULT_HEIGHT);
+
+        //  Throughput is what counts without a display
+        m_FramePacer.SetMode(FramePacer::PacingUncapped);
+
+        if (capturePath)
+        {
+            m_CapturePath = capturePath;
+
+            m_Renderer->SetFrameReadback([this](uint64_t, const uint8_t *pixels, uint32_t width, uint32_t height) {
+                m_CapturePixels.assign(pixels, pixels + (size_t)width * height * 4);
+                m_CaptureWidth = width;
+                m_CaptureHeight = height;
+            });
+        }
+
+        return true;
+    }
+
+    void MainLoop::SetSceneDrawCount(uint32_t count)
+    {
+        m_Renderer->SetSceneDrawCount(count);
+    }
+
     bool MainLoop::Initialize(const char *title, size_t width, size_t height)
     {
+        if (!FrameAllocator::getInstance().Initialize(FRAME_ALLOCATOR_CAPACITY))
+        {
+            return false;
+        }
+
+        if (!JobSystem::getInstance().Initialize())
+        {
+            return false;
+        }
+
+        PlatformFileSystemBase *fileSystem = PlatformFileSystem::getInstance();
+
+        fileSystem->MountDirectory("data", "data", ASSET_DIRECTORY_PRIORITY);
+
+#if BUILD_ENABLE_ASSET_ARCHIVE
+        //  Without the archive everything is still found in the loose data directory, only slower
+        if (fileSystem->MountArchive(ASSET_ARCHIVE_PATH, "", ASSET_ARCHIVE_PRIORITY) == INVALID_MOUNT)
+        {
+            LOG_WARNING_FMT_F("Can not mount {}, loading assets from the data directory\n", ASSET_ARCHIVE_PATH);
+        }
+#endif
+
+        if (!m_PlatformWindowBase)
+        {
+            return m_Renderer->Initialize() && _BuildFrameGraph();
+        }
+
         if (m_PlatformWindowBase->Initialize(title, width, height))
         {
             m_Renderer->SetPlatformWindow(m_PlatformWindowBase);
 
-            return m_Renderer->Initialize();
+            return m_Renderer->Initialize() && _BuildFrameGraph();
         }
 
         return false;
     }
 
+    bool MainLoop::_BuildFrameGraph()
+    {
+        using namespace literals;
+
+        //  Rendering trails one frame behind, so the simulation of frame N runs while frame N - 1 is submitted and
+        //  presented. It only has to wait until BeginRender copied the transforms of the previous frame. Everything
+        //  touching the window or the swap chain stays on the main thread.
+        m_FrameGraph.AddTask(
+            "Input",
+            [this](uint64_t frame) {
+                m_ShouldRun = m_PlatformWindowBase ? m_PlatformWindowBase->Update() : frame + 1 < m_HeadlessFrameCount;
+            },
+            {}, {"Input"_sid}, 0, FrameTaskGraph::TaskMainThread);
+
+        m_FrameGraph.AddTask(
+            "Simulation", [this](uint64_t) { _Simulate(); }, {"Input"_sid}, {"Transforms"_sid});
+
+        m_FrameGraph.AddTask(
+            "BeginRender", [this](uint64_t) { m_Renderer->BeginRender(); }, {"Transforms"_sid},
+            {"SwapChain"_sid, "UniformBuffers"_sid}, 1, FrameTaskGraph::TaskMainThread);
+
+        m_FrameGraph.AddTask(
+            "Submit", [this](uint64_t) { m_Renderer->RenderFrame(); }, {"UniformBuffers"_sid, "SwapChain"_sid},
+            {"GraphicsQueue"_sid}, 1, FrameTaskGraph::TaskMainThread);
+
+        m_FrameGraph.AddTask(
+            "Present", [this](uint64_t) { m_Renderer->EndRender(); }, {}, {"GraphicsQueue"_sid, "SwapChain"_sid},
+            1, FrameTaskGraph::TaskMainThread);
+
+        return m_FrameGraph.Build();
+    }
+
+    void MainLoop::_Simulate()
+    {
+        const real_t step = (real_t)m_GameClock.GetFixedStep();
+
+        for (uint32_t i = 0; i < m_SimulationSteps; ++i)
+        {
+            m_Renderer->Update(step);
+        }
+
+        m_Renderer->Interpolate(m_GameClock.GetInterpolationAlpha());
+    }
+
+    void MainLoop::SetFramePacing(FramePacer::Mode mode, double framesPerSecond)
+    {
+        m_FramePacer.SetMode(mode, framesPerSecond);
+        m_Renderer->SetVSync(mode == FramePacer::PacingVSync);
+    }
+
+    const FramePacer &MainLoop::GetFramePacer() const
+    {
+        return m_FramePacer;
+    }
+
+    GameClock &MainLoop::GetGameClock()
+    {
+        return m_GameClock;
+    }
+
+    void MainLoop::FinishHeadless()
+    {
+        //  Rendering trails one frame behind, the last frame is only simulated so far
+        if (m_FrameIndex > 0)
+        {
+            m_FrameGraph.Finish(m_FrameIndex - 1);
+        }
+
+        vkDeviceWaitIdle(m_Renderer->GetVulkanDevice());
+        m_Renderer->FlushReadbacks();
+
+        const FrameTimeHistogram &frameTimes = m_FramePacer.GetFrameTimes();
+
+        LOG_INFO_FMT("Headless throughput: {} frames per second\n",
+                     frameTimes.GetMean() > 0.0 ? 1000.0 / frameTimes.GetMean() : 0.0);
+
+        if (m_CapturePath.Length() > 0 && !_WriteCapture())
+        {
+            LOG_ERROR_FMT_F("Can not write capture {}\n", m_CapturePath);
+        }
+    }
+
     void MainLoop::DestroyWindow()
     {
+        //  A window closed by the user leaves its last simulated frame unrendered, the swap chain may already be gone.
+        //  Headless runs render it in FinishHeadless.
         vkDeviceWaitIdle(m_Renderer->GetVulkanDevice());
+
+        const FrameTimeHistogram &frameTimes = m_FramePacer.GetFrameTimes();
+
+        LOG_INFO_FMT("Frame time [ms]: mean {}, p50 {}, p99 {}, max {} over {} frames\n", frameTimes.GetMean(),
+                     frameTimes.GetPercentile(0.5), frameTimes.GetPercentile(0.99), frameTimes.GetMax(),
+                     frameTimes.GetCount());
+
+        const FrameTimeHistogram &recordTimes = m_Renderer->GetRecordTimes();
+
+        LOG_INFO_FMT("Command recording [ms]: mean {}, p50 {}, p99 {}, max {}\n", recordTimes.GetMean(),
+                     recordTimes.GetPercentile(0.5), recordTimes.GetPercentile(0.99), recordTimes.GetMax());
+
+#if BUILD_ENABLE_MEMORY_TRACKING
+        LOG_INFO_FMT("Heap allocations per frame after {} frames of warm-up: at most {}\n", FRAME_ALLOCATION_WARMUP,
+                     m_SteadyFrameAllocations);
+#endif
+
+        if (!m_PlatformWindowBase)
+        {
+            return;
+        }
+
         m_PlatformWindowBase->Destroy();
         SAFE_DELETE(m_PlatformWindowBase);
     }
 
-    bool MainLoop::Iterate() const
+    bool MainLoop::_WriteCapture()
+    {
+        if (m_CapturePixels.empty())
+        {
+            return false;
+        }
+
+        FILE *file = fopen(m_CapturePath.GetData(), "wb");
+
+        if (!file)
+        {
+            return false;
+        }
+
+        //  Binary PPM, the alpha channel is dropped
+        fprintf(file, "P6\n%u %u\n255\n", m_CaptureWidth, m_CaptureHeight);
+
+        std::vector<uint8_t> row(m_CaptureWidth * 3);
+        bool isWritten = true;
+
+        for (uint32_t y = 0; y < m_CaptureHeight && isWritten; ++y)
+        {
+            const uint8_t *pixel = m_CapturePixels.data() + (size_t)y * m_CaptureWidth * 4;
+
+            for (uint32_t x = 0; x < m_CaptureWidth; ++x, pixel += 4)
+            {
+                row[x * 3 + 0] = pixel[0];
+                row[x * 3 + 1] = pixel[1];
+                row[x * 3 + 2] = pixel[2];
+            }
+
+            isWritten = fwrite(row.data(), 1, row.size(), file) == row.size();
+        }
+
+        return fclose(file) == 0 && isWritten;
+    }
+
+    bool MainLoop::Iterate()
     {
-        //  TODO: Low CPU usage mode
-        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        //  Minimized or in the background: nothing to draw, sleep until the window system has news
+        if (m_PlatformWindowBase && !m_PlatformWindowBase->IsActive())
+        {
+            m_ShouldRun = m_PlatformWindowBase->WaitForEvents();
+            m_FramePacer.Reset();
+            m_GameClock.Reset();
+
+            return m_ShouldRun;
+        }
+
+        m_FramePacer.WaitForNextFrame();
+
+        //  Sampled once per frame, the Simulation task runs this many fixed steps
+        m_SimulationSteps = m_GameClock.Advance();
+
+        FrameAllocator::getInstance().Reset();
+        MemoryTracker::getInstance().EndFrame();
+
+        if (m_FrameIndex > FRAME_ALLOCATION_WARMUP)
+        {
+            m_SteadyFrameAllocations =
+                std::max(m_SteadyFrameAllocations, MemoryTracker::getInstance().GetFrameAllocations());
+        }
+
+        //  Loads finished since the last frame hand over their data on the main thread
+        PlatformFileSystem::getInstance()->DispatchCompletions();
+        PlatformFileSystem::getInstance()->DispatchFileChanges();
 
-        m_Renderer->BeginRender();
-        m_Renderer->RenderFrame();
-        m_Renderer->EndRender();
+        m_FrameGraph.Execute(m_FrameIndex++);
 
-        return m_PlatformWindowBase->Update();
+        return m_ShouldRun;
     }
 }  // namespace aga
\ No newline at end of file
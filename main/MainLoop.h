@@ -2,8 +2,14 @@
 
 #pragma once
 
+#include "core/FramePacer.h"
+#include "GameClock.h"
+#include "core/FrameTaskGraph.h"
+#include "core/String.h"
 #include "core/Typedefs.h"
 
+#include <vector>
+
 namespace aga
 {
     class VulkanRenderer;
@@ -20,13 +26,51 @@ namespace aga
 
         bool InitializeWindow();
         void DestroyWindow();
-        
+
+        //  Used instead of InitializeWindow: renders 'frameCount' frames offscreen as fast as possible and stops.
+        //  With 'capturePath' set the last frame read back is written there as a binary PPM.
+        bool InitializeHeadless(uint64_t frameCount, const char *capturePath = nullptr);
+        //  Renders the frame the last Iterate left to the latent tasks, then reports the throughput and writes the
+        //  capture. Called once after the loop, before DestroyWindow.
+        void FinishHeadless();
+
+        //  Draws the demo scene 'count' times, each draw recorded every frame. Has to be called before Initialize.
+        void SetSceneDrawCount(uint32_t count);
+
         bool Initialize(const char* title, size_t width = 1280, size_t height = 800);
 
-        bool Iterate() const;
+        bool Iterate();
+
+        //  VSync also switches the swap chain to FIFO presentation, 'framesPerSecond' is used by the fixed rate only
+        void SetFramePacing(FramePacer::Mode mode, double framesPerSecond = 60.0);
+        const FramePacer &GetFramePacer() const;
+
+        //  Pausing and scaling game time goes through the clock
+        GameClock &GetGameClock();
+
+    private:
+        bool _BuildFrameGraph();
+        void _Simulate();
+        bool _WriteCapture();
 
     private:
         VulkanRenderer *m_Renderer;
         PlatformWindowBase *m_PlatformWindowBase;
+
+        FrameTaskGraph m_FrameGraph;
+        FramePacer m_FramePacer;
+        GameClock m_GameClock;
+        uint32_t m_SimulationSteps;
+        uint64_t m_FrameIndex;
+        bool m_ShouldRun;
+
+        //  Most heap allocations made by one frame after the warm-up frames
+        uint64_t m_SteadyFrameAllocations;
+
+        uint64_t m_HeadlessFrameCount;
+        String m_CapturePath;
+        std::vector<uint8_t> m_CapturePixels;
+        uint32_t m_CaptureWidth;
+        uint32_t m_CaptureHeight;
     };
 }  // namespace aga
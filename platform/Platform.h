@@ -3,6 +3,7 @@
 #pragma once
 
 #include "core/Common.h"
+#include "core/String.h"
 
 #include <vulkan/vulkan.h>
 
@@ -22,6 +23,10 @@ namespace aga
         virtual void Initialize() = 0;
 
         virtual std::vector<const char *> GetRequiredExtensions() = 0;
+
+        //  Runs a program found on the PATH and waits for it. Its standard output is collected into 'output', the
+        //  error output goes to ours. True when the program ran and exited with status 0.
+        virtual bool RunProcess(const std::vector<String> &arguments, std::vector<uint8_t> &output) = 0;
     };
 
     class Platform
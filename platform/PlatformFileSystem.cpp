@@ -1,6 +1,12 @@
 // Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
 
 #include "PlatformFileSystem.h"
+#include "core/AssetArchive.h"
+#include "core/Logger.h"
+#include "core/Memory.h"
+
+#include <algorithm>
+#include <cstring>
 
 #if defined(_WIN32)
 #include "platform/windows/WindowsPlatformFileSystem.h"
@@ -13,12 +19,448 @@
 
 namespace aga
 {
-    PlatformFileSystemBase::PlatformFileSystemBase()
+    MappedFile::MappedFile() : m_Data(nullptr), m_Size(0), m_IsOpen(false), m_IsCopy(false)
+    {
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile &&other) noexcept : MappedFile()
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile &MappedFile::operator=(MappedFile &&other) noexcept
+    {
+        if (this != &other)
+        {
+            Close();
+
+            m_Data = other.m_Data;
+            m_Size = other.m_Size;
+            m_IsOpen = other.m_IsOpen;
+            m_IsCopy = other.m_IsCopy;
+            m_Shared = std::move(other.m_Shared);
+
+            other.m_Data = nullptr;
+            other.m_Size = 0;
+            other.m_IsOpen = false;
+            other.m_IsCopy = false;
+        }
+
+        return *this;
+    }
+
+    bool MappedFile::IsOpen() const
+    {
+        return m_IsOpen;
+    }
+
+    const uint8_t *MappedFile::GetData() const
+    {
+        return m_Data;
+    }
+
+    size_t MappedFile::GetSize() const
+    {
+        return m_Size;
+    }
+
+    void MappedFile::Close()
+    {
+        if (m_IsOpen)
+        {
+            PlatformFileSystem::getInstance()->UnmapFile(*this);
+        }
+    }
+
+    //  Path below 'mountPoint' relative to it, false when 'path' is outside of the mount point
+    static bool MatchMountPoint(const String &mountPoint, const String &path, StringView &relative)
+    {
+        const uint32_t length = mountPoint.Length();
+
+        if (length == 0)
+        {
+            relative = path;
+
+            return true;
+        }
+
+        if (path.Length() <= length + 1 || path[length] != '/' || memcmp(path.GetData(), mountPoint.GetData(), length))
+        {
+            return false;
+        }
+
+        relative = StringView(path).Substring(length + 1);
+
+        return true;
+    }
+
+    static String NormalizeMountPoint(const String &mountPoint)
+    {
+        String normalized = NormalizeAssetPath(mountPoint);
+        uint32_t length = normalized.Length();
+
+        while (length > 0 && normalized[length - 1] == '/')
+        {
+            --length;
+        }
+
+        return String(normalized.GetData(), length);
+    }
+
+    PlatformFileSystemBase::PlatformFileSystemBase() : m_NextMount(INVALID_MOUNT + 1)
     {
     }
 
     PlatformFileSystemBase::~PlatformFileSystemBase()
     {
+        UnmountAll();
+    }
+
+    MountHandle PlatformFileSystemBase::MountDirectory(const String &mountPoint, const String &directory,
+                                                       int32_t priority)
+    {
+        //  Mount tables and the lookup cache are charged to Platform
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        uint32_t length = directory.Length();
+
+        while (length > 1 && directory[length - 1] == '/')
+        {
+            --length;
+        }
+
+        Mount *mount = new Mount();
+        mount->Type = MountTypeDirectory;
+        mount->Priority = priority;
+        mount->MountPoint = NormalizeMountPoint(mountPoint);
+        mount->Directory = length > 0 ? String(directory.GetData(), length) : String(".");
+
+        return _AddMount(mount);
+    }
+
+    MountHandle PlatformFileSystemBase::MountArchive(const String &path, const String &mountPoint, int32_t priority)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        std::shared_ptr<AssetArchive> archive = std::make_shared<AssetArchive>();
+
+        if (!archive->Open(path.GetData()))
+        {
+            LOG_ERROR_FMT_F("Failed to mount archive: {}\n", path);
+
+            return INVALID_MOUNT;
+        }
+
+        LOG_INFO_FMT("Mounted archive {} with {} files\n", path, archive->GetEntryCount());
+
+        Mount *mount = new Mount();
+        mount->Type = MountTypeArchive;
+        mount->Priority = priority;
+        mount->MountPoint = NormalizeMountPoint(mountPoint);
+        mount->Archive = std::move(archive);
+
+        return _AddMount(mount);
+    }
+
+    MountHandle PlatformFileSystemBase::MountMemory(const String &mountPoint, int32_t priority)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        Mount *mount = new Mount();
+        mount->Type = MountTypeMemory;
+        mount->Priority = priority;
+        mount->MountPoint = NormalizeMountPoint(mountPoint);
+
+        return _AddMount(mount);
+    }
+
+    bool PlatformFileSystemBase::AddMemoryFile(MountHandle mount, const String &path, std::vector<uint8_t> data)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        for (Mount *owner : m_Mounts)
+        {
+            if (owner->Handle == mount && owner->Type == MountTypeMemory)
+            {
+                MemoryFile &file = owner->Files[StringId(HashAssetPath(path))];
+                file.Path = NormalizeAssetPath(path);
+                file.Data = std::make_shared<const std::vector<uint8_t>>(std::move(data));
+
+                m_LookupCache.clear();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool PlatformFileSystemBase::Unmount(MountHandle mount)
+    {
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        for (auto it = m_Mounts.begin(); it != m_Mounts.end(); ++it)
+        {
+            if ((*it)->Handle == mount)
+            {
+                delete *it;
+                m_Mounts.erase(it);
+                m_LookupCache.clear();
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void PlatformFileSystemBase::UnmountAll()
+    {
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        for (Mount *mount : m_Mounts)
+        {
+            delete mount;
+        }
+
+        m_Mounts.clear();
+        m_LookupCache.clear();
+    }
+
+    bool PlatformFileSystemBase::FileExists(const String &path)
+    {
+        FileLocation location;
+
+        return ResolvePath(path, location);
+    }
+
+    bool PlatformFileSystemBase::ResolvePath(const String &path, FileLocation &location)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        const StringId id(HashAssetPath(path));
+
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        auto cached = m_LookupCache.find(id);
+
+        if (cached != m_LookupCache.end())
+        {
+            if (!cached->second.Owner)
+            {
+                return false;
+            }
+
+            //  Archive entries are found by index alone, the common case needs no string work at all
+            const Mount *owner = cached->second.Owner;
+            const String normalized = owner->Type == MountTypeArchive ? String() : NormalizeAssetPath(path);
+
+            _FillLocation(owner, normalized, cached->second.Entry, location);
+
+            return true;
+        }
+
+        const String normalized = NormalizeAssetPath(path);
+        CachedLookup lookup = {nullptr, 0};
+
+        for (const Mount *mount : m_Mounts)
+        {
+            if (_FindInMount(mount, normalized, lookup.Entry))
+            {
+                lookup.Owner = mount;
+
+                break;
+            }
+        }
+
+        m_LookupCache[id] = lookup;
+
+        if (lookup.Owner)
+        {
+            _FillLocation(lookup.Owner, normalized, lookup.Entry, location);
+        }
+
+        return lookup.Owner != nullptr;
+    }
+
+    void PlatformFileSystemBase::EnumerateFiles(const String &directory, std::vector<String> &paths, bool recursive)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        const String normalized = NormalizeMountPoint(directory);
+
+        paths.clear();
+
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        for (const Mount *mount : m_Mounts)
+        {
+            //  Directory inside the mount, relative to its mount point. A mount point further down the tree is
+            //  only visited when recursing.
+            StringView relative;
+
+            if (normalized == mount->MountPoint)
+            {
+                relative = StringView();
+            }
+            else if (!MatchMountPoint(mount->MountPoint, normalized, relative))
+            {
+                StringView below;
+
+                if (!recursive || !(normalized.Length() == 0 || MatchMountPoint(normalized, mount->MountPoint, below)))
+                {
+                    continue;
+                }
+
+                relative = StringView();
+            }
+
+            const String prefix = mount->MountPoint.Length() > 0 ? mount->MountPoint + "/" : String();
+
+            if (mount->Type == MountTypeDirectory)
+            {
+                String native = mount->Directory;
+                String virtualDirectory = mount->MountPoint;
+
+                if (!relative.IsEmpty())
+                {
+                    native += "/";
+                    native += relative;
+                    virtualDirectory = prefix + String(relative);
+                }
+
+                _ListNativeFiles(native, virtualDirectory, paths, recursive);
+
+                continue;
+            }
+
+            //  Archive entries and memory files are flat lists of paths, directories are only implied by them
+            auto visit = [&](StringView name) {
+                if (!relative.IsEmpty() &&
+                    (name.Length() <= relative.Length() + 1 || name[relative.Length()] != '/' ||
+                     memcmp(name.GetData(), relative.GetData(), relative.Length())))
+                {
+                    return;
+                }
+
+                const StringView rest = relative.IsEmpty() ? name : name.Substring(relative.Length() + 1);
+
+                if (recursive || rest.IndexOf('/') < 0)
+                {
+                    paths.push_back(prefix + String(name));
+                }
+            };
+
+            if (mount->Type == MountTypeArchive)
+            {
+                for (uint32_t i = 0; i < mount->Archive->GetEntryCount(); ++i)
+                {
+                    visit(mount->Archive->GetEntryName(i));
+                }
+            }
+            else
+            {
+                for (const auto &file : mount->Files)
+                {
+                    visit(file.second.Path);
+                }
+            }
+        }
+
+        std::sort(paths.begin(), paths.end(), [](const String &lhs, const String &rhs) {
+            return strcmp(lhs.GetData(), rhs.GetData()) < 0;
+        });
+        paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    }
+
+    void PlatformFileSystemBase::InvalidateLookupCache()
+    {
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        m_LookupCache.clear();
+    }
+
+    MountHandle PlatformFileSystemBase::_AddMount(Mount *mount)
+    {
+        std::lock_guard<std::mutex> lock(m_MountMutex);
+
+        mount->Handle = m_NextMount++;
+
+        //  Newest first among equal priorities
+        auto position = m_Mounts.begin();
+
+        while (position != m_Mounts.end() && (*position)->Priority > mount->Priority)
+        {
+            ++position;
+        }
+
+        m_Mounts.insert(position, mount);
+        m_LookupCache.clear();
+
+        return mount->Handle;
+    }
+
+    bool PlatformFileSystemBase::_FindInMount(const Mount *mount, const String &path, uint32_t &entry)
+    {
+        StringView relative;
+
+        if (!MatchMountPoint(mount->MountPoint, path, relative))
+        {
+            return false;
+        }
+
+        entry = 0;
+
+        switch (mount->Type)
+        {
+            case MountTypeDirectory:
+                return _IsNativeFile(mount->Directory + "/" + String(relative));
+
+            case MountTypeArchive:
+                entry = mount->Archive->Find(relative);
+
+                return entry != ASSET_ARCHIVE_INVALID_ENTRY;
+
+            case MountTypeMemory:
+                return mount->Files.find(StringId(HashAssetPath(relative))) != mount->Files.end();
+        }
+
+        return false;
+    }
+
+    void PlatformFileSystemBase::_FillLocation(const Mount *mount, const String &path, uint32_t entry,
+                                               FileLocation &location)
+    {
+        StringView relative;
+
+        if (mount->Type != MountTypeArchive)
+        {
+            MatchMountPoint(mount->MountPoint, path, relative);
+        }
+
+        location.Type = mount->Type;
+        location.NativePath =
+            mount->Type == MountTypeDirectory ? mount->Directory + "/" + String(relative) : String();
+        location.Archive = mount->Archive;
+        location.Entry = entry;
+        location.Data.reset();
+
+        if (mount->Type == MountTypeMemory)
+        {
+            auto file = mount->Files.find(StringId(HashAssetPath(relative)));
+
+            if (file != mount->Files.end())
+            {
+                location.Data = file->second.Data;
+            }
+        }
     }
 
 #if defined(_WIN32)
@@ -3,20 +3,243 @@
 #pragma once
 
 #include "core/String.h"
+#include "core/StringId.h"
 #include "core/Typedefs.h"
 #include "platform/Platform.h"
 
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
 namespace aga
 {
+    class AssetArchive;
+
+    typedef uint32_t MountHandle;
+
+    const MountHandle INVALID_MOUNT = 0;
+
+    enum MountType
+    {
+        MountTypeDirectory,
+        MountTypeArchive,
+        MountTypeMemory
+    };
+
+    //  Where a virtual path was found. Archives and memory files are shared, so a location stays readable after
+    //  its mount is gone.
+    struct FileLocation
+    {
+        MountType Type;
+        String NativePath;
+        std::shared_ptr<const AssetArchive> Archive;
+        uint32_t Entry;
+        std::shared_ptr<const std::vector<uint8_t>> Data;
+    };
+
+    typedef uint32_t FileRequestHandle;
+
+    const FileRequestHandle INVALID_FILE_REQUEST = 0;
+
+    //  Pending reads are started in priority order, reads already in flight are not preempted
+    enum FileRequestPriority
+    {
+        FilePriorityLow,
+        FilePriorityNormal,
+        FilePriorityHigh,
+        FilePriorityCount
+    };
+
+    struct FileReadResult
+    {
+        FileRequestHandle Handle;
+        bool Success;
+        std::vector<uint8_t> Data;
+    };
+
+    //  The result can be moved from, the request is forgotten after the callback returns
+    typedef std::function<void(FileReadResult &result)> FileReadCallback;
+
+    //  Produces the data of a file that does not come from a native path, e.g. an archive entry
+    typedef std::function<bool(std::vector<uint8_t> &data)> FileSourceFunction;
+
+    typedef uint32_t FileWatchHandle;
+
+    const FileWatchHandle INVALID_FILE_WATCH = 0;
+
+    //  Called with the virtual path of a watched file after it was written
+    typedef std::function<void(const String &path)> FileChangeCallback;
+
+    //  How a mapped file is going to be read, lets the OS tune read-ahead
+    enum FileAccessHint
+    {
+        FileAccessNormal,
+        FileAccessSequential,
+        FileAccessRandom
+    };
+
+    //  Read-only view of a whole file mapped into memory, unmapped when the object goes away. The data is page
+    //  aligned and stays valid as long as the MappedFile lives, without being copied. Files of memory mounts share
+    //  the mount's buffer. Files found in a mounted archive are compressed and get decoded into a heap copy instead.
+    class MappedFile
+    {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        MappedFile(MappedFile &&other) noexcept;
+        MappedFile &operator=(MappedFile &&other) noexcept;
+
+        MappedFile(const MappedFile &) = delete;
+        void operator=(const MappedFile &) = delete;
+
+        bool IsOpen() const;
+        const uint8_t *GetData() const;
+        size_t GetSize() const;
+
+        void Close();
+
+    private:
+        friend class X11PlatformFileSystem;
+
+        const uint8_t *m_Data;
+        size_t m_Size;
+        bool m_IsOpen;
+        bool m_IsCopy;
+
+        //  Contents of a memory mount file, kept alive even if the file is replaced or unmounted meanwhile
+        std::shared_ptr<const std::vector<uint8_t>> m_Shared;
+    };
+
+    //  All paths given to the file system are virtual. They are looked up in the mounted directories, archives and
+    //  in-memory file sets, from the highest priority down, and the first mount holding the path wins. Mounts of
+    //  equal priority are searched newest first.
+    //
+    //  Every lookup is remembered by the hash of its normalized path, including misses, so repeated lookups cost a
+    //  single hash table probe no matter how many mounts or files there are. Mounting and unmounting forget all
+    //  lookups; files appearing in a mounted directory later need InvalidateLookupCache.
     class PlatformFileSystemBase
     {
     public:
         PlatformFileSystemBase();
         virtual ~PlatformFileSystemBase();
 
+        //  Makes the files below the native 'directory' visible below the virtual 'mountPoint', "" is the root
+        MountHandle MountDirectory(const String &mountPoint, const String &directory, int32_t priority = 0);
+
+        //  Makes the entries of an AssetArchive visible below 'mountPoint' under their stored paths
+        MountHandle MountArchive(const String &path, const String &mountPoint = "", int32_t priority = 0);
+
+        //  Empty set of files kept in memory, filled with AddMemoryFile
+        MountHandle MountMemory(const String &mountPoint, int32_t priority = 0);
+
+        //  Adds or replaces a file of a memory mount, 'path' is relative to the mount point
+        bool AddMemoryFile(MountHandle mount, const String &path, std::vector<uint8_t> data);
+
+        bool Unmount(MountHandle mount);
+        void UnmountAll();
+
+        bool FileExists(const String &path);
+
+        //  Finds the mount holding 'path', false when no mount has it
+        bool ResolvePath(const String &path, FileLocation &location);
+
+        //  Virtual paths of the files in 'directory' across all mounts, sorted and without duplicates. Files of
+        //  subdirectories are included when 'recursive' is set.
+        void EnumerateFiles(const String &directory, std::vector<String> &paths, bool recursive = false);
+
+        void InvalidateLookupCache();
+
     public:
+        //  Binary files are read with MapFile, which does not copy them
         virtual String ReadEntireFileTextMode(const String &path) = 0;
-        virtual String ReadEntireFileBinaryMode(const String &path) = 0;
+
+        //  Replaces 'file' with a mapping of 'path', fails if the file can not be opened. An empty file is open but
+        //  has no data.
+        virtual bool MapFile(const String &path, MappedFile &file, FileAccessHint hint = FileAccessNormal) = 0;
+        virtual void UnmapFile(MappedFile &file) = 0;
+
+        //  Reads the whole file in the background. The callback runs on the thread calling DispatchCompletions or
+        //  WaitForRequest, never on an I/O thread.
+        virtual FileRequestHandle ReadFileAsync(const String &path, FileReadCallback callback,
+                                                FileRequestPriority priority = FilePriorityNormal) = 0;
+
+        //  Like ReadFileAsync, but the data is produced by 'source' on an I/O thread, e.g. by running a tool. 'name'
+        //  only shows up in errors.
+        virtual FileRequestHandle ReadSourceAsync(const String &name, FileSourceFunction source,
+                                                  FileReadCallback callback,
+                                                  FileRequestPriority priority = FilePriorityNormal) = 0;
+
+        //  Drops a request that has not started yet, its callback is never called
+        virtual bool CancelRequest(FileRequestHandle handle) = 0;
+
+        //  True once the data is ready, or the callback already ran
+        virtual bool IsRequestFinished(FileRequestHandle handle) = 0;
+
+        //  Blocks until the request finished, then dispatches all finished callbacks
+        virtual void WaitForRequest(FileRequestHandle handle) = 0;
+
+        //  Runs the callbacks of finished requests, returns how many ran. Called once per frame by the main loop.
+        virtual uint32_t DispatchCompletions() = 0;
+
+        //  Calls 'callback' when the file behind 'path' is written or replaced, only files of directory mounts can be
+        //  watched. A change is reported once the file stayed untouched for a moment, so an editor saving in several
+        //  steps triggers a single call.
+        virtual FileWatchHandle WatchFile(const String &path, FileChangeCallback callback) = 0;
+        virtual void UnwatchFile(FileWatchHandle handle) = 0;
+
+        //  Runs the callbacks of changed files on the calling thread, returns how many ran. Called once per frame by
+        //  the main loop.
+        virtual uint32_t DispatchFileChanges() = 0;
+
+        //  Stops the I/O threads, pending requests are dropped
+        virtual void Destroy() = 0;
+
+    protected:
+        //  Native file system access for directory mounts
+        virtual bool _IsNativeFile(const String &path) = 0;
+
+        //  Appends the files in the native 'directory' as "<prefix>/<name>", recursing into subdirectories if asked
+        virtual void _ListNativeFiles(const String &directory, const String &prefix, std::vector<String> &paths,
+                                      bool recursive) = 0;
+
+    private:
+        struct MemoryFile
+        {
+            String Path;
+            std::shared_ptr<const std::vector<uint8_t>> Data;
+        };
+
+        struct Mount
+        {
+            MountHandle Handle;
+            MountType Type;
+            int32_t Priority;
+            String MountPoint;
+            String Directory;
+            std::shared_ptr<AssetArchive> Archive;
+            std::unordered_map<StringId, MemoryFile> Files;
+        };
+
+        //  Mount holding the path and its archive entry, a null mount records a miss
+        struct CachedLookup
+        {
+            const Mount *Owner;
+            uint32_t Entry;
+        };
+
+        MountHandle _AddMount(Mount *mount);
+        bool _FindInMount(const Mount *mount, const String &path, uint32_t &entry);
+        void _FillLocation(const Mount *mount, const String &path, uint32_t entry, FileLocation &location);
+
+    private:
+        std::mutex m_MountMutex;
+        std::vector<Mount *> m_Mounts;
+        std::unordered_map<StringId, CachedLookup> m_LookupCache;
+        MountHandle m_NextMount;
     };
 
     class PlatformFileSystem
@@ -17,7 +17,9 @@ namespace aga
 {
     PlatformWindowBase::PlatformWindowBase() :
         m_Renderer(nullptr),
-        m_ShouldRun(true)
+        m_ShouldRun(true),
+        m_IsFocused(true),
+        m_IsVisible(true)
     {
     }
 
@@ -30,6 +32,11 @@ namespace aga
         m_ShouldRun = false;
     }
 
+    bool PlatformWindowBase::IsActive() const
+    {
+        return m_IsFocused && m_IsVisible;
+    }
+
     void PlatformWindowBase::SetRenderer(VulkanRenderer *renderer)
     {
         m_Renderer = renderer;
@@ -22,10 +22,16 @@ namespace aga
         virtual void Destroy() = 0;
         virtual bool Update() = 0;
 
+        //  Blocks until at least one event arrived and handles everything pending, like Update
+        virtual bool WaitForEvents() = 0;
+
         virtual Vector2 GetCurrentWindowSize() = 0;
 
         void Close();
 
+        //  False while the window is minimized or lost focus, the main loop stops rendering and waits for events
+        bool IsActive() const;
+
         void SetRenderer(VulkanRenderer *renderer);
 
     public:
@@ -37,6 +43,8 @@ namespace aga
         uint32_t m_Width;
         uint32_t m_Height;
         bool m_ShouldRun;
+        bool m_IsFocused;
+        bool m_IsVisible;
     };
 
     class PlatformWindow
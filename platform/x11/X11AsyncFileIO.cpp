@@ -0,0 +1,767 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "X11AsyncFileIO.h"
+#include "core/BuildConfig.h"
+#include "core/Logger.h"
+#include "core/Memory.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace aga
+{
+    //  Reads the ring thread keeps in the kernel at once, the rest waits in the priority queues
+    const uint32_t FILE_IO_MAX_IN_FLIGHT = 32;
+
+    //  Room for every read in flight plus the wake-up poll
+    const uint32_t FILE_IO_RING_ENTRIES = 64;
+
+    const uint32_t FILE_IO_WORKER_COUNT = 2;
+
+    //  How long a failed ring waits for the reads the kernel already has before the workers take them over
+    const std::chrono::milliseconds FILE_IO_RING_DRAIN_TIMEOUT(500);
+
+    X11AsyncFileIO::X11AsyncFileIO()
+        : m_NextHandle(INVALID_FILE_REQUEST + 1),
+          m_Running(false),
+          m_Started(false),
+          m_UsingRing(false),
+          m_Ring(-1),
+          m_WakeEvent(-1),
+          m_WakeValue(0),
+          m_SubmissionRing(nullptr),
+          m_SubmissionRingSize(0),
+          m_CompletionRing(nullptr),
+          m_CompletionRingSize(0),
+          m_Submissions(nullptr),
+          m_SubmissionsSize(0),
+          m_SubmissionTail(nullptr),
+          m_SubmissionMask(nullptr),
+          m_SubmissionArray(nullptr),
+          m_CompletionHead(nullptr),
+          m_CompletionTail(nullptr),
+          m_CompletionMask(nullptr),
+          m_Completions(nullptr),
+          m_ToSubmit(0)
+    {
+    }
+
+    X11AsyncFileIO::~X11AsyncFileIO()
+    {
+        Destroy();
+
+        for (Request *request : m_Completed)
+        {
+            delete request;
+        }
+    }
+
+    void X11AsyncFileIO::Destroy()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (!m_Started)
+            {
+                return;
+            }
+
+            m_Running.store(false, std::memory_order_release);
+
+            //  Dropped before anyone is woken, so the threads only finish the reads they already started
+            for (std::deque<Request *> &pending : m_Pending)
+            {
+                for (Request *request : pending)
+                {
+                    //  Reads handed over by a failed ring are queued with their file still open
+                    if (request->Descriptor >= 0)
+                    {
+                        close(request->Descriptor);
+                    }
+
+                    m_Requests.erase(request->Handle);
+                    delete request;
+                }
+
+                pending.clear();
+            }
+        }
+
+        m_PendingCondition.notify_all();
+
+        if (m_WakeEvent >= 0)
+        {
+            _WakeRing();
+        }
+
+        for (std::thread &thread : m_Threads)
+        {
+            thread.join();
+        }
+
+        m_Threads.clear();
+
+        _DestroyRing();
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        m_Started = false;
+        m_FinishedCondition.notify_all();
+    }
+
+    void X11AsyncFileIO::_Start()
+    {
+        m_Running.store(true, std::memory_order_release);
+
+        m_UsingRing = _InitializeRing();
+
+        if (m_UsingRing)
+        {
+            m_Threads.emplace_back(&X11AsyncFileIO::_RingMain, this);
+
+            LOG_DEBUG("X11AsyncFileIO using io_uring\n");
+        }
+        else
+        {
+            _StartWorkers();
+
+            LOG_DEBUG("X11AsyncFileIO using worker threads\n");
+        }
+
+        m_Started = true;
+    }
+
+    void X11AsyncFileIO::_StartWorkers()
+    {
+        for (uint32_t i = 0; i < FILE_IO_WORKER_COUNT; ++i)
+        {
+            m_Threads.emplace_back(&X11AsyncFileIO::_WorkerMain, this);
+        }
+    }
+
+    bool X11AsyncFileIO::IsUsingRing() const
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        return m_UsingRing;
+    }
+
+    FileRequestHandle X11AsyncFileIO::Read(const String &path, FileReadCallback callback, FileRequestPriority priority,
+                                           FileSourceFunction source)
+    {
+        Request *request = new Request();
+        request->Path = path;
+        request->Callback = std::move(callback);
+        request->Priority = priority < FilePriorityCount ? priority : FilePriorityHigh;
+        request->Source = std::move(source);
+        request->Descriptor = -1;
+        request->Offset = 0;
+        request->Result.Success = false;
+        request->Finished = false;
+
+        FileRequestHandle handle;
+        bool usingRing;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            if (!m_Started)
+            {
+                _Start();
+            }
+
+            handle = m_NextHandle++;
+            request->Handle = handle;
+            request->Result.Handle = handle;
+
+            if (m_NextHandle == INVALID_FILE_REQUEST)
+            {
+                ++m_NextHandle;
+            }
+
+            m_Requests[request->Handle] = request;
+            m_Pending[request->Priority].push_back(request);
+            usingRing = m_UsingRing;
+        }
+
+        //  A ring that fails right now still leaves the request queued for the workers it starts
+        if (usingRing)
+        {
+            _WakeRing();
+        }
+        else
+        {
+            m_PendingCondition.notify_one();
+        }
+
+        //  The request may already be finished and dispatched by now
+        return handle;
+    }
+
+    bool X11AsyncFileIO::Cancel(FileRequestHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it = m_Requests.find(handle);
+
+        if (it == m_Requests.end())
+        {
+            return false;
+        }
+
+        std::deque<Request *> &pending = m_Pending[it->second->Priority];
+
+        for (auto request = pending.begin(); request != pending.end(); ++request)
+        {
+            if (*request == it->second)
+            {
+                if (it->second->Descriptor >= 0)
+                {
+                    close(it->second->Descriptor);
+                }
+
+                pending.erase(request);
+                delete it->second;
+                m_Requests.erase(it);
+
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    bool X11AsyncFileIO::IsFinished(FileRequestHandle handle)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        auto it = m_Requests.find(handle);
+
+        return it == m_Requests.end() || it->second->Finished;
+    }
+
+    void X11AsyncFileIO::Wait(FileRequestHandle handle)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+
+            m_FinishedCondition.wait(lock, [this, handle]() {
+                auto it = m_Requests.find(handle);
+
+                return it == m_Requests.end() || it->second->Finished;
+            });
+        }
+
+        DispatchCompletions();
+    }
+
+    uint32_t X11AsyncFileIO::DispatchCompletions()
+    {
+        std::vector<Request *> completed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            completed.swap(m_Completed);
+
+            for (Request *request : completed)
+            {
+                m_Requests.erase(request->Handle);
+            }
+        }
+
+        for (Request *request : completed)
+        {
+            if (request->Callback)
+            {
+                request->Callback(request->Result);
+            }
+
+            delete request;
+        }
+
+        return (uint32_t)completed.size();
+    }
+
+    X11AsyncFileIO::Request *X11AsyncFileIO::_PopPending(bool block)
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+
+        while (true)
+        {
+            for (int priority = FilePriorityCount - 1; priority >= 0; --priority)
+            {
+                if (!m_Pending[priority].empty())
+                {
+                    Request *request = m_Pending[priority].front();
+                    m_Pending[priority].pop_front();
+
+                    return request;
+                }
+            }
+
+            if (!block || !m_Running.load(std::memory_order_acquire))
+            {
+                return nullptr;
+            }
+
+            m_PendingCondition.wait(lock);
+        }
+    }
+
+    bool X11AsyncFileIO::_Open(Request *request)
+    {
+        //  Sources produce the whole file right here, the request is then complete without any read of its own
+        if (request->Source)
+        {
+            if (!request->Source(request->Result.Data))
+            {
+                LOG_ERROR_FMT_F("Failed to read file: {}\n", request->Path);
+
+                return false;
+            }
+
+            request->Offset = request->Result.Data.size();
+
+            return true;
+        }
+
+        request->Descriptor = open(request->Path.GetData(), O_RDONLY | O_CLOEXEC);
+
+        if (request->Descriptor < 0)
+        {
+            LOG_ERROR_FMT_F("Failed to open file: {}\n", request->Path);
+
+            return false;
+        }
+
+        struct stat status;
+
+        if (fstat(request->Descriptor, &status) != 0)
+        {
+            LOG_ERROR_FMT_F("Failed to stat file: {}\n", request->Path);
+
+            return false;
+        }
+
+        request->Result.Data.resize((size_t)status.st_size);
+
+        return true;
+    }
+
+    void X11AsyncFileIO::_Complete(Request *request, bool success)
+    {
+        if (request->Descriptor >= 0)
+        {
+            close(request->Descriptor);
+            request->Descriptor = -1;
+        }
+
+        if (!success)
+        {
+            request->Result.Data.clear();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            request->Result.Success = success;
+            request->Finished = true;
+            m_Completed.push_back(request);
+        }
+
+        m_FinishedCondition.notify_all();
+    }
+
+    void X11AsyncFileIO::_WorkerMain()
+    {
+        //  The data read here is handed to the caller, it is still charged to Platform
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        while (Request *request = _PopPending(true))
+        {
+            //  Reads handed over by a failed ring keep their descriptor and the bytes read so far
+            bool success = request->Descriptor >= 0 || _Open(request);
+            std::vector<uint8_t> &data = request->Result.Data;
+
+            while (success && request->Offset < data.size())
+            {
+                const ssize_t count = pread(request->Descriptor, data.data() + request->Offset,
+                                            data.size() - request->Offset, (off_t)request->Offset);
+
+                if (count < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+
+                success = count > 0;
+                request->Offset += count > 0 ? (size_t)count : 0;
+            }
+
+            _Complete(request, success);
+        }
+    }
+
+    bool X11AsyncFileIO::_InitializeRing()
+    {
+#if BUILD_ENABLE_IO_URING && defined(__NR_io_uring_setup)
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+
+        m_Ring = (int)syscall(__NR_io_uring_setup, FILE_IO_RING_ENTRIES, &params);
+
+        if (m_Ring < 0)
+        {
+            return false;
+        }
+
+        m_WakeEvent = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+        m_SubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_CompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        m_SubmissionsSize = params.sq_entries * sizeof(io_uring_sqe);
+
+        //  Newer kernels share one mapping between both rings
+        if (params.features & IORING_FEAT_SINGLE_MMAP)
+        {
+            m_SubmissionRingSize =
+                m_SubmissionRingSize > m_CompletionRingSize ? m_SubmissionRingSize : m_CompletionRingSize;
+            m_CompletionRingSize = 0;
+        }
+
+        m_SubmissionRing = mmap(nullptr, m_SubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                m_Ring, IORING_OFF_SQ_RING);
+        m_SubmissionRing = m_SubmissionRing != MAP_FAILED ? m_SubmissionRing : nullptr;
+
+        m_CompletionRing = m_CompletionRingSize > 0
+                               ? mmap(nullptr, m_CompletionRingSize, PROT_READ | PROT_WRITE,
+                                      MAP_SHARED | MAP_POPULATE, m_Ring, IORING_OFF_CQ_RING)
+                               : m_SubmissionRing;
+        m_CompletionRing = m_CompletionRing != MAP_FAILED ? m_CompletionRing : nullptr;
+
+        void *submissions = mmap(nullptr, m_SubmissionsSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                 m_Ring, IORING_OFF_SQES);
+        m_Submissions = submissions != MAP_FAILED ? static_cast<io_uring_sqe *>(submissions) : nullptr;
+
+        if (m_WakeEvent < 0 || !m_SubmissionRing || !m_CompletionRing || !m_Submissions)
+        {
+            _DestroyRing();
+
+            return false;
+        }
+
+        uint8_t *submissionRing = static_cast<uint8_t *>(m_SubmissionRing);
+        uint8_t *completionRing = static_cast<uint8_t *>(m_CompletionRing);
+
+        m_SubmissionTail = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.tail);
+        m_SubmissionMask = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.ring_mask);
+        m_SubmissionArray = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.array);
+        m_CompletionHead = reinterpret_cast<unsigned *>(completionRing + params.cq_off.head);
+        m_CompletionTail = reinterpret_cast<unsigned *>(completionRing + params.cq_off.tail);
+        m_CompletionMask = reinterpret_cast<unsigned *>(completionRing + params.cq_off.ring_mask);
+        m_Completions = reinterpret_cast<io_uring_cqe *>(completionRing + params.cq_off.cqes);
+        m_ToSubmit = 0;
+
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void X11AsyncFileIO::_DestroyRing()
+    {
+        if (m_Submissions)
+        {
+            munmap(m_Submissions, m_SubmissionsSize);
+        }
+
+        if (m_CompletionRing && m_CompletionRing != m_SubmissionRing)
+        {
+            munmap(m_CompletionRing, m_CompletionRingSize);
+        }
+
+        if (m_SubmissionRing)
+        {
+            munmap(m_SubmissionRing, m_SubmissionRingSize);
+        }
+
+        if (m_WakeEvent >= 0)
+        {
+            close(m_WakeEvent);
+        }
+
+        if (m_Ring >= 0)
+        {
+            close(m_Ring);
+        }
+
+        m_Submissions = nullptr;
+        m_CompletionRing = nullptr;
+        m_SubmissionRing = nullptr;
+        m_WakeEvent = -1;
+        m_Ring = -1;
+    }
+
+    void X11AsyncFileIO::_Push(const io_uring_sqe &submission)
+    {
+        //  Only this thread produces, the kernel consumes. In-flight reads are capped below the ring size, so the
+        //  ring can not overflow.
+        const unsigned tail = *m_SubmissionTail;
+        const unsigned index = tail & *m_SubmissionMask;
+
+        m_Submissions[index] = submission;
+        m_SubmissionArray[index] = index;
+
+        __atomic_store_n(m_SubmissionTail, tail + 1, __ATOMIC_RELEASE);
+        ++m_ToSubmit;
+    }
+
+    void X11AsyncFileIO::_SubmitRead(Request *request)
+    {
+        std::vector<uint8_t> &data = request->Result.Data;
+
+        request->Vector.iov_base = data.data() + request->Offset;
+        request->Vector.iov_len = data.size() - request->Offset;
+
+        //  READV instead of READ keeps kernels from 5.1 on supported
+        io_uring_sqe submission;
+        memset(&submission, 0, sizeof(submission));
+        submission.opcode = IORING_OP_READV;
+        submission.fd = request->Descriptor;
+        submission.addr = (uint64_t)(uintptr_t)&request->Vector;
+        submission.len = 1;
+        submission.off = request->Offset;
+        submission.user_data = (uint64_t)(uintptr_t)request;
+
+        _Push(submission);
+    }
+
+    void X11AsyncFileIO::_SubmitWakePoll()
+    {
+        //  Completes when Read or Destroy write the event, user data 0 tells it apart from reads
+        io_uring_sqe submission;
+        memset(&submission, 0, sizeof(submission));
+        submission.opcode = IORING_OP_POLL_ADD;
+        submission.fd = m_WakeEvent;
+        submission.poll_events = POLLIN;
+        submission.user_data = 0;
+
+        _Push(submission);
+    }
+
+    void X11AsyncFileIO::_WakeRing()
+    {
+        const uint64_t wake = 1;
+
+        //  EAGAIN means the counter is about to overflow, the event is readable then anyway
+        if (write(m_WakeEvent, &wake, sizeof(wake)) < 0 && errno != EAGAIN)
+        {
+            LOG_ERROR_FMT_F("Can not signal the wake event: {}\n", strerror(errno));
+        }
+    }
+
+    void X11AsyncFileIO::_RingMain()
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+#if defined(__NR_io_uring_enter)
+        _SubmitWakePoll();
+
+        while (m_Running.load(std::memory_order_acquire) || !m_InFlight.empty())
+        {
+            while (m_InFlight.size() < FILE_IO_MAX_IN_FLIGHT && m_Running.load(std::memory_order_acquire))
+            {
+                Request *request = _PopPending(false);
+
+                if (!request)
+                {
+                    break;
+                }
+
+                //  open and fstat are cheap next to the read itself and stay synchronous, so do sources
+                const bool opened = _Open(request);
+
+                if (!opened || request->Offset >= request->Result.Data.size())
+                {
+                    _Complete(request, opened);
+
+                    continue;
+                }
+
+                _SubmitRead(request);
+                m_InFlight.push_back(request);
+            }
+
+            const int submitted =
+                (int)syscall(__NR_io_uring_enter, m_Ring, m_ToSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+
+            if (submitted < 0)
+            {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                {
+                    continue;
+                }
+
+                LOG_ERROR_FMT_F("io_uring_enter failed: {}, falling back to worker threads\n", strerror(errno));
+
+                _FallBackToWorkers();
+
+                return;
+            }
+
+            m_ToSubmit -= (uint32_t)submitted;
+
+            _ReapCompletions(true);
+        }
+#endif
+    }
+
+    void X11AsyncFileIO::_ReapCompletions(bool resubmit)
+    {
+        unsigned head = *m_CompletionHead;
+        const unsigned tail = __atomic_load_n(m_CompletionTail, __ATOMIC_ACQUIRE);
+
+        for (; head != tail; ++head)
+        {
+            const io_uring_cqe &completion = m_Completions[head & *m_CompletionMask];
+            Request *request = reinterpret_cast<Request *>((uintptr_t)completion.user_data);
+
+            if (!request)
+            {
+                //  Resets the counter, EAGAIN only means an earlier completion already did
+                if (read(m_WakeEvent, &m_WakeValue, sizeof(m_WakeValue)) < 0 && errno != EAGAIN)
+                {
+                    LOG_ERROR_FMT_F("Can not reset the wake event: {}\n", strerror(errno));
+                }
+
+                if (resubmit && m_Running.load(std::memory_order_acquire))
+                {
+                    _SubmitWakePoll();
+                }
+
+                continue;
+            }
+
+            if (completion.res > 0)
+            {
+                request->Offset += (size_t)completion.res;
+            }
+
+            //  Interrupted or short read, the rest still has to be read
+            const bool unfinished = completion.res == -EINTR || completion.res == -EAGAIN ||
+                                    (completion.res > 0 && request->Offset < request->Result.Data.size());
+
+            if (unfinished && resubmit)
+            {
+                _SubmitRead(request);
+
+                continue;
+            }
+
+            m_InFlight.erase(std::find(m_InFlight.begin(), m_InFlight.end(), request));
+
+            if (unfinished)
+            {
+                //  The workers continue from the current offset
+                std::lock_guard<std::mutex> lock(m_Mutex);
+
+                m_Pending[request->Priority].push_front(request);
+
+                continue;
+            }
+
+            _Complete(request, completion.res > 0);
+        }
+
+        __atomic_store_n(m_CompletionHead, head, __ATOMIC_RELEASE);
+    }
+
+    void X11AsyncFileIO::_FallBackToWorkers()
+    {
+        std::vector<Request *> handOver;
+
+        //  The last m_ToSubmit entries never reached the kernel, their reads can move on right away
+        const unsigned tail = *m_SubmissionTail;
+
+        for (unsigned entry = tail - m_ToSubmit; entry != tail; ++entry)
+        {
+            const io_uring_sqe &submission = m_Submissions[entry & *m_SubmissionMask];
+            Request *request = reinterpret_cast<Request *>((uintptr_t)submission.user_data);
+
+            if (request)
+            {
+                m_InFlight.erase(std::find(m_InFlight.begin(), m_InFlight.end(), request));
+                handOver.push_back(request);
+            }
+        }
+
+        m_ToSubmit = 0;
+
+        //  Reads already in the kernel still complete into the mapped completion ring. Waiting for them keeps the
+        //  kernel and a worker from filling the same buffer.
+        const std::chrono::steady_clock::time_point deadline =
+            std::chrono::steady_clock::now() + FILE_IO_RING_DRAIN_TIMEOUT;
+
+        _ReapCompletions(false);
+
+        while (!m_InFlight.empty() && std::chrono::steady_clock::now() < deadline)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            _ReapCompletions(false);
+        }
+
+        if (!m_InFlight.empty())
+        {
+            LOG_WARNING_FMT_F("{} reads did not come back from io_uring, handing them on anyway\n",
+                              (uint32_t)m_InFlight.size());
+        }
+
+        handOver.insert(handOver.end(), m_InFlight.begin(), m_InFlight.end());
+        m_InFlight.clear();
+
+        std::vector<Request *> failed;
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            m_UsingRing = false;
+
+            for (Request *request : handOver)
+            {
+                m_Pending[request->Priority].push_front(request);
+            }
+
+            //  Destroy dropped the queue and joins the threads it saw, no new worker may start after that
+            if (m_Running.load(std::memory_order_acquire))
+            {
+                _StartWorkers();
+            }
+            else
+            {
+                for (std::deque<Request *> &pending : m_Pending)
+                {
+                    failed.insert(failed.end(), pending.begin(), pending.end());
+                    pending.clear();
+                }
+            }
+        }
+
+        //  Wait must not block on a request nobody reads anymore
+        for (Request *request : failed)
+        {
+            _Complete(request, false);
+        }
+
+        m_PendingCondition.notify_all();
+    }
+}  // namespace aga
@@ -0,0 +1,120 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "platform/PlatformFileSystem.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <sys/uio.h>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace aga
+{
+    //  Background file reads for X11PlatformFileSystem. With io_uring a single thread keeps many reads in flight
+    //  and sleeps in the kernel until one completes. Where the kernel or a sandbox refuses io_uring, a few worker
+    //  threads read with blocking pread calls instead.
+    class X11AsyncFileIO
+    {
+    public:
+        X11AsyncFileIO();
+        ~X11AsyncFileIO();
+
+        X11AsyncFileIO(const X11AsyncFileIO &) = delete;
+        void operator=(const X11AsyncFileIO &) = delete;
+
+        void Destroy();
+
+        //  With a source given, it is called on an I/O thread instead of reading the native 'path'
+        FileRequestHandle Read(const String &path, FileReadCallback callback, FileRequestPriority priority,
+                               FileSourceFunction source = nullptr);
+        bool Cancel(FileRequestHandle handle);
+        bool IsFinished(FileRequestHandle handle);
+        void Wait(FileRequestHandle handle);
+        uint32_t DispatchCompletions();
+
+        bool IsUsingRing() const;
+
+    private:
+        struct Request
+        {
+            FileRequestHandle Handle;
+            String Path;
+            FileReadCallback Callback;
+            FileRequestPriority Priority;
+            FileSourceFunction Source;
+            int Descriptor;
+            size_t Offset;
+            struct iovec Vector;
+            FileReadResult Result;
+            bool Finished;
+        };
+
+        void _Start();
+        //  Called with m_Mutex held
+        void _StartWorkers();
+        bool _InitializeRing();
+        void _DestroyRing();
+
+        Request *_PopPending(bool block);
+        bool _Open(Request *request);
+        void _Complete(Request *request, bool success);
+
+        void _WorkerMain();
+
+        void _RingMain();
+        //  Handles what the kernel completed so far. Unfinished reads are submitted again, or handed to the worker
+        //  threads when 'resubmit' is false.
+        void _ReapCompletions(bool resubmit);
+        //  After io_uring stopped working, moves every read of the ring thread to the worker threads
+        void _FallBackToWorkers();
+        void _Push(const io_uring_sqe &submission);
+        void _SubmitRead(Request *request);
+        void _SubmitWakePoll();
+        //  Makes the wake-up poll complete
+        void _WakeRing();
+
+    private:
+        mutable std::mutex m_Mutex;
+        std::condition_variable m_PendingCondition;
+        std::condition_variable m_FinishedCondition;
+
+        std::deque<Request *> m_Pending[FilePriorityCount];
+        std::vector<Request *> m_Completed;
+        std::unordered_map<FileRequestHandle, Request *> m_Requests;
+        FileRequestHandle m_NextHandle;
+
+        std::vector<std::thread> m_Threads;
+        std::atomic<bool> m_Running;
+        bool m_Started;
+        //  Guarded by m_Mutex, cleared when a failing ring hands its reads to the worker threads
+        bool m_UsingRing;
+
+        //  io_uring state, only touched by the ring thread after _InitializeRing
+        int m_Ring;
+        int m_WakeEvent;
+        uint64_t m_WakeValue;
+        void *m_SubmissionRing;
+        size_t m_SubmissionRingSize;
+        void *m_CompletionRing;
+        size_t m_CompletionRingSize;
+        io_uring_sqe *m_Submissions;
+        size_t m_SubmissionsSize;
+        unsigned *m_SubmissionTail;
+        unsigned *m_SubmissionMask;
+        unsigned *m_SubmissionArray;
+        unsigned *m_CompletionHead;
+        unsigned *m_CompletionTail;
+        unsigned *m_CompletionMask;
+        io_uring_cqe *m_Completions;
+        uint32_t m_ToSubmit;
+        std::vector<Request *> m_InFlight;
+    };
+}  // namespace aga
@@ -0,0 +1,175 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "X11FileWatcher.h"
+#include "core/FrameAllocator.h"
+#include "core/Logger.h"
+
+#include <cerrno>
+#include <cstring>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+namespace aga
+{
+    //  Editors write a file in bursts of events, a change is reported once this much time passed since the last one
+    const std::chrono::milliseconds FILE_WATCH_DEBOUNCE(100);
+
+    const uint32_t FILE_WATCH_EVENTS = IN_CLOSE_WRITE | IN_MOVED_TO;
+
+    X11FileWatcher::X11FileWatcher() : m_Descriptor(-1), m_NextHandle(INVALID_FILE_WATCH + 1)
+    {
+    }
+
+    X11FileWatcher::~X11FileWatcher()
+    {
+        Destroy();
+    }
+
+    void X11FileWatcher::Destroy()
+    {
+        if (m_Descriptor >= 0)
+        {
+            close(m_Descriptor);
+            m_Descriptor = -1;
+        }
+
+        m_Watches.clear();
+    }
+
+    FileWatchHandle X11FileWatcher::Watch(const String &nativePath, const String &path, FileChangeCallback callback)
+    {
+        if (m_Descriptor < 0)
+        {
+            m_Descriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+            if (m_Descriptor < 0)
+            {
+                LOG_ERROR_FMT_F("inotify_init1 failed: {}\n", strerror(errno));
+
+                return INVALID_FILE_WATCH;
+            }
+        }
+
+        const char *separator = strrchr(nativePath.GetData(), '/');
+        const int slash = separator ? (int)(separator - nativePath.GetData()) : -1;
+        const String directory = slash > 0 ? String(nativePath.GetData(), slash) : String(slash == 0 ? "/" : ".");
+        const String name = slash >= 0 ? String(nativePath.GetData() + slash + 1) : nativePath;
+
+        //  Watching a directory twice returns the same descriptor, files of one directory share it
+        const int watch = inotify_add_watch(m_Descriptor, directory.GetData(), FILE_WATCH_EVENTS);
+
+        if (watch < 0)
+        {
+            LOG_ERROR_FMT_F("Failed to watch {}: {}\n", directory, strerror(errno));
+
+            return INVALID_FILE_WATCH;
+        }
+
+        FileWatch fileWatch;
+        fileWatch.Handle = m_NextHandle++;
+        fileWatch.Directory = watch;
+        fileWatch.Name = name;
+        fileWatch.Path = path;
+        fileWatch.Callback = std::move(callback);
+        fileWatch.IsChanged = false;
+
+        m_Watches.push_back(std::move(fileWatch));
+
+        return m_Watches.back().Handle;
+    }
+
+    void X11FileWatcher::Unwatch(FileWatchHandle handle)
+    {
+        for (auto it = m_Watches.begin(); it != m_Watches.end(); ++it)
+        {
+            if (it->Handle != handle)
+            {
+                continue;
+            }
+
+            const int directory = it->Directory;
+            m_Watches.erase(it);
+
+            for (const FileWatch &fileWatch : m_Watches)
+            {
+                if (fileWatch.Directory == directory)
+                {
+                    return;
+                }
+            }
+
+            inotify_rm_watch(m_Descriptor, directory);
+
+            return;
+        }
+    }
+
+    uint32_t X11FileWatcher::Dispatch()
+    {
+        if (m_Descriptor < 0)
+        {
+            return 0;
+        }
+
+        _ReadEvents();
+
+        const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        //  Callbacks may add or remove watches, they run after the list was walked
+        FrameVector<std::pair<FileChangeCallback, String>> changed;
+
+        for (FileWatch &fileWatch : m_Watches)
+        {
+            if (fileWatch.IsChanged && now - fileWatch.LastChange >= FILE_WATCH_DEBOUNCE)
+            {
+                fileWatch.IsChanged = false;
+                changed.emplace_back(fileWatch.Callback, fileWatch.Path);
+            }
+        }
+
+        for (auto &change : changed)
+        {
+            change.first(change.second);
+        }
+
+        return (uint32_t)changed.size();
+    }
+
+    void X11FileWatcher::_ReadEvents()
+    {
+        alignas(struct inotify_event) char buffer[4096];
+
+        while (true)
+        {
+            const ssize_t length = read(m_Descriptor, buffer, sizeof(buffer));
+
+            if (length <= 0)
+            {
+                //  EAGAIN once the queue is drained
+                return;
+            }
+
+            const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+            for (ssize_t offset = 0; offset < length;)
+            {
+                const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(buffer + offset);
+                offset += sizeof(struct inotify_event) + event->len;
+
+                if (event->len == 0)
+                {
+                    continue;
+                }
+
+                for (FileWatch &fileWatch : m_Watches)
+                {
+                    if (fileWatch.Directory == event->wd && strcmp(fileWatch.Name.GetData(), event->name) == 0)
+                    {
+                        fileWatch.IsChanged = true;
+                        fileWatch.LastChange = now;
+                    }
+                }
+            }
+        }
+    }
+}  // namespace aga
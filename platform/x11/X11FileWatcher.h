@@ -0,0 +1,52 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "platform/PlatformFileSystem.h"
+
+#include <chrono>
+#include <vector>
+
+namespace aga
+{
+    //  File change notifications for X11PlatformFileSystem through inotify. The directory of each watched file is
+    //  watched instead of the file, editors often save by writing a new file and renaming it over the old one.
+    //  Not thread-safe, everything runs on the thread calling Dispatch.
+    class X11FileWatcher
+    {
+    public:
+        X11FileWatcher();
+        ~X11FileWatcher();
+
+        X11FileWatcher(const X11FileWatcher &) = delete;
+        void operator=(const X11FileWatcher &) = delete;
+
+        void Destroy();
+
+        //  'nativePath' is watched, 'path' is handed to the callback
+        FileWatchHandle Watch(const String &nativePath, const String &path, FileChangeCallback callback);
+        void Unwatch(FileWatchHandle handle);
+
+        //  Reads pending events and runs the callbacks of files that stayed quiet for the debounce interval
+        uint32_t Dispatch();
+
+    private:
+        struct FileWatch
+        {
+            FileWatchHandle Handle;
+            int Directory;
+            String Name;
+            String Path;
+            FileChangeCallback Callback;
+            bool IsChanged;
+            std::chrono::steady_clock::time_point LastChange;
+        };
+
+        void _ReadEvents();
+
+    private:
+        int m_Descriptor;
+        std::vector<FileWatch> m_Watches;
+        FileWatchHandle m_NextHandle;
+    };
+}  // namespace aga
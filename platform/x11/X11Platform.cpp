@@ -1,6 +1,15 @@
 // Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
 
 #include "X11Platform.h"
+#include "core/Logger.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
 
 namespace aga
 {
@@ -24,4 +33,78 @@ namespace aga
 
         return extensions;
     }
-}  // namespace aga
\ No newline at end of file
+
+    bool X11Platform::RunProcess(const std::vector<String> &arguments, std::vector<uint8_t> &output)
+    {
+        output.clear();
+
+        if (arguments.empty())
+        {
+            return false;
+        }
+
+        std::vector<char *> argv;
+
+        for (const String &argument : arguments)
+        {
+            argv.push_back(const_cast<char *>(argument.GetData()));
+        }
+
+        argv.push_back(nullptr);
+
+        int pipeDescriptors[2];
+
+        if (pipe2(pipeDescriptors, O_CLOEXEC) != 0)
+        {
+            return false;
+        }
+
+        //  The child writes its standard output into the pipe, the close-on-exec read end stays with us
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, pipeDescriptors[1], STDOUT_FILENO);
+
+        pid_t process;
+        const int error = posix_spawnp(&process, argv[0], &actions, nullptr, argv.data(), environ);
+
+        posix_spawn_file_actions_destroy(&actions);
+        close(pipeDescriptors[1]);
+
+        if (error != 0)
+        {
+            LOG_ERROR_FMT_F("Failed to run {}: {}\n", arguments[0], strerror(error));
+            close(pipeDescriptors[0]);
+
+            return false;
+        }
+
+        uint8_t buffer[4096];
+
+        while (true)
+        {
+            const ssize_t count = read(pipeDescriptors[0], buffer, sizeof(buffer));
+
+            if (count < 0 && errno == EINTR)
+            {
+                continue;
+            }
+
+            if (count <= 0)
+            {
+                break;
+            }
+
+            output.insert(output.end(), buffer, buffer + count);
+        }
+
+        close(pipeDescriptors[0]);
+
+        int status = 0;
+
+        while (waitpid(process, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+
+        return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    }
+}  // namespace aga
@@ -15,5 +15,7 @@ namespace aga
         void Initialize() override;
 
         std::vector<const char *> GetRequiredExtensions() override;
+
+        bool RunProcess(const std::vector<String> &arguments, std::vector<uint8_t> &output) override;
     };
 }  // namespace aga
@@ -1,40 +1,323 @@
 // Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
 
 #include "X11PlatformFileSystem.h"
+#include "core/AssetArchive.h"
 #include "core/Logger.h"
+#include "core/Memory.h"
 #include "core/Macros.h"
 #include "platform/Platform.h"
 
-#include <fstream>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace aga
 {
     String X11PlatformFileSystem::ReadEntireFileTextMode(const String &path)
     {
-        return "";
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        MappedFile file;
+
+        if (!MapFile(path, file, FileAccessSequential))
+        {
+            return "";
+        }
+
+        //  Line endings are turned into '\n', so files saved on Windows read the same
+        std::vector<char> text;
+        text.reserve(file.GetSize() + 1);
+
+        const char *data = reinterpret_cast<const char *>(file.GetData());
+
+        for (size_t i = 0; i < file.GetSize(); ++i)
+        {
+            if (data[i] != '\r' || i + 1 == file.GetSize() || data[i + 1] != '\n')
+            {
+                text.push_back(data[i]);
+            }
+        }
+
+        return String(text.data(), (uint32_t)text.size());
     }
 
-    String X11PlatformFileSystem::ReadEntireFileBinaryMode(const String &path)
+    bool X11PlatformFileSystem::MapFile(const String &path, MappedFile &file, FileAccessHint hint)
     {
-        std::ifstream file(path, std::ios::ate | std::ios::binary);
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        file.Close();
+
+        FileLocation location;
 
-        if (!file.is_open())
+        if (!ResolvePath(path, location))
         {
-            LOG_ERROR_F("Failed to open file: " + path + "\n");
+            LOG_ERROR_FMT_F("Failed to find file: {}\n", path);
 
-            return "";
+            return false;
         }
 
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<char> buffer(fileSize);
+        if (location.Type == MountTypeArchive)
+        {
+            return _CopyFromArchive(*location.Archive, location.Entry, file);
+        }
 
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
+        if (location.Type == MountTypeMemory)
+        {
+            file.m_Shared = location.Data;
+            file.m_Data = file.m_Shared->empty() ? nullptr : file.m_Shared->data();
+            file.m_Size = file.m_Shared->size();
+            file.m_IsOpen = true;
 
-        String result(buffer);
+            return true;
+        }
 
-        return result;
+        return _MapNativeFile(location.NativePath, file, hint);
     }
 
+    bool X11PlatformFileSystem::_MapNativeFile(const String &path, MappedFile &file, FileAccessHint hint)
+    {
+        const int descriptor = open(path.GetData(), O_RDONLY | O_CLOEXEC);
+
+        if (descriptor < 0)
+        {
+            LOG_ERROR_FMT_F("Failed to open file: {}\n", path);
+
+            return false;
+        }
+
+        struct stat status;
+
+        if (fstat(descriptor, &status) != 0)
+        {
+            LOG_ERROR_FMT_F("Failed to stat file: {}\n", path);
+            close(descriptor);
+
+            return false;
+        }
+
+        void *data = nullptr;
+
+        //  mmap refuses empty ranges, an empty file is open without data
+        if (status.st_size > 0)
+        {
+            data = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+
+            if (data == MAP_FAILED)
+            {
+                LOG_ERROR_FMT_F("Failed to map file: {}\n", path);
+                close(descriptor);
+
+                return false;
+            }
+
+            const int advice[] = {MADV_NORMAL, MADV_SEQUENTIAL, MADV_RANDOM};
+            madvise(data, (size_t)status.st_size, advice[hint]);
+        }
+
+        //  The mapping keeps its own reference to the file
+        close(descriptor);
+
+        file.m_Data = static_cast<const uint8_t *>(data);
+        file.m_Size = (size_t)status.st_size;
+        file.m_IsOpen = true;
+
+        return true;
+    }
+
+    void X11PlatformFileSystem::UnmapFile(MappedFile &file)
+    {
+        if (file.m_Shared)
+        {
+            file.m_Shared.reset();
+        }
+        else if (file.m_IsCopy)
+        {
+            delete[] file.m_Data;
+        }
+        else if (file.m_Data)
+        {
+            munmap(const_cast<uint8_t *>(file.m_Data), file.m_Size);
+        }
+
+        file.m_Data = nullptr;
+        file.m_Size = 0;
+        file.m_IsOpen = false;
+        file.m_IsCopy = false;
+    }
+
+    bool X11PlatformFileSystem::_CopyFromArchive(const AssetArchive &archive, uint32_t entry, MappedFile &file)
+    {
+        const size_t size = (size_t)archive.GetEntrySize(entry);
+        uint8_t *data = size > 0 ? new uint8_t[size] : nullptr;
+
+        if (!archive.Read(entry, data))
+        {
+            LOG_ERROR_FMT_F("Failed to read {} from archive {}\n", archive.GetEntryName(entry), archive.GetPath());
+            delete[] data;
+
+            return false;
+        }
+
+        file.m_Data = data;
+        file.m_Size = size;
+        file.m_IsOpen = true;
+        file.m_IsCopy = true;
+
+        return true;
+    }
+
+    FileRequestHandle X11PlatformFileSystem::ReadFileAsync(const String &path, FileReadCallback callback,
+                                                           FileRequestPriority priority)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        FileLocation location;
+
+        if (!ResolvePath(path, location))
+        {
+            LOG_ERROR_FMT_F("Failed to find file: {}\n", path);
+
+            return m_AsyncIO.Read(path, std::move(callback), priority, [](std::vector<uint8_t> &) { return false; });
+        }
+
+        if (location.Type == MountTypeArchive)
+        {
+            std::shared_ptr<const AssetArchive> archive = location.Archive;
+            const uint32_t entry = location.Entry;
+
+            return m_AsyncIO.Read(path, std::move(callback), priority,
+                                  [archive, entry](std::vector<uint8_t> &data) { return archive->Read(entry, data); });
+        }
+
+        if (location.Type == MountTypeMemory)
+        {
+            std::shared_ptr<const std::vector<uint8_t>> file = location.Data;
+
+            return m_AsyncIO.Read(path, std::move(callback), priority, [file](std::vector<uint8_t> &data) {
+                data = *file;
+
+                return true;
+            });
+        }
+
+        return m_AsyncIO.Read(location.NativePath, std::move(callback), priority);
+    }
+
+    FileRequestHandle X11PlatformFileSystem::ReadSourceAsync(const String &name, FileSourceFunction source,
+                                                             FileReadCallback callback, FileRequestPriority priority)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        return m_AsyncIO.Read(name, std::move(callback), priority, std::move(source));
+    }
+
+    bool X11PlatformFileSystem::CancelRequest(FileRequestHandle handle)
+    {
+        return m_AsyncIO.Cancel(handle);
+    }
+
+    bool X11PlatformFileSystem::IsRequestFinished(FileRequestHandle handle)
+    {
+        return m_AsyncIO.IsFinished(handle);
+    }
+
+    void X11PlatformFileSystem::WaitForRequest(FileRequestHandle handle)
+    {
+        m_AsyncIO.Wait(handle);
+    }
+
+    uint32_t X11PlatformFileSystem::DispatchCompletions()
+    {
+        return m_AsyncIO.DispatchCompletions();
+    }
+
+    FileWatchHandle X11PlatformFileSystem::WatchFile(const String &path, FileChangeCallback callback)
+    {
+        MemoryTagScope scope(MemoryTag::Platform);
+
+        FileLocation location;
+
+        if (!ResolvePath(path, location) || location.Type != MountTypeDirectory)
+        {
+            LOG_ERROR_FMT_F("Can not watch {}, it is not a file of a mounted directory\n", path);
+
+            return INVALID_FILE_WATCH;
+        }
+
+        return m_FileWatcher.Watch(location.NativePath, path, std::move(callback));
+    }
+
+    void X11PlatformFileSystem::UnwatchFile(FileWatchHandle handle)
+    {
+        m_FileWatcher.Unwatch(handle);
+    }
+
+    uint32_t X11PlatformFileSystem::DispatchFileChanges()
+    {
+        return m_FileWatcher.Dispatch();
+    }
+
+    void X11PlatformFileSystem::Destroy()
+    {
+        m_AsyncIO.Destroy();
+        m_FileWatcher.Destroy();
+    }
+
+    bool X11PlatformFileSystem::_IsNativeFile(const String &path)
+    {
+        struct stat status;
+
+        return stat(path.GetData(), &status) == 0 && S_ISREG(status.st_mode);
+    }
+
+    void X11PlatformFileSystem::_ListNativeFiles(const String &directory, const String &prefix,
+                                                 std::vector<String> &paths, bool recursive)
+    {
+        DIR *stream = opendir(directory.GetData());
+
+        if (!stream)
+        {
+            return;
+        }
+
+        while (struct dirent *entry = readdir(stream))
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            {
+                continue;
+            }
+
+            const String native = directory + "/" + entry->d_name;
+            const String name = prefix.Length() > 0 ? prefix + "/" + entry->d_name : String(entry->d_name);
+
+            bool isFile = entry->d_type == DT_REG;
+            bool isDirectory = entry->d_type == DT_DIR;
+
+            //  Some file systems do not fill in the type
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+            {
+                struct stat status;
+
+                if (stat(native.GetData(), &status) == 0)
+                {
+                    isFile = S_ISREG(status.st_mode);
+                    isDirectory = S_ISDIR(status.st_mode);
+                }
+            }
+
+            if (isFile)
+            {
+                paths.push_back(name);
+            }
+            else if (isDirectory && recursive)
+            {
+                _ListNativeFiles(native, name, paths, recursive);
+            }
+        }
+
+        closedir(stream);
+    }
 }  // namespace aga
\ No newline at end of file
@@ -2,6 +2,8 @@
 
 #pragma once
 
+#include "X11AsyncFileIO.h"
+#include "X11FileWatcher.h"
 #include "platform/Platform.h"
 #include "platform/PlatformFileSystem.h"
 
@@ -15,6 +17,36 @@ namespace aga
 
     public:
         String ReadEntireFileTextMode(const String &path) override;
-        String ReadEntireFileBinaryMode(const String &path) override;
+
+        bool MapFile(const String &path, MappedFile &file, FileAccessHint hint = FileAccessNormal) override;
+        void UnmapFile(MappedFile &file) override;
+
+        FileRequestHandle ReadFileAsync(const String &path, FileReadCallback callback,
+                                        FileRequestPriority priority = FilePriorityNormal) override;
+        FileRequestHandle ReadSourceAsync(const String &name, FileSourceFunction source, FileReadCallback callback,
+                                          FileRequestPriority priority = FilePriorityNormal) override;
+        bool CancelRequest(FileRequestHandle handle) override;
+        bool IsRequestFinished(FileRequestHandle handle) override;
+        void WaitForRequest(FileRequestHandle handle) override;
+        uint32_t DispatchCompletions() override;
+
+        FileWatchHandle WatchFile(const String &path, FileChangeCallback callback) override;
+        void UnwatchFile(FileWatchHandle handle) override;
+        uint32_t DispatchFileChanges() override;
+
+        void Destroy() override;
+
+    protected:
+        bool _IsNativeFile(const String &path) override;
+        void _ListNativeFiles(const String &directory, const String &prefix, std::vector<String> &paths,
+                              bool recursive) override;
+
+    private:
+        bool _MapNativeFile(const String &path, MappedFile &file, FileAccessHint hint);
+        bool _CopyFromArchive(const AssetArchive &archive, uint32_t entry, MappedFile &file);
+
+    private:
+        X11AsyncFileIO m_AsyncIO;
+        X11FileWatcher m_FileWatcher;
     };
 }  // namespace aga
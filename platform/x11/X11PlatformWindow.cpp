@@ -2,6 +2,7 @@
 
 #include "X11PlatformWindow.h"
 #include "core/Logger.h"
+#include "core/Memory.h"
 #include "platform/Platform.h"
 #include "render/VulkanRenderer.h"
 
@@ -22,6 +23,8 @@ namespace aga
 
     bool X11PlatformWindow::Initialize(const char *title, uint32_t width, uint32_t height)
     {
+        MemoryTagScope scope(MemoryTag::Platform);
+
         m_Name = title;
         m_Width = width;
         m_Height = height;
@@ -69,7 +72,7 @@ namespace aga
         value_list[1] = XCB_EVENT_MASK_KEY_RELEASE | XCB_EVENT_MASK_KEY_PRESS |
                         XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_STRUCTURE_NOTIFY |
                         XCB_EVENT_MASK_POINTER_MOTION | XCB_EVENT_MASK_BUTTON_PRESS |
-                        XCB_EVENT_MASK_BUTTON_RELEASE;
+                        XCB_EVENT_MASK_BUTTON_RELEASE | XCB_EVENT_MASK_FOCUS_CHANGE;
 
         xcb_create_window(m_XCBConnection, XCB_COPY_FROM_PARENT, m_XCBWindow, m_XCBScreen->root,
                           dimensions.offset.x, dimensions.offset.y, dimensions.extent.width,
@@ -102,7 +105,7 @@ namespace aga
                              XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y, coords);
         xcb_flush(m_XCBConnection);
 
-        LOG_INFO("Initialized X11PlatformWindow [" + String(width) + "x" + String(height) + "]\n");
+        LOG_INFO_FMT("Initialized X11PlatformWindow [{}x{}]\n", width, height);
 
         return true;
     }
@@ -119,6 +122,8 @@ namespace aga
 
     bool X11PlatformWindow::Update()
     {
+        MemoryTagScope scope(MemoryTag::Platform);
+
         xcb_generic_event_t *event;
         while ((event = xcb_poll_for_event(m_XCBConnection)))
         {
@@ -129,6 +134,24 @@ namespace aga
         return m_ShouldRun;
     }
 
+    bool X11PlatformWindow::WaitForEvents()
+    {
+        xcb_generic_event_t *event = xcb_wait_for_event(m_XCBConnection);
+
+        //  Null means the connection to the X server broke
+        if (!event)
+        {
+            m_ShouldRun = false;
+
+            return false;
+        }
+
+        _HandleEvent(event);
+        free(event);
+
+        return Update();
+    }
+
     Vector2 X11PlatformWindow::GetCurrentWindowSize()
     {
         xcb_get_geometry_reply_t *geom = xcb_get_geometry_reply(
@@ -232,6 +255,19 @@ namespace aga
             case XCB_DESTROY_NOTIFY:
                 m_ShouldRun = false;
                 break;
+            case XCB_FOCUS_IN:
+                m_IsFocused = true;
+                break;
+            case XCB_FOCUS_OUT:
+                m_IsFocused = false;
+                break;
+            //  Minimizing unmaps the window
+            case XCB_MAP_NOTIFY:
+                m_IsVisible = true;
+                break;
+            case XCB_UNMAP_NOTIFY:
+                m_IsVisible = false;
+                break;
             case XCB_CONFIGURE_NOTIFY:
             {
                 const xcb_configure_notify_event_t *cfgEvent =
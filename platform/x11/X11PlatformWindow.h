@@ -19,6 +19,7 @@ namespace aga
         bool Initialize(const char *title, uint32_t width = 1280, uint32_t height = 800) override;
         void Destroy() override;
         bool Update() override;
+        bool WaitForEvents() override;
         
         Vector2 GetCurrentWindowSize();
 
@@ -0,0 +1,647 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "VulkanMemoryAllocator.h"
+#include "core/Logger.h"
+
+#include <algorithm>
+
+namespace aga
+{
+    //  Without VK_EXT_memory_budget the process is assumed to get this much of a heap
+    const VkDeviceSize DEVICE_MEMORY_DEFAULT_BUDGET_PERCENT = 80;
+
+    VulkanMemoryAllocator::VulkanMemoryAllocator()
+        : m_PhysicalDevice(VK_NULL_HANDLE),
+          m_Device(VK_NULL_HANDLE),
+          m_MemoryProperties(),
+          m_IsMemoryBudgetEnabled(false),
+          m_IsDedicatedAllocationAvailable(false),
+          m_MemoryAllocationCount(0),
+          m_MaxMemoryAllocationCount(0)
+    {
+    }
+
+    VulkanMemoryAllocator::~VulkanMemoryAllocator()
+    {
+    }
+
+    bool VulkanMemoryAllocator::Initialize(VkPhysicalDevice physicalDevice, VkDevice device,
+                                           bool isMemoryBudgetEnabled)
+    {
+        m_PhysicalDevice = physicalDevice;
+        m_Device = device;
+        m_IsMemoryBudgetEnabled = isMemoryBudgetEnabled;
+
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+
+        //  Dedicated allocations and the *2 queries are core since 1.1
+        m_IsDedicatedAllocationAvailable = properties.apiVersion >= VK_API_VERSION_1_1;
+        m_MaxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+        m_MemoryAllocationCount = 0;
+
+        vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
+
+        m_HeapStatistics.assign(m_MemoryProperties.memoryHeapCount, DeviceHeapStatistics());
+
+        for (uint32_t i = 0; i < m_MemoryProperties.memoryHeapCount; ++i)
+        {
+            m_HeapStatistics[i].HeapSize = m_MemoryProperties.memoryHeaps[i].size;
+        }
+
+        LOG_DEBUG_FMT_F("Device memory allocator created, {} memory types in {} heaps\n",
+                        m_MemoryProperties.memoryTypeCount, m_MemoryProperties.memoryHeapCount);
+
+        return true;
+    }
+
+    void VulkanMemoryAllocator::Destroy()
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        for (uint32_t i = 0; i < m_HeapStatistics.size(); ++i)
+        {
+            if (m_HeapStatistics[i].AllocationCount > 0)
+            {
+                LOG_WARNING_FMT_F("{} allocations ({} bytes) still alive in memory heap {}\n",
+                                  m_HeapStatistics[i].AllocationCount, m_HeapStatistics[i].AllocatedBytes, i);
+            }
+        }
+
+        for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type)
+        {
+            for (uint32_t kind = 0; kind < DeviceResourceKindCount; ++kind)
+            {
+                MemoryPool &pool = m_Pools[type][kind];
+
+                for (uint32_t i = 0; i < pool.size(); ++i)
+                {
+                    if (pool[i].Memory != VK_NULL_HANDLE)
+                    {
+                        _FreeBlock(pool, type, i);
+                    }
+                }
+
+                pool.clear();
+            }
+        }
+
+        m_HeapStatistics.clear();
+        m_Device = VK_NULL_HANDLE;
+    }
+
+    bool VulkanMemoryAllocator::AllocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties,
+                                              DeviceAllocation &allocation, void *userData)
+    {
+        VkMemoryRequirements requirements = {};
+        bool isDedicated = false;
+
+        if (m_IsDedicatedAllocationAvailable)
+        {
+            VkMemoryDedicatedRequirements dedicatedRequirements = {};
+            dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+            VkMemoryRequirements2 requirements2 = {};
+            requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+            requirements2.pNext = &dedicatedRequirements;
+
+            VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+            requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+            requirementsInfo.image = image;
+
+            vkGetImageMemoryRequirements2(m_Device, &requirementsInfo, &requirements2);
+
+            requirements = requirements2.memoryRequirements;
+
+            //  Drivers ask for it on render targets they compress or place specially
+            isDedicated = dedicatedRequirements.requiresDedicatedAllocation ||
+                          dedicatedRequirements.prefersDedicatedAllocation;
+        }
+        else
+        {
+            vkGetImageMemoryRequirements(m_Device, image, &requirements);
+        }
+
+        //  Linear tiling images are laid out like buffers, next to optimal ones they would need the
+        //  bufferImageGranularity gap
+        const DeviceResourceKind kind = tiling == VK_IMAGE_TILING_LINEAR ? DeviceResourceLinear : DeviceResourceOptimal;
+
+        if (!_Allocate(requirements, properties, kind, isDedicated, image, VK_NULL_HANDLE, userData, allocation))
+        {
+            return false;
+        }
+
+        if (vkBindImageMemory(m_Device, image, allocation.Memory, allocation.Offset) != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Can't bind memory for an Image\n");
+            Free(allocation);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    bool VulkanMemoryAllocator::AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties,
+                                               DeviceAllocation &allocation, void *userData)
+    {
+        VkMemoryRequirements requirements = {};
+        bool isDedicated = false;
+
+        if (m_IsDedicatedAllocationAvailable)
+        {
+            VkMemoryDedicatedRequirements dedicatedRequirements = {};
+            dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+            VkMemoryRequirements2 requirements2 = {};
+            requirements2.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+            requirements2.pNext = &dedicatedRequirements;
+
+            VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+            requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+            requirementsInfo.buffer = buffer;
+
+            vkGetBufferMemoryRequirements2(m_Device, &requirementsInfo, &requirements2);
+
+            requirements = requirements2.memoryRequirements;
+            isDedicated = dedicatedRequirements.requiresDedicatedAllocation;
+        }
+        else
+        {
+            vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+        }
+
+        if (!_Allocate(requirements, properties, DeviceResourceLinear, isDedicated, VK_NULL_HANDLE, buffer, userData,
+                       allocation))
+        {
+            return false;
+        }
+
+        if (vkBindBufferMemory(m_Device, buffer, allocation.Memory, allocation.Offset) != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Can't bind memory for a Buffer\n");
+            Free(allocation);
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void VulkanMemoryAllocator::Free(DeviceAllocation &allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        _Free(allocation);
+    }
+
+    VkDeviceSize VulkanMemoryAllocator::Defragment(VkDeviceSize maxBytes, const DeviceMemoryMoveCallback &move)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        VkDeviceSize movedBytes = 0;
+        uint32_t movedCount = 0;
+        uint32_t freedBlocks = 0;
+
+        for (uint32_t type = 0; type < m_MemoryProperties.memoryTypeCount && movedBytes < maxBytes; ++type)
+        {
+            for (uint32_t kind = 0; kind < DeviceResourceKindCount && movedBytes < maxBytes; ++kind)
+            {
+                MemoryPool &pool = m_Pools[type][kind];
+
+                //  Emptiest blocks first, they take the fewest moves to free
+                std::vector<uint32_t> blocks;
+
+                for (uint32_t i = 0; i < pool.size(); ++i)
+                {
+                    if (pool[i].Memory != VK_NULL_HANDLE)
+                    {
+                        blocks.push_back(i);
+                    }
+                }
+
+                std::sort(blocks.begin(), blocks.end(), [&pool](uint32_t a, uint32_t b) {
+                    return pool[a].Ranges.GetUsedSize() < pool[b].Ranges.GetUsedSize();
+                });
+
+                //  The fullest block is the last one worth moving into
+                for (uint32_t i = 0; i + 1 < blocks.size() && movedBytes < maxBytes; ++i)
+                {
+                    const uint32_t source = blocks[i];
+
+                    struct Move
+                    {
+                        uint32_t Range;
+                        VkDeviceSize Offset;
+                        VkDeviceSize Size;
+                        void *UserData;
+                    };
+
+                    std::vector<Move> moves;
+                    bool isMovable = true;
+
+                    pool[source].Ranges.ForEachAllocation(
+                        [&moves, &isMovable](uint32_t range, uint64_t offset, uint64_t size, void *userData) {
+                            isMovable = isMovable && userData;
+                            moves.push_back(Move{range, offset, size, userData});
+                        });
+
+                    //  A block keeping even one resource stays, moving the rest of it out gains nothing
+                    if (!isMovable || moves.empty())
+                    {
+                        continue;
+                    }
+
+                    for (const Move &entry : moves)
+                    {
+                        if (movedBytes >= maxBytes)
+                        {
+                            break;
+                        }
+
+                        DeviceAllocation from;
+                        from.Memory = pool[source].Memory;
+                        from.Offset = entry.Offset;
+                        from.Size = entry.Size;
+                        from.Mapped = pool[source].Mapped ? pool[source].Mapped + entry.Offset : nullptr;
+                        from.MemoryType = type;
+                        from.Kind = (DeviceResourceKind)kind;
+                        from.Block = source;
+                        from.Range = entry.Range;
+
+                        VkMemoryRequirements requirements = {};
+                        requirements.size = entry.Size;
+                        requirements.alignment = pool[source].Alignments[entry.Range];
+                        requirements.memoryTypeBits = 1u << type;
+
+                        DeviceAllocation to;
+
+                        if (!_AllocateFromPool(type, (DeviceResourceKind)kind, requirements, entry.UserData, to,
+                                               source))
+                        {
+                            break;
+                        }
+
+                        if (!move(entry.UserData, from, to))
+                        {
+                            _Free(to);
+
+                            continue;
+                        }
+
+                        const bool isLast = pool[source].Ranges.GetAllocationCount() == 1;
+
+                        _Free(from);
+
+                        movedBytes += entry.Size;
+                        ++movedCount;
+                        freedBlocks += isLast ? 1 : 0;
+                    }
+                }
+            }
+        }
+
+        if (movedCount > 0)
+        {
+            LOG_DEBUG_FMT_F("Moved {} allocations ({} bytes), {} blocks freed\n", movedCount, movedBytes,
+                            freedBlocks);
+        }
+
+        return movedBytes;
+    }
+
+    uint32_t VulkanMemoryAllocator::GetHeapCount() const
+    {
+        return m_MemoryProperties.memoryHeapCount;
+    }
+
+    DeviceHeapStatistics VulkanMemoryAllocator::GetHeapStatistics(uint32_t heap)
+    {
+        DeviceHeapStatistics statistics;
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+
+            statistics = m_HeapStatistics[heap];
+        }
+
+        if (m_IsMemoryBudgetEnabled)
+        {
+            VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+            budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+            VkPhysicalDeviceMemoryProperties2 memoryProperties = {};
+            memoryProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            memoryProperties.pNext = &budgetProperties;
+
+            vkGetPhysicalDeviceMemoryProperties2(m_PhysicalDevice, &memoryProperties);
+
+            statistics.Budget = budgetProperties.heapBudget[heap];
+            statistics.Usage = budgetProperties.heapUsage[heap];
+        }
+        else
+        {
+            statistics.Budget = statistics.HeapSize / 100 * DEVICE_MEMORY_DEFAULT_BUDGET_PERCENT;
+            statistics.Usage = statistics.BlockBytes;
+        }
+
+        return statistics;
+    }
+
+    void VulkanMemoryAllocator::LogStatistics()
+    {
+        const VkDeviceSize megabyte = 1024 * 1024;
+
+        for (uint32_t i = 0; i < GetHeapCount(); ++i)
+        {
+            const DeviceHeapStatistics statistics = GetHeapStatistics(i);
+
+            LOG_INFO_FMT("Memory heap {}: {} of {} MiB used in {} blocks, {} allocations ({} dedicated), "
+                         "usage {} of {} MiB budget\n",
+                         i, statistics.AllocatedBytes / megabyte, statistics.BlockBytes / megabyte,
+                         statistics.BlockCount, statistics.AllocationCount, statistics.DedicatedCount,
+                         statistics.Usage / megabyte, statistics.Budget / megabyte);
+        }
+    }
+
+    bool VulkanMemoryAllocator::_Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                          DeviceResourceKind kind, bool isDedicated, VkImage image, VkBuffer buffer,
+                                          void *userData, DeviceAllocation &allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+
+        //  Every matching memory type is tried in turn, the next one may live in a heap that still has room
+        for (uint32_t type = 0; type < m_MemoryProperties.memoryTypeCount; ++type)
+        {
+            if (!(requirements.memoryTypeBits & (1u << type)) ||
+                (m_MemoryProperties.memoryTypes[type].propertyFlags & properties) != properties)
+            {
+                continue;
+            }
+
+            const bool isOwnMemory =
+                isDedicated || requirements.size >= std::min(DEVICE_MEMORY_DEDICATED_SIZE, _GetBlockSize(type) / 2);
+
+            if (!isOwnMemory &&
+                _AllocateFromPool(type, kind, requirements, userData, allocation, DEVICE_MEMORY_DEDICATED))
+            {
+                return true;
+            }
+
+            if (_AllocateDedicated(type, requirements, image, buffer, allocation))
+            {
+                return true;
+            }
+        }
+
+        LOG_ERROR_FMT_F("Failed to allocate {} bytes of device memory!\n", requirements.size);
+
+        return false;
+    }
+
+    bool VulkanMemoryAllocator::_AllocateFromPool(uint32_t memoryType, DeviceResourceKind kind,
+                                                  const VkMemoryRequirements &requirements, void *userData,
+                                                  DeviceAllocation &allocation, uint32_t excludedBlock)
+    {
+        MemoryPool &pool = m_Pools[memoryType][kind];
+
+        uint32_t block = DEVICE_MEMORY_DEDICATED;
+        uint32_t range = TLSF_INVALID_RANGE;
+        uint64_t offset = 0;
+        uint32_t unusedSlot = DEVICE_MEMORY_DEDICATED;
+
+        for (uint32_t i = 0; i < pool.size() && range == TLSF_INVALID_RANGE; ++i)
+        {
+            if (pool[i].Memory == VK_NULL_HANDLE)
+            {
+                unusedSlot = i;
+            }
+            else if (i != excludedBlock)
+            {
+                range = pool[i].Ranges.Allocate(requirements.size, requirements.alignment, offset, userData);
+                block = i;
+            }
+        }
+
+        if (range == TLSF_INVALID_RANGE)
+        {
+            if (excludedBlock != DEVICE_MEMORY_DEDICATED)
+            {
+                return false;
+            }
+
+            const VkDeviceSize blockSize = _GetBlockSize(memoryType);
+            VkDeviceMemory memory;
+            uint8_t *mapped;
+
+            if (!_AllocateMemory(memoryType, blockSize, nullptr, memory, mapped))
+            {
+                return false;
+            }
+
+            if (unusedSlot == DEVICE_MEMORY_DEDICATED)
+            {
+                unusedSlot = (uint32_t)pool.size();
+                pool.emplace_back();
+            }
+
+            block = unusedSlot;
+            pool[block].Memory = memory;
+            pool[block].Mapped = mapped;
+            pool[block].Ranges.Initialize(blockSize);
+            pool[block].Alignments.clear();
+
+            ++m_HeapStatistics[_GetHeap(memoryType)].BlockCount;
+
+            range = pool[block].Ranges.Allocate(requirements.size, requirements.alignment, offset, userData);
+
+            if (range == TLSF_INVALID_RANGE)
+            {
+                return false;
+            }
+        }
+
+        MemoryBlock &memoryBlock = pool[block];
+
+        if (memoryBlock.Alignments.size() <= range)
+        {
+            memoryBlock.Alignments.resize(range + 1);
+        }
+
+        memoryBlock.Alignments[range] = requirements.alignment;
+
+        allocation.Memory = memoryBlock.Memory;
+        allocation.Offset = offset;
+        allocation.Size = requirements.size;
+        allocation.Mapped = memoryBlock.Mapped ? memoryBlock.Mapped + offset : nullptr;
+        allocation.MemoryType = memoryType;
+        allocation.Kind = kind;
+        allocation.Block = block;
+        allocation.Range = range;
+
+        DeviceHeapStatistics &statistics = m_HeapStatistics[_GetHeap(memoryType)];
+        statistics.AllocatedBytes += requirements.size;
+        ++statistics.AllocationCount;
+
+        return true;
+    }
+
+    bool VulkanMemoryAllocator::_AllocateDedicated(uint32_t memoryType, const VkMemoryRequirements &requirements,
+                                                   VkImage image, VkBuffer buffer, DeviceAllocation &allocation)
+    {
+        VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+        dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+        dedicatedInfo.image = image;
+        dedicatedInfo.buffer = buffer;
+
+        VkDeviceMemory memory;
+        uint8_t *mapped;
+
+        if (!_AllocateMemory(memoryType, requirements.size, m_IsDedicatedAllocationAvailable ? &dedicatedInfo : nullptr,
+                             memory, mapped))
+        {
+            return false;
+        }
+
+        allocation.Memory = memory;
+        allocation.Offset = 0;
+        allocation.Size = requirements.size;
+        allocation.Mapped = mapped;
+        allocation.MemoryType = memoryType;
+        allocation.Kind = DeviceResourceLinear;
+        allocation.Block = DEVICE_MEMORY_DEDICATED;
+        allocation.Range = TLSF_INVALID_RANGE;
+
+        DeviceHeapStatistics &statistics = m_HeapStatistics[_GetHeap(memoryType)];
+        statistics.AllocatedBytes += requirements.size;
+        ++statistics.AllocationCount;
+        ++statistics.DedicatedCount;
+
+        return true;
+    }
+
+    void VulkanMemoryAllocator::_Free(DeviceAllocation &allocation)
+    {
+        if (allocation.Memory == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        DeviceHeapStatistics &statistics = m_HeapStatistics[_GetHeap(allocation.MemoryType)];
+        statistics.AllocatedBytes -= allocation.Size;
+        --statistics.AllocationCount;
+
+        if (allocation.Block == DEVICE_MEMORY_DEDICATED)
+        {
+            --statistics.DedicatedCount;
+            _FreeMemory(allocation.MemoryType, allocation.Memory, allocation.Size);
+        }
+        else
+        {
+            MemoryPool &pool = m_Pools[allocation.MemoryType][allocation.Kind];
+            MemoryBlock &block = pool[allocation.Block];
+
+            block.Ranges.Free(allocation.Range);
+
+            //  One empty block per pool is kept, resources created and destroyed every frame would keep allocating
+            //  and freeing it otherwise
+            if (block.Ranges.IsEmpty())
+            {
+                uint32_t liveBlocks = 0;
+
+                for (const MemoryBlock &other : pool)
+                {
+                    liveBlocks += other.Memory != VK_NULL_HANDLE ? 1 : 0;
+                }
+
+                if (liveBlocks > 1)
+                {
+                    _FreeBlock(pool, allocation.MemoryType, allocation.Block);
+                }
+            }
+        }
+
+        allocation = DeviceAllocation();
+    }
+
+    bool VulkanMemoryAllocator::_AllocateMemory(uint32_t memoryType, VkDeviceSize size, const void *next,
+                                                VkDeviceMemory &memory, uint8_t *&mapped)
+    {
+        if (m_MemoryAllocationCount >= m_MaxMemoryAllocationCount)
+        {
+            LOG_ERROR_FMT_F("Out of device memory allocations ({} allowed)\n", m_MaxMemoryAllocationCount);
+
+            return false;
+        }
+
+        VkMemoryAllocateInfo allocateInfo = {};
+        allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocateInfo.pNext = next;
+        allocateInfo.allocationSize = size;
+        allocateInfo.memoryTypeIndex = memoryType;
+
+        if (vkAllocateMemory(m_Device, &allocateInfo, VK_NULL_HANDLE, &memory) != VK_SUCCESS)
+        {
+            LOG_WARNING_FMT_F("Failed to allocate {} bytes of memory type {}\n", size, memoryType);
+
+            return false;
+        }
+
+        mapped = nullptr;
+
+        //  Mapped once for good, a block is shared by many resources and may only be mapped a single time
+        if (m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            void *data;
+
+            if (vkMapMemory(m_Device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS)
+            {
+                LOG_ERROR_F("Failed to map device memory!\n");
+                vkFreeMemory(m_Device, memory, VK_NULL_HANDLE);
+
+                return false;
+            }
+
+            mapped = static_cast<uint8_t *>(data);
+        }
+
+        ++m_MemoryAllocationCount;
+        m_HeapStatistics[_GetHeap(memoryType)].BlockBytes += size;
+
+        return true;
+    }
+
+    void VulkanMemoryAllocator::_FreeMemory(uint32_t memoryType, VkDeviceMemory memory, VkDeviceSize size)
+    {
+        //  Unmapped implicitly
+        vkFreeMemory(m_Device, memory, VK_NULL_HANDLE);
+
+        --m_MemoryAllocationCount;
+        m_HeapStatistics[_GetHeap(memoryType)].BlockBytes -= size;
+    }
+
+    void VulkanMemoryAllocator::_FreeBlock(MemoryPool &pool, uint32_t memoryType, uint32_t block)
+    {
+        MemoryBlock &memoryBlock = pool[block];
+
+        _FreeMemory(memoryType, memoryBlock.Memory, memoryBlock.Ranges.GetSize());
+        --m_HeapStatistics[_GetHeap(memoryType)].BlockCount;
+
+        memoryBlock.Memory = VK_NULL_HANDLE;
+        memoryBlock.Mapped = nullptr;
+        memoryBlock.Ranges.Initialize(0);
+        memoryBlock.Alignments.clear();
+    }
+
+    VkDeviceSize VulkanMemoryAllocator::_GetBlockSize(uint32_t memoryType) const
+    {
+        //  Small heaps, like the 256 MiB host visible window into device memory, are not eaten by a few blocks
+        const VkDeviceSize heapSize = m_MemoryProperties.memoryHeaps[_GetHeap(memoryType)].size;
+
+        return std::min(DEVICE_MEMORY_BLOCK_SIZE, heapSize / 8);
+    }
+
+    uint32_t VulkanMemoryAllocator::_GetHeap(uint32_t memoryType) const
+    {
+        return m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+    }
+}  // namespace aga
@@ -0,0 +1,154 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "core/TlsfAllocator.h"
+#include "platform/Platform.h"
+
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Device memory is taken from the driver in blocks of this size, smaller on heaps below 8 blocks
+    const VkDeviceSize DEVICE_MEMORY_BLOCK_SIZE = 64 * 1024 * 1024;
+
+    //  Resources this big get a vkAllocateMemory of their own, they would leave most of a block unusable
+    const VkDeviceSize DEVICE_MEMORY_DEDICATED_SIZE = DEVICE_MEMORY_BLOCK_SIZE / 2;
+
+    //  DeviceAllocation::Block of memory owned by a single resource
+    const uint32_t DEVICE_MEMORY_DEDICATED = 0xFFFFFFFF;
+
+    //  Linear resources (buffers and linear tiling images) and optimal tiling images come from separate blocks, so
+    //  neighbours never have to be kept bufferImageGranularity apart
+    enum DeviceResourceKind
+    {
+        DeviceResourceLinear,
+        DeviceResourceOptimal,
+        DeviceResourceKindCount
+    };
+
+    struct DeviceAllocation
+    {
+        VkDeviceMemory Memory = VK_NULL_HANDLE;
+        VkDeviceSize Offset = 0;
+        VkDeviceSize Size = 0;
+
+        //  Host address of Offset for host visible memory, whose blocks stay mapped for their lifetime
+        uint8_t *Mapped = nullptr;
+
+        uint32_t MemoryType = 0;
+        DeviceResourceKind Kind = DeviceResourceLinear;
+        uint32_t Block = DEVICE_MEMORY_DEDICATED;
+        uint32_t Range = TLSF_INVALID_RANGE;
+    };
+
+    struct DeviceHeapStatistics
+    {
+        VkDeviceSize HeapSize;
+
+        //  From VK_EXT_memory_budget when the device has it, otherwise 80% of the heap and our own block bytes
+        VkDeviceSize Budget;
+        VkDeviceSize Usage;
+
+        //  Taken from the driver, dedicated allocations included
+        VkDeviceSize BlockBytes;
+        //  Handed out to resources
+        VkDeviceSize AllocatedBytes;
+        uint32_t BlockCount;
+        uint32_t AllocationCount;
+        uint32_t DedicatedCount;
+    };
+
+    //  Called by Defragment for each resource it moves: create the resource again at 'to', copy its contents over
+    //  and start using it. Returning false leaves the resource where it is. The old memory is freed by Defragment, the
+    //  callback must not call into the allocator.
+    typedef std::function<bool(void *userData, const DeviceAllocation &from, const DeviceAllocation &to)>
+        DeviceMemoryMoveCallback;
+
+    //  Places resources in large blocks of device memory with a TLSF allocator per block, instead of one
+    //  vkAllocateMemory per resource: drivers limit the number of allocations (maxMemoryAllocationCount) and each
+    //  of them is slow. Thread-safe.
+    class VulkanMemoryAllocator
+    {
+    public:
+        VulkanMemoryAllocator();
+        ~VulkanMemoryAllocator();
+
+        VulkanMemoryAllocator(const VulkanMemoryAllocator &) = delete;
+        void operator=(const VulkanMemoryAllocator &) = delete;
+
+        //  'isMemoryBudgetEnabled' tells VK_EXT_memory_budget was enabled on 'device'
+        bool Initialize(VkPhysicalDevice physicalDevice, VkDevice device, bool isMemoryBudgetEnabled);
+
+        //  Frees all blocks, resources still holding memory are reported
+        void Destroy();
+
+        //  Allocate memory for the resource and bind it. 'userData' identifies the resource to Defragment, memory
+        //  without it is never moved. 'tiling' is the one the image was created with, it can not be queried.
+        bool AllocateImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties,
+                           DeviceAllocation &allocation, void *userData = nullptr);
+        bool AllocateBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, DeviceAllocation &allocation,
+                            void *userData = nullptr);
+
+        void Free(DeviceAllocation &allocation);
+
+        //  Moves resources out of the emptiest blocks of each pool into the others, up to 'maxBytes', and frees the
+        //  blocks left empty. The device must be idle, their old memory is released on return.
+        VkDeviceSize Defragment(VkDeviceSize maxBytes, const DeviceMemoryMoveCallback &move);
+
+        uint32_t GetHeapCount() const;
+        DeviceHeapStatistics GetHeapStatistics(uint32_t heap);
+        void LogStatistics();
+
+    private:
+        struct MemoryBlock
+        {
+            //  VK_NULL_HANDLE once freed, the slot is reused by the next block of its pool
+            VkDeviceMemory Memory;
+            uint8_t *Mapped;
+            TlsfAllocator Ranges;
+
+            //  Alignment each range was allocated with, by range index, Defragment has to keep it
+            std::vector<VkDeviceSize> Alignments;
+        };
+
+        typedef std::vector<MemoryBlock> MemoryPool;
+
+        bool _Allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                       DeviceResourceKind kind, bool isDedicated, VkImage image, VkBuffer buffer, void *userData,
+                       DeviceAllocation &allocation);
+
+        //  Defragment passes the block it empties as 'excludedBlock', no new block is created then
+        bool _AllocateFromPool(uint32_t memoryType, DeviceResourceKind kind, const VkMemoryRequirements &requirements,
+                               void *userData, DeviceAllocation &allocation, uint32_t excludedBlock);
+        bool _AllocateDedicated(uint32_t memoryType, const VkMemoryRequirements &requirements, VkImage image,
+                                VkBuffer buffer, DeviceAllocation &allocation);
+        void _Free(DeviceAllocation &allocation);
+
+        bool _AllocateMemory(uint32_t memoryType, VkDeviceSize size, const void *next, VkDeviceMemory &memory,
+                             uint8_t *&mapped);
+        void _FreeMemory(uint32_t memoryType, VkDeviceMemory memory, VkDeviceSize size);
+        void _FreeBlock(MemoryPool &pool, uint32_t memoryType, uint32_t block);
+
+        VkDeviceSize _GetBlockSize(uint32_t memoryType) const;
+        uint32_t _GetHeap(uint32_t memoryType) const;
+
+    private:
+        VkPhysicalDevice m_PhysicalDevice;
+        VkDevice m_Device;
+        VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+        bool m_IsMemoryBudgetEnabled;
+        bool m_IsDedicatedAllocationAvailable;
+
+        std::mutex m_Mutex;
+        MemoryPool m_Pools[VK_MAX_MEMORY_TYPES][DeviceResourceKindCount];
+
+        //  Budget and Usage are filled in by GetHeapStatistics
+        std::vector<DeviceHeapStatistics> m_HeapStatistics;
+        uint32_t m_MemoryAllocationCount;
+        uint32_t m_MaxMemoryAllocationCount;
+    };
+}  // namespace aga
@@ -0,0 +1,281 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "VulkanPipelineCache.h"
+#include "core/Logger.h"
+#include "core/StringId.h"
+
+#include <cstdio>
+#include <cstring>
+
+namespace aga
+{
+    //  Size of the header vkGetPipelineCacheData puts in front of the data (VK_PIPELINE_CACHE_HEADER_VERSION_ONE):
+    //  header size, header version, vendor ID and device ID, then the pipeline cache UUID
+    const uint32_t PIPELINE_CACHE_VULKAN_HEADER_SIZE = 16 + VK_UUID_SIZE;
+
+    VulkanPipelineCache::VulkanPipelineCache()
+        : m_Device(VK_NULL_HANDLE),
+          m_Cache(VK_NULL_HANDLE),
+          m_VendorID(0),
+          m_DeviceID(0),
+          m_DriverVersion(0),
+          m_DataHash(0)
+    {
+        memset(m_CacheUUID, 0, sizeof(m_CacheUUID));
+    }
+
+    VulkanPipelineCache::~VulkanPipelineCache()
+    {
+    }
+
+    bool VulkanPipelineCache::Create(VkDevice device, const VkPhysicalDeviceProperties &properties, const String &path)
+    {
+        m_Device = device;
+        m_Path = path;
+        m_VendorID = properties.vendorID;
+        m_DeviceID = properties.deviceID;
+        m_DriverVersion = properties.driverVersion;
+        memcpy(m_CacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+        std::vector<uint8_t> data;
+
+        if (_Load(data))
+        {
+            m_DataHash = HashString(reinterpret_cast<const char *>(data.data()), data.size());
+
+            LOG_DEBUG_FMT_F("Loaded {} bytes of pipeline cache from {}\n", data.size(), path);
+        }
+
+        VkPipelineCacheCreateInfo cacheCreateInfo = {};
+        cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cacheCreateInfo.initialDataSize = data.size();
+        cacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+        VkResult result = vkCreatePipelineCache(m_Device, &cacheCreateInfo, VK_NULL_HANDLE, &m_Cache);
+
+        //  The driver may still refuse data it wrote itself, start over empty then
+        if (result != VK_SUCCESS && !data.empty())
+        {
+            LOG_WARNING_FMT_F("Driver rejected the pipeline cache {}, starting empty\n", path);
+
+            m_DataHash = 0;
+            cacheCreateInfo.initialDataSize = 0;
+            cacheCreateInfo.pInitialData = nullptr;
+
+            result = vkCreatePipelineCache(m_Device, &cacheCreateInfo, VK_NULL_HANDLE, &m_Cache);
+        }
+
+        if (result != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Failed to create pipeline cache!\n");
+
+            return false;
+        }
+
+        return true;
+    }
+
+    void VulkanPipelineCache::Destroy()
+    {
+        if (m_Cache == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        Save();
+
+        vkDestroyPipelineCache(m_Device, m_Cache, VK_NULL_HANDLE);
+        m_Cache = VK_NULL_HANDLE;
+    }
+
+    bool VulkanPipelineCache::Save()
+    {
+        size_t size = 0;
+
+        if (vkGetPipelineCacheData(m_Device, m_Cache, &size, nullptr) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        std::vector<uint8_t> data(size);
+
+        if (vkGetPipelineCacheData(m_Device, m_Cache, &size, data.data()) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        data.resize(size);
+
+        const uint64_t hash = HashString(reinterpret_cast<const char *>(data.data()), data.size());
+
+        if (hash == m_DataHash)
+        {
+            return true;
+        }
+
+        PipelineCacheFileHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.Magic, PIPELINE_CACHE_MAGIC, sizeof(header.Magic));
+        header.Version = PIPELINE_CACHE_VERSION;
+        header.VendorID = m_VendorID;
+        header.DeviceID = m_DeviceID;
+        header.DriverVersion = m_DriverVersion;
+        memcpy(header.CacheUUID, m_CacheUUID, VK_UUID_SIZE);
+        header.DataSize = data.size();
+        header.DataHash = hash;
+
+        //  Written aside and renamed over the old file, a crash while saving leaves the previous cache intact
+        const String temporaryPath = m_Path + ".tmp";
+        FILE *file = std::fopen(temporaryPath.GetData(), "wb");
+
+        if (!file)
+        {
+            LOG_ERROR_FMT_F("Can not write pipeline cache {}\n", temporaryPath);
+
+            return false;
+        }
+
+        bool isWritten = std::fwrite(&header, sizeof(header), 1, file) == 1;
+        isWritten = isWritten && std::fwrite(data.data(), 1, data.size(), file) == data.size();
+        isWritten = std::fclose(file) == 0 && isWritten;
+
+        if (!isWritten || std::rename(temporaryPath.GetData(), m_Path.GetData()) != 0)
+        {
+            LOG_ERROR_FMT_F("Can not write pipeline cache {}\n", m_Path);
+            std::remove(temporaryPath.GetData());
+
+            return false;
+        }
+
+        m_DataHash = hash;
+
+        LOG_DEBUG_FMT_F("Saved {} bytes of pipeline cache to {}\n", data.size(), m_Path);
+
+        return true;
+    }
+
+    VkPipelineCache VulkanPipelineCache::GetCache() const
+    {
+        return m_Cache;
+    }
+
+    VkPipelineCache VulkanPipelineCache::CreateWorkerCache()
+    {
+        VkPipelineCacheCreateInfo cacheCreateInfo = {};
+        cacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+
+        VkPipelineCache cache = VK_NULL_HANDLE;
+
+        if (vkCreatePipelineCache(m_Device, &cacheCreateInfo, VK_NULL_HANDLE, &cache) != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Failed to create worker pipeline cache!\n");
+
+            return VK_NULL_HANDLE;
+        }
+
+        return cache;
+    }
+
+    bool VulkanPipelineCache::MergeWorkerCache(VkPipelineCache cache)
+    {
+        if (cache == VK_NULL_HANDLE)
+        {
+            return false;
+        }
+
+        VkResult result;
+        {
+            std::lock_guard<std::mutex> lock(m_MergeMutex);
+
+            result = vkMergePipelineCaches(m_Device, m_Cache, 1, &cache);
+        }
+
+        vkDestroyPipelineCache(m_Device, cache, VK_NULL_HANDLE);
+
+        return result == VK_SUCCESS;
+    }
+
+    bool VulkanPipelineCache::_Load(std::vector<uint8_t> &data)
+    {
+        FILE *file = std::fopen(m_Path.GetData(), "rb");
+
+        if (!file)
+        {
+            return false;
+        }
+
+        //  DataSize is checked against this before anything is allocated for it
+        const long fileSize = std::fseek(file, 0, SEEK_END) == 0 ? std::ftell(file) : -1;
+
+        PipelineCacheFileHeader header;
+        bool isValid = std::fseek(file, 0, SEEK_SET) == 0 && std::fread(&header, sizeof(header), 1, file) == 1;
+
+        isValid = isValid && memcmp(header.Magic, PIPELINE_CACHE_MAGIC, sizeof(header.Magic)) == 0 &&
+                  header.Version == PIPELINE_CACHE_VERSION;
+
+        if (!isValid)
+        {
+            LOG_WARNING_FMT_F("{} is not a pipeline cache file\n", m_Path);
+        }
+        else if (header.VendorID != m_VendorID || header.DeviceID != m_DeviceID ||
+                 header.DriverVersion != m_DriverVersion || memcmp(header.CacheUUID, m_CacheUUID, VK_UUID_SIZE) != 0)
+        {
+            //  Expected after a driver update, everything is compiled once more
+            LOG_INFO_FMT_F("Pipeline cache {} belongs to another device or driver\n", m_Path);
+
+            isValid = false;
+        }
+
+        if (isValid && (fileSize < (long)sizeof(header) || header.DataSize != (uint64_t)fileSize - sizeof(header)))
+        {
+            LOG_WARNING_FMT_F("Pipeline cache {} is damaged\n", m_Path);
+
+            isValid = false;
+        }
+
+        if (isValid)
+        {
+            data.resize(header.DataSize);
+
+            isValid = std::fread(data.data(), 1, data.size(), file) == data.size() &&
+                      HashString(reinterpret_cast<const char *>(data.data()), data.size()) == header.DataHash;
+
+            if (!isValid)
+            {
+                LOG_WARNING_FMT_F("Pipeline cache {} is damaged\n", m_Path);
+            }
+        }
+
+        std::fclose(file);
+
+        //  Same check the driver does on its own header, cheaper to find out here
+        if (isValid)
+        {
+            uint32_t vulkanHeader[4];
+
+            isValid = data.size() >= PIPELINE_CACHE_VULKAN_HEADER_SIZE;
+
+            if (isValid)
+            {
+                memcpy(vulkanHeader, data.data(), sizeof(vulkanHeader));
+
+                isValid = vulkanHeader[0] >= PIPELINE_CACHE_VULKAN_HEADER_SIZE &&
+                          vulkanHeader[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE && vulkanHeader[2] == m_VendorID &&
+                          vulkanHeader[3] == m_DeviceID &&
+                          memcmp(data.data() + sizeof(vulkanHeader), m_CacheUUID, VK_UUID_SIZE) == 0;
+            }
+
+            if (!isValid)
+            {
+                LOG_WARNING_FMT_F("Pipeline cache {} holds data of another device\n", m_Path);
+            }
+        }
+
+        if (!isValid)
+        {
+            data.clear();
+        }
+
+        return isValid;
+    }
+}  // namespace aga
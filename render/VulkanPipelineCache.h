@@ -0,0 +1,82 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "core/String.h"
+#include "platform/Platform.h"
+
+#include <mutex>
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Pipeline cache file, in host byte order: PipelineCacheFileHeader followed by the data returned by
+    //  vkGetPipelineCacheData. A file written by another device or driver version is ignored, the driver would
+    //  reject its data anyway.
+    const char PIPELINE_CACHE_MAGIC[8] = {'A', 'G', 'A', 'P', 'S', 'O', '0', '1'};
+    const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+    struct PipelineCacheFileHeader
+    {
+        char Magic[8];
+        uint32_t Version;
+        uint32_t VendorID;
+        uint32_t DeviceID;
+        uint32_t DriverVersion;
+        uint8_t CacheUUID[VK_UUID_SIZE];
+        uint64_t DataSize;
+
+        //  HashString of the data, catches files cut short by a crash while saving
+        uint64_t DataHash;
+    };
+
+    //  VkPipelineCache kept on disk between runs, so pipelines are compiled once per device and driver instead of
+    //  on every start and swap chain rebuild
+    class VulkanPipelineCache
+    {
+    public:
+        VulkanPipelineCache();
+        ~VulkanPipelineCache();
+
+        VulkanPipelineCache(const VulkanPipelineCache &) = delete;
+        void operator=(const VulkanPipelineCache &) = delete;
+
+        //  Starts from the contents of the native file 'path' when it matches the device, empty otherwise
+        bool Create(VkDevice device, const VkPhysicalDeviceProperties &properties, const String &path);
+
+        //  Saves the cache and destroys it
+        void Destroy();
+
+        //  Writes the cache to its file unless nothing changed since it was loaded or saved
+        bool Save();
+
+        VkPipelineCache GetCache() const;
+
+        //  Pipelines built on worker threads go into caches of their own, a shared cache serializes them inside the
+        //  driver. Each worker cache is merged back and destroyed by MergeWorkerCache.
+        VkPipelineCache CreateWorkerCache();
+
+        //  Not thread-safe with pipeline creation through GetCache, call it from the thread building pipelines with
+        //  the main cache
+        bool MergeWorkerCache(VkPipelineCache cache);
+
+    private:
+        bool _Load(std::vector<uint8_t> &data);
+
+    private:
+        VkDevice m_Device;
+        VkPipelineCache m_Cache;
+        String m_Path;
+
+        uint32_t m_VendorID;
+        uint32_t m_DeviceID;
+        uint32_t m_DriverVersion;
+        uint8_t m_CacheUUID[VK_UUID_SIZE];
+
+        //  Hash of the data last loaded or saved, 0 for none
+        uint64_t m_DataHash;
+
+        std::mutex m_MergeMutex;
+    };
+}  // namespace aga
@@ -4,6 +4,7 @@
 #include "core/BuildConfig.h"
 #include "core/Common.h"
 #include "core/Logger.h"
+#include "core/Memory.h"
 #include "core/Typedefs.h"
 #include "core/math/Matrix.h"
 #include "core/math/Vector2.h"
@@ -12,15 +13,36 @@
 #include "platform/PlatformFileSystem.h"
 #include "platform/PlatformWindow.h"
 
-#include <chrono>
-
 #define STB_IMAGE_IMPLEMENTATION
 #include "external/stb/stb_image.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
 const int MAX_FRAMES_IN_PROCESS = 2;
 
 namespace aga
 {
+    //  Native path, the file is written on shutdown and reused by the next run on the same device and driver
+    const char *const PIPELINE_CACHE_PATH = "pipeline_cache.bin";
+
+    //  Stored as it is read back, sRGB encoded like the window's swap chain
+    const VkFormat HEADLESS_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
+
+    //  Marks an offscreen image without a frame waiting for its readback
+    const uint64_t HEADLESS_NO_FRAME = UINT64_MAX;
+
+    const char *const SHADER_BASE_VERTEX = "data/shaders/shader_base.vert.spv";
+    const char *const SHADER_BASE_FRAGMENT = "data/shaders/shader_base.frag.spv";
+
+#if BUILD_ENABLE_SHADER_HOT_RELOAD
+    //  GLSL sources are mounted to be watched, recompiled SPIR-V shadows the shipped files from a memory mount
+    const char *const SHADER_SOURCE_MOUNT = "shader-sources";
+    const char *const SHADER_OUTPUT_MOUNT = "data/shaders";
+    const int32_t SHADER_OUTPUT_PRIORITY = 100;
+#endif
+
     const std::vector<const char *> g_ValidationLayers = {"VK_LAYER_KHRONOS_validation"};
 
     VKAPI_ATTR VkBool32 VKAPI_CALL VulkanDebugCallback(VkDebugReportFlagsEXT flags,
@@ -28,27 +50,25 @@ namespace aga
                                                        size_t location, int32_t code, const char *layerPrefix,
                                                        const char *message, void *userData)
     {
-        String layerPart = String(" Layer[") + layerPrefix + "]: ";
-
         if (flags & VK_DEBUG_REPORT_INFORMATION_BIT_EXT)
         {
-            LOG_INFO(layerPart + String(message) + "\n");
+            LOG_INFO_FMT(" Layer[{}]: {}\n", layerPrefix, message);
         }
         else if (flags & VK_DEBUG_REPORT_WARNING_BIT_EXT)
         {
-            LOG_WARNING(layerPart + String(message) + "\n");
+            LOG_WARNING_FMT(" Layer[{}]: {}\n", layerPrefix, message);
         }
         else if (flags & VK_DEBUG_REPORT_ERROR_BIT_EXT)
         {
-            LOG_ERROR(layerPart + String(message) + "\n");
+            LOG_ERROR_FMT(" Layer[{}]: {}\n", layerPrefix, message);
         }
         else if (flags & VK_DEBUG_REPORT_DEBUG_BIT_EXT)
         {
-            LOG_DEBUG(layerPart + String(message) + "\n");
+            LOG_DEBUG_FMT(" Layer[{}]: {}\n", layerPrefix, message);
         }
         else
         {
-            LOG_INFO(layerPart + String(message) + "\n");
+            LOG_INFO_FMT(" Layer[{}]: {}\n", layerPrefix, message);
         }
 
         return VK_FALSE;
@@ -122,31 +142,42 @@ namespace aga
         m_VulkanPhysicalDevice(VK_NULL_HANDLE),
         m_GraphicsFamilyIndex(-1),
         m_PresentFamilyIndex(-1),
+        m_TransferFamilyIndex(-1),
         m_GraphicsQueue(VK_NULL_HANDLE),
         m_DebugReport(VK_NULL_HANDLE),
-        m_CommandPool(VK_NULL_HANDLE),
         m_VulkanSurface(VK_NULL_HANDLE),
         m_PresentMode(VK_PRESENT_MODE_MAX_ENUM_KHR),
+        m_IsVSyncEnabled(true),
         m_SwapChain(VK_NULL_HANDLE),
         m_SwapChainImageCount(2),
         m_ActiveSwapChainImageID(0),
+        m_IsHeadless(false),
+        m_FrameNumber(0),
         m_DescriptorSetLayout(VK_NULL_HANDLE),
         m_DescriptorPool(VK_NULL_HANDLE),
+        m_DescriptorSet(VK_NULL_HANDLE),
         m_PipelineLayout(VK_NULL_HANDLE),
         m_GraphicsPipeline(VK_NULL_HANDLE),
+        m_VertexShaderPath(SHADER_BASE_VERTEX),
+        m_FragmentShaderPath(SHADER_BASE_FRAGMENT),
+        m_RetiredPipelineFrames(0),
+        m_ShaderOverrides(INVALID_MOUNT),
         m_RenderPass(VK_NULL_HANDLE),
         m_CurrentFrame(0),
         m_FramebufferResized(false),
         m_VertexBuffer(VK_NULL_HANDLE),
-        m_VertexBufferMemory(VK_NULL_HANDLE),
         m_IndexBuffer(VK_NULL_HANDLE),
-        m_IndexBufferMemory(VK_NULL_HANDLE),
+        m_DrawUniformOffset(INVALID_UNIFORM_OFFSET),
+        m_DrawUniformStride(0),
         m_DepthStencilImage(VK_NULL_HANDLE),
         m_DepthStencilImageView(VK_NULL_HANDLE),
-        m_DepthStencilImageMemory(VK_NULL_HANDLE),
         m_DepthStencilFormat(VK_FORMAT_UNDEFINED),
-        m_IsStencilAvailable(false)
+        m_IsStencilAvailable(false),
+        m_TextureFileRequest(INVALID_FILE_REQUEST),
+        m_ModelAngle(0.0f),
+        m_PreviousModelAngle(0.0f)
     {
+        SetSceneDrawCount(1);
     }
 
     VulkanRenderer::~VulkanRenderer()
@@ -155,23 +186,43 @@ namespace aga
 
     bool VulkanRenderer::BeginRender()
     {
+        MemoryTagScope scope(MemoryTag::Render);
+
         CheckResult(vkWaitForFences(m_VulkanDevice, 1, &m_SyncFences[m_CurrentFrame], VK_TRUE, UINT64_MAX),
                     "Wait For Fences error\n");
 
-        VkResult result =
-            vkAcquireNextImageKHR(m_VulkanDevice, m_SwapChain, UINT64_MAX, m_ImageAvailableSemaphores[m_CurrentFrame],
-                                  VK_NULL_HANDLE, &m_ActiveSwapChainImageID);
+        //  Once the fence of every frame in flight was waited for, no submission binds the old pipelines anymore
+        if (m_RetiredPipelineFrames > 0 && --m_RetiredPipelineFrames == 0)
+        {
+            _DestroyRetiredPipelines();
+        }
+
+        //  Last frame's draws went away with the frame arena, start from fresh storage sized for the demo scene
+        FrameVector<DrawCommand>().swap(m_Draws);
+        m_Draws.reserve(m_Transforms.GetCount());
 
-        if (result == VK_ERROR_OUT_OF_DATE_KHR)
+        if (m_IsHeadless)
         {
-            RecreateSwapChain();
-            return true;
+            //  One offscreen image per frame in flight, so its fence was waited for above
+            m_ActiveSwapChainImageID = (uint32_t)m_CurrentFrame;
         }
-        else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+        else
         {
-            LOG_ERROR_F("Failed to acquire swap chain image!");
+            VkResult result = vkAcquireNextImageKHR(m_VulkanDevice, m_SwapChain, UINT64_MAX,
+                                                    m_ImageAvailableSemaphores[m_CurrentFrame], VK_NULL_HANDLE,
+                                                    &m_ActiveSwapChainImageID);
 
-            return false;
+            if (result == VK_ERROR_OUT_OF_DATE_KHR)
+            {
+                RecreateSwapChain();
+                return true;
+            }
+            else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+            {
+                LOG_ERROR_F("Failed to acquire swap chain image!");
+
+                return false;
+            }
         }
 
         _UpdateUniformBuffer();
@@ -181,13 +232,38 @@ namespace aga
             vkWaitForFences(m_VulkanDevice, 1, &m_ImagesInProcess[m_ActiveSwapChainImageID], VK_TRUE, UINT64_MAX);
         }
 
+        if (m_IsHeadless)
+        {
+            _ReadBackFrame(m_ActiveSwapChainImageID);
+        }
+
         m_ImagesInProcess[m_ActiveSwapChainImageID] = m_SyncFences[m_CurrentFrame];
 
+        //  The demo scene, one draw per transform
+        for (uint32_t transform = 0; transform < m_Transforms.GetCount(); ++transform)
+        {
+            SubmitDraw({m_VertexBuffer, m_IndexBuffer, static_cast<uint32_t>(indices.size()), 0, 0, transform});
+        }
+
         return true;
     }
 
+    void VulkanRenderer::SubmitDraw(const DrawCommand &draw)
+    {
+        m_Draws.push_back(draw);
+    }
+
     bool VulkanRenderer::EndRender()
     {
+        MemoryTagScope scope(MemoryTag::Render);
+
+        if (m_IsHeadless)
+        {
+            m_CurrentFrame = (m_CurrentFrame + 1) % MAX_FRAMES_IN_PROCESS;
+
+            return true;
+        }
+
         VkSemaphore signalSemaphores[] = {m_RenderFinishedSemaphores[m_CurrentFrame]};
 
         VkPresentInfoKHR presentInfo = {};
@@ -235,6 +311,20 @@ namespace aga
 
     bool VulkanRenderer::RenderFrame()
     {
+        MemoryTagScope scope(MemoryTag::Render);
+
+        const std::chrono::steady_clock::time_point recordStart = std::chrono::steady_clock::now();
+
+        //  BeginRender waited for the frame's fence, none of the pool's command buffers is pending anymore. Resetting
+        //  the pool hands their memory back in one call instead of one per command buffer.
+        CheckResult(vkResetCommandPool(m_VulkanDevice, m_FrameCommandPools[m_CurrentFrame], 0),
+                    "Error while resetting Command Pool");
+
+        _RecordCommandBuffer(m_FrameCommandBuffers[m_CurrentFrame], m_ActiveSwapChainImageID);
+
+        m_RecordTimes.Add(
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recordStart).count());
+
         VkSemaphore waitSemaphores[] = {m_ImageAvailableSemaphores[m_CurrentFrame]};
         VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
         VkSemaphore signalSemaphores[] = {m_RenderFinishedSemaphores[m_CurrentFrame]};
@@ -242,13 +332,22 @@ namespace aga
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &m_CommandBuffers[m_ActiveSwapChainImageID];
+        submitInfo.pCommandBuffers = &m_FrameCommandBuffers[m_CurrentFrame];
         submitInfo.waitSemaphoreCount = 1;
         submitInfo.pWaitSemaphores = waitSemaphores;
         submitInfo.pWaitDstStageMask = waitStages;
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
+        if (m_IsHeadless)
+        {
+            //  Nothing was acquired and nothing is presented
+            submitInfo.waitSemaphoreCount = 0;
+            submitInfo.signalSemaphoreCount = 0;
+
+            m_ReadbackFrames[m_ActiveSwapChainImageID] = m_FrameNumber++;
+        }
+
         CheckResult(vkResetFences(m_VulkanDevice, 1, &m_SyncFences[m_CurrentFrame]), "Reset Fences error\n");
 
         CheckResult(vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, m_SyncFences[m_CurrentFrame]),
@@ -257,8 +356,18 @@ namespace aga
         return true;
     }
 
+    const FrameTimeHistogram &VulkanRenderer::GetRecordTimes() const
+    {
+        return m_RecordTimes;
+    }
+
     bool VulkanRenderer::CreateSwapChain()
     {
+        if (m_IsHeadless)
+        {
+            return _CreateOffscreenImages();
+        }
+
         SwapChainSupportDetails swapChainSupport = FindSwapChainDetails(m_VulkanPhysicalDevice);
 
         m_SurfaceFormat = _ChooseSwapSurfaceFormat(swapChainSupport.Formats);
@@ -393,12 +502,11 @@ namespace aga
         vkDestroyImageView(m_VulkanDevice, m_DepthStencilImageView, VK_NULL_HANDLE);
         m_DepthStencilImageView = VK_NULL_HANDLE;
 
-        vkFreeMemory(m_VulkanDevice, m_DepthStencilImageMemory, VK_NULL_HANDLE);
-        m_DepthStencilImageMemory = VK_NULL_HANDLE;
-
         vkDestroyImage(m_VulkanDevice, m_DepthStencilImage, VK_NULL_HANDLE);
         m_DepthStencilImage = VK_NULL_HANDLE;
 
+        m_MemoryAllocator.Free(m_DepthStencilImageMemory);
+
         LOG_DEBUG_F("VulkanRenderer DepthStencil Image destroyed\n");
     }
 
@@ -429,10 +537,36 @@ namespace aga
 
     bool VulkanRenderer::CreateGraphicsPipeline()
     {
-        String vertShaderCode =
-            PlatformFileSystem::getInstance()->ReadEntireFileBinaryMode("data/shaders/shader_base.vert.spv");
-        String fragShaderCode =
-            PlatformFileSystem::getInstance()->ReadEntireFileBinaryMode("data/shaders/shader_base.frag.spv");
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 0;
+
+        CheckResult(vkCreatePipelineLayout(m_VulkanDevice, &pipelineLayoutInfo, VK_NULL_HANDLE, &m_PipelineLayout),
+                    "Failed to create pipeline layout!");
+
+        if (!_CreatePipeline(m_GraphicsPipeline))
+        {
+            return false;
+        }
+
+        LOG_DEBUG_F("VulkanRenderer Graphics Pipeline created\n");
+
+        return true;
+    }
+
+    bool VulkanRenderer::_CreatePipeline(VkPipeline &pipeline)
+    {
+        //  SPIR-V is handed to the driver straight from the mapping, page alignment covers its 4 byte requirement
+        MappedFile vertShaderCode;
+        MappedFile fragShaderCode;
+
+        if (!PlatformFileSystem::getInstance()->MapFile(m_VertexShaderPath, vertShaderCode, FileAccessSequential) ||
+            !PlatformFileSystem::getInstance()->MapFile(m_FragmentShaderPath, fragShaderCode, FileAccessSequential))
+        {
+            return false;
+        }
 
         VkShaderModule vertShaderModule = _CreateShaderModule(vertShaderCode);
         VkShaderModule fragShaderModule = _CreateShaderModule(fragShaderCode);
@@ -526,15 +660,6 @@ namespace aga
         colorBlending.blendConstants[2] = 0.0f;
         colorBlending.blendConstants[3] = 0.0f;
 
-        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
-        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-        pipelineLayoutInfo.setLayoutCount = 1;
-        pipelineLayoutInfo.pSetLayouts = &m_DescriptorSetLayout;
-        pipelineLayoutInfo.pushConstantRangeCount = 0;
-
-        CheckResult(vkCreatePipelineLayout(m_VulkanDevice, &pipelineLayoutInfo, VK_NULL_HANDLE, &m_PipelineLayout),
-                    "Failed to create pipeline layout!");
-
         VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
         pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         pipelineCreateInfo.stageCount = 2;
@@ -551,31 +676,38 @@ namespace aga
         pipelineCreateInfo.subpass = 0;
         pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-        CheckResult(vkCreateGraphicsPipelines(m_VulkanDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr,
-                                              &m_GraphicsPipeline),
-                    "Failed to create graphics pipeline!");
+        //  Found in the pipeline cache after the first run, so swap chain rebuilds do not compile shaders again
+        const VkResult result = vkCreateGraphicsPipelines(m_VulkanDevice, m_PipelineCache.GetCache(), 1,
+                                                          &pipelineCreateInfo, nullptr, &pipeline);
 
         vkDestroyShaderModule(m_VulkanDevice, fragShaderModule, VK_NULL_HANDLE);
         vkDestroyShaderModule(m_VulkanDevice, vertShaderModule, VK_NULL_HANDLE);
 
-        LOG_DEBUG_F("VulkanRenderer Graphics Pipeline created\n");
+        if (result != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Failed to create graphics pipeline!\n");
+
+            return false;
+        }
 
         return true;
     }
 
     void VulkanRenderer::DestroyGraphicsPipeline()
     {
+        _DestroyRetiredPipelines();
+
         vkDestroyPipeline(m_VulkanDevice, m_GraphicsPipeline, VK_NULL_HANDLE);
         vkDestroyPipelineLayout(m_VulkanDevice, m_PipelineLayout, VK_NULL_HANDLE);
 
         LOG_DEBUG_F("VulkanRenderer Graphics Pipeline destoryed\n");
     }
 
-    VkShaderModule VulkanRenderer::_CreateShaderModule(const String &shaderCodeData)
+    VkShaderModule VulkanRenderer::_CreateShaderModule(const MappedFile &shaderCodeData)
     {
         VkShaderModuleCreateInfo shaderModuleCreateInfo = {};
         shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-        shaderModuleCreateInfo.codeSize = shaderCodeData.Length();
+        shaderModuleCreateInfo.codeSize = shaderCodeData.GetSize();
         shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCodeData.GetData());
 
         VkShaderModule shaderModule;
@@ -595,7 +727,8 @@ namespace aga
         attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        attachments[0].finalLayout =
+            m_IsHeadless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
         attachments[1].format = _FindDepthFormat();
         attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -620,13 +753,21 @@ namespace aga
         subpass.pColorAttachments = &colorAttachmentRef;
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        std::array<VkSubpassDependency, 2> dependencies = {};
+        dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[0].dstSubpass = 0;
+        dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].srcAccessMask = 0;
+        dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+        //  Headless frames are copied out of the color attachment right after the pass
+        dependencies[1].srcSubpass = 0;
+        dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+        dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
 
         VkRenderPassCreateInfo renderPassCreateInfo = {};
         renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -634,8 +775,8 @@ namespace aga
         renderPassCreateInfo.pAttachments = attachments.data();
         renderPassCreateInfo.subpassCount = 1;
         renderPassCreateInfo.pSubpasses = &subpass;
-        renderPassCreateInfo.dependencyCount = 1;
-        renderPassCreateInfo.pDependencies = &dependency;
+        renderPassCreateInfo.dependencyCount = m_IsHeadless ? 2 : 1;
+        renderPassCreateInfo.pDependencies = dependencies.data();
 
         CheckResult(vkCreateRenderPass(m_VulkanDevice, &renderPassCreateInfo, VK_NULL_HANDLE, &m_RenderPass),
                     "VulkanRenderer Error while creating RenderPass\n");
@@ -657,7 +798,7 @@ namespace aga
         VkDescriptorSetLayoutBinding uboLayoutBinding = {};
         uboLayoutBinding.binding = 0;
         uboLayoutBinding.descriptorCount = 1;
-        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uboLayoutBinding.pImmutableSamplers = VK_NULL_HANDLE;
         uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
@@ -770,6 +911,14 @@ namespace aga
 
     bool VulkanRenderer::Initialize()
     {
+        //  Everything the renderer allocates while setting up or recording a frame is charged to Render
+        MemoryTagScope scope(MemoryTag::Render);
+
+        //  The texture is read while the device is being set up
+        m_TextureFileRequest = PlatformFileSystem::getInstance()->ReadFileAsync(
+            "data/textures/logo.png", [this](FileReadResult &result) { m_TextureFileData = std::move(result.Data); },
+            FilePriorityHigh);
+
         _PrepareExtensions();
 
         if (!_InitInstance())
@@ -791,6 +940,20 @@ namespace aga
             return false;
         }
 
+        VkPhysicalDeviceProperties physicalDeviceProperties = {};
+        vkGetPhysicalDeviceProperties(m_VulkanPhysicalDevice, &physicalDeviceProperties);
+
+        if (!m_PipelineCache.Create(m_VulkanDevice, physicalDeviceProperties, PIPELINE_CACHE_PATH))
+        {
+            return false;
+        }
+
+        if (!m_UploadQueue.Initialize(m_VulkanDevice, &m_MemoryAllocator, m_TransferFamilyIndex, m_TransferQueue,
+                                      m_GraphicsFamilyIndex, m_GraphicsQueue))
+        {
+            return false;
+        }
+
         if (!CreateSwapChain())
         {
             return false;
@@ -871,6 +1034,9 @@ namespace aga
             return false;
         }
 
+        //  Texture, vertices and indices go to the device in a single submission
+        m_UploadQueue.Flush();
+
         if (!CreateCommandBuffers())
         {
             return false;
@@ -881,12 +1047,39 @@ namespace aga
             return false;
         }
 
+#if BUILD_ENABLE_SHADER_HOT_RELOAD
+        _WatchShaderSources();
+#endif
+
         return true;
     }
 
     void VulkanRenderer::Destroy()
     {
+        for (FileWatchHandle watch : m_ShaderWatches)
+        {
+            PlatformFileSystem::getInstance()->UnwatchFile(watch);
+        }
+
+        m_ShaderWatches.clear();
+
+        //  Compiles still running are waited for, their completions find no request and do nothing
+        std::vector<FileRequestHandle> compileRequests;
+        compileRequests.swap(m_ShaderCompileRequests);
+
+        for (FileRequestHandle request : compileRequests)
+        {
+            if (!PlatformFileSystem::getInstance()->CancelRequest(request))
+            {
+                PlatformFileSystem::getInstance()->WaitForRequest(request);
+            }
+        }
+
+        m_UploadQueue.Destroy();
+        m_MemoryAllocator.LogStatistics();
+
         DestroySwapChain();
+        DestroyUniformBuffers();
         DestroyTextureSampler();
         DestroyTextureImageView();
         DestroyTextureImage();
@@ -895,6 +1088,7 @@ namespace aga
         DestroyVertexBuffer();
         DestroySynchronizations();
         DestroyCommandPool();
+        m_PipelineCache.Destroy();
         _DestroyLogicalDevice();
 
 #if BUILD_ENABLE_VULKAN_DEBUG
@@ -909,6 +1103,121 @@ namespace aga
         m_PlatformWindow = window;
     }
 
+    void VulkanRenderer::SetHeadless(uint32_t width, uint32_t height)
+    {
+        m_IsHeadless = true;
+        m_SurfaceWidth = width;
+        m_SurfaceHeight = height;
+    }
+
+    void VulkanRenderer::SetSceneDrawCount(uint32_t count)
+    {
+        //  A square grid covering the area of the single quad
+        const uint32_t side = (uint32_t)::ceil(::sqrt((double)count));
+        const real_t cell = 1.0f / std::max(side, 1u);
+
+        m_Transforms.Clear();
+        m_Transforms.Reserve(count);
+
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            const Vector3 position(-0.5f + (i % side + 0.5f) * cell, -0.5f + (i / side + 0.5f) * cell, 0.0f);
+
+            m_Transforms.Add(position, Vector3(cell, cell, cell));
+        }
+    }
+
+    bool VulkanRenderer::IsHeadless() const
+    {
+        return m_IsHeadless;
+    }
+
+    void VulkanRenderer::SetFrameReadback(FrameReadbackCallback callback)
+    {
+        m_FrameReadback = std::move(callback);
+    }
+
+    void VulkanRenderer::FlushReadbacks()
+    {
+        MemoryTagScope scope(MemoryTag::Render);
+
+        if (!m_IsHeadless)
+        {
+            return;
+        }
+
+        //  Oldest first, the image of the current frame was written longest ago
+        for (uint32_t i = 0; i < m_SwapChainImageCount; ++i)
+        {
+            _ReadBackFrame((uint32_t)((m_CurrentFrame + i) % m_SwapChainImageCount));
+        }
+    }
+
+    bool VulkanRenderer::_CreateOffscreenImages()
+    {
+        m_SurfaceFormat.format = HEADLESS_FORMAT;
+        m_SurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+        m_SwapChainImageCount = MAX_FRAMES_IN_PROCESS;
+
+        m_SwapChainImages.resize(m_SwapChainImageCount);
+        m_OffscreenImagesMemory.resize(m_SwapChainImageCount);
+        m_ReadbackBuffers.resize(m_SwapChainImageCount);
+        m_ReadbackBuffersMemory.resize(m_SwapChainImageCount);
+        m_ReadbackFrames.assign(m_SwapChainImageCount, HEADLESS_NO_FRAME);
+
+        const VkDeviceSize readbackSize = (VkDeviceSize)m_SurfaceWidth * m_SurfaceHeight * 4;
+
+        for (uint32_t i = 0; i < m_SwapChainImageCount; ++i)
+        {
+            _CreateImage(m_SurfaceWidth, m_SurfaceHeight, HEADLESS_FORMAT, VK_IMAGE_TILING_OPTIMAL,
+                         VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_SwapChainImages[i], m_OffscreenImagesMemory[i]);
+
+            _CreateBuffer(readbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                          m_ReadbackBuffers[i], m_ReadbackBuffersMemory[i]);
+        }
+
+        LOG_DEBUG_FMT_F("VulkanRenderer {}x{} offscreen images created\n", m_SurfaceWidth, m_SurfaceHeight);
+
+        return true;
+    }
+
+    void VulkanRenderer::_DestroyOffscreenImages()
+    {
+        for (uint32_t i = 0; i < m_OffscreenImagesMemory.size(); ++i)
+        {
+            vkDestroyImage(m_VulkanDevice, m_SwapChainImages[i], VK_NULL_HANDLE);
+            m_MemoryAllocator.Free(m_OffscreenImagesMemory[i]);
+
+            vkDestroyBuffer(m_VulkanDevice, m_ReadbackBuffers[i], VK_NULL_HANDLE);
+            m_MemoryAllocator.Free(m_ReadbackBuffersMemory[i]);
+        }
+
+        m_OffscreenImagesMemory.clear();
+        m_ReadbackBuffers.clear();
+        m_ReadbackBuffersMemory.clear();
+        m_ReadbackFrames.clear();
+
+        LOG_DEBUG_F("VulkanRenderer offscreen images destroyed\n");
+    }
+
+    void VulkanRenderer::_ReadBackFrame(uint32_t image)
+    {
+        if (m_ReadbackFrames[image] == HEADLESS_NO_FRAME)
+        {
+            return;
+        }
+
+        if (m_FrameReadback)
+        {
+            m_FrameReadback(m_ReadbackFrames[image], m_ReadbackBuffersMemory[image].Mapped, m_SurfaceWidth,
+                            m_SurfaceHeight);
+        }
+
+        m_ReadbackFrames[image] = HEADLESS_NO_FRAME;
+    }
+
     void VulkanRenderer::_PrepareExtensions()
     {
 #if BUILD_ENABLE_VULKAN_DEBUG
@@ -933,18 +1242,39 @@ namespace aga
         }
 
         m_InstanceExtensions.push_back(VK_EXT_DEBUG_REPORT_EXTENSION_NAME);
-        m_InstanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
-
-        std::vector<const char *> requiredExtensions = Platform::getInstance()->GetRequiredExtensions();
 
-        for (const char *ext : requiredExtensions)
+        //  Headless rendering does not touch the window system
+        if (!m_IsHeadless)
         {
-            m_InstanceExtensions.push_back(ext);
+            m_InstanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+
+            std::vector<const char *> requiredExtensions = Platform::getInstance()->GetRequiredExtensions();
+
+            for (const char *ext : requiredExtensions)
+            {
+                m_InstanceExtensions.push_back(ext);
+            }
         }
 
-        // Prepare validation layers as well
+        uint32_t layerCount = 0;
+        vkEnumerateInstanceLayerProperties(&layerCount, nullptr);
+        std::vector<VkLayerProperties> layers(layerCount);
+        vkEnumerateInstanceLayerProperties(&layerCount, layers.data());
+
+        // Prepare validation layers as well, machines without the SDK (build servers) simply run without them
         for (const char *layer : g_ValidationLayers)
         {
+            const bool isAvailable = std::any_of(layers.begin(), layers.end(), [layer](const VkLayerProperties &p) {
+                return strcmp(p.layerName, layer) == 0;
+            });
+
+            if (!isAvailable)
+            {
+                LOG_WARNING_FMT_F("Validation layer {} is not available\n", layer);
+
+                continue;
+            }
+
             m_InstanceLayers.push_back(layer);
             m_DeviceLayers.push_back(layer);
         }
@@ -978,7 +1308,10 @@ namespace aga
 
         LOG_DEBUG_F("vkCreateInstance succeeded\n");
 
-        m_VulkanSurface = m_PlatformWindow->CreateVulkanSurface();
+        if (!m_IsHeadless)
+        {
+            m_VulkanSurface = m_PlatformWindow->CreateVulkanSurface();
+        }
 
         return true;
     }
@@ -1004,7 +1337,10 @@ namespace aga
 
     bool VulkanRenderer::_InitPhysicalDevice()
     {
-        m_DeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        if (!m_IsHeadless)
+        {
+            m_DeviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
 
         uint32_t physicalDevicesCount = 0;
         vkEnumeratePhysicalDevices(m_VulkanInstance, &physicalDevicesCount, VK_NULL_HANDLE);
@@ -1087,7 +1423,7 @@ namespace aga
     bool VulkanRenderer::_InitLogicalDevice()
     {
         std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::set<uint32_t> uniqueQueueFamilies = {m_GraphicsFamilyIndex, m_PresentFamilyIndex};
+        std::set<uint32_t> uniqueQueueFamilies = {m_GraphicsFamilyIndex, m_PresentFamilyIndex, m_TransferFamilyIndex};
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -1109,15 +1445,40 @@ namespace aga
         deviceCreateInfo.pQueueCreateInfos = queueCreateInfos.data();
         deviceCreateInfo.enabledLayerCount = m_DeviceLayers.size();
         deviceCreateInfo.ppEnabledLayerNames = m_DeviceLayers.data();
+        deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
+
+        //  Optional, gives the memory allocator the real budget of each heap
+        uint32_t extensionCount = 0;
+        vkEnumerateDeviceExtensionProperties(m_VulkanPhysicalDevice, VK_NULL_HANDLE, &extensionCount, VK_NULL_HANDLE);
+        std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+        vkEnumerateDeviceExtensionProperties(m_VulkanPhysicalDevice, VK_NULL_HANDLE, &extensionCount,
+                                             availableExtensions.data());
+
+        bool isMemoryBudgetEnabled = false;
+
+        for (const VkExtensionProperties &extension : availableExtensions)
+        {
+            if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0)
+            {
+                m_DeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+                isMemoryBudgetEnabled = true;
+            }
+        }
+
         deviceCreateInfo.enabledExtensionCount = m_DeviceExtensions.size();
         deviceCreateInfo.ppEnabledExtensionNames = m_DeviceExtensions.data();
-        deviceCreateInfo.pEnabledFeatures = &deviceFeatures;
 
         CheckResult(vkCreateDevice(m_VulkanPhysicalDevice, &deviceCreateInfo, VK_NULL_HANDLE, &m_VulkanDevice),
                     "Create Logical Device failed!\n");
 
         vkGetDeviceQueue(m_VulkanDevice, m_GraphicsFamilyIndex, 0, &m_GraphicsQueue);
         vkGetDeviceQueue(m_VulkanDevice, m_PresentFamilyIndex, 0, &m_PresentQueue);
+        vkGetDeviceQueue(m_VulkanDevice, m_TransferFamilyIndex, 0, &m_TransferQueue);
+
+        if (!m_MemoryAllocator.Initialize(m_VulkanPhysicalDevice, m_VulkanDevice, isMemoryBudgetEnabled))
+        {
+            return false;
+        }
 
         LOG_DEBUG_F("Create Logical Device succeeded\n");
 
@@ -1136,7 +1497,16 @@ namespace aga
         for (uint32_t i = 0; i < queueFamilyProperyCount; ++i)
         {
             VkBool32 presentSupport = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_VulkanSurface, &presentSupport);
+
+            //  Without a surface the graphics queue stands in for presentation
+            if (m_IsHeadless)
+            {
+                presentSupport = (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0;
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_VulkanSurface, &presentSupport);
+            }
 
             if (queueFamilyProperties[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
             {
@@ -1156,6 +1526,20 @@ namespace aga
             }
         }
 
+        indices.TransferIndex = indices.GraphicsIndex;
+
+        for (uint32_t i = 0; i < queueFamilyProperyCount; ++i)
+        {
+            const VkQueueFlags flags = queueFamilyProperties[i].queueFlags;
+
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                indices.TransferIndex = i;
+
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -1170,11 +1554,12 @@ namespace aga
         {
             m_GraphicsFamilyIndex = indices.GraphicsIndex;
             m_PresentFamilyIndex = indices.PresentIndex;
+            m_TransferFamilyIndex = indices.TransferIndex;
         }
         else
         {
-            LOG_WARNING_F("Can not find queue family supporting graphics for device: " + deviceProperties.deviceName +
-                          "!\n");
+            LOG_WARNING_FMT_F("Can not find queue family supporting graphics for device: {}!\n",
+                              deviceProperties.deviceName);
         }
 
         // Check if selected physical device supports all required extensions
@@ -1190,8 +1575,8 @@ namespace aga
             requiredExtensions.erase(extension.extensionName);
         }
 
-        bool swapChainAdequate = false;
-        if (requiredExtensions.empty())
+        bool swapChainAdequate = m_IsHeadless;
+        if (requiredExtensions.empty() && !m_IsHeadless)
         {
             SwapChainSupportDetails swapChainSupport = FindSwapChainDetails(device);
             swapChainAdequate = !swapChainSupport.Formats.empty() && !swapChainSupport.PresentModes.empty();
@@ -1200,8 +1585,12 @@ namespace aga
         VkPhysicalDeviceFeatures supportedFeatures;
         vkGetPhysicalDeviceFeatures(device, &supportedFeatures);
 
-        return deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU && indices.IsValid() &&
-               requiredExtensions.empty() && swapChainAdequate && supportedFeatures.samplerAnisotropy;
+        //  Headless takes whatever is there, CPU implementations like lavapipe included
+        const bool isTypeAdequate =
+            m_IsHeadless || deviceProperties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+
+        return isTypeAdequate && indices.IsValid() && requiredExtensions.empty() && swapChainAdequate &&
+               supportedFeatures.samplerAnisotropy;
     }
 
     SwapChainSupportDetails VulkanRenderer::FindSwapChainDetails(VkPhysicalDevice device)
@@ -1248,15 +1637,28 @@ namespace aga
 
     VkPresentModeKHR VulkanRenderer::_ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes)
     {
+        //  FIFO is the only mode every device supports
+        if (m_IsVSyncEnabled)
+        {
+            return VK_PRESENT_MODE_FIFO_KHR;
+        }
+
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+
         for (const VkPresentModeKHR &availablePresentMode : availablePresentModes)
         {
             if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR)
             {
                 return availablePresentMode;
             }
+
+            if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR)
+            {
+                presentMode = availablePresentMode;
+            }
         }
 
-        return VK_PRESENT_MODE_FIFO_KHR;
+        return presentMode;
     }
 
     Rect2D VulkanRenderer::_ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities)
@@ -1283,6 +1685,8 @@ namespace aga
     {
         if (m_VulkanDevice)
         {
+            m_MemoryAllocator.Destroy();
+
             vkDestroyDevice(m_VulkanDevice, VK_NULL_HANDLE);
             m_VulkanDevice = VK_NULL_HANDLE;
 
@@ -1333,53 +1737,32 @@ namespace aga
         VkCommandPoolCreateInfo poolCreateInfo = {};
         poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
         poolCreateInfo.queueFamilyIndex = m_GraphicsFamilyIndex;
+        //  Recorded once, submitted once and reset with the whole pool
+        poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
 
-        CheckResult(vkCreateCommandPool(m_VulkanDevice, &poolCreateInfo, VK_NULL_HANDLE, &m_CommandPool),
-                    "Error while creating Command Pool");
-
-        return true;
-    }
-
-    uint32_t VulkanRenderer::_FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-    {
-        VkPhysicalDeviceMemoryProperties memProperties;
-        vkGetPhysicalDeviceMemoryProperties(m_VulkanPhysicalDevice, &memProperties);
+        m_FrameCommandPools.resize(MAX_FRAMES_IN_PROCESS);
 
-        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+        for (VkCommandPool &pool : m_FrameCommandPools)
         {
-            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-            {
-                return i;
-            }
+            CheckResult(vkCreateCommandPool(m_VulkanDevice, &poolCreateInfo, VK_NULL_HANDLE, &pool),
+                        "Error while creating Command Pool");
         }
 
-        CheckResult(VK_ERROR_UNKNOWN, "Failed to find suitable memory type!");
-
-        return -1;
+        return true;
     }
 
     bool VulkanRenderer::CreateVertexBuffer()
     {
         VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        _CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                      stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(m_VulkanDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(m_VulkanDevice, stagingBufferMemory);
-
         _CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_IndexBuffer, m_IndexBufferMemory);
 
-        _CopyBuffer(stagingBuffer, m_IndexBuffer, bufferSize);
-
-        vkDestroyBuffer(m_VulkanDevice, stagingBuffer, nullptr);
-        vkFreeMemory(m_VulkanDevice, stagingBufferMemory, nullptr);
+        if (!m_UploadQueue.UploadBuffer(m_IndexBuffer, 0, indices.data(), bufferSize,
+                                        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT))
+        {
+            return false;
+        }
 
         LOG_DEBUG_F("Vulkan Vertex Buffer created\n");
 
@@ -1389,7 +1772,7 @@ namespace aga
     void VulkanRenderer::DestroyVertexBuffer()
     {
         vkDestroyBuffer(m_VulkanDevice, m_VertexBuffer, nullptr);
-        vkFreeMemory(m_VulkanDevice, m_VertexBufferMemory, nullptr);
+        m_MemoryAllocator.Free(m_VertexBufferMemory);
 
         LOG_DEBUG_F("Vulkan Vertex Buffer destroyed\n");
     }
@@ -1398,24 +1781,14 @@ namespace aga
     {
         VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        _CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                      stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(m_VulkanDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-        memcpy(data, vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(m_VulkanDevice, stagingBufferMemory);
-
         _CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                       VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_VertexBuffer, m_VertexBufferMemory);
 
-        _CopyBuffer(stagingBuffer, m_VertexBuffer, bufferSize);
-
-        vkDestroyBuffer(m_VulkanDevice, stagingBuffer, nullptr);
-        vkFreeMemory(m_VulkanDevice, stagingBufferMemory, nullptr);
+        if (!m_UploadQueue.UploadBuffer(m_VertexBuffer, 0, vertices.data(), bufferSize,
+                                        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT))
+        {
+            return false;
+        }
 
         LOG_DEBUG_F("Vulkan Vertex Buffer created\n");
 
@@ -1425,23 +1798,28 @@ namespace aga
     void VulkanRenderer::DestroyIndexBuffer()
     {
         vkDestroyBuffer(m_VulkanDevice, m_IndexBuffer, nullptr);
-        vkFreeMemory(m_VulkanDevice, m_IndexBufferMemory, nullptr);
+        m_MemoryAllocator.Free(m_IndexBufferMemory);
 
         LOG_DEBUG_F("Vulkan Index Buffer destroyed\n");
     }
 
     bool VulkanRenderer::CreateUniformBuffers()
     {
-        VkDeviceSize bufferSize = sizeof(UniformBufferObject);
+        VkPhysicalDeviceProperties physicalDeviceProperties = {};
+        vkGetPhysicalDeviceProperties(m_VulkanPhysicalDevice, &physicalDeviceProperties);
 
-        m_UniformBuffers.resize(m_SwapChainImages.size());
-        m_UniformBuffersMemory.resize(m_SwapChainImages.size());
+        const VkDeviceSize alignment = physicalDeviceProperties.limits.minUniformBufferOffsetAlignment;
+        m_DrawUniformStride = (uint32_t)((sizeof(UniformBufferObject) + alignment - 1) / alignment * alignment);
 
-        for (size_t i = 0; i < m_SwapChainImages.size(); i++)
+        //  Every transform of the scene fits into a frame's region
+        const VkDeviceSize frameSize =
+            std::max(UNIFORM_FRAME_SIZE, (VkDeviceSize)m_DrawUniformStride * m_Transforms.GetCount());
+
+        //  Split by frame in flight rather than swap chain image, so it outlives swap chain recreation
+        if (!m_UniformAllocator.Initialize(m_VulkanDevice, &m_MemoryAllocator, alignment, MAX_FRAMES_IN_PROCESS,
+                                           frameSize))
         {
-            _CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                          m_UniformBuffers[i], m_UniformBuffersMemory[i]);
+            return false;
         }
 
         LOG_DEBUG_F("Vulkan Uniforms Buffers created\n");
@@ -1451,11 +1829,7 @@ namespace aga
 
     void VulkanRenderer::DestroyUniformBuffers()
     {
-        for (size_t i = 0; i < m_SwapChainImages.size(); i++)
-        {
-            vkDestroyBuffer(m_VulkanDevice, m_UniformBuffers[i], nullptr);
-            vkFreeMemory(m_VulkanDevice, m_UniformBuffersMemory[i], nullptr);
-        }
+        m_UniformAllocator.Destroy();
 
         LOG_DEBUG_F("Vulkan Uniforms Buffers destroyed\n");
     }
@@ -1463,16 +1837,16 @@ namespace aga
     bool VulkanRenderer::CreateDescriptorPool()
     {
         std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-        poolSizes[0].descriptorCount = static_cast<uint32_t>(m_SwapChainImages.size());
+        poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        poolSizes[0].descriptorCount = 1;
         poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-        poolSizes[1].descriptorCount = static_cast<uint32_t>(m_SwapChainImages.size());
+        poolSizes[1].descriptorCount = 1;
 
         VkDescriptorPoolCreateInfo poolInfo = {};
         poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
         poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
         poolInfo.pPoolSizes = poolSizes.data();
-        poolInfo.maxSets = static_cast<uint32_t>(m_SwapChainImages.size());
+        poolInfo.maxSets = 1;
 
         CheckResult(vkCreateDescriptorPool(m_VulkanDevice, &poolInfo, nullptr, &m_DescriptorPool),
                     "failed to create descriptor pool!");
@@ -1491,51 +1865,46 @@ namespace aga
 
     bool VulkanRenderer::CreateDescriptorSets()
     {
-        std::vector<VkDescriptorSetLayout> layouts(m_SwapChainImages.size(), m_DescriptorSetLayout);
         VkDescriptorSetAllocateInfo allocInfo = {};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = m_DescriptorPool;
-        allocInfo.descriptorSetCount = static_cast<uint32_t>(m_SwapChainImages.size());
-        allocInfo.pSetLayouts = layouts.data();
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &m_DescriptorSetLayout;
 
-        m_DescriptorSets.resize(m_SwapChainImages.size());
-
-        CheckResult(vkAllocateDescriptorSets(m_VulkanDevice, &allocInfo, m_DescriptorSets.data()),
+        CheckResult(vkAllocateDescriptorSets(m_VulkanDevice, &allocInfo, &m_DescriptorSet),
                     "Failed to allocate descriptor sets!");
 
-        for (size_t i = 0; i < m_SwapChainImages.size(); i++)
-        {
-            VkDescriptorBufferInfo bufferInfo = {};
-            bufferInfo.buffer = m_UniformBuffers[i];
-            bufferInfo.offset = 0;
-            bufferInfo.range = sizeof(UniformBufferObject);
-
-            VkDescriptorImageInfo imageInfo = {};
-            imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            imageInfo.imageView = m_TextureImageView;
-            imageInfo.sampler = m_TextureSampler;
-
-            std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
-
-            descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[0].dstSet = m_DescriptorSets[i];
-            descriptorWrites[0].dstBinding = 0;
-            descriptorWrites[0].dstArrayElement = 0;
-            descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            descriptorWrites[0].descriptorCount = 1;
-            descriptorWrites[0].pBufferInfo = &bufferInfo;
-
-            descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-            descriptorWrites[1].dstSet = m_DescriptorSets[i];
-            descriptorWrites[1].dstBinding = 1;
-            descriptorWrites[1].dstArrayElement = 0;
-            descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-            descriptorWrites[1].descriptorCount = 1;
-            descriptorWrites[1].pImageInfo = &imageInfo;
-
-            vkUpdateDescriptorSets(m_VulkanDevice, static_cast<uint32_t>(descriptorWrites.size()),
-                                   descriptorWrites.data(), 0, VK_NULL_HANDLE);
-        }
+        //  Covers one draw's uniforms, the dynamic offset given at bind time selects which
+        VkDescriptorBufferInfo bufferInfo = {};
+        bufferInfo.buffer = m_UniformAllocator.GetBuffer();
+        bufferInfo.offset = 0;
+        bufferInfo.range = sizeof(UniformBufferObject);
+
+        VkDescriptorImageInfo imageInfo = {};
+        imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        imageInfo.imageView = m_TextureImageView;
+        imageInfo.sampler = m_TextureSampler;
+
+        std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+
+        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[0].dstSet = m_DescriptorSet;
+        descriptorWrites[0].dstBinding = 0;
+        descriptorWrites[0].dstArrayElement = 0;
+        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[0].descriptorCount = 1;
+        descriptorWrites[0].pBufferInfo = &bufferInfo;
+
+        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[1].dstSet = m_DescriptorSet;
+        descriptorWrites[1].dstBinding = 1;
+        descriptorWrites[1].dstArrayElement = 0;
+        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptorWrites[1].descriptorCount = 1;
+        descriptorWrites[1].pImageInfo = &imageInfo;
+
+        vkUpdateDescriptorSets(m_VulkanDevice, static_cast<uint32_t>(descriptorWrites.size()),
+                               descriptorWrites.data(), 0, VK_NULL_HANDLE);
 
         LOG_DEBUG_F("Vulkan Descriptor Sets created\n");
 
@@ -1549,10 +1918,16 @@ namespace aga
 
     bool VulkanRenderer::CreateTextureImage()
     {
+        //  Requested at the start of Initialize, normally done by now
+        PlatformFileSystem::getInstance()->WaitForRequest(m_TextureFileRequest);
+
         int texWidth, texHeight, texChannels;
-        stbi_uc *pixels = stbi_load("data/textures/logo.png", &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+        stbi_uc *pixels = stbi_load_from_memory(m_TextureFileData.data(), (int)m_TextureFileData.size(), &texWidth,
+                                                &texHeight, &texChannels, STBI_rgb_alpha);
         VkDeviceSize imageSize = texWidth * texHeight * 4;
 
+        std::vector<uint8_t>().swap(m_TextureFileData);
+
         if (!pixels)
         {
             LOG_ERROR_F("Failed to load texture image!");
@@ -1560,32 +1935,19 @@ namespace aga
             return false;
         }
 
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingBufferMemory;
-        _CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer,
-                      stagingBufferMemory);
-
-        void *data;
-        vkMapMemory(m_VulkanDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(imageSize));
-        vkUnmapMemory(m_VulkanDevice, stagingBufferMemory);
-
-        stbi_image_free(pixels);
-
         _CreateImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
                      VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
                      m_TextureImage, m_TextureImageMemory);
 
-        _TransitionImageLayout(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        _CopyBufferToImage(stagingBuffer, m_TextureImage, static_cast<uint32_t>(texWidth),
-                           static_cast<uint32_t>(texHeight));
-        _TransitionImageLayout(m_TextureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                               VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        const bool isUploaded = m_UploadQueue.UploadImage(m_TextureImage, static_cast<uint32_t>(texWidth),
+                                                          static_cast<uint32_t>(texHeight), pixels, imageSize);
+
+        stbi_image_free(pixels);
 
-        vkDestroyBuffer(m_VulkanDevice, stagingBuffer, VK_NULL_HANDLE);
-        vkFreeMemory(m_VulkanDevice, stagingBufferMemory, VK_NULL_HANDLE);
+        if (!isUploaded)
+        {
+            return false;
+        }
 
         return true;
     }
@@ -1593,7 +1955,7 @@ namespace aga
     void VulkanRenderer::DestroyTextureImage()
     {
         vkDestroyImage(m_VulkanDevice, m_TextureImage, VK_NULL_HANDLE);
-        vkFreeMemory(m_VulkanDevice, m_TextureImageMemory, VK_NULL_HANDLE);
+        m_MemoryAllocator.Free(m_TextureImageMemory);
     }
 
     bool VulkanRenderer::CreateTextureImageView()
@@ -1656,116 +2018,9 @@ namespace aga
         return imageView;
     }
 
-    VkCommandBuffer VulkanRenderer::_BeginSingleTimeCommands()
-    {
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandPool = m_CommandPool;
-        allocInfo.commandBufferCount = 1;
-
-        VkCommandBuffer commandBuffer;
-        CheckResult(vkAllocateCommandBuffers(m_VulkanDevice, &allocInfo, &commandBuffer),
-                    "Failed to create Command Buffer for CopyBuffer operation");
-
-        VkCommandBufferBeginInfo beginInfo = {};
-        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-        CheckResult(vkBeginCommandBuffer(commandBuffer, &beginInfo), "Error during CopyBuffer operation");
-
-        return commandBuffer;
-    }
-
-    void VulkanRenderer::_EndSingleTimeCommands(VkCommandBuffer commandBuffer)
-    {
-        CheckResult(vkEndCommandBuffer(commandBuffer), "Error during CopyBuffer operation");
-
-        VkSubmitInfo submitInfo = {};
-        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        CheckResult(vkQueueSubmit(m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE),
-                    "Error during CopyBuffer operation");
-        CheckResult(vkQueueWaitIdle(m_GraphicsQueue), "Error during CopyBuffer operation");
-
-        vkFreeCommandBuffers(m_VulkanDevice, m_CommandPool, 1, &commandBuffer);
-    }
-
-    void VulkanRenderer::_TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout,
-                                                VkImageLayout newLayout)
-    {
-        VkCommandBuffer commandBuffer = _BeginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = oldLayout;
-        barrier.newLayout = newLayout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags sourceStage;
-        VkPipelineStageFlags destinationStage;
-
-        if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        }
-        else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-                 newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else
-        {
-            LOG_ERROR_F("Unsupported layout transition!");
-
-            std::exit(-1);
-        }
-
-        vkCmdPipelineBarrier(commandBuffer, sourceStage, destinationStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-        _EndSingleTimeCommands(commandBuffer);
-    }
-
-    void VulkanRenderer::_CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-    {
-        VkCommandBuffer commandBuffer = _BeginSingleTimeCommands();
-
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        _EndSingleTimeCommands(commandBuffer);
-    }
-
     void VulkanRenderer::_CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
                                       VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image,
-                                      VkDeviceMemory &imageMemory)
+                                      DeviceAllocation &imageMemory)
     {
         VkImageCreateInfo imageInfo = {};
         imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1784,22 +2039,14 @@ namespace aga
 
         CheckResult(vkCreateImage(m_VulkanDevice, &imageInfo, nullptr, &image), "Failed to create image!");
 
-        VkMemoryRequirements memRequirements;
-        vkGetImageMemoryRequirements(m_VulkanDevice, image, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = _FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-        CheckResult(vkAllocateMemory(m_VulkanDevice, &allocInfo, nullptr, &imageMemory),
-                    "Failed to allocate image memory!");
-
-        vkBindImageMemory(m_VulkanDevice, image, imageMemory, 0);
+        if (!m_MemoryAllocator.AllocateImage(image, tiling, properties, imageMemory))
+        {
+            CheckResult(VK_ERROR_OUT_OF_DEVICE_MEMORY, "Failed to allocate image memory!");
+        }
     }
 
     void VulkanRenderer::_CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                                       VkBuffer &buffer, VkDeviceMemory &bufferMemory)
+                                       VkBuffer &buffer, DeviceAllocation &bufferMemory)
     {
         VkBufferCreateInfo bufferInfo = {};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1809,110 +2056,181 @@ namespace aga
 
         CheckResult(vkCreateBuffer(m_VulkanDevice, &bufferInfo, nullptr, &buffer), "Failed to create vertex buffer!");
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(m_VulkanDevice, buffer, &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = _FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-        CheckResult(vkAllocateMemory(m_VulkanDevice, &allocInfo, nullptr, &bufferMemory),
-                    "Failed to allocate buffer memory!");
+        if (!m_MemoryAllocator.AllocateBuffer(buffer, properties, bufferMemory))
+        {
+            CheckResult(VK_ERROR_OUT_OF_DEVICE_MEMORY, "Failed to allocate buffer memory!");
+        }
+    }
 
-        CheckResult(vkBindBufferMemory(m_VulkanDevice, buffer, bufferMemory, 0), "Can't bind memory for a Buffer");
+    void VulkanRenderer::Update(real_t step)
+    {
+        m_PreviousModelAngle = m_ModelAngle;
+        m_ModelAngle += step * DegToRad(30.0f);
     }
 
-    void VulkanRenderer::_CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+    void VulkanRenderer::Interpolate(real_t alpha)
     {
-        VkCommandBuffer commandBuffer = _BeginSingleTimeCommands();
+        MemoryTagScope scope(MemoryTag::Render);
+
+        const real_t angle = m_PreviousModelAngle + (m_ModelAngle - m_PreviousModelAngle) * alpha;
+
+        //  Every copy turns about z by the same angle
+        const real_t sine = ::sin(angle * 0.5f);
+        const real_t cosine = ::cos(angle * 0.5f);
+
+        for (uint32_t i = 0; i < m_Transforms.GetCount(); ++i)
         {
-            VkBufferCopy copyRegion = {};
-            copyRegion.size = size;
-            vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
+            m_Transforms.SetRotation(i, 0.0f, 0.0f, sine, cosine);
         }
-        _EndSingleTimeCommands(commandBuffer);
     }
 
     void VulkanRenderer::_UpdateUniformBuffer()
     {
-        static auto startTime = std::chrono::high_resolution_clock::now();
-
-        auto currentTime = std::chrono::high_resolution_clock::now();
-        float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-
         UniformBufferObject ubo = {};
-        ubo.Model = ubo.Model.SetRotationAxisRadians(time * DegToRad(30.0f), Vector3(0.0f, 0.0f, 1.0f));
         ubo.View = ubo.View.LookAt(Vector3(2.0f, 2.0f, 2.0f), Vector3(0.0f, 0.0f, 0.0f), Vector3(0.0f, 0.0f, 1.0f));
         ubo.Projection = ubo.Projection.ProjectionMatrixPerspectiveFov(
             DegToRad(45.0f), m_SurfaceWidth / (real_t)m_SurfaceHeight, 0.1f, 10.0f);
         ubo.Projection[1][1] *= -1;
 
-        void *data;
-        vkMapMemory(m_VulkanDevice, m_UniformBuffersMemory[m_ActiveSwapChainImageID], 0, sizeof(ubo), 0, &data);
-        memcpy(data, &ubo, sizeof(ubo));
-        vkUnmapMemory(m_VulkanDevice, m_UniformBuffersMemory[m_ActiveSwapChainImageID]);
+        //  The fence of this frame in flight was waited for, its previous uniforms are no longer read
+        m_UniformAllocator.BeginFrame((uint32_t)m_CurrentFrame);
+
+        //  One block per transform, draws pick theirs with a dynamic offset
+        const uint32_t drawCount = m_Transforms.GetCount();
+        uint8_t *data = m_UniformAllocator.Allocate((VkDeviceSize)m_DrawUniformStride * drawCount, m_DrawUniformOffset);
+
+        if (data == nullptr)
+        {
+            return;
+        }
+
+        //  Model matrices are composed straight into the mapped buffer, View and Projection follow each of them
+        m_Transforms.ComposeWorldMatrices(data + offsetof(UniformBufferObject, Model), m_DrawUniformStride);
+
+        for (uint32_t i = 0; i < drawCount; ++i)
+        {
+            memcpy(data + i * m_DrawUniformStride + offsetof(UniformBufferObject, View), &ubo.View,
+                   sizeof(ubo) - offsetof(UniformBufferObject, View));
+        }
     }
 
     bool VulkanRenderer::CreateCommandBuffers()
     {
-        m_CommandBuffers.resize(m_FrameBuffers.size());
+        m_FrameCommandBuffers.resize(m_FrameCommandPools.size());
+
+        for (size_t i = 0; i < m_FrameCommandPools.size(); ++i)
+        {
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
+            commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            commandBufferAllocateInfo.commandPool = m_FrameCommandPools[i];
+            commandBufferAllocateInfo.commandBufferCount = 1;
+            commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+
+            CheckResult(vkAllocateCommandBuffers(m_VulkanDevice, &commandBufferAllocateInfo, &m_FrameCommandBuffers[i]),
+                        "Error while creating Command Buffers");
+        }
 
-        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {};
-        commandBufferAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        commandBufferAllocateInfo.commandPool = m_CommandPool;
-        commandBufferAllocateInfo.commandBufferCount = (uint32_t)m_CommandBuffers.size();
-        commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        return true;
+    }
 
-        CheckResult(vkAllocateCommandBuffers(m_VulkanDevice, &commandBufferAllocateInfo, m_CommandBuffers.data()),
-                    "Error while creating Command Buffers");
+    void VulkanRenderer::_RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image)
+    {
+        VkCommandBufferBeginInfo commandBufferBeginInfo = {};
+        commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-        for (size_t i = 0; i < m_CommandBuffers.size(); ++i)
+        CheckResult(vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo),
+                    "Error while running vkBeginCommandBuffer");
         {
-            VkCommandBufferBeginInfo commandBufferBeginInfo = {};
-            commandBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            std::array<VkClearValue, 2> clearValues = {};
+            clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
+            clearValues[1].depthStencil = {1.0f, 0};
+
+            VkRenderPassBeginInfo renderPassBeginInfo = {};
+            renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassBeginInfo.renderPass = m_RenderPass;
+            renderPassBeginInfo.framebuffer = m_FrameBuffers[image];
+            renderPassBeginInfo.renderArea.offset = {0, 0};
+            renderPassBeginInfo.renderArea.extent.width = GetSurfaceSize().Size.Width;
+            renderPassBeginInfo.renderArea.extent.height = GetSurfaceSize().Size.Height;
+            renderPassBeginInfo.clearValueCount = clearValues.size();
+            renderPassBeginInfo.pClearValues = clearValues.data();
 
-            CheckResult(vkBeginCommandBuffer(m_CommandBuffers[i], &commandBufferBeginInfo),
-                        "Error while running vkBeginCommandBuffer");
+            vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
+
+            //  Nothing is drawn when the frame ran out of uniform space
+            if (m_DrawUniformOffset != INVALID_UNIFORM_OFFSET)
             {
-                std::array<VkClearValue, 2> clearValues = {};
-                clearValues[0].color = {0.01f, 0.01f, 0.01f, 1.0f};
-                clearValues[1].depthStencil = {1.0f, 0};
-
-                VkRenderPassBeginInfo renderPassBeginInfo = {};
-                renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                renderPassBeginInfo.renderPass = m_RenderPass;
-                renderPassBeginInfo.framebuffer = m_FrameBuffers[i];
-                renderPassBeginInfo.renderArea.offset = {0, 0};
-                renderPassBeginInfo.renderArea.extent.width = GetSurfaceSize().Size.Width;
-                renderPassBeginInfo.renderArea.extent.height = GetSurfaceSize().Size.Height;
-                renderPassBeginInfo.clearValueCount = clearValues.size();
-                renderPassBeginInfo.pClearValues = clearValues.data();
-
-                vkCmdBeginRenderPass(m_CommandBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-                vkCmdBindPipeline(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_GraphicsPipeline);
-
-                VkBuffer vertexBuffers[] = {m_VertexBuffer};
-                VkDeviceSize offsets[] = {0};
-                vkCmdBindVertexBuffers(m_CommandBuffers[i], 0, 1, vertexBuffers, offsets);
-                vkCmdBindIndexBuffer(m_CommandBuffers[i], m_IndexBuffer, 0, VK_INDEX_TYPE_UINT16);
-                vkCmdBindDescriptorSets(m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1,
-                                        &m_DescriptorSets[i], 0, nullptr);
-
-                vkCmdDrawIndexed(m_CommandBuffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
-
-                vkCmdEndRenderPass(m_CommandBuffers[i]);
+                //  Draws of the same mesh follow each other, its buffers are bound only when they change
+                VkBuffer vertexBuffer = VK_NULL_HANDLE;
+                VkBuffer indexBuffer = VK_NULL_HANDLE;
+
+                for (const DrawCommand &draw : m_Draws)
+                {
+                    if (draw.VertexBuffer != vertexBuffer)
+                    {
+                        const VkDeviceSize offset = 0;
+
+                        vertexBuffer = draw.VertexBuffer;
+                        vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+                    }
+
+                    if (draw.IndexBuffer != indexBuffer)
+                    {
+                        indexBuffer = draw.IndexBuffer;
+                        vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+                    }
+
+                    const uint32_t dynamicOffset = m_DrawUniformOffset + draw.Transform * m_DrawUniformStride;
+
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1,
+                                            &m_DescriptorSet, 1, &dynamicOffset);
+                    vkCmdDrawIndexed(commandBuffer, draw.IndexCount, 1, draw.FirstIndex, draw.VertexOffset, 0);
+                }
             }
-            CheckResult(vkEndCommandBuffer(m_CommandBuffers[i]), "Error while running vkEndCommandBuffer");
-        }
 
-        return true;
+            vkCmdEndRenderPass(commandBuffer);
+
+            if (m_IsHeadless)
+            {
+                VkBufferImageCopy region = {};
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.layerCount = 1;
+                region.imageExtent = {m_SurfaceWidth, m_SurfaceHeight, 1};
+
+                vkCmdCopyImageToBuffer(commandBuffer, m_SwapChainImages[image], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                                       m_ReadbackBuffers[image], 1, &region);
+
+                //  Makes the copy visible to the host once the frame's fence signaled
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = m_ReadbackBuffers[image];
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0,
+                                     nullptr, 1, &barrier, 0, nullptr);
+            }
+        }
+        CheckResult(vkEndCommandBuffer(commandBuffer), "Error while running vkEndCommandBuffer");
     }
 
     void VulkanRenderer::DestroyCommandPool()
     {
-        vkDestroyCommandPool(m_VulkanDevice, m_CommandPool, VK_NULL_HANDLE);
+        //  Command buffers go with their pools
+        for (VkCommandPool pool : m_FrameCommandPools)
+        {
+            vkDestroyCommandPool(m_VulkanDevice, pool, VK_NULL_HANDLE);
+        }
+
+        m_FrameCommandPools.clear();
+        m_FrameCommandBuffers.clear();
 
         LOG_DEBUG_F("Vulkan Command Pool destroyed\n");
     }
@@ -1922,16 +2240,19 @@ namespace aga
         DestroyDepthStencilImage();
         DestroyFrameBuffers();
 
-        vkFreeCommandBuffers(m_VulkanDevice, m_CommandPool, static_cast<uint32_t>(m_CommandBuffers.size()),
-                             m_CommandBuffers.data());
-
         DestroyGraphicsPipeline();
         DestroyRenderPass();
         DestroySwapChainImages();
 
-        vkDestroySwapchainKHR(m_VulkanDevice, m_SwapChain, VK_NULL_HANDLE);
+        if (m_IsHeadless)
+        {
+            _DestroyOffscreenImages();
+        }
+        else
+        {
+            vkDestroySwapchainKHR(m_VulkanDevice, m_SwapChain, VK_NULL_HANDLE);
+        }
 
-        DestroyUniformBuffers();
         DestroyDescriptorPool();
 
         LOG_DEBUG_F("VulkanRenderer Vulkan SwapChain destroyed\n");
@@ -1939,6 +2260,8 @@ namespace aga
 
     void VulkanRenderer::RecreateSwapChain()
     {
+        MemoryTagScope scope(MemoryTag::Render);
+
         Vector2 winSize = m_PlatformWindow->GetCurrentWindowSize();
 
         while (winSize.Width == 0 || winSize.Height == 0)
@@ -1957,10 +2280,8 @@ namespace aga
         CreateGraphicsPipeline();
         CreateDepthStencilImage();
         CreateFrameBuffers();
-        CreateUniformBuffers();
         CreateDescriptorPool();
         CreateDescriptorSets();
-        CreateCommandBuffers();
     }
 
     const VkInstance VulkanRenderer::GetVulkanInstance()
@@ -1988,7 +2309,121 @@ namespace aga
         return m_GraphicsQueue;
     }
 
-    void VulkanRenderer::CheckResult(VkResult result, const String &message)
+    void VulkanRenderer::_DestroyRetiredPipelines()
+    {
+        for (VkPipeline pipeline : m_RetiredPipelines)
+        {
+            vkDestroyPipeline(m_VulkanDevice, pipeline, VK_NULL_HANDLE);
+        }
+
+        m_RetiredPipelines.clear();
+    }
+
+#if BUILD_ENABLE_SHADER_HOT_RELOAD
+    void VulkanRenderer::_WatchShaderSources()
+    {
+        PlatformFileSystemBase *fileSystem = PlatformFileSystem::getInstance();
+
+        fileSystem->MountDirectory(SHADER_SOURCE_MOUNT, BUILD_SHADER_SOURCE_DIRECTORY);
+        m_ShaderOverrides = fileSystem->MountMemory(SHADER_OUTPUT_MOUNT, SHADER_OUTPUT_PRIORITY);
+
+        //  "data/shaders/<name>.spv" is compiled from "<name>" in the source directory
+        for (const String &shader : {m_VertexShaderPath, m_FragmentShaderPath})
+        {
+            const char *name = strrchr(shader.GetData(), '/') + 1;
+            const String source = String(SHADER_SOURCE_MOUNT) + "/" + String(name, (uint32_t)strlen(name) - 4);
+
+            const FileWatchHandle watch = fileSystem->WatchFile(
+                source, [this](const String &path) { _OnShaderSourceChanged(path); });
+
+            if (watch != INVALID_FILE_WATCH)
+            {
+                m_ShaderWatches.push_back(watch);
+            }
+        }
+    }
+
+    void VulkanRenderer::_OnShaderSourceChanged(const String &path)
+    {
+        MemoryTagScope scope(MemoryTag::Render);
+
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        PlatformFileSystemBase *fileSystem = PlatformFileSystem::getInstance();
+        FileLocation location;
+
+        if (!fileSystem->ResolvePath(path, location))
+        {
+            return;
+        }
+
+        //  glslc runs on an I/O thread and writes the SPIR-V to its standard output, nothing lands on disk. The
+        //  pipeline is swapped when the main loop dispatches the completion.
+        const String sourcePath = location.NativePath;
+
+        const FileRequestHandle request = fileSystem->ReadSourceAsync(
+            path,
+            [sourcePath](std::vector<uint8_t> &spirv) {
+                return Platform::getInstance()->RunProcess({"glslc", sourcePath, "-o", "-"}, spirv);
+            },
+            [this, path, start](FileReadResult &result) { _OnShaderCompiled(path, result, start); },
+            FilePriorityHigh);
+
+        m_ShaderCompileRequests.push_back(request);
+    }
+
+    void VulkanRenderer::_OnShaderCompiled(const String &path, FileReadResult &result,
+                                           std::chrono::steady_clock::time_point start)
+    {
+        MemoryTagScope scope(MemoryTag::Render);
+
+        auto it = std::find(m_ShaderCompileRequests.begin(), m_ShaderCompileRequests.end(), result.Handle);
+
+        //  Forgotten by Destroy, the renderer is going away
+        if (it == m_ShaderCompileRequests.end())
+        {
+            return;
+        }
+
+        m_ShaderCompileRequests.erase(it);
+
+        if (!result.Success)
+        {
+            LOG_ERROR_FMT_F("Failed to compile {}, the previous shader stays in use\n", path);
+
+            return;
+        }
+
+        PlatformFileSystemBase *fileSystem = PlatformFileSystem::getInstance();
+
+        const String name = String(strrchr(path.GetData(), '/') + 1) + ".spv";
+        const String shader = String(SHADER_OUTPUT_MOUNT) + "/" + name;
+
+        fileSystem->AddMemoryFile(m_ShaderOverrides, name, std::move(result.Data));
+
+        if (shader != m_VertexShaderPath && shader != m_FragmentShaderPath)
+        {
+            return;
+        }
+
+        //  The old pipeline is destroyed once the frames in flight that bound it are done
+        VkPipeline pipeline;
+
+        if (!_CreatePipeline(pipeline))
+        {
+            return;
+        }
+
+        m_RetiredPipelines.push_back(m_GraphicsPipeline);
+        m_GraphicsPipeline = pipeline;
+        m_RetiredPipelineFrames = MAX_FRAMES_IN_PROCESS;
+
+        LOG_INFO_FMT("Reloaded {} in {} ms\n", path,
+                     std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+#endif
+
+    void VulkanRenderer::CheckResult(VkResult result, StringView message)
     {
         if (result != VK_SUCCESS)
         {
@@ -2003,6 +2438,17 @@ namespace aga
         m_FramebufferResized = resized;
     }
 
+    void VulkanRenderer::SetVSync(bool enabled)
+    {
+        if (m_IsVSyncEnabled != enabled)
+        {
+            m_IsVSyncEnabled = enabled;
+
+            //  Rebuilds the swap chain after the next present
+            m_FramebufferResized = m_SwapChain != VK_NULL_HANDLE;
+        }
+    }
+
     uint32_t VulkanRenderer::FindMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties *memoryProperties,
                                                  const VkMemoryRequirements *memoryRequirements,
                                                  const VkMemoryPropertyFlags requiredPropertyFlags)
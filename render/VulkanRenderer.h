@@ -2,9 +2,20 @@
 
 #pragma once
 
+#include "VulkanMemoryAllocator.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanUniformAllocator.h"
+#include "VulkanUploadQueue.h"
+#include "core/FrameAllocator.h"
+#include "core/FramePacer.h"
 #include "core/String.h"
 #include "core/math/Rect2D.h"
+#include "core/math/TransformStorage.h"
 #include "platform/Platform.h"
+#include "platform/PlatformFileSystem.h"
+
+#include <chrono>
+#include <functional>
 
 namespace aga
 {
@@ -18,6 +29,9 @@ namespace aga
         uint32_t GraphicsIndex;
         uint32_t PresentIndex;
 
+        //  Transfer-only family (a DMA engine) when the device has one, GraphicsIndex otherwise
+        uint32_t TransferIndex;
+
         int valid_bit = 0;
 
         bool IsValid()
@@ -33,6 +47,21 @@ namespace aga
         std::vector<VkPresentModeKHR> PresentModes;
     };
 
+    //  One indexed draw with Vertex vertices and 16-bit indices, posed by the model matrix of 'Transform'
+    struct DrawCommand
+    {
+        VkBuffer VertexBuffer;
+        VkBuffer IndexBuffer;
+        uint32_t IndexCount;
+        uint32_t FirstIndex;
+        int32_t VertexOffset;
+        uint32_t Transform;
+    };
+
+    //  Receives a frame rendered in headless mode: tightly packed RGBA rows, valid only during the call
+    typedef std::function<void(uint64_t frame, const uint8_t *pixels, uint32_t width, uint32_t height)>
+        FrameReadbackCallback;
+
     class VulkanRenderer
     {
     public:
@@ -44,10 +73,42 @@ namespace aga
 
         void SetPlatformWindow(PlatformWindowBase *window);
 
+        //  Renders into offscreen images instead of a window's swap chain, any device with a graphics queue will do.
+        //  Has to be called before Initialize.
+        void SetHeadless(uint32_t width, uint32_t height);
+        bool IsHeadless() const;
+
+        //  Headless frames are copied into host memory by the frame itself and handed out once its fence signaled,
+        //  MAX_FRAMES_IN_PROCESS frames later
+        void SetFrameReadback(FrameReadbackCallback callback);
+
+        //  Hands out the frames still waiting for their readback, the device has to be idle
+        void FlushReadbacks();
+
+        //  Advances the scene by one fixed step, independent of the swap chain so it can run while the previous
+        //  frame is submitted
+        void Update(real_t step);
+
+        //  Poses the scene between the previous and the latest step for rendering
+        void Interpolate(real_t alpha);
+
+        //  Draws the demo quads 'count' times on a grid, each with a transform of its own. Has to be called before
+        //  Initialize.
+        void SetSceneDrawCount(uint32_t count);
+
         bool BeginRender();
+
+        //  Adds a draw to the current frame, between BeginRender (which submits the demo scene) and RenderFrame.
+        //  Main thread only.
+        void SubmitDraw(const DrawCommand &draw);
+
+        //  Records the frame's draws into a fresh command buffer and submits it
         bool RenderFrame();
         bool EndRender();
 
+        //  Time RenderFrame spent resetting the command pool and recording, per frame
+        const FrameTimeHistogram &GetRecordTimes() const;
+
         bool CreateSwapChain();
         void DestroySwapChain();
         void RecreateSwapChain();
@@ -114,7 +175,10 @@ namespace aga
 
         void SetFrameBufferResized(bool resized);
 
-        static void CheckResult(VkResult result, const String &message);
+        //  FIFO presentation when enabled, otherwise mailbox or immediate. Takes effect with the next swap chain.
+        void SetVSync(bool enabled);
+
+        static void CheckResult(VkResult result, StringView message);
 
     private:
         void _PrepareExtensions();
@@ -125,20 +189,18 @@ namespace aga
         QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
         SwapChainSupportDetails FindSwapChainDetails(VkPhysicalDevice device);
 
-        VkCommandBuffer _BeginSingleTimeCommands();
-        void _EndSingleTimeCommands(VkCommandBuffer commandBuffer);
-
-        void _TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-        void _CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
         void _CreateImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
                           VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage &image,
-                          VkDeviceMemory &imageMemory);
+                          DeviceAllocation &imageMemory);
         VkImageView _CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
         void _CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-                           VkBuffer &buffer, VkDeviceMemory &bufferMemory);
-        void _CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+                           VkBuffer &buffer, DeviceAllocation &bufferMemory);
         void _UpdateUniformBuffer();
 
+        bool _CreateOffscreenImages();
+        void _DestroyOffscreenImages();
+        void _ReadBackFrame(uint32_t image);
+
         VkSurfaceFormatKHR _ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR> &availableFormats);
         VkPresentModeKHR _ChooseSwapPresentMode(const std::vector<VkPresentModeKHR> &availablePresentModes);
         Rect2D _ChooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
@@ -150,12 +212,20 @@ namespace aga
         bool _InitDebugging();
         bool _DestroyDebugging();
 
-        VkShaderModule _CreateShaderModule(const String &data);
+        VkShaderModule _CreateShaderModule(const MappedFile &data);
+        bool _CreatePipeline(VkPipeline &pipeline);
+        void _DestroyRetiredPipelines();
+
+        void _RecordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t image);
+
+        void _WatchShaderSources();
+        void _OnShaderSourceChanged(const String &path);
+        void _OnShaderCompiled(const String &path, FileReadResult &result,
+                               std::chrono::steady_clock::time_point start);
 
         uint32_t FindMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties *memoryProperties,
                                      const VkMemoryRequirements *memoryRequirements,
                                      const VkMemoryPropertyFlags requiredPropertyFlags);
-        uint32_t _FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
         VkFormat _FindSupportedFormat(const std::vector<VkFormat> &candidates, VkImageTiling tiling,
                                       VkFormatFeatureFlags features);
         VkFormat _FindDepthFormat();
@@ -167,12 +237,23 @@ namespace aga
         VkPhysicalDevice m_VulkanPhysicalDevice;
         uint32_t m_GraphicsFamilyIndex;
         uint32_t m_PresentFamilyIndex;
+        uint32_t m_TransferFamilyIndex;
         VkQueue m_GraphicsQueue;
         VkQueue m_PresentQueue;
+        VkQueue m_TransferQueue;
         VkPhysicalDeviceMemoryProperties m_PhysicalDeviceMemoryProperties;
+        VulkanMemoryAllocator m_MemoryAllocator;
+        VulkanUploadQueue m_UploadQueue;
+        VulkanUniformAllocator m_UniformAllocator;
 
-        VkCommandPool m_CommandPool;
-        std::vector<VkCommandBuffer> m_CommandBuffers;
+        //  One transient pool per frame in flight, reset as a whole once the frame's fence signaled, with the
+        //  command buffer the frame is recorded into
+        std::vector<VkCommandPool> m_FrameCommandPools;
+        std::vector<VkCommandBuffer> m_FrameCommandBuffers;
+
+        //  Lives in the frame arena, only valid between BeginRender and RenderFrame of the same frame
+        FrameVector<DrawCommand> m_Draws;
+        FrameTimeHistogram m_RecordTimes;
 
         std::vector<const char *> m_InstanceLayers;
         std::vector<const char *> m_InstanceExtensions;
@@ -186,6 +267,7 @@ namespace aga
         uint32_t m_SurfaceWidth;
         uint32_t m_SurfaceHeight;
         VkPresentModeKHR m_PresentMode;
+        bool m_IsVSyncEnabled;
         VkSurfaceKHR m_VulkanSurface;
         VkSurfaceCapabilitiesKHR m_SurfaceCapabilities;
         VkFormat m_DepthStencilFormat;
@@ -196,12 +278,35 @@ namespace aga
         uint32_t m_SwapChainImageCount;
         uint32_t m_ActiveSwapChainImageID;
 
+        //  Headless mode owns the images m_SwapChainImages refers to, each one has a persistently mapped buffer its
+        //  frame is copied into
+        bool m_IsHeadless;
+        std::vector<DeviceAllocation> m_OffscreenImagesMemory;
+        std::vector<VkBuffer> m_ReadbackBuffers;
+        std::vector<DeviceAllocation> m_ReadbackBuffersMemory;
+        std::vector<uint64_t> m_ReadbackFrames;
+        uint64_t m_FrameNumber;
+        FrameReadbackCallback m_FrameReadback;
+
         VkDescriptorSetLayout m_DescriptorSetLayout;
         VkDescriptorPool m_DescriptorPool;
-        std::vector<VkDescriptorSet> m_DescriptorSets;
+        //  Shared by all frames, per-draw uniforms are picked with dynamic offsets
+        VkDescriptorSet m_DescriptorSet;
 
+        VulkanPipelineCache m_PipelineCache;
         VkPipelineLayout m_PipelineLayout;
         VkPipeline m_GraphicsPipeline;
+        String m_VertexShaderPath;
+        String m_FragmentShaderPath;
+
+        //  Replaced by a shader reload, destroyed once the fences of all frames in flight were waited for
+        std::vector<VkPipeline> m_RetiredPipelines;
+        uint32_t m_RetiredPipelineFrames;
+
+        MountHandle m_ShaderOverrides;
+        std::vector<FileWatchHandle> m_ShaderWatches;
+        //  glslc runs started by a source change that have not been dispatched yet
+        std::vector<FileRequestHandle> m_ShaderCompileRequests;
 
         std::vector<VkSemaphore> m_ImageAvailableSemaphores;
         std::vector<VkSemaphore> m_RenderFinishedSemaphores;
@@ -218,20 +323,28 @@ namespace aga
         std::vector<VkFramebuffer> m_FrameBuffers;
 
         VkBuffer m_VertexBuffer;
-        VkDeviceMemory m_VertexBufferMemory;
+        DeviceAllocation m_VertexBufferMemory;
         VkBuffer m_IndexBuffer;
-        VkDeviceMemory m_IndexBufferMemory;
+        DeviceAllocation m_IndexBufferMemory;
 
-        std::vector<VkBuffer> m_UniformBuffers;
-        std::vector<VkDeviceMemory> m_UniformBuffersMemory;
+        //  Dynamic offset of the first draw's uniforms in the current frame, the others follow 'stride' bytes apart
+        uint32_t m_DrawUniformOffset;
+        uint32_t m_DrawUniformStride;
 
         VkImage m_TextureImage;
-        VkDeviceMemory m_TextureImageMemory;
+        DeviceAllocation m_TextureImageMemory;
         VkImageView m_TextureImageView;
         VkSampler m_TextureSampler;
 
         VkImage m_DepthStencilImage;
-        VkDeviceMemory m_DepthStencilImageMemory;
+        DeviceAllocation m_DepthStencilImageMemory;
         VkImageView m_DepthStencilImageView;
+
+        FileRequestHandle m_TextureFileRequest;
+        std::vector<uint8_t> m_TextureFileData;
+
+        TransformStorage m_Transforms;
+        real_t m_ModelAngle;
+        real_t m_PreviousModelAngle;
     };
 }  // namespace aga
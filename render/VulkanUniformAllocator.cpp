@@ -0,0 +1,120 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "VulkanUniformAllocator.h"
+#include "core/Logger.h"
+
+namespace aga
+{
+    VulkanUniformAllocator::VulkanUniformAllocator()
+        : m_Device(VK_NULL_HANDLE),
+          m_Allocator(nullptr),
+          m_Buffer(VK_NULL_HANDLE),
+          m_OffsetAlignment(1),
+          m_FrameCount(0),
+          m_FrameSize(0),
+          m_FrameBegin(0),
+          m_FrameEnd(0),
+          m_Offset(0),
+          m_HasOverflowed(false)
+    {
+    }
+
+    VulkanUniformAllocator::~VulkanUniformAllocator()
+    {
+    }
+
+    bool VulkanUniformAllocator::Initialize(VkDevice device, VulkanMemoryAllocator *allocator,
+                                            VkDeviceSize offsetAlignment, uint32_t frameCount, VkDeviceSize frameSize)
+    {
+        m_Device = device;
+        m_Allocator = allocator;
+        m_OffsetAlignment = offsetAlignment > 0 ? offsetAlignment : 1;
+        m_FrameCount = frameCount;
+        m_FrameSize = frameSize;
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = m_FrameSize * m_FrameCount;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_Device, &bufferCreateInfo, VK_NULL_HANDLE, &m_Buffer) != VK_SUCCESS ||
+            !m_Allocator->AllocateBuffer(m_Buffer,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         m_Memory))
+        {
+            LOG_ERROR_F("Failed to create uniform buffer!\n");
+
+            return false;
+        }
+
+        BeginFrame(0);
+
+        LOG_DEBUG_FMT_F("Uniform buffer created, {} frames of {} KiB\n", m_FrameCount, m_FrameSize / 1024);
+
+        return true;
+    }
+
+    void VulkanUniformAllocator::Destroy()
+    {
+        if (m_Device == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        vkDestroyBuffer(m_Device, m_Buffer, VK_NULL_HANDLE);
+        m_Allocator->Free(m_Memory);
+        m_Buffer = VK_NULL_HANDLE;
+
+        m_Device = VK_NULL_HANDLE;
+    }
+
+    void VulkanUniformAllocator::BeginFrame(uint32_t frame)
+    {
+        m_FrameBegin = m_FrameSize * (frame % m_FrameCount);
+        m_FrameEnd = m_FrameBegin + m_FrameSize;
+        m_Offset.store(m_FrameBegin, std::memory_order_relaxed);
+        m_HasOverflowed.store(false, std::memory_order_relaxed);
+    }
+
+    uint8_t *VulkanUniformAllocator::Allocate(VkDeviceSize size, uint32_t &dynamicOffset)
+    {
+        //  Sizes are multiples of the alignment and so is every region's start, a plain fetch_add keeps it aligned
+        const VkDeviceSize alignedSize = GetAlignedSize(size);
+        const VkDeviceSize offset = m_Offset.fetch_add(alignedSize, std::memory_order_relaxed);
+
+        if (offset + alignedSize > m_FrameEnd)
+        {
+            if (!m_HasOverflowed.exchange(true, std::memory_order_relaxed))
+            {
+                LOG_WARNING_FMT_F("Uniform buffer region of {} KiB used up, draws are dropped this frame\n",
+                                  m_FrameSize / 1024);
+            }
+
+            dynamicOffset = INVALID_UNIFORM_OFFSET;
+
+            return nullptr;
+        }
+
+        dynamicOffset = (uint32_t)offset;
+
+        return m_Memory.Mapped + offset;
+    }
+
+    VkDeviceSize VulkanUniformAllocator::GetAlignedSize(VkDeviceSize size) const
+    {
+        return (size + m_OffsetAlignment - 1) / m_OffsetAlignment * m_OffsetAlignment;
+    }
+
+    VkBuffer VulkanUniformAllocator::GetBuffer() const
+    {
+        return m_Buffer;
+    }
+
+    VkDeviceSize VulkanUniformAllocator::GetUsedSize() const
+    {
+        const VkDeviceSize offset = m_Offset.load(std::memory_order_relaxed);
+
+        return (offset < m_FrameEnd ? offset : m_FrameEnd) - m_FrameBegin;
+    }
+}  // namespace aga
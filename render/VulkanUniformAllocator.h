@@ -0,0 +1,67 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "VulkanMemoryAllocator.h"
+
+#include <atomic>
+#include <stdint.h>
+
+namespace aga
+{
+    //  Default uniform bytes available to one frame in flight, 16k draws of a 256-byte aligned block
+    const VkDeviceSize UNIFORM_FRAME_SIZE = 4 * 1024 * 1024;
+
+    //  Returned by Allocate when the frame's region is used up
+    const uint32_t INVALID_UNIFORM_OFFSET = 0xFFFFFFFF;
+
+    //  Linear allocator for per-draw constants in a single persistently mapped, host coherent uniform buffer. Every
+    //  frame in flight owns a region of it which BeginFrame rewinds, so the caller must have waited for that frame's
+    //  fence first. Draws bind the buffer once with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC and pass the offsets
+    //  returned by Allocate, no descriptor set or vkMapMemory per object. Allocate is lock-free.
+    class VulkanUniformAllocator
+    {
+    public:
+        VulkanUniformAllocator();
+        ~VulkanUniformAllocator();
+
+        VulkanUniformAllocator(const VulkanUniformAllocator &) = delete;
+        void operator=(const VulkanUniformAllocator &) = delete;
+
+        //  'offsetAlignment' is VkPhysicalDeviceLimits::minUniformBufferOffsetAlignment
+        bool Initialize(VkDevice device, VulkanMemoryAllocator *allocator, VkDeviceSize offsetAlignment,
+                        uint32_t frameCount, VkDeviceSize frameSize = UNIFORM_FRAME_SIZE);
+        void Destroy();
+
+        //  Releases everything the frame allocated last time it was in flight
+        void BeginFrame(uint32_t frame);
+
+        //  Returns the host address of 'size' bytes and their dynamic offset, or nullptr and INVALID_UNIFORM_OFFSET
+        //  once the frame's region is full. Consecutive blocks of GetAlignedSize bytes can be allocated at once.
+        uint8_t *Allocate(VkDeviceSize size, uint32_t &dynamicOffset);
+
+        //  Size rounded up to the offset alignment, the stride of blocks that are bound one by one
+        VkDeviceSize GetAlignedSize(VkDeviceSize size) const;
+
+        VkBuffer GetBuffer() const;
+
+        //  Bytes allocated by the current frame so far
+        VkDeviceSize GetUsedSize() const;
+
+    private:
+        VkDevice m_Device;
+        VulkanMemoryAllocator *m_Allocator;
+
+        VkBuffer m_Buffer;
+        DeviceAllocation m_Memory;
+        VkDeviceSize m_OffsetAlignment;
+        uint32_t m_FrameCount;
+        VkDeviceSize m_FrameSize;
+
+        //  Region of the current frame, m_Offset grows from m_FrameBegin towards m_FrameEnd
+        VkDeviceSize m_FrameBegin;
+        VkDeviceSize m_FrameEnd;
+        std::atomic<VkDeviceSize> m_Offset;
+        std::atomic<bool> m_HasOverflowed;
+    };
+}  // namespace aga
@@ -0,0 +1,526 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#include "VulkanUploadQueue.h"
+#include "core/Logger.h"
+
+#include <cstring>
+
+namespace aga
+{
+    VulkanUploadQueue::VulkanUploadQueue()
+        : m_Device(VK_NULL_HANDLE),
+          m_Allocator(nullptr),
+          m_TransferFamilyIndex(0),
+          m_GraphicsFamilyIndex(0),
+          m_TransferQueue(VK_NULL_HANDLE),
+          m_GraphicsQueue(VK_NULL_HANDLE),
+          m_TransferCommandPool(VK_NULL_HANDLE),
+          m_GraphicsCommandPool(VK_NULL_HANDLE),
+          m_StagingBuffer(VK_NULL_HANDLE),
+          m_StagingHead(0),
+          m_StagingTail(0),
+          m_NextTicket(INVALID_UPLOAD_TICKET + 1),
+          m_CompletedTicket(INVALID_UPLOAD_TICKET),
+          m_IsRecording(false)
+    {
+        for (UploadBatch &batch : m_Batches)
+        {
+            batch.TransferCommands = VK_NULL_HANDLE;
+            batch.GraphicsCommands = VK_NULL_HANDLE;
+            batch.Semaphore = VK_NULL_HANDLE;
+            batch.Fence = VK_NULL_HANDLE;
+            batch.Ticket = INVALID_UPLOAD_TICKET;
+            batch.StagingEnd = 0;
+            batch.DestinationStages = 0;
+        }
+    }
+
+    VulkanUploadQueue::~VulkanUploadQueue()
+    {
+    }
+
+    bool VulkanUploadQueue::Initialize(VkDevice device, VulkanMemoryAllocator *allocator, uint32_t transferFamilyIndex,
+                                       VkQueue transferQueue, uint32_t graphicsFamilyIndex, VkQueue graphicsQueue)
+    {
+        m_Device = device;
+        m_Allocator = allocator;
+        m_TransferFamilyIndex = transferFamilyIndex;
+        m_TransferQueue = transferQueue;
+        m_GraphicsFamilyIndex = graphicsFamilyIndex;
+        m_GraphicsQueue = graphicsQueue;
+
+        VkCommandPoolCreateInfo poolCreateInfo = {};
+        poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolCreateInfo.queueFamilyIndex = m_TransferFamilyIndex;
+
+        if (vkCreateCommandPool(m_Device, &poolCreateInfo, VK_NULL_HANDLE, &m_TransferCommandPool) != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Failed to create upload Command Pool!\n");
+
+            return false;
+        }
+
+        if (!_IsSharedQueue())
+        {
+            poolCreateInfo.queueFamilyIndex = m_GraphicsFamilyIndex;
+
+            if (vkCreateCommandPool(m_Device, &poolCreateInfo, VK_NULL_HANDLE, &m_GraphicsCommandPool) != VK_SUCCESS)
+            {
+                LOG_ERROR_F("Failed to create upload Command Pool!\n");
+
+                return false;
+            }
+        }
+
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+        semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for (UploadBatch &batch : m_Batches)
+        {
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandPool = m_TransferCommandPool;
+            allocateInfo.commandBufferCount = 1;
+
+            bool isCreated = vkAllocateCommandBuffers(m_Device, &allocateInfo, &batch.TransferCommands) == VK_SUCCESS &&
+                             vkCreateFence(m_Device, &fenceCreateInfo, VK_NULL_HANDLE, &batch.Fence) == VK_SUCCESS;
+
+            if (isCreated && !_IsSharedQueue())
+            {
+                allocateInfo.commandPool = m_GraphicsCommandPool;
+
+                isCreated = vkAllocateCommandBuffers(m_Device, &allocateInfo, &batch.GraphicsCommands) == VK_SUCCESS &&
+                            vkCreateSemaphore(m_Device, &semaphoreCreateInfo, VK_NULL_HANDLE, &batch.Semaphore) ==
+                                VK_SUCCESS;
+            }
+
+            if (!isCreated)
+            {
+                LOG_ERROR_F("Failed to create upload batch!\n");
+
+                return false;
+            }
+        }
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = UPLOAD_STAGING_SIZE;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(m_Device, &bufferCreateInfo, VK_NULL_HANDLE, &m_StagingBuffer) != VK_SUCCESS ||
+            !m_Allocator->AllocateBuffer(m_StagingBuffer,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                         m_StagingMemory))
+        {
+            LOG_ERROR_F("Failed to create upload staging buffer!\n");
+
+            return false;
+        }
+
+        LOG_DEBUG_FMT_F("Upload queue created on queue family {}{}\n", m_TransferFamilyIndex,
+                        _IsSharedQueue() ? " (graphics)" : " (transfer)");
+
+        return true;
+    }
+
+    void VulkanUploadQueue::Destroy()
+    {
+        if (m_Device == VK_NULL_HANDLE)
+        {
+            return;
+        }
+
+        Wait(Flush());
+
+        for (UploadBatch &batch : m_Batches)
+        {
+            vkDestroyFence(m_Device, batch.Fence, VK_NULL_HANDLE);
+            vkDestroySemaphore(m_Device, batch.Semaphore, VK_NULL_HANDLE);
+
+            batch.Fence = VK_NULL_HANDLE;
+            batch.Semaphore = VK_NULL_HANDLE;
+            batch.TransferCommands = VK_NULL_HANDLE;
+            batch.GraphicsCommands = VK_NULL_HANDLE;
+        }
+
+        //  Command buffers go with their pools
+        vkDestroyCommandPool(m_Device, m_TransferCommandPool, VK_NULL_HANDLE);
+        vkDestroyCommandPool(m_Device, m_GraphicsCommandPool, VK_NULL_HANDLE);
+        m_TransferCommandPool = VK_NULL_HANDLE;
+        m_GraphicsCommandPool = VK_NULL_HANDLE;
+
+        vkDestroyBuffer(m_Device, m_StagingBuffer, VK_NULL_HANDLE);
+        m_Allocator->Free(m_StagingMemory);
+        m_StagingBuffer = VK_NULL_HANDLE;
+
+        m_Device = VK_NULL_HANDLE;
+    }
+
+    bool VulkanUploadQueue::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                                         VkPipelineStageFlags stage, VkAccessFlags access)
+    {
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint8_t *mapped;
+
+        if (!_AllocateStaging(size, stagingBuffer, stagingOffset, mapped))
+        {
+            return false;
+        }
+
+        memcpy(mapped, data, static_cast<size_t>(size));
+
+        VkCommandBuffer commands = _GetCommands();
+
+        VkBufferCopy region = {};
+        region.srcOffset = stagingOffset;
+        region.dstOffset = offset;
+        region.size = size;
+
+        vkCmdCopyBuffer(commands, stagingBuffer, buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = access;
+        barrier.srcQueueFamilyIndex = _IsSharedQueue() ? VK_QUEUE_FAMILY_IGNORED : m_TransferFamilyIndex;
+        barrier.dstQueueFamilyIndex = _IsSharedQueue() ? VK_QUEUE_FAMILY_IGNORED : m_GraphicsFamilyIndex;
+        barrier.buffer = buffer;
+        barrier.offset = offset;
+        barrier.size = size;
+
+        UploadBatch &batch = m_Batches[m_NextTicket % UPLOAD_BATCH_COUNT];
+        batch.BufferBarriers.push_back(barrier);
+        batch.DestinationStages |= stage;
+
+        return true;
+    }
+
+    bool VulkanUploadQueue::UploadImage(VkImage image, uint32_t width, uint32_t height, const void *data,
+                                        VkDeviceSize size)
+    {
+        VkBuffer stagingBuffer;
+        VkDeviceSize stagingOffset;
+        uint8_t *mapped;
+
+        if (!_AllocateStaging(size, stagingBuffer, stagingOffset, mapped))
+        {
+            return false;
+        }
+
+        memcpy(mapped, data, static_cast<size_t>(size));
+
+        VkCommandBuffer commands = _GetCommands();
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        vkCmdPipelineBarrier(commands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                             nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = stagingOffset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = {0, 0, 0};
+        region.imageExtent = {width, height, 1};
+
+        vkCmdCopyBufferToImage(commands, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barrier.srcQueueFamilyIndex = _IsSharedQueue() ? VK_QUEUE_FAMILY_IGNORED : m_TransferFamilyIndex;
+        barrier.dstQueueFamilyIndex = _IsSharedQueue() ? VK_QUEUE_FAMILY_IGNORED : m_GraphicsFamilyIndex;
+
+        UploadBatch &batch = m_Batches[m_NextTicket % UPLOAD_BATCH_COUNT];
+        batch.ImageBarriers.push_back(barrier);
+        batch.DestinationStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+        return true;
+    }
+
+    UploadTicket VulkanUploadQueue::Flush()
+    {
+        if (!m_IsRecording)
+        {
+            return m_NextTicket - 1;
+        }
+
+        UploadBatch &batch = m_Batches[m_NextTicket % UPLOAD_BATCH_COUNT];
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers = batch.BufferBarriers;
+        std::vector<VkImageMemoryBarrier> imageBarriers = batch.ImageBarriers;
+
+        //  The transfer family may not know the stages the resources are used in, its release barrier ends at the
+        //  bottom of the pipe and the graphics queue acquires them for the real stages
+        const VkPipelineStageFlags releaseStages =
+            _IsSharedQueue() ? batch.DestinationStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+        if (!_IsSharedQueue())
+        {
+            for (VkBufferMemoryBarrier &barrier : bufferBarriers)
+            {
+                barrier.dstAccessMask = 0;
+            }
+
+            for (VkImageMemoryBarrier &barrier : imageBarriers)
+            {
+                barrier.dstAccessMask = 0;
+            }
+        }
+
+        vkCmdPipelineBarrier(batch.TransferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, releaseStages, 0, 0, nullptr,
+                             static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+                             static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+        if (vkEndCommandBuffer(batch.TransferCommands) != VK_SUCCESS)
+        {
+            LOG_ERROR_F("Failed to record upload batch!\n");
+        }
+
+        vkResetFences(m_Device, 1, &batch.Fence);
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.TransferCommands;
+
+        if (_IsSharedQueue())
+        {
+            if (vkQueueSubmit(m_TransferQueue, 1, &submitInfo, batch.Fence) != VK_SUCCESS)
+            {
+                LOG_ERROR_F("Failed to submit upload batch!\n");
+            }
+        }
+        else
+        {
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores = &batch.Semaphore;
+
+            if (vkQueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                LOG_ERROR_F("Failed to submit upload batch!\n");
+            }
+
+            for (VkBufferMemoryBarrier &barrier : batch.BufferBarriers)
+            {
+                barrier.srcAccessMask = 0;
+            }
+
+            for (VkImageMemoryBarrier &barrier : batch.ImageBarriers)
+            {
+                barrier.srcAccessMask = 0;
+            }
+
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            vkBeginCommandBuffer(batch.GraphicsCommands, &beginInfo);
+            vkCmdPipelineBarrier(batch.GraphicsCommands, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, batch.DestinationStages,
+                                 0, 0, nullptr, static_cast<uint32_t>(batch.BufferBarriers.size()),
+                                 batch.BufferBarriers.data(), static_cast<uint32_t>(batch.ImageBarriers.size()),
+                                 batch.ImageBarriers.data());
+            vkEndCommandBuffer(batch.GraphicsCommands);
+
+            VkSubmitInfo acquireInfo = {};
+            acquireInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireInfo.waitSemaphoreCount = 1;
+            acquireInfo.pWaitSemaphores = &batch.Semaphore;
+            acquireInfo.pWaitDstStageMask = &batch.DestinationStages;
+            acquireInfo.commandBufferCount = 1;
+            acquireInfo.pCommandBuffers = &batch.GraphicsCommands;
+
+            if (vkQueueSubmit(m_GraphicsQueue, 1, &acquireInfo, batch.Fence) != VK_SUCCESS)
+            {
+                LOG_ERROR_F("Failed to submit upload batch!\n");
+            }
+        }
+
+        LOG_DEBUG_FMT_F("Submitted {} buffer and {} image uploads\n", batch.BufferBarriers.size(),
+                        batch.ImageBarriers.size());
+
+        batch.Ticket = m_NextTicket++;
+        batch.StagingEnd = m_StagingHead;
+        batch.BufferBarriers.clear();
+        batch.ImageBarriers.clear();
+        batch.DestinationStages = 0;
+
+        m_IsRecording = false;
+
+        return batch.Ticket;
+    }
+
+    bool VulkanUploadQueue::IsComplete(UploadTicket ticket)
+    {
+        //  Batches complete in submission order, the oldest one is checked first
+        while (m_CompletedTicket < ticket && m_CompletedTicket + 1 < m_NextTicket)
+        {
+            UploadBatch &batch = m_Batches[(m_CompletedTicket + 1) % UPLOAD_BATCH_COUNT];
+
+            if (vkGetFenceStatus(m_Device, batch.Fence) != VK_SUCCESS)
+            {
+                return false;
+            }
+
+            _Retire(batch);
+        }
+
+        return m_CompletedTicket >= ticket;
+    }
+
+    void VulkanUploadQueue::Wait(UploadTicket ticket)
+    {
+        while (m_CompletedTicket < ticket && m_CompletedTicket + 1 < m_NextTicket)
+        {
+            UploadBatch &batch = m_Batches[(m_CompletedTicket + 1) % UPLOAD_BATCH_COUNT];
+
+            vkWaitForFences(m_Device, 1, &batch.Fence, VK_TRUE, UINT64_MAX);
+
+            _Retire(batch);
+        }
+    }
+
+    bool VulkanUploadQueue::_AllocateStaging(VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset,
+                                             uint8_t *&mapped)
+    {
+        if (size > UPLOAD_STAGING_SIZE)
+        {
+            _GetCommands();
+
+            VkBufferCreateInfo bufferCreateInfo = {};
+            bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferCreateInfo.size = size;
+            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+            DeviceAllocation memory;
+
+            if (vkCreateBuffer(m_Device, &bufferCreateInfo, VK_NULL_HANDLE, &buffer) != VK_SUCCESS)
+            {
+                LOG_ERROR_FMT_F("Failed to create {} bytes staging buffer!\n", size);
+
+                return false;
+            }
+
+            if (!m_Allocator->AllocateBuffer(
+                    buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory))
+            {
+                vkDestroyBuffer(m_Device, buffer, VK_NULL_HANDLE);
+
+                return false;
+            }
+
+            UploadBatch &batch = m_Batches[m_NextTicket % UPLOAD_BATCH_COUNT];
+            batch.TemporaryBuffers.push_back(buffer);
+            batch.TemporaryMemory.push_back(memory);
+
+            offset = 0;
+            mapped = memory.Mapped;
+
+            return true;
+        }
+
+        uint64_t position = (m_StagingHead + UPLOAD_STAGING_ALIGNMENT - 1) & ~(UPLOAD_STAGING_ALIGNMENT - 1);
+
+        //  Uploads never wrap around the end of the ring, they start over at its beginning
+        if (position % UPLOAD_STAGING_SIZE + size > UPLOAD_STAGING_SIZE)
+        {
+            position = (position / UPLOAD_STAGING_SIZE + 1) * UPLOAD_STAGING_SIZE;
+        }
+
+        while (position + size - m_StagingTail > UPLOAD_STAGING_SIZE)
+        {
+            if (m_CompletedTicket + 1 < m_NextTicket)
+            {
+                Wait(m_CompletedTicket + 1);
+            }
+            else if (m_IsRecording)
+            {
+                //  The batch being recorded fills the ring on its own
+                Flush();
+            }
+            else
+            {
+                m_StagingTail = position;
+            }
+        }
+
+        m_StagingHead = position + size;
+
+        buffer = m_StagingBuffer;
+        offset = position % UPLOAD_STAGING_SIZE;
+        mapped = m_StagingMemory.Mapped + offset;
+
+        return true;
+    }
+
+    VkCommandBuffer VulkanUploadQueue::_GetCommands()
+    {
+        UploadBatch &batch = m_Batches[m_NextTicket % UPLOAD_BATCH_COUNT];
+
+        if (!m_IsRecording)
+        {
+            //  The slot still holds a batch UPLOAD_BATCH_COUNT tickets old
+            if (batch.Ticket != INVALID_UPLOAD_TICKET)
+            {
+                Wait(batch.Ticket);
+            }
+
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+            vkBeginCommandBuffer(batch.TransferCommands, &beginInfo);
+
+            m_IsRecording = true;
+        }
+
+        return batch.TransferCommands;
+    }
+
+    void VulkanUploadQueue::_Retire(UploadBatch &batch)
+    {
+        for (size_t i = 0; i < batch.TemporaryBuffers.size(); ++i)
+        {
+            vkDestroyBuffer(m_Device, batch.TemporaryBuffers[i], VK_NULL_HANDLE);
+            m_Allocator->Free(batch.TemporaryMemory[i]);
+        }
+
+        batch.TemporaryBuffers.clear();
+        batch.TemporaryMemory.clear();
+
+        m_StagingTail = batch.StagingEnd;
+        m_CompletedTicket = batch.Ticket;
+        batch.Ticket = INVALID_UPLOAD_TICKET;
+    }
+
+    bool VulkanUploadQueue::_IsSharedQueue() const
+    {
+        return m_TransferFamilyIndex == m_GraphicsFamilyIndex;
+    }
+}  // namespace aga
@@ -0,0 +1,106 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+#include "VulkanMemoryAllocator.h"
+
+#include <stdint.h>
+#include <vector>
+
+namespace aga
+{
+    //  Persistently mapped staging ring, uploads wrap around in it and its space is reused once their batch is done
+    const VkDeviceSize UPLOAD_STAGING_SIZE = 16 * 1024 * 1024;
+
+    //  Batches in flight at once, recording into a batch that is still in flight waits for it
+    const uint32_t UPLOAD_BATCH_COUNT = 4;
+
+    //  Offsets in the ring satisfy the copy alignment of every format (texel size and 4)
+    const VkDeviceSize UPLOAD_STAGING_ALIGNMENT = 16;
+
+    typedef uint64_t UploadTicket;
+    const UploadTicket INVALID_UPLOAD_TICKET = 0;
+
+    //  Records buffer and image uploads into one command buffer and submits them together with a fence, instead of a
+    //  command buffer and a vkQueueWaitIdle per copy. Uses a transfer-only queue family when the device has one and
+    //  hands the resources over to the graphics family afterwards. Not thread-safe.
+    class VulkanUploadQueue
+    {
+    public:
+        VulkanUploadQueue();
+        ~VulkanUploadQueue();
+
+        VulkanUploadQueue(const VulkanUploadQueue &) = delete;
+        void operator=(const VulkanUploadQueue &) = delete;
+
+        //  'transferQueue' may be the graphics queue itself
+        bool Initialize(VkDevice device, VulkanMemoryAllocator *allocator, uint32_t transferFamilyIndex,
+                        VkQueue transferQueue, uint32_t graphicsFamilyIndex, VkQueue graphicsQueue);
+
+        //  Waits for all batches
+        void Destroy();
+
+        //  'data' is copied right away. The buffer is ready for 'stage'/'access' of graphics queue submissions made
+        //  after the batch is submitted.
+        bool UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void *data, VkDeviceSize size,
+                          VkPipelineStageFlags stage, VkAccessFlags access);
+
+        //  Fills the whole first mip level and leaves the image in SHADER_READ_ONLY_OPTIMAL for fragment shaders
+        bool UploadImage(VkImage image, uint32_t width, uint32_t height, const void *data, VkDeviceSize size);
+
+        //  Submits the uploads recorded so far, returns their ticket or the previous one when there were none
+        UploadTicket Flush();
+
+        bool IsComplete(UploadTicket ticket);
+        void Wait(UploadTicket ticket);
+
+    private:
+        struct UploadBatch
+        {
+            VkCommandBuffer TransferCommands;
+            //  Acquires the resources on the graphics queue, only with a separate transfer family
+            VkCommandBuffer GraphicsCommands;
+            VkSemaphore Semaphore;
+            VkFence Fence;
+
+            UploadTicket Ticket;
+            //  Ring position after the batch's last upload, the ring is free up to here once it completed
+            uint64_t StagingEnd;
+
+            //  Uploads bigger than the ring get staging buffers of their own, freed with the batch
+            std::vector<VkBuffer> TemporaryBuffers;
+            std::vector<DeviceAllocation> TemporaryMemory;
+
+            std::vector<VkBufferMemoryBarrier> BufferBarriers;
+            std::vector<VkImageMemoryBarrier> ImageBarriers;
+            VkPipelineStageFlags DestinationStages;
+        };
+
+        bool _AllocateStaging(VkDeviceSize size, VkBuffer &buffer, VkDeviceSize &offset, uint8_t *&mapped);
+        VkCommandBuffer _GetCommands();
+        void _Retire(UploadBatch &batch);
+        bool _IsSharedQueue() const;
+
+    private:
+        VkDevice m_Device;
+        VulkanMemoryAllocator *m_Allocator;
+
+        uint32_t m_TransferFamilyIndex;
+        uint32_t m_GraphicsFamilyIndex;
+        VkQueue m_TransferQueue;
+        VkQueue m_GraphicsQueue;
+        VkCommandPool m_TransferCommandPool;
+        VkCommandPool m_GraphicsCommandPool;
+
+        VkBuffer m_StagingBuffer;
+        DeviceAllocation m_StagingMemory;
+        //  Positions grow without wrapping, the ring offset is the position modulo UPLOAD_STAGING_SIZE
+        uint64_t m_StagingHead;
+        uint64_t m_StagingTail;
+
+        UploadBatch m_Batches[UPLOAD_BATCH_COUNT];
+        UploadTicket m_NextTicket;
+        UploadTicket m_CompletedTicket;
+        bool m_IsRecording;
+    };
+}  // namespace aga
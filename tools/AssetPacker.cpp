@@ -0,0 +1,131 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Packs files and directory trees into an AssetArchive. Entries are named by their path as given on the command
+//  line, so the engine finds "data/shaders/x.spv" in an archive packed from "data" in the working directory.
+
+#include "core/AssetArchive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//  Slow to pack, decompression speed hardly depends on the level
+const int ASSET_PACKER_DEFAULT_LEVEL = 19;
+
+static bool ReadFile(const std::string &path, std::vector<uint8_t> &data)
+{
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+
+    if (!file.is_open())
+    {
+        return false;
+    }
+
+    data.resize((size_t)file.tellg());
+    file.seekg(0);
+    file.read(reinterpret_cast<char *>(data.data()), data.size());
+
+    return (bool)file;
+}
+
+int main(int argc, char *argv[])
+{
+    int level = ASSET_PACKER_DEFAULT_LEVEL;
+    int first = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-l") == 0)
+    {
+        level = atoi(argv[2]);
+        first = 3;
+    }
+
+    if (argc - first < 2)
+    {
+        std::fprintf(stderr, "Usage: %s [-l level] <archive> <file or directory>...\n", argv[0]);
+
+        return 1;
+    }
+
+    std::vector<std::string> paths;
+
+    for (int i = first + 1; i < argc; ++i)
+    {
+        std::error_code error;
+
+        if (std::filesystem::is_directory(argv[i], error))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(argv[i], error))
+            {
+                if (entry.is_regular_file())
+                {
+                    paths.push_back(entry.path().generic_string());
+                }
+            }
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+
+        if (error)
+        {
+            std::fprintf(stderr, "Can not read '%s': %s\n", argv[i], error.message().c_str());
+
+            return 1;
+        }
+    }
+
+    //  Sorted paths keep files of one directory next to each other in the archive, and the output reproducible
+    std::sort(paths.begin(), paths.end());
+
+    aga::AssetArchiveWriter writer;
+
+    if (!writer.Open(argv[first], level))
+    {
+        std::fprintf(stderr, "Can not create archive '%s'\n", argv[first]);
+
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    uint64_t totalSize = 0;
+
+    for (const std::string &path : paths)
+    {
+        if (!ReadFile(path, data))
+        {
+            std::fprintf(stderr, "Can not read '%s'\n", path.c_str());
+
+            return 1;
+        }
+
+        if (!writer.Add(aga::StringView(path.c_str(), (uint32_t)path.size()), data.data(), data.size()))
+        {
+            std::fprintf(stderr, "Can not add '%s', the path is listed twice or the archive is not writable\n",
+                         path.c_str());
+
+            return 1;
+        }
+
+        totalSize += data.size();
+    }
+
+    const uint64_t dataSize = writer.GetDataSize();
+
+    if (!writer.Close())
+    {
+        std::fprintf(stderr, "Can not write archive '%s'\n", argv[first]);
+
+        return 1;
+    }
+
+    std::printf("%s: %zu files, %llu bytes packed into %llu\n", argv[first], paths.size(),
+                (unsigned long long)totalSize, (unsigned long long)dataSize);
+
+    return 0;
+}
@@ -0,0 +1,57 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+#pragma once
+
+//  Timing helpers shared by the agaXxxBenchmark tools
+
+#include <chrono>
+#include <cstdio>
+#include <stdint.h>
+
+namespace aga
+{
+    //  Makes the compiler assume 'value' is read, so the work producing it is not optimized away
+    template <typename T>
+    inline void DoNotOptimize(const T &value)
+    {
+        asm volatile("" : : "r,m"(value) : "memory");
+    }
+
+    //  Runs 'body(iterations)' a few times and returns the best time per iteration in nanoseconds, the best run is
+    //  the one least disturbed by the rest of the system
+    template <typename Body>
+    double MeasureNanoseconds(uint64_t iterations, Body body, uint32_t runs = 5)
+    {
+        double best = 0.0;
+
+        for (uint32_t run = 0; run < runs; ++run)
+        {
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+            body(iterations);
+
+            const double nanoseconds =
+                std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+            if (run == 0 || nanoseconds < best)
+            {
+                best = nanoseconds;
+            }
+        }
+
+        return best / (double)iterations;
+    }
+
+    //  One line per measurement, with the speedup over 'reference' when there is one
+    inline void PrintBenchmark(const char *name, double nanoseconds, double reference = 0.0)
+    {
+        if (reference > 0.0)
+        {
+            std::printf("%-40s %10.2f ns %8.2fx\n", name, nanoseconds, reference / nanoseconds);
+        }
+        else
+        {
+            std::printf("%-40s %10.2f ns\n", name, nanoseconds);
+        }
+    }
+}  // namespace aga
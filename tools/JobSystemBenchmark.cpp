@@ -0,0 +1,113 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Scaling of the JobSystem from one worker up to one per hardware thread: transform composition as the engine runs
+//  it every frame, the cost of an empty job, and the CPU time idle workers burn while there is nothing to do.
+//  An argument overrides the largest worker count.
+
+#include "Benchmark.h"
+#include "core/JobSystem.h"
+#include "core/math/Matrix.h"
+#include "core/math/TransformStorage.h"
+
+#include <cstdlib>
+#include <sys/resource.h>
+#include <vector>
+
+using namespace aga;
+
+static void EmptyJob(Job *, void *)
+{
+}
+
+static double GetProcessCpuMilliseconds()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000.0 +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000.0;
+}
+
+int main(int argc, char **argv)
+{
+    const uint32_t TRANSFORM_COUNT = 100000;
+    const uint32_t EMPTY_JOB_COUNT = 1000;
+    const std::chrono::milliseconds IDLE_TIME(500);
+
+    TransformStorage transforms;
+    transforms.Reserve(TRANSFORM_COUNT);
+
+    for (uint32_t i = 0; i < TRANSFORM_COUNT; ++i)
+    {
+        const uint32_t index = transforms.Add(Vector3((real_t)i, 0.0f, 0.0f));
+        transforms.SetRotationAxisRadians(index, 0.001f * i, Vector3(0.0f, 1.0f, 0.0f));
+    }
+
+    std::vector<Matrix> world(TRANSFORM_COUNT);
+
+    uint32_t maxWorkers = argc > 1 ? (uint32_t)std::atoi(argv[1]) : std::thread::hardware_concurrency();
+    maxWorkers = maxWorkers > 0 ? maxWorkers : 1;
+
+    std::printf("%u hardware threads\n", std::thread::hardware_concurrency());
+
+    //  Powers of two, then the largest count
+    std::vector<uint32_t> workerCounts;
+
+    for (uint32_t workers = 1; workers < maxWorkers; workers *= 2)
+    {
+        workerCounts.push_back(workers);
+    }
+
+    workerCounts.push_back(maxWorkers);
+
+    double singleWorker = 0.0;
+
+    for (uint32_t workers : workerCounts)
+    {
+        JobSystem &jobSystem = JobSystem::getInstance();
+        jobSystem.Initialize(workers);
+
+        const double compose = MeasureNanoseconds(20, [&](uint64_t iterations) {
+            for (uint64_t n = 0; n < iterations; ++n)
+            {
+                transforms.ComposeWorldMatrices(world.data(), sizeof(Matrix));
+                DoNotOptimize(world[TRANSFORM_COUNT - 1]);
+            }
+        });
+
+        const double emptyJob = MeasureNanoseconds(100, [&](uint64_t iterations) {
+            for (uint64_t n = 0; n < iterations; ++n)
+            {
+                Job *root = jobSystem.CreateJob(&EmptyJob);
+
+                for (uint32_t i = 0; i < EMPTY_JOB_COUNT; ++i)
+                {
+                    jobSystem.Run(jobSystem.CreateChildJob(root, &EmptyJob));
+                }
+
+                jobSystem.Run(root);
+                jobSystem.Wait(root);
+            }
+        }) / EMPTY_JOB_COUNT;
+
+        //  Everything is finished, the other workers should be asleep now
+        const double cpuBefore = GetProcessCpuMilliseconds();
+        std::this_thread::sleep_for(IDLE_TIME);
+        const double idleCpu = (GetProcessCpuMilliseconds() - cpuBefore) * 1000.0 / IDLE_TIME.count();
+
+        jobSystem.Destroy();
+
+        singleWorker = workers == 1 ? compose : singleWorker;
+
+        char name[64];
+        std::snprintf(name, sizeof(name), "%u worker(s), compose %u transforms", workers, TRANSFORM_COUNT);
+        PrintBenchmark(name, compose, singleWorker);
+
+        std::snprintf(name, sizeof(name), "%u worker(s), empty job", workers);
+        PrintBenchmark(name, emptyJob);
+
+        std::printf("%-40s %10.2f ms CPU per second\n", "  idle", idleCpu);
+    }
+
+    return 0;
+}
@@ -0,0 +1,49 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Prints a binary log written by Logger::OpenBinarySink in the same text form the Logger writes to stdout
+
+#include "core/BinaryLog.h"
+#include "core/Logger.h"
+
+#include <cstdio>
+#include <ctime>
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::fprintf(stderr, "Usage: %s <binary log file>\n", argv[0]);
+
+        return 1;
+    }
+
+    aga::BinaryLogReader reader;
+
+    if (!reader.Open(argv[1]))
+    {
+        std::fprintf(stderr, "Can not read binary log '%s'\n", argv[1]);
+
+        return 1;
+    }
+
+    aga::BinaryLogReader::Entry entry;
+
+    while (reader.Read(entry))
+    {
+        const std::time_t seconds = (std::time_t)(entry.Time / 1000000000);
+
+        char time[16];
+        std::strftime(time, sizeof(time), "%T", std::localtime(&seconds));
+
+        std::printf("%s %s: ", time, aga::Logger::GetLevelName((aga::Logger::LogLevel)entry.Level));
+
+        if (!entry.Function.IsEmpty())
+        {
+            std::printf("%.*s: ", (int)entry.Function.Length(), entry.Function.GetData());
+        }
+
+        std::fwrite(entry.Message.GetData(), 1, entry.Message.Length(), stdout);
+    }
+
+    return 0;
+}
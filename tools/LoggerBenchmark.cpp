@@ -0,0 +1,104 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Cost of a LOG_*_FMT call on the calling thread with 1 to 8 threads logging at once. Records go to a binary sink
+//  in the temp directory, so the numbers are not bound by the terminal.
+
+#include "Benchmark.h"
+#include "core/Logger.h"
+
+#include <thread>
+#include <vector>
+
+using namespace aga;
+
+//  Nanoseconds per call seen by one producer while 'threadCount' of them log 'count' records each
+static double MeasureThreads(uint32_t threadCount, uint64_t count)
+{
+    double best = 0.0;
+
+    for (uint32_t run = 0; run < 3; ++run)
+    {
+        std::vector<std::thread> threads;
+        const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        for (uint32_t t = 0; t < threadCount; ++t)
+        {
+            threads.emplace_back([t, count]() {
+                for (uint64_t n = 0; n < count; ++n)
+                {
+                    LOG_INFO_FMT("thread {} record {} value {}\n", t, n, 0.5);
+                }
+            });
+        }
+
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        const double nanoseconds =
+            std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        Logger::getInstance().Flush();
+
+        if (run == 0 || nanoseconds < best)
+        {
+            best = nanoseconds;
+        }
+    }
+
+    return best / (double)count;
+}
+
+int main()
+{
+    const uint64_t COUNT = 200000;
+    const uint32_t THREAD_COUNTS[] = {1, 2, 4, 8};
+
+    Logger &logger = Logger::getInstance();
+
+    //  Below the enabled level the call is only the level check
+    const double filtered = MeasureNanoseconds(COUNT, [](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            LOG_DEBUG_FMT("filtered record {}\n", n);
+        }
+    });
+
+    if (!logger.OpenBinarySink("/tmp/agaLoggerBenchmark.binlog"))
+    {
+        std::printf("Can not open the binary log\n");
+
+        return 1;
+    }
+
+    const Logger::OverflowPolicy POLICIES[] = {Logger::Drop, Logger::Block};
+    const char *const POLICY_NAMES[] = {"drop", "block"};
+
+    PrintBenchmark("filtered call", filtered);
+
+    for (uint32_t policy = 0; policy < 2; ++policy)
+    {
+        logger.SetOverflowPolicy(POLICIES[policy]);
+
+        for (uint32_t threadCount : THREAD_COUNTS)
+        {
+            const uint64_t dropped = logger.GetDroppedCount();
+            const double nanoseconds = MeasureThreads(threadCount, COUNT);
+
+            char name[64];
+            std::snprintf(name, sizeof(name), "%s, %u thread(s)", POLICY_NAMES[policy], threadCount);
+            PrintBenchmark(name, nanoseconds);
+
+            if (logger.GetDroppedCount() != dropped)
+            {
+                std::printf("%-40s %10.1f %%\n", "  dropped",
+                            100.0 * (double)(logger.GetDroppedCount() - dropped) / (3.0 * threadCount * COUNT));
+            }
+        }
+    }
+
+    logger.CloseBinarySink();
+
+    return 0;
+}
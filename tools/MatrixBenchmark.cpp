@@ -0,0 +1,175 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Times the core/math Matrix kernels against the scalar loops they replaced. Build once with the default flags
+//  (SSE2) and once with -DBUILD_ENABLE_AVX2=ON to compare instruction sets.
+
+#include "Benchmark.h"
+#include "core/math/Matrix.h"
+#include "core/math/SIMD.h"
+
+#include <vector>
+
+using namespace aga;
+
+//  The triple loop Matrix::operator*= used before the SIMD kernels
+static void ReferenceMultiply(const Matrix &a, const Matrix &b, Matrix &out)
+{
+    real_t temp[4][4] = {};
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            for (int k = 0; k < 4; ++k)
+            {
+                temp[i][j] += a[i][k] * b[k][j];
+            }
+        }
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            out[i][j] = temp[i][j];
+        }
+    }
+}
+
+static void ReferenceTranspose(const Matrix &m, Matrix &out)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        for (int j = 0; j < 4; ++j)
+        {
+            out[i][j] = m[j][i];
+        }
+    }
+}
+
+//  One point at a time, v' = v * M with the translation in the last row
+static void ReferenceTransformPoints(const Matrix &m, const Vector3 *in, Vector3 *out, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const Vector3 p = in[i];
+
+        out[i] = Vector3(p.X * m[0][0] + p.Y * m[1][0] + p.Z * m[2][0] + m[3][0],
+                         p.X * m[0][1] + p.Y * m[1][1] + p.Z * m[2][1] + m[3][1],
+                         p.X * m[0][2] + p.Y * m[1][2] + p.Z * m[2][2] + m[3][2]);
+    }
+}
+
+int main()
+{
+    const uint32_t MATRIX_COUNT = 1024;
+    const uint32_t POINT_COUNT = 64 * 1024;
+    const uint64_t ITERATIONS = 2000;
+
+    std::printf("Matrix kernels: %s\n", SIMD_ENABLE_AVX2 ? "AVX2" : (SIMD_ENABLE_SSE2 ? "SSE2" : "scalar"));
+
+    //  A chain of matrices like a transform hierarchy, working set stays in L1/L2
+    std::vector<Matrix> matrices(MATRIX_COUNT);
+    std::vector<Matrix> results(MATRIX_COUNT);
+
+    for (uint32_t i = 0; i < MATRIX_COUNT; ++i)
+    {
+        matrices[i].SetRotationAxisRadians(0.001f * i, Vector3(0.0f, 0.0f, 1.0f));
+        matrices[i][3][0] = (real_t)i;
+        matrices[i][3][1] = 1.0f;
+    }
+
+    const double referenceMultiply = MeasureNanoseconds(ITERATIONS, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            for (uint32_t i = 1; i < MATRIX_COUNT; ++i)
+            {
+                ReferenceMultiply(matrices[i - 1], matrices[i], results[i]);
+            }
+
+            DoNotOptimize(results[MATRIX_COUNT - 1]);
+        }
+    }) / (MATRIX_COUNT - 1);
+
+    const double multiply = MeasureNanoseconds(ITERATIONS, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            for (uint32_t i = 1; i < MATRIX_COUNT; ++i)
+            {
+                Matrix::Multiply(matrices[i - 1], matrices[i], results[i]);
+            }
+
+            DoNotOptimize(results[MATRIX_COUNT - 1]);
+        }
+    }) / (MATRIX_COUNT - 1);
+
+    const double referenceTranspose = MeasureNanoseconds(ITERATIONS, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            for (uint32_t i = 0; i < MATRIX_COUNT; ++i)
+            {
+                ReferenceTranspose(matrices[i], results[i]);
+            }
+
+            DoNotOptimize(results[MATRIX_COUNT - 1]);
+        }
+    }) / MATRIX_COUNT;
+
+    const double transpose = MeasureNanoseconds(ITERATIONS, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            for (uint32_t i = 0; i < MATRIX_COUNT; ++i)
+            {
+                results[i] = matrices[i].Transpose();
+            }
+
+            DoNotOptimize(results[MATRIX_COUNT - 1]);
+        }
+    }) / MATRIX_COUNT;
+
+    const double inverse = MeasureNanoseconds(ITERATIONS, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            for (uint32_t i = 0; i < MATRIX_COUNT; ++i)
+            {
+                matrices[i].GetInverse(results[i]);
+            }
+
+            DoNotOptimize(results[MATRIX_COUNT - 1]);
+        }
+    }) / MATRIX_COUNT;
+
+    std::vector<Vector3> points(POINT_COUNT);
+    std::vector<Vector3> transformed(POINT_COUNT);
+
+    for (uint32_t i = 0; i < POINT_COUNT; ++i)
+    {
+        points[i] = Vector3((real_t)i, (real_t)(i % 7), 1.0f);
+    }
+
+    const double referenceTransform = MeasureNanoseconds(ITERATIONS / 10, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            ReferenceTransformPoints(matrices[1], points.data(), transformed.data(), POINT_COUNT);
+            DoNotOptimize(transformed[POINT_COUNT - 1]);
+        }
+    }) / POINT_COUNT;
+
+    const double transform = MeasureNanoseconds(ITERATIONS / 10, [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            matrices[1].TransformPoints(points.data(), transformed.data(), POINT_COUNT);
+            DoNotOptimize(transformed[POINT_COUNT - 1]);
+        }
+    }) / POINT_COUNT;
+
+    PrintBenchmark("multiply (scalar loop)", referenceMultiply);
+    PrintBenchmark("multiply", multiply, referenceMultiply);
+    PrintBenchmark("transpose (scalar loop)", referenceTranspose);
+    PrintBenchmark("transpose", transpose, referenceTranspose);
+    PrintBenchmark("inverse", inverse);
+    PrintBenchmark("transform point (scalar loop)", referenceTransform);
+    PrintBenchmark("transform point, batched", transform, referenceTransform);
+
+    return 0;
+}
@@ -0,0 +1,262 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Runs VulkanMemoryAllocator against the first device found, without a window: fills several blocks with buffers,
+//  places linear and optimal tiling images, frees most buffers, defragments and logs the statistics. Exits with 1
+//  and names the check when one fails. A software driver such as lavapipe is enough.
+
+#include "core/Logger.h"
+#include "render/VulkanMemoryAllocator.h"
+
+#include <cstdio>
+#include <vector>
+
+using namespace aga;
+
+#define CHECK(condition)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            std::printf("Check failed: %s (line %d)\n", #condition, __LINE__);                                        \
+            return 1;                                                                                                  \
+        }                                                                                                              \
+    } while (0)
+
+//  A buffer Defragment can move, it finds it again through the allocation's userData
+struct TestBuffer
+{
+    VkBuffer Buffer;
+    DeviceAllocation Allocation;
+    VkDeviceSize Size;
+};
+
+static VkBuffer CreateBuffer(VkDevice device, VkDeviceSize size)
+{
+    VkBufferCreateInfo bufferInfo = {};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer buffer = VK_NULL_HANDLE;
+
+    return vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) == VK_SUCCESS ? buffer : VK_NULL_HANDLE;
+}
+
+static VkImage CreateImage(VkDevice device, VkImageTiling tiling)
+{
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent = {256, 256, 1};
+    imageInfo.mipLevels = 1;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+    imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkImage image = VK_NULL_HANDLE;
+
+    return vkCreateImage(device, &imageInfo, nullptr, &image) == VK_SUCCESS ? image : VK_NULL_HANDLE;
+}
+
+//  Sums the statistics of all heaps
+static DeviceHeapStatistics GetTotals(VulkanMemoryAllocator &allocator)
+{
+    DeviceHeapStatistics totals = {};
+
+    for (uint32_t heap = 0; heap < allocator.GetHeapCount(); ++heap)
+    {
+        const DeviceHeapStatistics statistics = allocator.GetHeapStatistics(heap);
+
+        totals.BlockBytes += statistics.BlockBytes;
+        totals.AllocatedBytes += statistics.AllocatedBytes;
+        totals.BlockCount += statistics.BlockCount;
+        totals.AllocationCount += statistics.AllocationCount;
+        totals.DedicatedCount += statistics.DedicatedCount;
+    }
+
+    return totals;
+}
+
+static int RunChecks(VkDevice device, VulkanMemoryAllocator &allocator)
+{
+    //  Three blocks worth of buffers
+    const VkDeviceSize BUFFER_SIZE = 256 * 1024;
+    const uint32_t BUFFER_COUNT = (uint32_t)(3 * DEVICE_MEMORY_BLOCK_SIZE / BUFFER_SIZE);
+
+    std::vector<TestBuffer> buffers(BUFFER_COUNT);
+
+    for (TestBuffer &buffer : buffers)
+    {
+        buffer.Size = BUFFER_SIZE;
+        buffer.Buffer = CreateBuffer(device, buffer.Size);
+
+        CHECK(buffer.Buffer != VK_NULL_HANDLE);
+        CHECK(allocator.AllocateBuffer(buffer.Buffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer.Allocation, &buffer));
+        CHECK(buffer.Allocation.Kind == DeviceResourceLinear);
+    }
+
+    const DeviceHeapStatistics filled = GetTotals(allocator);
+
+    CHECK(filled.AllocationCount == BUFFER_COUNT);
+    CHECK(filled.BlockCount >= 3 && filled.BlockCount < BUFFER_COUNT);
+
+    //  Linear tiling images share the blocks of buffers, optimal ones get their own
+    VkImage linearImage = CreateImage(device, VK_IMAGE_TILING_LINEAR);
+    VkImage optimalImage = CreateImage(device, VK_IMAGE_TILING_OPTIMAL);
+    DeviceAllocation linearAllocation;
+    DeviceAllocation optimalAllocation;
+
+    CHECK(linearImage != VK_NULL_HANDLE && optimalImage != VK_NULL_HANDLE);
+    CHECK(allocator.AllocateImage(linearImage, VK_IMAGE_TILING_LINEAR, 0, linearAllocation));
+    CHECK(allocator.AllocateImage(optimalImage, VK_IMAGE_TILING_OPTIMAL, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                  optimalAllocation));
+    CHECK(linearAllocation.Block == DEVICE_MEMORY_DEDICATED || linearAllocation.Kind == DeviceResourceLinear);
+    CHECK(optimalAllocation.Block == DEVICE_MEMORY_DEDICATED || optimalAllocation.Kind == DeviceResourceOptimal);
+
+    allocator.Free(linearAllocation);
+    allocator.Free(optimalAllocation);
+    vkDestroyImage(device, linearImage, nullptr);
+    vkDestroyImage(device, optimalImage, nullptr);
+
+    //  Keeps every fourth buffer, spread over all blocks
+    for (uint32_t i = 0; i < BUFFER_COUNT; ++i)
+    {
+        if (i % 4 != 0)
+        {
+            allocator.Free(buffers[i].Allocation);
+            vkDestroyBuffer(device, buffers[i].Buffer, nullptr);
+            buffers[i].Buffer = VK_NULL_HANDLE;
+        }
+    }
+
+    const DeviceHeapStatistics fragmented = GetTotals(allocator);
+
+    //  Nothing was written to the buffers, so the move only creates and binds them again
+    const VkDeviceSize moved = allocator.Defragment(
+        DEVICE_MEMORY_BLOCK_SIZE * 4, [device](void *userData, const DeviceAllocation &, const DeviceAllocation &to) {
+            TestBuffer &buffer = *static_cast<TestBuffer *>(userData);
+            VkBuffer moved = CreateBuffer(device, buffer.Size);
+
+            if (moved == VK_NULL_HANDLE || vkBindBufferMemory(device, moved, to.Memory, to.Offset) != VK_SUCCESS)
+            {
+                vkDestroyBuffer(device, moved, nullptr);
+
+                return false;
+            }
+
+            vkDestroyBuffer(device, buffer.Buffer, nullptr);
+            buffer.Buffer = moved;
+            buffer.Allocation = to;
+
+            return true;
+        });
+
+    const DeviceHeapStatistics defragmented = GetTotals(allocator);
+
+    CHECK(moved > 0);
+    CHECK(defragmented.AllocationCount == fragmented.AllocationCount);
+    CHECK(defragmented.AllocatedBytes == fragmented.AllocatedBytes);
+    CHECK(defragmented.BlockCount < fragmented.BlockCount);
+
+    allocator.LogStatistics();
+
+    for (TestBuffer &buffer : buffers)
+    {
+        if (buffer.Buffer != VK_NULL_HANDLE)
+        {
+            allocator.Free(buffer.Allocation);
+            vkDestroyBuffer(device, buffer.Buffer, nullptr);
+        }
+    }
+
+    const DeviceHeapStatistics freed = GetTotals(allocator);
+
+    CHECK(freed.AllocationCount == 0 && freed.AllocatedBytes == 0 && freed.DedicatedCount == 0);
+
+    std::printf("%u buffers in %u blocks, %u blocks after freeing 3/4 and defragmenting (%llu KiB moved)\n",
+                BUFFER_COUNT, filled.BlockCount, defragmented.BlockCount, (unsigned long long)(moved / 1024));
+
+    return 0;
+}
+
+int main()
+{
+    VkApplicationInfo applicationInfo = {};
+    applicationInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+    applicationInfo.pApplicationName = "agaMemoryAllocatorCheck";
+    applicationInfo.apiVersion = VK_API_VERSION_1_1;
+
+    VkInstanceCreateInfo instanceInfo = {};
+    instanceInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+    instanceInfo.pApplicationInfo = &applicationInfo;
+
+    VkInstance instance = VK_NULL_HANDLE;
+
+    if (vkCreateInstance(&instanceInfo, nullptr, &instance) != VK_SUCCESS)
+    {
+        std::printf("Can not create a Vulkan instance\n");
+
+        return 1;
+    }
+
+    uint32_t physicalDeviceCount = 1;
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    const VkResult enumerateResult = vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, &physicalDevice);
+
+    if ((enumerateResult != VK_SUCCESS && enumerateResult != VK_INCOMPLETE) || physicalDeviceCount == 0)
+    {
+        std::printf("No Vulkan device found\n");
+        vkDestroyInstance(instance, nullptr);
+
+        return 1;
+    }
+
+    //  Any queue will do, the checks never submit
+    const float queuePriority = 1.0f;
+
+    VkDeviceQueueCreateInfo queueInfo = {};
+    queueInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueInfo.queueFamilyIndex = 0;
+    queueInfo.queueCount = 1;
+    queueInfo.pQueuePriorities = &queuePriority;
+
+    VkDeviceCreateInfo deviceInfo = {};
+    deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceInfo.queueCreateInfoCount = 1;
+    deviceInfo.pQueueCreateInfos = &queueInfo;
+
+    VkDevice device = VK_NULL_HANDLE;
+
+    if (vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device) != VK_SUCCESS)
+    {
+        std::printf("Can not create a Vulkan device\n");
+        vkDestroyInstance(instance, nullptr);
+
+        return 1;
+    }
+
+    VulkanMemoryAllocator allocator;
+    allocator.Initialize(physicalDevice, device, false);
+
+    const int result = RunChecks(device, allocator);
+
+    //  On failure, the resources still alive are reported here
+    allocator.Destroy();
+
+    vkDestroyDevice(device, nullptr);
+    vkDestroyInstance(instance, nullptr);
+
+    Logger::getInstance().Flush();
+
+    if (result == 0)
+    {
+        std::printf("All checks passed\n");
+    }
+
+    return result;
+}
@@ -0,0 +1,165 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Times the concatenation patterns the engine uses most, with std::string as the reference, and the ways a
+//  LOG_*_F style message can be put together. Heap allocations per call come from the MemoryTracker counters, which
+//  include the slabs the PoolAllocator grows by and buffers too large for its pools. Blocks handed out of a slab the
+//  pool already owns are not counted.
+
+#include "Benchmark.h"
+#include "core/Format.h"
+#include "core/Memory.h"
+#include "core/String.h"
+
+#include <string>
+
+using namespace aga;
+
+//  Allocations made by every tag since the previous call
+static uint64_t CountAllocations()
+{
+    static uint64_t previous = 0;
+    uint64_t total = 0;
+
+    MemoryTracker::getInstance().EndFrame();
+
+    for (uint32_t tag = 0; tag < (uint32_t)MemoryTag::Count; ++tag)
+    {
+        total += MemoryTracker::getInstance().GetTagStatistics((MemoryTag)tag).TotalAllocations;
+    }
+
+    const uint64_t allocations = total - previous;
+    previous = total;
+
+    return allocations;
+}
+
+//  Runs 'body' once more outside the timing and prints the heap allocations it made
+template <typename Body>
+static void PrintAllocations(const char *name, Body body)
+{
+    const uint64_t ITERATIONS = 1000;
+
+    CountAllocations();
+    body(ITERATIONS);
+
+    std::printf("%-40s %10.2f heap allocations\n", name, (double)CountAllocations() / ITERATIONS);
+}
+
+int main()
+{
+    const uint64_t ITERATIONS = 200000;
+
+    const String name = "VulkanRenderer";
+    const std::string stdName = "VulkanRenderer";
+    const char *const MESSAGE = "Failed to create graphics pipeline!\n";
+
+    //  Fits the inline storage of both
+    auto shortConcat = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            String text = String("id") + ":" + String((uint32_t)n);
+            DoNotOptimize(text);
+        }
+    };
+
+    auto stdShortConcat = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            std::string text = std::string("id") + ":" + std::to_string((uint32_t)n);
+            DoNotOptimize(text);
+        }
+    };
+
+    //  The shape LOG_*_F messages used to be built with, function + ": " + message + value + "\n"
+    auto chainedConcat = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            String text = name + ": " + MESSAGE + String((uint32_t)n) + "\n";
+            DoNotOptimize(text);
+        }
+    };
+
+    auto stdChainedConcat = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            std::string text = stdName + ": " + MESSAGE + std::to_string((uint32_t)n) + "\n";
+            DoNotOptimize(text);
+        }
+    };
+
+    //  Appending one piece at a time, capacity grows geometrically
+    auto append = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations / 100; ++n)
+        {
+            String text;
+
+            for (uint32_t i = 0; i < 100; ++i)
+            {
+                text += "line ";
+            }
+
+            DoNotOptimize(text);
+        }
+    };
+
+    auto stdAppend = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations / 100; ++n)
+        {
+            std::string text;
+
+            for (uint32_t i = 0; i < 100; ++i)
+            {
+                text += "line ";
+            }
+
+            DoNotOptimize(text);
+        }
+    };
+
+    //  What LOG_*_FMT_F does with its arguments, formatted into a stack buffer
+    auto format = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            char buffer[1024];
+            const uint32_t length =
+                Format(buffer, sizeof(buffer), "{}: Failed to create pipeline {} of {}\n", name, (uint32_t)n, 2.5);
+            DoNotOptimize(buffer);
+            DoNotOptimize(length);
+        }
+    };
+
+    auto printfFormat = [&](uint64_t iterations) {
+        for (uint64_t n = 0; n < iterations; ++n)
+        {
+            char buffer[1024];
+            const int length = snprintf(buffer, sizeof(buffer), "%s: Failed to create pipeline %u of %g\n",
+                                        name.GetData(), (uint32_t)n, 2.5);
+            DoNotOptimize(buffer);
+            DoNotOptimize(length);
+        }
+    };
+
+    const double stdShort = MeasureNanoseconds(ITERATIONS, stdShortConcat);
+    const double stdChained = MeasureNanoseconds(ITERATIONS, stdChainedConcat);
+    const double stdAppended = MeasureNanoseconds(ITERATIONS, stdAppend);
+    const double printfFormatted = MeasureNanoseconds(ITERATIONS, printfFormat);
+
+    PrintBenchmark("short concat (std::string)", stdShort);
+    PrintBenchmark("short concat", MeasureNanoseconds(ITERATIONS, shortConcat), stdShort);
+    PrintBenchmark("log message concat (std::string)", stdChained);
+    PrintBenchmark("log message concat", MeasureNanoseconds(ITERATIONS, chainedConcat), stdChained);
+    PrintBenchmark("append per piece (std::string)", stdAppended);
+    PrintBenchmark("append per piece", MeasureNanoseconds(ITERATIONS, append), stdAppended);
+    PrintBenchmark("log message format (snprintf)", printfFormatted);
+    PrintBenchmark("log message format", MeasureNanoseconds(ITERATIONS, format), printfFormatted);
+
+    PrintAllocations("short concat (std::string)", stdShortConcat);
+    PrintAllocations("short concat", shortConcat);
+    PrintAllocations("log message concat (std::string)", stdChainedConcat);
+    PrintAllocations("log message concat", chainedConcat);
+    PrintAllocations("append per piece (std::string)", stdAppend);
+    PrintAllocations("append per piece", append);
+    PrintAllocations("log message format", format);
+
+    return 0;
+}
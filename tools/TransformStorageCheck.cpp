@@ -0,0 +1,82 @@
+// Copyright (C) 2020 Dominik 'dreamsComeTrue' Jasiński
+
+//  Checks that TransformStorage::ComposeWorldMatrices writes the matrix of every entity when the work is split over
+//  1 to 4 workers, with entity counts that do not divide into four entities per worker. Exits with 1 and names the
+//  case when one fails.
+
+#include "core/JobSystem.h"
+#include "core/math/Matrix.h"
+#include "core/math/TransformStorage.h"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace aga;
+
+//  Every byte 0xFF is a NaN matrix, which composing never produces
+const uint8_t UNWRITTEN = 0xFF;
+
+static bool IsUnwritten(const Matrix &matrix)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&matrix);
+
+    for (uint32_t i = 0; i < sizeof(Matrix); ++i)
+    {
+        if (bytes[i] != UNWRITTEN)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main()
+{
+    const uint32_t MAX_WORKERS = 4;
+    //  Odd, so never a multiple of four entities per worker
+    const uint32_t COUNTS[] = {1, 3, 5, 2049, 32769, 65537, 100003};
+
+    for (uint32_t workers = 1; workers <= MAX_WORKERS; ++workers)
+    {
+        JobSystem::getInstance().Initialize(workers);
+
+        for (uint32_t count : COUNTS)
+        {
+            TransformStorage transforms;
+            transforms.Reserve(count);
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                const uint32_t index = transforms.Add(Vector3((real_t)i, 1.0f, 2.0f));
+                transforms.SetRotationAxisRadians(index, 0.001f * i, Vector3(0.0f, 1.0f, 0.0f));
+            }
+
+            std::vector<Matrix> composed(count);
+            std::vector<Matrix> expected(count);
+            memset(static_cast<void *>(composed.data()), UNWRITTEN, count * sizeof(Matrix));
+
+            transforms.ComposeWorldMatrices(composed.data(), sizeof(Matrix));
+            transforms.ComposeWorldMatrices(expected.data(), sizeof(Matrix), 0, count);
+
+            for (uint32_t i = 0; i < count; ++i)
+            {
+                if (memcmp(&composed[i], &expected[i], sizeof(Matrix)) != 0)
+                {
+                    std::printf("Check failed: entity %u of %u with %u worker(s) was %s\n", i, count, workers,
+                                IsUnwritten(composed[i]) ? "not written" : "wrong");
+                    JobSystem::getInstance().Destroy();
+
+                    return 1;
+                }
+            }
+        }
+
+        JobSystem::getInstance().Destroy();
+    }
+
+    std::printf("All checks passed\n");
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/bash
+
+# Command recording and frame times of the headless renderer with 1k, 10k and 100k draws per frame. Run it from the
+# build directory, an optional argument sets the number of frames rendered per scene size (default 1000).
+
+set -o pipefail
+
+FRAMES=${1:-1000}
+
+for DRAWS in 1000 10000 100000; do
+    echo "${DRAWS} draws, ${FRAMES} frames:"
+
+    if ! ./agaEngine --headless "${FRAMES}" --draws "${DRAWS}" | grep -E "Command recording|Frame time|throughput"; then
+        echo "agaEngine failed with ${DRAWS} draws"
+        exit 1
+    fi
+done